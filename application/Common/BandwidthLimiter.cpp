@@ -0,0 +1,298 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <BandwidthLimiter.h>
+using namespace Common;
+
+#include <cmath>
+
+#include <QMutexLocker>
+#include <QList>
+
+/**
+  * @class Common::BandwidthLimiter
+  *
+  * A token bucket limiting the throughput of a set of streams (for example all the uploads).
+  * There is a global rate and a rate for each peer, 0 means unlimited. During a period of the day (see 'setLimitedPeriod(..)')
+  * the global rate can be replaced by another one.
+  *
+  * Each stream has its own bucket: the global tokens are shared equally among the active streams instead of being taken by the
+  * streams asking first. The tokens a stream can't hold (its bucket is full because it's slower than its share) are given to the other
+  * streams. The streams of a same peer also share a bucket refilled with the rate per peer.
+  *
+  * A stream is identified by any pointer, typically the object doing the transfer. It asks some tokens with 'request(..)' or 'acquire(..)'
+  * before sending or receiving data and gives back with 'giveBack(..)' the ones it doesn't use.
+  * An instance of 'BandwidthLimiter' can be shared among several threads.
+  */
+
+/**
+  * @param clock The time used to produce the tokens, by default the time elapsed since the creation. Used by the tests.
+  */
+BandwidthLimiter::BandwidthLimiter(Clock clock) :
+   clock(clock),
+   lastRefill(0),
+   lastPeriodCheck(-1),
+   rate(0),
+   ratePerPeer(0),
+   rateDuringPeriod(0),
+   currentRate(0)
+{
+   this->timer.start();
+}
+
+/**
+  * @param rate [B/s], 0 means unlimited.
+  * @param ratePerPeer [B/s], 0 means unlimited.
+  */
+void BandwidthLimiter::setLimits(quint32 rate, quint32 ratePerPeer)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->rate = rate;
+   this->ratePerPeer = ratePerPeer;
+   this->lastPeriodCheck = -1;
+}
+
+/**
+  * Between 'begin' and 'end' the global rate is 'rate' [B/s] (0 means unlimited) instead of the one given to 'setLimits(..)'.
+  * The period can span midnight, if 'begin' equals 'end' there is no period.
+  */
+void BandwidthLimiter::setLimitedPeriod(const QTime& begin, const QTime& end, quint32 rate)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->periodBegin = begin;
+   this->periodEnd = end;
+   this->rateDuringPeriod = rate;
+   this->lastPeriodCheck = -1;
+}
+
+/**
+  * @return The current global rate [B/s], 0 if unlimited.
+  */
+quint32 BandwidthLimiter::getRate()
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->updateCurrentRate(this->getTime());
+   return this->currentRate;
+}
+
+/**
+  * Ask to transfer 'nbBytes' bytes, returns immediately.
+  * @param waitTime Set to the time [ms] to wait before asking again when no byte is granted.
+  * @return The number of bytes which can be transferred, from 0 to 'nbBytes'.
+  */
+int BandwidthLimiter::request(const void* stream, const Hash& peerID, int nbBytes, int& waitTime)
+{
+   QMutexLocker locker(&this->mutex);
+
+   waitTime = 0;
+
+   const qint64 now = this->getTime();
+   this->refill(now);
+
+   if (this->currentRate == 0 && this->ratePerPeer == 0)
+      return nbBytes;
+
+   QHash<const void*, Stream>::iterator s = this->streams.find(stream);
+   if (s == this->streams.end())
+   {
+      s = this->streams.insert(stream, Stream());
+      s->peerID = peerID;
+      this->peers[peerID].nbStreams++;
+   }
+   s->lastRequest = now;
+   Peer& peer = this->peers[s->peerID];
+
+   double available = nbBytes;
+   if (this->currentRate != 0)
+      available = qMin(available, s->tokens);
+   if (this->ratePerPeer != 0)
+      available = qMin(available, peer.tokens);
+
+   const int minimum = qMin(nbBytes, static_cast<int>(MIN_QUANTUM));
+   if (available < minimum)
+   {
+      double t = 0.0; // [ms].
+      if (this->currentRate != 0 && s->tokens < minimum)
+         t = (minimum - s->tokens) * 1000.0 * this->streams.size() / this->currentRate;
+      if (this->ratePerPeer != 0 && peer.tokens < minimum)
+         t = qMax(t, (minimum - peer.tokens) * 1000.0 * peer.nbStreams / this->ratePerPeer);
+      waitTime = qBound(1, static_cast<int>(std::ceil(t)), static_cast<int>(MAX_WAIT_TIME));
+      return 0;
+   }
+
+   const int allowed = static_cast<int>(available);
+   if (this->currentRate != 0)
+      s->tokens -= allowed;
+   if (this->ratePerPeer != 0)
+      peer.tokens -= allowed;
+
+   return allowed;
+}
+
+/**
+  * Like 'request(..)' but if no byte can be transferred wait for some tokens during at most 'MAX_WAIT_TIME' ms.
+  * Used by the blocking transfers, they should check if they have been stopped when 0 is returned.
+  * @return The number of bytes which can be transferred, from 0 to 'nbBytes'.
+  */
+int BandwidthLimiter::acquire(const void* stream, const Hash& peerID, int nbBytes)
+{
+   int waitTime;
+   const int allowed = this->request(stream, peerID, nbBytes, waitTime);
+   if (allowed != 0)
+      return allowed;
+
+   this->mutex.lock();
+   this->tokensGivenBack.wait(&this->mutex, waitTime);
+   this->mutex.unlock();
+
+   return this->request(stream, peerID, nbBytes, waitTime);
+}
+
+/**
+  * Give back the bytes granted by 'request(..)' or 'acquire(..)' which haven't been transferred.
+  */
+void BandwidthLimiter::giveBack(const void* stream, int nbBytes)
+{
+   QMutexLocker locker(&this->mutex);
+
+   QHash<const void*, Stream>::iterator s = this->streams.find(stream);
+   if (s == this->streams.end() || nbBytes <= 0)
+      return;
+
+   if (this->currentRate != 0)
+      s->tokens += nbBytes;
+   if (this->ratePerPeer != 0)
+      this->peers[s->peerID].tokens += nbBytes;
+
+   this->tokensGivenBack.wakeAll();
+}
+
+/**
+  * Must be called when a stream is over, its share is given to the other streams.
+  */
+void BandwidthLimiter::removeStream(const void* stream)
+{
+   QMutexLocker locker(&this->mutex);
+
+   QHash<const void*, Stream>::iterator s = this->streams.find(stream);
+   if (s != this->streams.end())
+      this->eraseStream(s);
+}
+
+/**
+  * @return [ns].
+  */
+qint64 BandwidthLimiter::getTime() const
+{
+   return this->clock ? this->clock() : this->timer.nsecsElapsed();
+}
+
+/**
+  * Give the tokens produced since the last refill to the active streams.
+  * @param now [ns].
+  */
+void BandwidthLimiter::refill(qint64 now)
+{
+   const qint64 dt = now - this->lastRefill; // [ns].
+   if (dt <= 0)
+      return;
+   this->lastRefill = now;
+
+   this->updateCurrentRate(now);
+
+   for (QHash<const void*, Stream>::iterator s = this->streams.begin(); s != this->streams.end();)
+   {
+      if (now - s->lastRequest > STREAM_LIFETIME * 1000000LL)
+         s = this->eraseStream(s);
+      else
+         ++s;
+   }
+
+   if (this->ratePerPeer != 0)
+   {
+      const double capacity = qMax(double(this->ratePerPeer) * BURST_DURATION / 1000, double(MIN_QUANTUM));
+      for (QHash<Hash, Peer>::iterator p = this->peers.begin(); p != this->peers.end(); ++p)
+         p->tokens = qMin(p->tokens + double(this->ratePerPeer) * dt / 1000000000, capacity);
+   }
+
+   if (this->currentRate != 0 && !this->streams.isEmpty())
+   {
+      const double capacity = qMax(double(this->currentRate) / this->streams.size() * BURST_DURATION / 1000, double(MIN_QUANTUM));
+      double tokens = double(this->currentRate) * dt / 1000000000;
+
+      QList<Stream*> hungryStreams;
+      for (QHash<const void*, Stream>::iterator s = this->streams.begin(); s != this->streams.end(); ++s)
+      {
+         if (s->tokens < capacity)
+            hungryStreams << &s.value();
+         else
+            s->tokens = capacity;
+      }
+
+      // The tokens a stream can't hold are shared among the other ones.
+      while (tokens > 0.0 && !hungryStreams.isEmpty())
+      {
+         const double share = tokens / hungryStreams.size();
+         tokens = 0.0;
+         for (QList<Stream*>::iterator s = hungryStreams.begin(); s != hungryStreams.end();)
+         {
+            (*s)->tokens += share;
+            if ((*s)->tokens >= capacity)
+            {
+               tokens += (*s)->tokens - capacity;
+               (*s)->tokens = capacity;
+               s = hungryStreams.erase(s);
+            }
+            else
+               ++s;
+         }
+      }
+   }
+}
+
+void BandwidthLimiter::updateCurrentRate(qint64 now)
+{
+   if (this->lastPeriodCheck != -1 && now - this->lastPeriodCheck < PERIOD_CHECK * 1000000LL)
+      return;
+   this->lastPeriodCheck = now;
+
+   this->currentRate = this->isInLimitedPeriod(QTime::currentTime()) ? this->rateDuringPeriod : this->rate;
+}
+
+bool BandwidthLimiter::isInLimitedPeriod(const QTime& time) const
+{
+   if (!this->periodBegin.isValid() || !this->periodEnd.isValid() || this->periodBegin == this->periodEnd)
+      return false;
+
+   if (this->periodBegin < this->periodEnd)
+      return time >= this->periodBegin && time < this->periodEnd;
+   else
+      return time >= this->periodBegin || time < this->periodEnd;
+}
+
+QHash<const void*, BandwidthLimiter::Stream>::iterator BandwidthLimiter::eraseStream(QHash<const void*, Stream>::iterator stream)
+{
+   QHash<Hash, Peer>::iterator peer = this->peers.find(stream->peerID);
+   if (peer != this->peers.end() && --peer->nbStreams <= 0)
+      this->peers.erase(peer);
+
+   return this->streams.erase(stream);
+}
@@ -0,0 +1,98 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#ifndef COMMON_BANDWIDTHLIMITER_H
+#define COMMON_BANDWIDTHLIMITER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QTime>
+#include <QHash>
+
+#include <functional>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace Common
+{
+   class BandwidthLimiter : Common::Uncopyable
+   {
+      static const int BURST_DURATION = 100; ///< [ms]. The tokens of a stream can't exceed the amount of data it can transfer during this period.
+      static const int MIN_QUANTUM = 4096; ///< [byte]. A stream waits to have at least this amount of tokens, or the amount it asks if smaller.
+      static const int STREAM_LIFETIME = 1000; ///< [ms]. A stream which doesn't ask any token during this period isn't active anymore.
+      static const int MAX_WAIT_TIME = 100; ///< [ms].
+      static const int PERIOD_CHECK = 1000; ///< [ms]. The time of day is checked at this interval to know if we are in the limited period.
+
+   public:
+      typedef std::function<qint64()> Clock; ///< Returns a monotonic time [ns].
+
+      BandwidthLimiter(Clock clock = nullptr);
+
+      void setLimits(quint32 rate, quint32 ratePerPeer);
+      void setLimitedPeriod(const QTime& begin, const QTime& end, quint32 rate);
+      quint32 getRate();
+
+      int request(const void* stream, const Hash& peerID, int nbBytes, int& waitTime);
+      int acquire(const void* stream, const Hash& peerID, int nbBytes);
+      void giveBack(const void* stream, int nbBytes);
+      void removeStream(const void* stream);
+
+   private:
+      struct Stream
+      {
+         Stream() : tokens(0), lastRequest(0) {}
+         Hash peerID;
+         double tokens; ///< [byte].
+         qint64 lastRequest; ///< [ns].
+      };
+
+      struct Peer
+      {
+         Peer() : tokens(0), nbStreams(0) {}
+         double tokens; ///< [byte].
+         int nbStreams;
+      };
+
+      qint64 getTime() const;
+      void refill(qint64 now);
+      void updateCurrentRate(qint64 now);
+      bool isInLimitedPeriod(const QTime& time) const;
+      QHash<const void*, Stream>::iterator eraseStream(QHash<const void*, Stream>::iterator stream);
+
+      QMutex mutex;
+      QWaitCondition tokensGivenBack;
+      const Clock clock; ///< Replaces 'timer' if defined.
+      QElapsedTimer timer;
+      qint64 lastRefill; ///< [ns].
+      qint64 lastPeriodCheck; ///< [ns], -1 if the current rate must be updated.
+
+      quint32 rate; ///< [B/s], 0 means unlimited.
+      quint32 ratePerPeer; ///< [B/s], 0 means unlimited.
+      QTime periodBegin;
+      QTime periodEnd;
+      quint32 rateDuringPeriod; ///< [B/s], replaces 'rate' between 'periodBegin' and 'periodEnd'.
+      quint32 currentRate;
+
+      QHash<const void*, Stream> streams;
+      QHash<Hash, Peer> peers;
+   };
+}
+
+#endif
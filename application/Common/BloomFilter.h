@@ -19,70 +19,90 @@
 #ifndef COMMON_BLOOMFILTER_H
 #define COMMON_BLOOMFILTER_H
 
-#include <qmath.h>
+#include <atomic>
+#include <cstring>
 
 #include <Common/Hash.h>
+#include <Common/Uncopyable.h>
 
 /**
   * @class Common::BloomFilter
-  * A very simple bloom filter implementation for the class 'Common::Hash'.
-  * Calibrated by default for n = 100'000 hashes (~6.1 TiB of chunks) and p = 0.006 (probability of false positive).
+  * A blocked bloom filter for the class 'Common::Hash', sized for a given number of hashes (the capacity).
   *
-  * We don't use any hash functions to compute the positions, instead we use part of the hash. See the 'position(..)' function.
+  * Each hash sets 'K' bits in only one block of 512 bits, a block is a cache line thus a test costs at most one cache miss.
+  * With 16 bits per hash the probability of false positive is about 0.002 as long as the size doesn't exceed the capacity,
+  * above that the filter saturates: the owner must build a larger one, see 'getSize()'.
   *
-  * More information: http://en.wikipedia.org/wiki/Bloom_filter
+  * We don't use any hash functions to compute the positions, instead we use the last eight bytes of the hash:
+  * bytes 12 to 15 choose the block and bytes 16 to 19 the bits in the block (double hashing). See the 'block(..)' and 'bits(..)' functions.
   *
-  * Description of the parameters:
-  *  - 'w' Is the number of bit allocated to compute a position in the filter. Thus the filter size (in bits) is 2^w. The default size (w = 20) takes 128 KiB of memory.
-  *  - w * k must be lower or equal than 8 * HASH_SIZE because we extract each 'k' positions from the hash data.
-  *  - 'w' must be lower or equal than 32 bits,
+  * 'add(..)' and 'test(..)' can be called concurrently, the bits are set atomically.
+  * 'reset()' mustn't be called concurrently with them.
   *
-  * @remarks (x >> 3) is used as a division by 8.
+  * More information: http://en.wikipedia.org/wiki/Bloom_filter
   */
 
 namespace Common
 {
-   class BloomFilter
+   class BloomFilter : Uncopyable
    {
    public:
-      BloomFilter(int w = 20, int n = 100000) :
-         w(w), m(qPow(2, w)), k(qLn(2) * m / n), wMask((1 << this->w) - 1)
+      BloomFilter(int capacity = 100000) :
+         capacity(capacity),
+         nbBlocks(qMax(1, capacity * BITS_PER_HASH / BLOCK_SIZE)),
+         memory(new std::atomic<quint64>[nbBlocks * WORDS_PER_BLOCK + WORDS_PER_BLOCK - 1]()),
+         words(memory + (WORDS_PER_BLOCK - reinterpret_cast<quintptr>(memory) / sizeof(quint64) % WORDS_PER_BLOCK) % WORDS_PER_BLOCK),
+         size(0)
       {
-         this->bitArray = new uchar[this->m >> 3]();
       }
 
       ~BloomFilter()
       {
-         delete[] this->bitArray;
+         delete[] this->memory;
       }
 
       inline void add(const Hash& hash);
       inline bool test(const Hash& hash) const;
       inline void reset();
 
-   private:
       /**
-        * Returns the position value of 'i',  0 <= i <= k.
+        * The number of hashes the filter has been sized for.
+        */
+      inline int getCapacity() const { return this->capacity; }
+
+      /**
+        * The number of calls to 'add(..)' since the creation or the last reset.
         */
-      inline quint32 position(const Hash& hash, int i) const;
+      inline int getSize() const { return this->size.load(std::memory_order_relaxed); }
+
+   private:
+      static const int BLOCK_SIZE = 512; // [bit].
+      static const int WORDS_PER_BLOCK = BLOCK_SIZE / 64;
+      static const int BITS_PER_HASH = 16;
+      static const int K = 8; // Number of bits set per hash.
 
-      const int w;
-      const int m; // Total number of positions.
-      const int k; // Number of positions set per hash: ln(2) * m / n.
+      inline std::atomic<quint64>* block(const Hash& hash) const;
+      inline void bits(const Hash& hash, quint64 mask[WORDS_PER_BLOCK]) const;
 
-      const quint32 wMask;
+      const int capacity;
+      const quint32 nbBlocks;
 
-      uchar* bitArray;
+      std::atomic<quint64>* const memory;
+      std::atomic<quint64>* const words; // Aligned on a block.
+
+      std::atomic<int> size;
    };
 }
 
 inline void Common::BloomFilter::add(const Hash& hash)
 {
-   for (int i = 0; i < k; i++)
-   {
-      const quint32 p = position(hash, i);
-      this->bitArray[p >> 3] |= 1 << (p % 8);
-   }
+   std::atomic<quint64>* block = this->block(hash);
+   quint64 mask[WORDS_PER_BLOCK];
+   this->bits(hash, mask);
+   for (int i = 0; i < WORDS_PER_BLOCK; i++)
+      if (mask[i] != 0)
+         block[i].fetch_or(mask[i], std::memory_order_relaxed);
+   this->size.fetch_add(1, std::memory_order_relaxed);
 }
 
 /**
@@ -90,26 +110,44 @@ inline void Common::BloomFilter::add(const Hash& hash)
   */
 inline bool Common::BloomFilter::test(const Hash& hash) const
 {
-   for (int i = 0; i < k; i++)
-   {
-      const quint32 p = position(hash, i);
-      if ((this->bitArray[p >> 3] & 1 << (p % 8)) == 0)
+   const std::atomic<quint64>* block = this->block(hash);
+   quint64 mask[WORDS_PER_BLOCK];
+   this->bits(hash, mask);
+   for (int i = 0; i < WORDS_PER_BLOCK; i++)
+      if ((block[i].load(std::memory_order_relaxed) & mask[i]) != mask[i])
          return false;
-   }
    return true;
 }
 
 inline void Common::BloomFilter::reset()
 {
-   memset(this->bitArray, 0, sizeof(uchar) * (this->m >> 3));
+   for (quint32 i = 0; i < this->nbBlocks * WORDS_PER_BLOCK; i++)
+      this->words[i].store(0, std::memory_order_relaxed);
+   this->size.store(0, std::memory_order_relaxed);
+}
+
+inline std::atomic<quint64>* Common::BloomFilter::block(const Hash& hash) const
+{
+   quint32 word;
+   memcpy(&word, hash.getData() + 12, sizeof(word));
+   return this->words + (static_cast<quint64>(word) * this->nbBlocks >> 32) * WORDS_PER_BLOCK;
 }
 
-inline quint32 Common::BloomFilter::position(const Hash& hash, int i) const
+inline void Common::BloomFilter::bits(const Hash& hash, quint64 mask[WORDS_PER_BLOCK]) const
 {
-   const char* hashData = hash.getData();
-   const quint32 pPos = i * this->w; // Position in 'hashData' of 'p'.
-   const quint32* p = reinterpret_cast<const quint32*>(hashData + (pPos >> 3));   
-   return *p >> (32 - this->w - pPos % 8) & this->wMask;
+   quint32 word;
+   memcpy(&word, hash.getData() + 16, sizeof(word));
+
+   // The step is odd thus the 'K' positions are all different.
+   const quint32 first = word % BLOCK_SIZE;
+   const quint32 step = (word / BLOCK_SIZE) | 1;
+
+   memset(mask, 0, WORDS_PER_BLOCK * sizeof(quint64));
+   for (int i = 0; i < K; i++)
+   {
+      const quint32 p = (first + i * step) % BLOCK_SIZE;
+      mask[p / 64] |= static_cast<quint64>(1) << (p % 64);
+   }
 }
 
 #endif
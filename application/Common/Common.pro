@@ -19,10 +19,16 @@ INCLUDEPATH += . ..
 DEFINES += COMMON_LIBRARY
 
 SOURCES += Hash.cpp \
+    HashAlgorithms/SHA1.cpp \
+    HashAlgorithms/SHA1X86.cpp \
+    HashAlgorithms/SHA1ARM.cpp \
+    HashAlgorithms/BLAKE3.cpp \
+    HashAlgorithms/BLAKE3X86.cpp \
     Global.cpp \
     ZeroCopyStreamQIODevice.cpp \
     Settings.cpp \
     TransferRateCalculator.cpp \
+    BandwidthLimiter.cpp \
     ProtoHelper.cpp \
     Timeoutable.cpp \
     PersistentData.cpp \
@@ -42,12 +48,15 @@ SOURCES += Hash.cpp \
 
 HEADERS += Hashes.h \
     Hash.h \
+    HashAlgorithms/SHA1.h \
+    HashAlgorithms/BLAKE3.h \
     Constants.h \
     Global.h \
     Uncopyable.h \
     ZeroCopyStreamQIODevice.h \
     Settings.h \
     TransferRateCalculator.h \
+    BandwidthLimiter.h \
     ProtoHelper.h \
     Timeoutable.h \
     Version.h \
@@ -66,6 +75,7 @@ HEADERS += Hashes.h \
     ConsoleReader.h \
     StringUtils.h \
     BloomFilter.h \
+    HashesDigest.h \
     Network/Message.h \
     KnownExtensions.h \
     Containers/Tree.h \
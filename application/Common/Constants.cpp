@@ -19,7 +19,7 @@
 #include <Common/Constants.h>
 using namespace Common;
 
-const quint32 Constants::PROTOCOL_VERSION { 4 };
+const quint32 Constants::PROTOCOL_VERSION { 5 };
 
 #ifdef Q_OS_WIN32
    const QString Constants::APPLICATION_FOLDER_NAME("D-LAN");
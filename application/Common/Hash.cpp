@@ -26,54 +26,27 @@ using namespace Common;
   * @class Common::Hash
   *
   * An Über-optimized hash.
+  *
+  * The 20 bytes are held inline, a hash doesn't allocate any memory and can be freely copied between threads.
+  * The special value with all bytes to 0 is the null hash.
   */
 
 MTRand Hash::mtrand;
 
 const char Hash::NULL_HASH[HASH_SIZE] = {};
 
-/**
-  * Build a new empty hash, its value is set to 0.
-  */
-Hash::Hash() :
-   data(nullptr)
-{
-}
-
-/**
-  * Build a new hash from an existing one.
-  * The data are shared between both.
-  */
-Hash::Hash(const Hash& h)
-{
-   this->data = h.data;
-   if (this->data)
-      this->data->nbRef += 1;
-}
-
-Hash::Hash(Hash&& h)
-{
-   this->data = h.data;
-   h.data = nullptr;
-}
-
 /**
   * Build a new hash from a char*, 'h' is not a readable string, @see fromStr.
   * 'h' must have a length equal or bigger to HASH_SIZE!
   * The data are copied, no pointer is keept to 'h'.
-  * 'h' can be a null pointer, in this case a null hashe will be built.
+  * 'h' can be a null pointer, in this case a null hash is built.
   */
 Hash::Hash(const char* h)
 {
-   Q_ASSERT(h);
-
-   if (h == nullptr || memcmp(h, NULL_HASH, Hash::HASH_SIZE) == 0)
-      this->data = nullptr;
+   if (h == nullptr)
+      memset(this->data, 0, HASH_SIZE);
    else
-   {
-      this->newData();
-      memcpy(this->data->hash, h, HASH_SIZE);
-   }
+      memcpy(this->data, h, HASH_SIZE);
 }
 
 /**
@@ -88,13 +61,10 @@ Hash::Hash(const char* h)
   */
 Hash::Hash(const std::string& str)
 {
-   if (str.size() == 0 || static_cast<int>(str.size()) != HASH_SIZE || memcmp(str.data(), NULL_HASH, Hash::HASH_SIZE) == 0)
-      this->data = nullptr;
+   if (static_cast<int>(str.size()) != HASH_SIZE)
+      memset(this->data, 0, HASH_SIZE);
    else
-   {
-      this->newData();
-      memcpy(this->data->hash, str.data(), HASH_SIZE);
-   }
+      memcpy(this->data, str.data(), HASH_SIZE);
 }
 
 /**
@@ -106,44 +76,10 @@ Hash::Hash(const QByteArray& a)
 {   
    Q_ASSERT_X(a.size() == HASH_SIZE, "Hash::Hash", QString("The given QByteArray must have a size of %1").arg(HASH_SIZE).toUtf8().constData());
 
-   if (a.isNull() || a.size() != HASH_SIZE || memcmp(a.constData(), NULL_HASH, Hash::HASH_SIZE) == 0)
-      this->data = nullptr;
+   if (a.size() != HASH_SIZE)
+      memset(this->data, 0, HASH_SIZE);
    else
-   {
-      this->newData();
-      memcpy(this->data->hash, a.constData(), HASH_SIZE);
-   }
-}
-
-/**
-  * Remove its reference to the shared data, if its the last
-  * then delete the data.
-  */
-Hash::~Hash()
-{
-   this->dereference();
-}
-
-/**
-  * Assign the data of a another hash.
-  * The data are shared.
-  */
-Hash& Hash::operator=(const Hash& h)
-{
-   if (&h != this && h.data != this->data)
-   {
-      this->dereference();
-      this->data = h.data;
-      if (this->data)
-         this->data->nbRef += 1;
-   }
-   return *this;
-}
-
-Hash& Hash::operator=(Hash&& h)
-{
-   qSwap(this->data, h.data);
-   return *this;
+      memcpy(this->data, a.constData(), HASH_SIZE);
 }
 
 /**
@@ -154,7 +90,7 @@ Hash& Hash::operator=(Hash&& h)
 QString Hash::toStr() const
 {
    QString ret(2 * HASH_SIZE);
-   const char* hashData = this->data ? this->data->hash : NULL_HASH;
+   const char* hashData = this->data;
 
    for (int i = 0; i < HASH_SIZE; i++)
    {
@@ -180,7 +116,7 @@ QString Hash::toStr() const
   */
 QString Hash::toStrCArray() const
 {
-   const char* hashData = this->data ? this->data->hash : NULL_HASH;
+   const char* hashData = this->data;
 
    QString str("{");
    for (int i = 0; i < HASH_SIZE; i++)
@@ -193,23 +129,14 @@ QString Hash::toStrCArray() const
    return str;
 }
 
-/**
-  * The special hash value with all bytes to 0 is defined as a null value.
-  */
-bool Hash::isNull() const
-{
-   return this->data == nullptr;
-}
-
 /**
   * Return a new rand hash.
   */
 Hash Hash::rand()
 {
    Hash hash;
-   hash.newData();
    for (int i = 0; i < HASH_SIZE; i++)
-      hash.data->hash[i] = static_cast<char>(Hash::mtrand.randInt(255));
+      hash.data[i] = static_cast<char>(Hash::mtrand.randInt(255));
    return hash;
 }
 
@@ -217,9 +144,8 @@ Hash Hash::rand(quint32 seed)
 {
    MTRand mtrand(seed);
    Hash hash;
-   hash.newData();
    for (int i = 0; i < HASH_SIZE; i++)
-      hash.data->hash[i] = static_cast<char>(mtrand.randInt(255));
+      hash.data[i] = static_cast<char>(mtrand.randInt(255));
    return hash;
 }
 
@@ -233,7 +159,6 @@ Hash Hash::fromStr(const QString& str)
    Q_ASSERT_X(str.size() == 2 * HASH_SIZE, "Hash::fromStr", "The string representation of an hash must have twice as character as the size (in byte) of the hash.");
 
    Hash hash;
-   hash.newData();
    const QString strLower = str.toLower();
 
    for (int i = 0; i < HASH_SIZE && 2*i + 1 < strLower.size(); i++)
@@ -244,7 +169,7 @@ Hash Hash::fromStr(const QString& str)
       char p1 = c1 <= '9' ? c1 - '0' : c1 - 'a' + 10;
       char p2 = c2 <= '9' ? c2 - '0' : c2 - 'a' + 10;
 
-      hash.data->hash[i] = (p1 << 4 & 0xF0) | (p2 & 0x0F);
+      hash.data[i] = (p1 << 4 & 0xF0) | (p2 & 0x0F);
    }
 
    return hash;
@@ -256,14 +181,20 @@ Hash Hash::fromStr(const QString& str)
   * @class Common::Hasher
   *
   * To create hash from row data.
+  * The SHA-1 implementation is chosen at runtime depending of the CPU capabilities, see 'SHA1'.
+  * The hashes of the chunks may use BLAKE3 instead, see the setting 'chunk_hash_algorithm'. The static methods always use SHA-1.
   */
 
 MTRand Hasher::mtrand;
 
-Hasher::Hasher() :
-   cryptographicHash(QCryptographicHash::Sha1)
+Hasher::Hasher(HashAlgorithm algorithm) :
+   algorithm(algorithm)
+{
+}
+
+HashAlgorithm Hasher::getAlgorithm() const
 {
-   this->reset();
+   return this->algorithm;
 }
 
 /**
@@ -290,10 +221,10 @@ Hasher::Hasher() :
 
 void Hasher::addSalt(quint64 salt)
 {
-   QByteArray saltArray(8, 0);
+   char saltArray[8];
    for (int i = 0; i < 8; i++)
       saltArray[i] = salt >> (8*i) & 0xFF;
-   this->cryptographicHash.addData(saltArray);
+   this->addData(saltArray, sizeof(saltArray));
 }
 
 /**
@@ -305,20 +236,38 @@ void Hasher::addData(const char* data, int size)
    Q_ASSERT(data);
    Q_ASSERT(size >= 0);
 
-   this->cryptographicHash.addData(data, size);
+   switch (this->algorithm)
+   {
+   case HashAlgorithm::SHA1:
+      this->sha1.addData(data, size);
+      break;
+   case HashAlgorithm::BLAKE3:
+      this->blake3.addData(data, size);
+      break;
+   }
 }
 
 Hash Hasher::getResult()
 {
    Hash result;
-   result.newData();
-   memcpy(result.data->hash, this->cryptographicHash.result().constData(), Hash::HASH_SIZE);
+
+   switch (this->algorithm)
+   {
+   case HashAlgorithm::SHA1:
+      this->sha1.getResult(result.data);
+      break;
+   case HashAlgorithm::BLAKE3:
+      this->blake3.getResult(result.data, Hash::HASH_SIZE);
+      break;
+   }
+
    return result;
 }
 
 void Hasher::reset()
 {
-   this->cryptographicHash.reset();
+   this->sha1.reset();
+   this->blake3.reset();
 }
 
 Common::Hash Hasher::hash(const QString& str)
@@ -19,22 +19,19 @@
 #ifndef COMMON_HASH_H
 #define COMMON_HASH_H
 
-#define WITH_MUTEX false // Not implemented. Using a 'QAtomicPointer' instead of a mutex should be better.
-
+#include <cstring>
 #include <string>
 
 #include <QString>
 #include <QByteArray>
 #include <QDataStream>
-#include <QCryptographicHash>
+#include <QtEndian>
 
 #include <Libs/MersenneTwister.h>
 
-#if WITH_MUTEX
-#  include <QMutex>
-#endif
-
 #include <Common/Uncopyable.h>
+#include <Common/HashAlgorithms/SHA1.h>
+#include <Common/HashAlgorithms/BLAKE3.h>
 
 namespace Common
 {
@@ -45,35 +42,36 @@ namespace Common
 
    public:
       static const int HASH_SIZE = 20;
+      static const int PREFIX_SIZE = 8;
 
    private:
       static const char NULL_HASH[HASH_SIZE];
 
    public:
-
-      Hash();
-      Hash(const Hash& h);
-      Hash(Hash&& h);
+      /**
+        * Build a null hash, all its bytes are 0.
+        */
+      constexpr Hash() : data() {}
 
       explicit Hash(const char* h); // It's too dangerous to construct an implicit Hash from a const char*.
       Hash(const std::string& str);
       Hash(const QByteArray& a);
 
-      ~Hash();
-
-      Hash& operator=(const Hash& h);
-      Hash& operator=(Hash&& h);
-
       /**
         * Return a pointer to its internal data.
         * The length of the returned value is exactly HASH_SIZE.
         */
-      inline const char* getData() const { return this->data ? this->data->hash : NULL_HASH; }
-      inline QByteArray getByteArray() const { return QByteArray(this->data ? this->data->hash : NULL_HASH, HASH_SIZE); }
+      inline const char* getData() const { return this->data; }
+      inline QByteArray getByteArray() const { return QByteArray(this->data, HASH_SIZE); }
+
+      /**
+        * The first 'PREFIX_SIZE' bytes read as a little-endian integer, it identifies a hash in the compact messages of the protocol.
+        */
+      inline quint64 getPrefix() const { return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(this->data)); }
 
       QString toStr() const;
       QString toStrCArray() const;
-      bool isNull() const;
+      inline bool isNull() const { return memcmp(this->data, NULL_HASH, HASH_SIZE) == 0; }
 
       static Hash rand();
       static Hash rand(quint32 seed);
@@ -81,49 +79,22 @@ namespace Common
       static Hash fromStr(const QString& str);
 
    private:
-      inline void dereference();
-      inline void newData();
-
       friend QDataStream& operator>>(QDataStream&, Hash&);
-      friend QDataStream& operator<<(QDataStream& stream, const Hash& hash);
-      friend bool operator==(const Hash& h1, const Hash& h2);
       friend class Hasher;
 
-      struct SharedData
-      {
-#if WITH_MUTEX
-         QMutex mutex;
-#endif
-         int nbRef;
-         char hash[HASH_SIZE];
-      };
-
-      SharedData* data;
+      char data[HASH_SIZE];
    };
 
+   static_assert(sizeof(Hash) == Hash::HASH_SIZE, "A hash must only contain its data");
+
    /**
      * It will read an hash from a data stream and modify the given hash.
      */
    inline QDataStream& operator>>(QDataStream& stream, Hash& hash)
    {
       char data[Hash::HASH_SIZE];
-      if (stream.readRawData(data, Hash::HASH_SIZE) != Hash::HASH_SIZE)
-         return stream;
-
-      if (memcmp(Hash::NULL_HASH, data, Hash::HASH_SIZE) == 0)
-      {
-         if (hash.data)
-         {
-            hash.dereference();
-            hash.data = 0;
-         }
-      }
-      else if (!hash.data || memcmp(hash.data->hash, data, Hash::HASH_SIZE) != 0)
-      {
-         hash.dereference();
-         hash.newData();
-         memcpy(hash.data->hash, data, Hash::HASH_SIZE);
-      }
+      if (stream.readRawData(data, Hash::HASH_SIZE) == Hash::HASH_SIZE)
+         memcpy(hash.data, data, Hash::HASH_SIZE);
 
       return stream;
    }
@@ -133,17 +104,13 @@ namespace Common
      */
    inline QDataStream& operator<<(QDataStream& stream, const Hash& hash)
    {
-      if (hash.data)
-         stream.writeRawData(hash.data->hash, Hash::HASH_SIZE);
-      else
-         stream.writeRawData(Hash::NULL_HASH, Hash::HASH_SIZE);
-
+      stream.writeRawData(hash.getData(), Hash::HASH_SIZE);
       return stream;
    }
 
    inline bool operator==(const Hash& h1, const Hash& h2)
    {
-      return h1.data == h2.data || memcmp(h1.getData(), h2.getData(), Hash::HASH_SIZE) == 0;
+      return memcmp(h1.getData(), h2.getData(), Hash::HASH_SIZE) == 0;
    }
 
    inline bool operator!=(const Hash& h1, const Hash& h2)
@@ -158,22 +125,32 @@ namespace Common
 
    /**
      * Used by QHash.
+     * All the bytes are folded, two hashes differing only by their last bytes don't collide.
      */
    inline uint qHash(const Hash& h)
    {
-      // Take the first sizeof(uint) bytes of the hash data.
-      if (h.isNull())
-         return 0;
-      else
-         return *(const uint*)(h.getData());
+      quint32 words[Hash::HASH_SIZE / 4];
+      memcpy(words, h.getData(), Hash::HASH_SIZE);
+      return words[0] ^ (words[1] << 7 | words[1] >> 25) ^ (words[2] << 13 | words[2] >> 19) ^ (words[3] << 19 | words[3] >> 13) ^ (words[4] << 25 | words[4] >> 7);
    }
 
+   /**
+     * The values must match 'Protos::Common::Hash::Algorithm'.
+     */
+   enum class HashAlgorithm
+   {
+      SHA1 = 0,
+      BLAKE3 = 1
+   };
+
    class Hasher : Uncopyable
    {
       static MTRand mtrand;
 
    public:
-      Hasher();
+      Hasher(HashAlgorithm algorithm = HashAlgorithm::SHA1);
+      HashAlgorithm getAlgorithm() const;
+
       // void addPredefinedSalt(); Deprecated.
       void addSalt(quint64 salt);
       void addData(const char*, int size);
@@ -188,25 +165,13 @@ namespace Common
       static Common::Hash hashWithRandomSalt(const Common::Hash& hash, quint64& salt);
 
    private:
-      QCryptographicHash cryptographicHash;
+      const HashAlgorithm algorithm;
+      SHA1 sha1;
+      BLAKE3 blake3;
    };
 }
 
-inline void Common::Hash::dereference()
-{
-   if (this->data)
-   {
-      this->data->nbRef -= 1;
-      if (this->data->nbRef == 0)
-         delete this->data;
-   }
-}
-
-inline void Common::Hash::newData()
-{
-   this->data = new SharedData;
-   this->data->nbRef = 1;
-}
+Q_DECLARE_TYPEINFO(Common::Hash, Q_PRIMITIVE_TYPE);
 
 #endif
 
@@ -0,0 +1,289 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Common/HashAlgorithms/BLAKE3.h>
+using namespace Common;
+
+#include <cstring>
+
+/**
+  * @class Common::BLAKE3
+  *
+  * An implementation of the BLAKE3 hash function (the successor of BLAKE, see 'prototypes/11_BLAKE').
+  * The input is split in chunks of 1 KiB which are the leaves of a binary tree, the chunks are independent
+  * thus eight of them are hashed at the same time with AVX2 when it's available, see 'BLAKE3X86.cpp'.
+  *
+  * Only the non-keyed mode is implemented. By default the result is truncated to 'HASH_SIZE' bytes,
+  * it's a prefix of the standard 32 bytes BLAKE3 hash.
+  */
+
+namespace
+{
+   const quint32 IV[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+   // The message words used by each round, the permutation is applied once per round.
+   const int MSG_SCHEDULE[7][16] = {
+      { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+      { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+      { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+      { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+      { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+      { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+      { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+   };
+
+   inline quint32 rotr(quint32 x, int n)
+   {
+      return x >> n | x << (32 - n);
+   }
+
+   inline void g(quint32 v[16], int a, int b, int c, int d, quint32 mx, quint32 my)
+   {
+      v[a] = v[a] + v[b] + mx;
+      v[d] = rotr(v[d] ^ v[a], 16);
+      v[c] = v[c] + v[d];
+      v[b] = rotr(v[b] ^ v[c], 12);
+      v[a] = v[a] + v[b] + my;
+      v[d] = rotr(v[d] ^ v[a], 8);
+      v[c] = v[c] + v[d];
+      v[b] = rotr(v[b] ^ v[c], 7);
+   }
+
+   inline void readWords(const uchar* bytes, int size, quint32 words[16])
+   {
+      uchar block[BLAKE3::BLOCK_SIZE];
+      if (size < BLAKE3::BLOCK_SIZE)
+      {
+         memcpy(block, bytes, size);
+         memset(block + size, 0, BLAKE3::BLOCK_SIZE - size);
+         bytes = block;
+      }
+
+      for (int i = 0; i < 16; i++)
+         words[i] = quint32(bytes[4 * i]) | quint32(bytes[4 * i + 1]) << 8 | quint32(bytes[4 * i + 2]) << 16 | quint32(bytes[4 * i + 3]) << 24;
+   }
+}
+
+BLAKE3::BLAKE3()
+{
+   this->reset();
+}
+
+void BLAKE3::reset()
+{
+   memcpy(this->chunkCV, IV, sizeof(this->chunkCV));
+   this->chunkCounter = 0;
+   this->blockSize = 0;
+   this->nbBlocksCompressed = 0;
+   this->cvStackSize = 0;
+}
+
+void BLAKE3::addData(const char* data, int size)
+{
+   const uchar* input = reinterpret_cast<const uchar*>(data);
+
+   while (size > 0)
+   {
+      // The current chunk is complete and there is more data: it can't be the root, its chaining value is added to the tree.
+      if (this->nbBlocksCompressed * BLOCK_SIZE + this->blockSize == CHUNK_SIZE)
+      {
+         quint32 out[16];
+         BLAKE3::compressOutput(this->chunkOutput(), out);
+         this->addChunkChainingValue(out, this->chunkCounter + 1);
+
+         memcpy(this->chunkCV, IV, sizeof(this->chunkCV));
+         this->chunkCounter++;
+         this->blockSize = 0;
+         this->nbBlocksCompressed = 0;
+      }
+
+      // The whole chunks are hashed directly from the input, the last one is always kept in case it's the root.
+      if (this->nbBlocksCompressed == 0 && this->blockSize == 0 && size > CHUNK_SIZE)
+      {
+         const int nbChunks = (size - 1) / CHUNK_SIZE;
+         this->hashWholeChunks(input, nbChunks);
+         input += nbChunks * CHUNK_SIZE;
+         size -= nbChunks * CHUNK_SIZE;
+      }
+
+      // Same thing for the blocks: the last block of a chunk has the flag 'CHUNK_END'.
+      if (this->blockSize == BLOCK_SIZE)
+      {
+         quint32 words[16];
+         readWords(this->block, BLOCK_SIZE, words);
+         quint32 out[16];
+         BLAKE3::compress(this->chunkCV, words, this->chunkCounter, BLOCK_SIZE, this->nbBlocksCompressed == 0 ? CHUNK_START : 0, out);
+         memcpy(this->chunkCV, out, sizeof(this->chunkCV));
+         this->nbBlocksCompressed++;
+         this->blockSize = 0;
+      }
+
+      const int n = qMin(size, BLOCK_SIZE - this->blockSize);
+      memcpy(this->block + this->blockSize, input, n);
+      this->blockSize += n;
+      input += n;
+      size -= n;
+   }
+}
+
+/**
+  * Write the first 'size' bytes of the hash to 'result'.
+  * The hasher isn't modified, more data can be added after.
+  * @param size Must be between 0 and 'MAX_HASH_SIZE'.
+  */
+void BLAKE3::getResult(char* result, int size) const
+{
+   Q_ASSERT(size >= 0 && size <= MAX_HASH_SIZE);
+
+   Output output = this->chunkOutput();
+   for (int i = this->cvStackSize - 1; i >= 0; i--)
+   {
+      quint32 out[16];
+      BLAKE3::compressOutput(output, out);
+      output = BLAKE3::parentOutput(this->cvStack[i], out);
+   }
+
+   output.flags |= ROOT;
+   quint32 out[16];
+   BLAKE3::compressOutput(output, out);
+
+   for (int i = 0; i < size; i++)
+      result[i] = static_cast<char>(out[i / 4] >> (8 * (i % 4)));
+}
+
+BLAKE3::Output BLAKE3::chunkOutput() const
+{
+   Output output;
+   memcpy(output.cv, this->chunkCV, sizeof(output.cv));
+   readWords(this->block, this->blockSize, output.block);
+   output.counter = this->chunkCounter;
+   output.blockSize = this->blockSize;
+   output.flags = CHUNK_END | (this->nbBlocksCompressed == 0 ? CHUNK_START : 0);
+   return output;
+}
+
+/**
+  * Add the chaining value of a chunk, the completed subtrees are merged as soon as possible.
+  * @param totalChunks The number of chunks hashed including this one.
+  */
+void BLAKE3::addChunkChainingValue(const quint32 cv[8], quint64 totalChunks)
+{
+   quint32 newCV[8];
+   memcpy(newCV, cv, sizeof(newCV));
+
+   while ((totalChunks & 1) == 0)
+   {
+      quint32 out[16];
+      BLAKE3::compressOutput(BLAKE3::parentOutput(this->cvStack[--this->cvStackSize], newCV), out);
+      memcpy(newCV, out, sizeof(newCV));
+      totalChunks >>= 1;
+   }
+
+   memcpy(this->cvStack[this->cvStackSize++], newCV, sizeof(newCV));
+}
+
+/**
+  * Hash 'nbChunks' complete chunks, none of them must be the last one.
+  * The current chunk must be empty and is still empty after.
+  */
+void BLAKE3::hashWholeChunks(const uchar* input, int nbChunks)
+{
+   int i = 0;
+
+   if (BLAKE3::isAVX2Available())
+   {
+      quint32 cvs[NB_LANES][8];
+      for (; i + NB_LANES <= nbChunks; i += NB_LANES)
+      {
+         BLAKE3::hashChunksAVX2(input + i * CHUNK_SIZE, this->chunkCounter, cvs);
+         for (int lane = 0; lane < NB_LANES; lane++)
+            this->addChunkChainingValue(cvs[lane], ++this->chunkCounter);
+      }
+   }
+
+   for (; i < nbChunks; i++)
+   {
+      quint32 cv[8];
+      BLAKE3::hashChunk(input + i * CHUNK_SIZE, this->chunkCounter, cv);
+      this->addChunkChainingValue(cv, ++this->chunkCounter);
+   }
+}
+
+void BLAKE3::compress(const quint32 cv[8], const quint32 block[16], quint64 counter, int blockSize, quint32 flags, quint32 out[16])
+{
+   quint32 v[16] = {
+      cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+      IV[0], IV[1], IV[2], IV[3],
+      static_cast<quint32>(counter), static_cast<quint32>(counter >> 32), static_cast<quint32>(blockSize), flags
+   };
+
+   for (int r = 0; r < 7; r++)
+   {
+      const int* s = MSG_SCHEDULE[r];
+      g(v, 0, 4, 8, 12, block[s[0]], block[s[1]]);
+      g(v, 1, 5, 9, 13, block[s[2]], block[s[3]]);
+      g(v, 2, 6, 10, 14, block[s[4]], block[s[5]]);
+      g(v, 3, 7, 11, 15, block[s[6]], block[s[7]]);
+      g(v, 0, 5, 10, 15, block[s[8]], block[s[9]]);
+      g(v, 1, 6, 11, 12, block[s[10]], block[s[11]]);
+      g(v, 2, 7, 8, 13, block[s[12]], block[s[13]]);
+      g(v, 3, 4, 9, 14, block[s[14]], block[s[15]]);
+   }
+
+   for (int i = 0; i < 8; i++)
+   {
+      out[i] = v[i] ^ v[i + 8];
+      out[i + 8] = v[i + 8] ^ cv[i];
+   }
+}
+
+void BLAKE3::compressOutput(const Output& output, quint32 out[16])
+{
+   BLAKE3::compress(output.cv, output.block, output.counter, output.blockSize, output.flags, out);
+}
+
+BLAKE3::Output BLAKE3::parentOutput(const quint32 left[8], const quint32 right[8])
+{
+   Output output;
+   memcpy(output.cv, IV, sizeof(output.cv));
+   memcpy(output.block, left, 8 * sizeof(quint32));
+   memcpy(output.block + 8, right, 8 * sizeof(quint32));
+   output.counter = 0;
+   output.blockSize = BLOCK_SIZE;
+   output.flags = PARENT;
+   return output;
+}
+
+/**
+  * Compute the chaining value of a complete chunk which isn't the root.
+  */
+void BLAKE3::hashChunk(const uchar* input, quint64 counter, quint32 cv[8])
+{
+   memcpy(cv, IV, 8 * sizeof(quint32));
+
+   for (int b = 0; b < CHUNK_SIZE / BLOCK_SIZE; b++)
+   {
+      quint32 words[16];
+      readWords(input + b * BLOCK_SIZE, BLOCK_SIZE, words);
+
+      const quint32 flags = (b == 0 ? CHUNK_START : 0) | (b == CHUNK_SIZE / BLOCK_SIZE - 1 ? CHUNK_END : 0);
+      quint32 out[16];
+      BLAKE3::compress(cv, words, counter, BLOCK_SIZE, flags, out);
+      memcpy(cv, out, 8 * sizeof(quint32));
+   }
+}
@@ -0,0 +1,89 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef COMMON_BLAKE3_H
+#define COMMON_BLAKE3_H
+
+#include <QtGlobal>
+
+namespace Common
+{
+   class BLAKE3
+   {
+   public:
+      static const int HASH_SIZE = 20; ///< The size of the result by default, the first bytes of the BLAKE3 output.
+      static const int MAX_HASH_SIZE = 64; ///< The maximum size given to 'getResult(..)', the extendable output isn't supported beyond one block.
+      static const int BLOCK_SIZE = 64;
+      static const int CHUNK_SIZE = 1024;
+      static const int NB_LANES = 8; ///< The number of chunks hashed at the same time with AVX2.
+
+      BLAKE3();
+
+      void reset();
+      void addData(const char* data, int size);
+      void getResult(char* result, int size = HASH_SIZE) const;
+
+      static bool isAVX2Available();
+
+   private:
+      static const int MAX_DEPTH = 54; ///< 2^54 chunks of 1 KiB: 2^64 bytes.
+
+      enum Flags
+      {
+         CHUNK_START = 1 << 0,
+         CHUNK_END = 1 << 1,
+         PARENT = 1 << 2,
+         ROOT = 1 << 3
+      };
+
+      /**
+        * The input of a compression not done yet, see 'getResult(..)'.
+        */
+      struct Output
+      {
+         quint32 cv[8];
+         quint32 block[16];
+         quint64 counter;
+         int blockSize;
+         quint32 flags;
+      };
+
+      Output chunkOutput() const;
+      void addChunkChainingValue(const quint32 cv[8], quint64 totalChunks);
+      void hashWholeChunks(const uchar* input, int nbChunks);
+
+      static void compress(const quint32 cv[8], const quint32 block[16], quint64 counter, int blockSize, quint32 flags, quint32 out[16]);
+      static void compressOutput(const Output& output, quint32 out[16]);
+      static Output parentOutput(const quint32 left[8], const quint32 right[8]);
+      static void hashChunk(const uchar* input, quint64 counter, quint32 cv[8]);
+      static void hashChunksAVX2(const uchar* input, quint64 counter, quint32 cvs[NB_LANES][8]);
+
+      // The current chunk.
+      quint32 chunkCV[8];
+      quint64 chunkCounter;
+      uchar block[BLOCK_SIZE];
+      int blockSize;
+      int nbBlocksCompressed;
+
+      // The chaining values of the completed subtrees.
+      quint32 cvStack[MAX_DEPTH][8];
+      int cvStackSize;
+   };
+}
+
+#endif
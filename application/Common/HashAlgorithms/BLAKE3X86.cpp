@@ -0,0 +1,223 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Common/HashAlgorithms/BLAKE3.h>
+using namespace Common;
+
+/**
+  * The AVX2 backend of 'BLAKE3': eight chunks are hashed at the same time, one per 32 bits lane.
+  * Like in 'SHA1X86.cpp' the function is compiled with the 'target' attribute and only called if the CPU supports AVX2.
+  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define BLAKE3_X86
+#endif
+
+#ifdef BLAKE3_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+bool BLAKE3::isAVX2Available()
+{
+   static const bool hasAVX2 = [] {
+      unsigned int eax, ebx, ecx, edx;
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+         return false;
+
+      // The OS must save the YMM registers (XCR0 bits 1 and 2).
+      unsigned int xcr0Low, xcr0High;
+      __asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+      if ((xcr0Low & 0x6) != 0x6 || __get_cpuid_max(0, nullptr) < 7)
+         return false;
+
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      return (ebx & (1 << 5)) != 0; // AVX2.
+   }();
+   return hasAVX2;
+}
+
+namespace
+{
+   const quint32 IV[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+   const int MSG_SCHEDULE[7][16] = {
+      { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+      { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+      { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+      { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+      { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+      { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+      { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+   };
+
+   __attribute__((target("avx2")))
+   inline __m256i rotr16(__m256i x)
+   {
+      return _mm256_shuffle_epi8(x, _mm256_set_epi8(
+         13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+         13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2
+      ));
+   }
+
+   __attribute__((target("avx2")))
+   inline __m256i rotr8(__m256i x)
+   {
+      return _mm256_shuffle_epi8(x, _mm256_set_epi8(
+         12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+         12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1
+      ));
+   }
+
+   __attribute__((target("avx2")))
+   inline __m256i rotr(__m256i x, int n)
+   {
+      return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+   }
+
+   __attribute__((target("avx2")))
+   inline void g(__m256i& a, __m256i& b, __m256i& c, __m256i& d, __m256i mx, __m256i my)
+   {
+      a = _mm256_add_epi32(_mm256_add_epi32(a, b), mx);
+      d = rotr16(_mm256_xor_si256(d, a));
+      c = _mm256_add_epi32(c, d);
+      b = rotr(_mm256_xor_si256(b, c), 12);
+      a = _mm256_add_epi32(_mm256_add_epi32(a, b), my);
+      d = rotr8(_mm256_xor_si256(d, a));
+      c = _mm256_add_epi32(c, d);
+      b = rotr(_mm256_xor_si256(b, c), 7);
+   }
+
+   /**
+     * Load eight words of the eight chunks and transpose them: 'w[i]' contains the word 'i' of each chunk.
+     */
+   __attribute__((target("avx2")))
+   inline void loadTransposed(const uchar* input, int offset, __m256i w[8])
+   {
+      __m256i r[8];
+      for (int lane = 0; lane < 8; lane++)
+         r[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + lane * BLAKE3::CHUNK_SIZE + offset));
+
+      const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+      const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+      const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+      const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+      const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+      const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+      const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+      const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+      const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+      const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+      const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+      const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+      const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+      const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+      const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+      const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+      w[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+      w[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+      w[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+      w[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+      w[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+      w[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+      w[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+      w[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+   }
+}
+
+/**
+  * A round must be expanded with a constant 'r' to keep all the words in registers.
+  */
+#define BLAKE3_AVX2_ROUND(r) \
+   g(v0, v4, v8, v12, m[MSG_SCHEDULE[r][0]], m[MSG_SCHEDULE[r][1]]); \
+   g(v1, v5, v9, v13, m[MSG_SCHEDULE[r][2]], m[MSG_SCHEDULE[r][3]]); \
+   g(v2, v6, v10, v14, m[MSG_SCHEDULE[r][4]], m[MSG_SCHEDULE[r][5]]); \
+   g(v3, v7, v11, v15, m[MSG_SCHEDULE[r][6]], m[MSG_SCHEDULE[r][7]]); \
+   g(v0, v5, v10, v15, m[MSG_SCHEDULE[r][8]], m[MSG_SCHEDULE[r][9]]); \
+   g(v1, v6, v11, v12, m[MSG_SCHEDULE[r][10]], m[MSG_SCHEDULE[r][11]]); \
+   g(v2, v7, v8, v13, m[MSG_SCHEDULE[r][12]], m[MSG_SCHEDULE[r][13]]); \
+   g(v3, v4, v9, v14, m[MSG_SCHEDULE[r][14]], m[MSG_SCHEDULE[r][15]]);
+
+/**
+  * Compute the chaining values of the 'NB_LANES' complete chunks starting at 'input'.
+  * @param counter The index of the first chunk.
+  */
+__attribute__((target("avx2")))
+void BLAKE3::hashChunksAVX2(const uchar* input, quint64 counter, quint32 cvs[NB_LANES][8])
+{
+   __m256i h[8];
+   for (int i = 0; i < 8; i++)
+      h[i] = _mm256_set1_epi32(IV[i]);
+
+   quint32 counterLow[NB_LANES];
+   quint32 counterHigh[NB_LANES];
+   for (int lane = 0; lane < NB_LANES; lane++)
+   {
+      counterLow[lane] = static_cast<quint32>(counter + lane);
+      counterHigh[lane] = static_cast<quint32>((counter + lane) >> 32);
+   }
+   const __m256i counterLowV = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counterLow));
+   const __m256i counterHighV = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counterHigh));
+
+   for (int b = 0; b < CHUNK_SIZE / BLOCK_SIZE; b++)
+   {
+      __m256i m[16];
+      loadTransposed(input, b * BLOCK_SIZE, m);
+      loadTransposed(input, b * BLOCK_SIZE + 32, m + 8);
+
+      const quint32 flags = (b == 0 ? CHUNK_START : 0) | (b == CHUNK_SIZE / BLOCK_SIZE - 1 ? CHUNK_END : 0);
+
+      __m256i v0 = h[0], v1 = h[1], v2 = h[2], v3 = h[3], v4 = h[4], v5 = h[5], v6 = h[6], v7 = h[7];
+      __m256i v8 = _mm256_set1_epi32(IV[0]), v9 = _mm256_set1_epi32(IV[1]), v10 = _mm256_set1_epi32(IV[2]), v11 = _mm256_set1_epi32(IV[3]);
+      __m256i v12 = counterLowV, v13 = counterHighV, v14 = _mm256_set1_epi32(BLOCK_SIZE), v15 = _mm256_set1_epi32(flags);
+
+      BLAKE3_AVX2_ROUND(0) BLAKE3_AVX2_ROUND(1) BLAKE3_AVX2_ROUND(2) BLAKE3_AVX2_ROUND(3)
+      BLAKE3_AVX2_ROUND(4) BLAKE3_AVX2_ROUND(5) BLAKE3_AVX2_ROUND(6)
+
+      h[0] = _mm256_xor_si256(v0, v8);
+      h[1] = _mm256_xor_si256(v1, v9);
+      h[2] = _mm256_xor_si256(v2, v10);
+      h[3] = _mm256_xor_si256(v3, v11);
+      h[4] = _mm256_xor_si256(v4, v12);
+      h[5] = _mm256_xor_si256(v5, v13);
+      h[6] = _mm256_xor_si256(v6, v14);
+      h[7] = _mm256_xor_si256(v7, v15);
+   }
+
+   quint32 words[8][NB_LANES];
+   for (int i = 0; i < 8; i++)
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(words[i]), h[i]);
+
+   for (int lane = 0; lane < NB_LANES; lane++)
+      for (int i = 0; i < 8; i++)
+         cvs[lane][i] = words[i][lane];
+}
+
+#else
+
+bool BLAKE3::isAVX2Available()
+{
+   return false;
+}
+
+void BLAKE3::hashChunksAVX2(const uchar*, quint64, quint32[NB_LANES][8])
+{
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Common/HashAlgorithms/SHA1.h>
+using namespace Common;
+
+#include <cstring>
+
+/**
+  * @class Common::SHA1
+  *
+  * A SHA-1 implementation with many backends, the fastest one available on the current CPU is chosen at runtime.
+  * All the backends give the same result as 'QCryptographicHash(QCryptographicHash::Sha1)'.
+  *
+  * The backends only differ by their compression function, see 'SHA1X86.cpp' and 'SHA1ARM.cpp'.
+  */
+
+namespace
+{
+   const quint32 INITIAL_STATE[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+   inline quint32 rotl(quint32 x, int n)
+   {
+      return x << n | x >> (32 - n);
+   }
+
+   inline quint32 readBigEndian(const uchar* p)
+   {
+      return quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | quint32(p[3]);
+   }
+
+   inline void writeBigEndian(quint32 value, char* p)
+   {
+      p[0] = static_cast<char>(value >> 24);
+      p[1] = static_cast<char>(value >> 16);
+      p[2] = static_cast<char>(value >> 8);
+      p[3] = static_cast<char>(value);
+   }
+
+   /**
+     * Write the padding and the message length after 'size' bytes of 'block' (less than 'BLOCK_SIZE').
+     * @return The number of blocks to compress: 1 or 2.
+     */
+   int pad(uchar block[2 * SHA1::BLOCK_SIZE], int size, quint64 length)
+   {
+      const int nbBlocks = size < SHA1::BLOCK_SIZE - 8 ? 1 : 2;
+      block[size] = 0x80;
+      memset(block + size + 1, 0, nbBlocks * SHA1::BLOCK_SIZE - size - 1);
+
+      const quint64 nbBits = length * 8;
+      for (int i = 0; i < 8; i++)
+         block[nbBlocks * SHA1::BLOCK_SIZE - 1 - i] = static_cast<uchar>(nbBits >> (8 * i));
+
+      return nbBlocks;
+   }
+}
+
+SHA1::SHA1(Backend backend) :
+   backend(backend == Backend::BEST || !SHA1::isAvailable(backend) ? SHA1::getBestBackend() : backend),
+   compress(SHA1::getCompressFunction(this->backend))
+{
+   this->reset();
+}
+
+void SHA1::reset()
+{
+   memcpy(this->state, INITIAL_STATE, sizeof(this->state));
+   this->length = 0;
+   this->bufferSize = 0;
+}
+
+void SHA1::addData(const char* data, int size)
+{
+   const uchar* bytes = reinterpret_cast<const uchar*>(data);
+   this->length += size;
+
+   if (this->bufferSize > 0)
+   {
+      const int n = qMin(size, BLOCK_SIZE - this->bufferSize);
+      memcpy(this->buffer + this->bufferSize, bytes, n);
+      this->bufferSize += n;
+      bytes += n;
+      size -= n;
+
+      if (this->bufferSize < BLOCK_SIZE)
+         return;
+
+      this->compress(this->state, this->buffer, 1);
+      this->bufferSize = 0;
+   }
+
+   const int nbBlocks = size / BLOCK_SIZE;
+   if (nbBlocks > 0)
+   {
+      this->compress(this->state, bytes, nbBlocks);
+      bytes += nbBlocks * BLOCK_SIZE;
+      size -= nbBlocks * BLOCK_SIZE;
+   }
+
+   memcpy(this->buffer, bytes, size);
+   this->bufferSize = size;
+}
+
+/**
+  * Write the 'HASH_SIZE' bytes of the hash to 'result'.
+  * The hasher isn't modified, more data can be added after.
+  */
+void SHA1::getResult(char* result) const
+{
+   quint32 finalState[5];
+   memcpy(finalState, this->state, sizeof(finalState));
+
+   uchar lastBlocks[2 * BLOCK_SIZE];
+   memcpy(lastBlocks, this->buffer, this->bufferSize);
+   this->compress(finalState, lastBlocks, pad(lastBlocks, this->bufferSize, this->length));
+
+   for (int i = 0; i < 5; i++)
+      writeBigEndian(finalState[i], result + 4 * i);
+}
+
+SHA1::Backend SHA1::getBackend() const
+{
+   return this->backend;
+}
+
+bool SHA1::isAvailable(Backend backend)
+{
+   switch (backend)
+   {
+   case Backend::BEST:
+   case Backend::GENERIC:
+      return true;
+   case Backend::SHA_NI:
+      return SHA1::cpuHasSHANI();
+   case Backend::ARMV8:
+      return SHA1::cpuHasARMv8SHA();
+   }
+   return false;
+}
+
+SHA1::Backend SHA1::getBestBackend()
+{
+   static const Backend bestBackend =
+      SHA1::isAvailable(Backend::SHA_NI) ? Backend::SHA_NI :
+      SHA1::isAvailable(Backend::ARMV8) ? Backend::ARMV8 :
+      Backend::GENERIC;
+   return bestBackend;
+}
+
+const char* SHA1::getBackendName(Backend backend)
+{
+   switch (backend)
+   {
+   case Backend::BEST: return SHA1::getBackendName(SHA1::getBestBackend());
+   case Backend::GENERIC: return "Generic";
+   case Backend::SHA_NI: return "SHA-NI";
+   case Backend::ARMV8: return "ARMv8";
+   }
+   return "?";
+}
+
+SHA1::CompressFunction SHA1::getCompressFunction(Backend backend)
+{
+   switch (backend)
+   {
+   case Backend::SHA_NI: return &SHA1::compressSHANI;
+   case Backend::ARMV8: return &SHA1::compressARMv8;
+   default: return &SHA1::compressGeneric;
+   }
+}
+
+void SHA1::compressGeneric(quint32 state[5], const uchar* blocks, int nbBlocks)
+{
+   for (int n = 0; n < nbBlocks; n++, blocks += BLOCK_SIZE)
+   {
+      quint32 w[16];
+      for (int i = 0; i < 16; i++)
+         w[i] = readBigEndian(blocks + 4 * i);
+
+      quint32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+      for (int i = 0; i < 80; i++)
+      {
+         if (i >= 16)
+            w[i & 15] = rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+
+         quint32 f, k;
+         if (i < 20)
+         {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+         }
+         else if (i < 40)
+         {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+         }
+         else if (i < 60)
+         {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+         }
+         else
+         {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+         }
+
+         const quint32 temp = rotl(a, 5) + f + e + k + w[i & 15];
+         e = d;
+         d = c;
+         c = rotl(b, 30);
+         b = a;
+         a = temp;
+      }
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+   }
+}
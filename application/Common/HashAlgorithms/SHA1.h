@@ -0,0 +1,75 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef COMMON_SHA1_H
+#define COMMON_SHA1_H
+
+#include <QtGlobal>
+
+namespace Common
+{
+   class SHA1
+   {
+   public:
+      static const int HASH_SIZE = 20;
+      static const int BLOCK_SIZE = 64;
+
+      enum class Backend
+      {
+         BEST = -1, ///< The fastest available backend, chosen at runtime.
+         GENERIC = 0, ///< Portable C++ implementation.
+         SHA_NI = 1, ///< x86 SHA extensions.
+         ARMV8 = 2 ///< ARMv8 cryptographic extensions.
+      };
+      static const int NB_BACKENDS = 3;
+
+      SHA1(Backend backend = Backend::BEST);
+
+      void reset();
+      void addData(const char* data, int size);
+      void getResult(char* result) const;
+
+      Backend getBackend() const;
+
+      static bool isAvailable(Backend backend);
+      static Backend getBestBackend();
+      static const char* getBackendName(Backend backend);
+
+   private:
+      typedef void (*CompressFunction)(quint32 state[5], const uchar* blocks, int nbBlocks);
+
+      static CompressFunction getCompressFunction(Backend backend);
+
+      static void compressGeneric(quint32 state[5], const uchar* blocks, int nbBlocks);
+      static void compressSHANI(quint32 state[5], const uchar* blocks, int nbBlocks);
+      static void compressARMv8(quint32 state[5], const uchar* blocks, int nbBlocks);
+
+      static bool cpuHasSHANI();
+      static bool cpuHasARMv8SHA();
+
+      Backend backend;
+      CompressFunction compress;
+
+      quint32 state[5];
+      quint64 length; ///< Number of bytes given to 'addData(..)'.
+      uchar buffer[BLOCK_SIZE];
+      int bufferSize;
+   };
+}
+
+#endif
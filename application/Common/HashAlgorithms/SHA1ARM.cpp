@@ -0,0 +1,120 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Common/HashAlgorithms/SHA1.h>
+using namespace Common;
+
+/**
+  * The ARMv8 backend of 'SHA1', it uses the SHA1 instructions of the cryptographic extension.
+  * With GCC the function is compiled with the 'target' attribute, with the other compilers the
+  * extension must be enabled at compile time (for example: -march=armv8-a+crypto).
+  */
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2) || defined(__GNUC__) && !defined(__clang__))
+#  define SHA1_ARMV8
+#endif
+
+#ifdef SHA1_ARMV8
+
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+#  define SHA1_ARMV8_TARGET
+#else
+#  define SHA1_ARMV8_TARGET __attribute__((target("+crypto")))
+#endif
+
+bool SHA1::cpuHasARMv8SHA()
+{
+#if defined(__linux__)
+   static const bool hasSHA = (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+   return hasSHA;
+#elif defined(__APPLE__)
+   return true; // All the 64 bits Apple processors have the cryptographic extension.
+#else
+   return false;
+#endif
+}
+
+/**
+  * One group of four rounds, 'g' is the group number [0, 19] and must be a constant.
+  * 'TMP[g % 2]' contains the words of the group plus the round constant, the next words are computed on the fly.
+  */
+#define SHA1_ARMV8_ROUNDS(g, OP) \
+   E[((g) + 1) % 2] = vsha1h_u32(vgetq_lane_u32(ABCD, 0)); \
+   ABCD = OP(ABCD, E[(g) % 2], TMP[(g) % 2]); \
+   if ((g) <= 17) \
+      TMP[(g) % 2] = vaddq_u32(MSG[((g) + 2) % 4], vdupq_n_u32(K[(((g) + 2) / 5) % 4])); \
+   if ((g) >= 1 && (g) <= 16) \
+      MSG[((g) + 3) % 4] = vsha1su1q_u32(MSG[((g) + 3) % 4], MSG[((g) + 2) % 4]); \
+   if ((g) <= 15) \
+      MSG[(g) % 4] = vsha1su0q_u32(MSG[(g) % 4], MSG[((g) + 1) % 4], MSG[((g) + 2) % 4]);
+
+SHA1_ARMV8_TARGET
+void SHA1::compressARMv8(quint32 state[5], const uchar* blocks, int nbBlocks)
+{
+   static const quint32 K[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+   uint32x4_t ABCD = vld1q_u32(state);
+   quint32 E[2];
+   E[0] = state[4];
+
+   for (int n = 0; n < nbBlocks; n++, blocks += BLOCK_SIZE)
+   {
+      const uint32x4_t ABCD_SAVE = ABCD;
+      const quint32 E0_SAVE = E[0];
+
+      uint32x4_t MSG[4];
+      for (int i = 0; i < 4; i++)
+         MSG[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16 * i)));
+
+      uint32x4_t TMP[2];
+      TMP[0] = vaddq_u32(MSG[0], vdupq_n_u32(K[0]));
+      TMP[1] = vaddq_u32(MSG[1], vdupq_n_u32(K[0]));
+
+      SHA1_ARMV8_ROUNDS(0, vsha1cq_u32)  SHA1_ARMV8_ROUNDS(1, vsha1cq_u32)  SHA1_ARMV8_ROUNDS(2, vsha1cq_u32)  SHA1_ARMV8_ROUNDS(3, vsha1cq_u32)  SHA1_ARMV8_ROUNDS(4, vsha1cq_u32)
+      SHA1_ARMV8_ROUNDS(5, vsha1pq_u32)  SHA1_ARMV8_ROUNDS(6, vsha1pq_u32)  SHA1_ARMV8_ROUNDS(7, vsha1pq_u32)  SHA1_ARMV8_ROUNDS(8, vsha1pq_u32)  SHA1_ARMV8_ROUNDS(9, vsha1pq_u32)
+      SHA1_ARMV8_ROUNDS(10, vsha1mq_u32) SHA1_ARMV8_ROUNDS(11, vsha1mq_u32) SHA1_ARMV8_ROUNDS(12, vsha1mq_u32) SHA1_ARMV8_ROUNDS(13, vsha1mq_u32) SHA1_ARMV8_ROUNDS(14, vsha1mq_u32)
+      SHA1_ARMV8_ROUNDS(15, vsha1pq_u32) SHA1_ARMV8_ROUNDS(16, vsha1pq_u32) SHA1_ARMV8_ROUNDS(17, vsha1pq_u32) SHA1_ARMV8_ROUNDS(18, vsha1pq_u32) SHA1_ARMV8_ROUNDS(19, vsha1pq_u32)
+
+      E[0] += E0_SAVE;
+      ABCD = vaddq_u32(ABCD_SAVE, ABCD);
+   }
+
+   vst1q_u32(state, ABCD);
+   state[4] = E[0];
+}
+
+#else
+
+bool SHA1::cpuHasARMv8SHA()
+{
+   return false;
+}
+
+void SHA1::compressARMv8(quint32 state[5], const uchar* blocks, int nbBlocks)
+{
+   SHA1::compressGeneric(state, blocks, nbBlocks);
+}
+
+#endif
@@ -0,0 +1,112 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <Common/HashAlgorithms/SHA1.h>
+using namespace Common;
+
+/**
+  * The x86 backend of 'SHA1': SHA-NI.
+  * The function is compiled with the 'target' attribute thus the rest of the code doesn't require these instructions,
+  * it's only called if the CPU supports them (see 'cpuHasSHANI()').
+  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SHA1_X86
+#endif
+
+#ifdef SHA1_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+bool SHA1::cpuHasSHANI()
+{
+   static const bool hasSHANI = [] {
+      unsigned int eax, ebx, ecx, edx;
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3))
+         return false;
+      if (__get_cpuid_max(0, nullptr) < 7)
+         return false;
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      return (ebx & (1 << 29)) != 0; // SHA.
+   }();
+   return hasSHANI;
+}
+
+/**
+  * One group of four rounds, 'g' is the group number [0, 19] and must be a constant.
+  * 'MSG[g % 4]' contains the words of the group, the next words are computed on the fly.
+  */
+#define SHA1_NI_ROUNDS(g) \
+   if ((g) == 0) \
+      E[0] = _mm_add_epi32(E[0], MSG[0]); \
+   else \
+      E[(g) % 2] = _mm_sha1nexte_epu32(E[(g) % 2], MSG[(g) % 4]); \
+   E[((g) + 1) % 2] = ABCD; \
+   if ((g) >= 3 && (g) <= 18) \
+      MSG[((g) + 1) % 4] = _mm_sha1msg2_epu32(MSG[((g) + 1) % 4], MSG[(g) % 4]); \
+   ABCD = _mm_sha1rnds4_epu32(ABCD, E[(g) % 2], (g) / 5); \
+   if ((g) >= 1 && (g) <= 16) \
+      MSG[((g) + 3) % 4] = _mm_sha1msg1_epu32(MSG[((g) + 3) % 4], MSG[(g) % 4]); \
+   if ((g) >= 2 && (g) <= 17) \
+      MSG[((g) + 2) % 4] = _mm_xor_si128(MSG[((g) + 2) % 4], MSG[(g) % 4]);
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void SHA1::compressSHANI(quint32 state[5], const uchar* blocks, int nbBlocks)
+{
+   const __m128i BYTE_MASK = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+   __m128i ABCD = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+   __m128i E[2];
+   E[0] = _mm_set_epi32(state[4], 0, 0, 0);
+
+   for (int n = 0; n < nbBlocks; n++, blocks += BLOCK_SIZE)
+   {
+      const __m128i ABCD_SAVE = ABCD;
+      const __m128i E0_SAVE = E[0];
+
+      __m128i MSG[4];
+      for (int i = 0; i < 4; i++)
+         MSG[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), BYTE_MASK);
+
+      SHA1_NI_ROUNDS(0)  SHA1_NI_ROUNDS(1)  SHA1_NI_ROUNDS(2)  SHA1_NI_ROUNDS(3)  SHA1_NI_ROUNDS(4)
+      SHA1_NI_ROUNDS(5)  SHA1_NI_ROUNDS(6)  SHA1_NI_ROUNDS(7)  SHA1_NI_ROUNDS(8)  SHA1_NI_ROUNDS(9)
+      SHA1_NI_ROUNDS(10) SHA1_NI_ROUNDS(11) SHA1_NI_ROUNDS(12) SHA1_NI_ROUNDS(13) SHA1_NI_ROUNDS(14)
+      SHA1_NI_ROUNDS(15) SHA1_NI_ROUNDS(16) SHA1_NI_ROUNDS(17) SHA1_NI_ROUNDS(18) SHA1_NI_ROUNDS(19)
+
+      E[0] = _mm_sha1nexte_epu32(E[0], E0_SAVE);
+      ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+   }
+
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(ABCD, 0x1B));
+   state[4] = _mm_extract_epi32(E[0], 3);
+}
+
+#else
+
+bool SHA1::cpuHasSHANI()
+{
+   return false;
+}
+
+void SHA1::compressSHANI(quint32 state[5], const uchar* blocks, int nbBlocks)
+{
+   SHA1::compressGeneric(state, blocks, nbBlocks);
+}
+
+#endif
@@ -0,0 +1,119 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#ifndef COMMON_HASHESDIGEST_H
+#define COMMON_HASHESDIGEST_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+#include <Common/Hash.h>
+
+/**
+  * @class Common::HashesDigest
+  * A Bloom filter of a shard of a set of hashes, small enough to be sent in a datagram, see 'Protos::Core::IMAlive::ChunksDigest'.
+  *
+  * The hashes are split in 'nbShards' shards (a power of two) by the low bits of their prefix, see 'Common::Hash::getPrefix()'.
+  * A digest covers only one of them, the hashes of the other shards are never added or tested.
+  *
+  * The positions are part of the protocol, they don't depend on the endianness: bytes 8 to 11 and 12 to 15 of the hash
+  * are read as two little-endian integers and give the 'K' positions by double hashing, modulo the number of bits.
+  * With 'BITS_PER_HASH' bits per hash the probability of false positive is about 0.02.
+  */
+
+namespace Common
+{
+   class HashesDigest
+   {
+   public:
+      static const int BITS_PER_HASH = 8;
+      static const int K = 5; // Number of bits set per hash.
+
+      HashesDigest() : shard(0), nbShards(1) {}
+      HashesDigest(quint32 shard, quint32 nbShards, int size) : shard(shard), nbShards(nbShards), bits(size, 0) {}
+      HashesDigest(quint32 shard, quint32 nbShards, const QByteArray& bits) : shard(shard), nbShards(nbShards), bits(bits) {}
+
+      /**
+        * The number of hashes a digest of 'size' bytes can hold without exceeding its probability of false positive.
+        */
+      static int getCapacity(int size) { return size * 8 / BITS_PER_HASH; }
+
+      inline bool covers(const Hash& hash) const { return (hash.getPrefix() & (this->nbShards - 1)) == this->shard; }
+      inline void add(const Hash& hash);
+      inline bool test(const Hash& hash) const;
+
+      inline quint32 getShard() const { return this->shard; }
+      inline quint32 getNbShards() const { return this->nbShards; }
+      inline const QByteArray& getBits() const { return this->bits; }
+
+      inline bool isNull() const { return this->bits.isEmpty(); }
+
+      /**
+        * A received digest must be checked before being tested.
+        */
+      inline bool isValid() const { return !this->isNull() && this->nbShards != 0 && (this->nbShards & (this->nbShards - 1)) == 0 && this->shard < this->nbShards; }
+
+   private:
+      inline quint32 position(const Hash& hash, int i) const;
+
+      quint32 shard;
+      quint32 nbShards;
+      QByteArray bits;
+   };
+}
+
+/**
+  * The hash must be covered by the digest, see 'covers(..)'.
+  */
+inline void Common::HashesDigest::add(const Hash& hash)
+{
+   char* data = this->bits.data();
+   for (int i = 0; i < K; i++)
+   {
+      const quint32 p = this->position(hash, i);
+      data[p / 8] |= 1 << (p % 8);
+   }
+}
+
+/**
+  * Returns 'true' if the hash is covered by the digest and may be in the set.
+  */
+inline bool Common::HashesDigest::test(const Hash& hash) const
+{
+   if (this->isNull() || !this->covers(hash))
+      return false;
+
+   const char* data = this->bits.constData();
+   for (int i = 0; i < K; i++)
+   {
+      const quint32 p = this->position(hash, i);
+      if (!(data[p / 8] & (1 << (p % 8))))
+         return false;
+   }
+   return true;
+}
+
+inline quint32 Common::HashesDigest::position(const Hash& hash, int i) const
+{
+   const uchar* data = reinterpret_cast<const uchar*>(hash.getData());
+   const quint64 first = qFromLittleEndian<quint32>(data + 8);
+   const quint64 step = qFromLittleEndian<quint32>(data + 12) | 1;
+   return (first + i * step) % (static_cast<quint64>(this->bits.size()) * 8);
+}
+
+#endif
@@ -110,6 +110,19 @@ QHostAddress ProtoHelper::getIP(const Protos::Common::IP& ipMess)
    }
 }
 
+void ProtoHelper::setHash(Protos::Common::Hash& hashMess, const Hash& hash)
+{
+   hashMess.set_hash(hash.getData(), Hash::HASH_SIZE);
+}
+
+/**
+  * Return a null hash if the message doesn't contain exactly 'Hash::HASH_SIZE' bytes.
+  */
+Hash ProtoHelper::getHash(const Protos::Common::Hash& hashMess)
+{
+   return Hash(hashMess.hash());
+}
+
 QString ProtoHelper::getRelativePath(const Protos::Common::Entry& entry, bool appendFilename)
 {
    QString path = Common::ProtoHelper::getStr(entry, &Protos::Common::Entry::path);
@@ -22,6 +22,7 @@
 #include <QString>
 #include <QLocale>
 #include <QHostAddress>
+#include <QBitArray>
 
 #include <google/protobuf/message.h>
 
@@ -29,6 +30,8 @@
 
 namespace Common
 {
+   class Hash;
+
    /**
      * The ugliest class ever!
      * Has some methods to read and write string field from Protocol Buffer objects.
@@ -48,12 +51,27 @@ namespace Common
       template <typename T>
       static QString getRepeatedStr(const T& mess, const std::string& (T::*getter)(int) const, int i);
 
+      /**
+        * A bit array is stored in a 'bytes' field, eight bits per byte, the first bit is the least significant bit of the first byte.
+        */
+      template <typename T>
+      static void setBits(T& mess, void (T::*setter)(const void*, size_t), const QBitArray& bits);
+
+      /**
+        * @param size The number of bits, the missing ones are set to 'false'.
+        */
+      template <typename T>
+      static QBitArray getBits(const T& mess, const std::string& (T::*getter)() const, int size);
+
       static void setLang(Protos::Common::Language& langMess, const QLocale& locale);
       static QLocale getLang(const Protos::Common::Language& langMess);
 
       static void setIP(Protos::Common::IP& ipMess, const QHostAddress& address);
       static QHostAddress getIP(const Protos::Common::IP& ipMess);
 
+      static void setHash(Protos::Common::Hash& hashMess, const Hash& hash);
+      static Hash getHash(const Protos::Common::Hash& hashMess);
+
       /**
         * Return the relative path of an entry, for exemple:
         *  - entry is a root: "/".
@@ -95,4 +113,25 @@ QString Common::ProtoHelper::getRepeatedStr(const T& mess, const std::string& (T
    return QString::fromUtf8(str.data(), str.length());
 }
 
+template <typename T>
+void Common::ProtoHelper::setBits(T& mess, void (T::*setter)(const void*, size_t), const QBitArray& bits)
+{
+   QByteArray bytes((bits.size() + 7) / 8, 0);
+   for (int i = 0; i < bits.size(); i++)
+      if (bits.testBit(i))
+         bytes[i / 8] = bytes[i / 8] | (1 << (i % 8));
+   (mess.*setter)(bytes.constData(), bytes.size());
+}
+
+template <typename T>
+QBitArray Common::ProtoHelper::getBits(const T& mess, const std::string& (T::*getter)() const, int size)
+{
+   const std::string& bytes = (mess.*getter)();
+   QBitArray bits(size);
+   for (int i = 0; i < size && i / 8 < static_cast<int>(bytes.size()); i++)
+      if (bytes[i / 8] & (1 << (i % 8)))
+         bits.setBit(i);
+   return bits;
+}
+
 #endif
@@ -24,6 +24,7 @@
 #include <QMap>
 #include <QDir>
 #include <QElapsedTimer>
+#include <QCryptographicHash>
 
 #include <Libs/MersenneTwister.h>
 
@@ -43,6 +44,9 @@
 #include <ProtoHelper.h>
 #include <BloomFilter.h>
 #include <TransferRateCalculator.h>
+#include <BandwidthLimiter.h>
+#include <HashAlgorithms/SHA1.h>
+#include <HashAlgorithms/BLAKE3.h>
 using namespace Common;
 
 Tests::Tests()
@@ -488,6 +492,56 @@ void Tests::transferRateCalculator()
    QCOMPARE(t.getTransferRate(), 0);
 }
 
+void Tests::bandwidthLimiter()
+{
+   const Hash peer1 = Hash::rand();
+   const Hash peer2 = Hash::rand();
+   int stream1, stream2, stream3; // Only their addresses are used to identify the streams.
+   int waitTime;
+
+   qint64 time = 0; // [ns].
+   BandwidthLimiter limiter([&time]() { return time; });
+   QCOMPARE(limiter.getRate(), 0u);
+   QCOMPARE(limiter.request(&stream1, peer1, 1000000, waitTime), 1000000);
+   QCOMPARE(waitTime, 0);
+
+   // The first stream asks ten times more often than the second one, they must have the same share.
+   const quint32 RATE = 200000; // [B/s].
+   limiter.setLimits(RATE, 0);
+   QCOMPARE(limiter.getRate(), RATE);
+
+   qint64 bytes1 = 0, bytes2 = 0;
+   for (int i = 0; i < 300; i++, time += 2000000) // 600 ms.
+   {
+      for (int j = 0; j < 10; j++)
+         bytes1 += limiter.request(&stream1, peer1, 1000, waitTime);
+      bytes2 += limiter.request(&stream2, peer2, 1000, waitTime);
+   }
+   QCOMPARE(bytes1, bytes2);
+   QVERIFY(bytes1 + bytes2 <= RATE * 600 / 1000);
+   QVERIFY(bytes1 + bytes2 >= RATE * 600 / 1000 - 4000); // Each stream may keep less than 1000 tokens and the last 2 ms aren't produced.
+
+   // The unused tokens are given back.
+   limiter.removeStream(&stream1);
+   limiter.removeStream(&stream2);
+   limiter.setLimits(0, RATE);
+   QCOMPARE(limiter.getRate(), 0u);
+   QCOMPARE(limiter.request(&stream3, peer1, 1000, waitTime), 0);
+   QCOMPARE(waitTime, 5); // The time to have 1000 bytes.
+   time += 50000000; // 50 ms.
+   const int bytes3 = limiter.acquire(&stream3, peer1, 1000000);
+   QCOMPARE(bytes3, static_cast<int>(RATE * 50 / 1000));
+   limiter.giveBack(&stream3, bytes3);
+   QCOMPARE(limiter.request(&stream3, peer1, bytes3, waitTime), bytes3);
+
+   // A limited period which includes the current time.
+   const QTime now = QTime::currentTime();
+   limiter.setLimitedPeriod(now.addSecs(-60), now.addSecs(60), RATE / 2);
+   QCOMPARE(limiter.getRate(), RATE / 2);
+   limiter.setLimitedPeriod(now, now, RATE / 2);
+   QCOMPARE(limiter.getRate(), 0u);
+}
+
 void Tests::writePersistentData()
 {
    this->hash = Hash::rand();
@@ -629,6 +683,27 @@ void Tests::hashMoveConstuctorAndAssignment()
    QVERIFY(h.toStr() == str);
 }
 
+void Tests::hashNullAndQHash()
+{
+   constexpr Hash nullHash;
+   QVERIFY(nullHash.isNull());
+   QVERIFY(Hash(QByteArray(Hash::HASH_SIZE, 0)).isNull());
+   QVERIFY(Hash(std::string("too short")).isNull());
+   QCOMPARE(qHash(nullHash), 0u);
+
+   Hash h1 = Hash::fromStr("2d73736f34a73837d422f7aba2740d8409ac60df");
+   Hash h2 = Hash::fromStr("2d73736f34a73837d422f7aba2740d8409ac60de"); // Only the last byte differs.
+   QVERIFY(!h1.isNull());
+   QVERIFY(h1 != h2);
+   QVERIFY(qHash(h1) != qHash(h2));
+
+   // The copies are independent.
+   Hash h3 = h1;
+   h1 = h2;
+   QCOMPARE(h3.toStr(), QString("2d73736f34a73837d422f7aba2740d8409ac60df"));
+   QVERIFY(h1 == h2);
+}
+
 void Tests::hasher()
 {
    char str1[] = "abc";
@@ -666,6 +741,125 @@ void Tests::hasher()
    QVERIFY(h4 == h5);
 }
 
+/**
+  * All the available SHA-1 backends must give the same result as 'QCryptographicHash'.
+  */
+void Tests::sha1Backends()
+{
+   MTRand mtRand(42);
+   QByteArray data(100000, 0);
+   for (int i = 0; i < data.size(); i++)
+      data[i] = static_cast<char>(mtRand.randInt(255));
+
+   const int sizes[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 65536, 99000 };
+
+   for (int b = 0; b < SHA1::NB_BACKENDS; b++)
+   {
+      const SHA1::Backend backend = static_cast<SHA1::Backend>(b);
+      if (!SHA1::isAvailable(backend))
+      {
+         qDebug() << "SHA-1 backend not available:" << SHA1::getBackendName(backend);
+         continue;
+      }
+
+      for (size_t i = 0; i < sizeof(sizes) / sizeof(int); i++)
+      {
+         const QByteArray expected = QCryptographicHash::hash(data.left(sizes[i]), QCryptographicHash::Sha1);
+
+         // The data are given in small pieces of different sizes.
+         SHA1 sha1(backend);
+         for (int offset = 0, step = 1; offset < sizes[i]; step = step * 7 % 200 + 1)
+         {
+            const int n = qMin(step, sizes[i] - offset);
+            sha1.addData(data.constData() + offset, n);
+            offset += n;
+         }
+
+         char result[SHA1::HASH_SIZE];
+         sha1.getResult(result);
+         QVERIFY(QByteArray(result, SHA1::HASH_SIZE) == expected);
+      }
+   }
+}
+
+void Tests::sha1BackendsBenchmark()
+{
+   const int SIZE = 64 * 1024 * 1024; // 64 MiB, the size of a chunk.
+   const QByteArray data(SIZE, 'x');
+
+   QElapsedTimer timer;
+
+   timer.start();
+   QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+   qint64 delta = timer.elapsed();
+   qDebug() << "QCryptographicHash:" << (delta == 0 ? 0 : 1000LL * SIZE / delta / 1024 / 1024) << "MB/s";
+
+   for (int b = 0; b < SHA1::NB_BACKENDS; b++)
+   {
+      const SHA1::Backend backend = static_cast<SHA1::Backend>(b);
+      if (!SHA1::isAvailable(backend))
+         continue;
+
+      timer.start();
+      SHA1 sha1(backend);
+      sha1.addData(data.constData(), data.size());
+      char result[SHA1::HASH_SIZE];
+      sha1.getResult(result);
+      delta = timer.elapsed();
+      qDebug() << SHA1::getBackendName(backend) << ":" << (delta == 0 ? 0 : 1000LL * SIZE / delta / 1024 / 1024) << "MB/s";
+   }
+
+}
+
+void Tests::blake3()
+{
+   // The official test vectors, the input is the sequence 0, 1, .., 250, 0, 1, ..
+   const struct { int size; const char* hash; } vectors[] = {
+      { 0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262" },
+      { 1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213" },
+      { 1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7" },
+      { 1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444" },
+      { 2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a" },
+      { 8192, "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63" },
+      { 102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085" }
+   };
+
+   QByteArray data(102400, 0);
+   for (int i = 0; i < data.size(); i++)
+      data[i] = static_cast<char>(i % 251);
+
+   for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+   {
+      const QByteArray expected = QByteArray::fromHex(vectors[i].hash);
+
+      BLAKE3 blake3;
+      blake3.addData(data.constData(), vectors[i].size);
+      char result[32];
+      blake3.getResult(result, 32);
+      QVERIFY(QByteArray(result, 32) == expected);
+
+      // The data are given in small pieces of different sizes, the whole chunks aren't hashed in parallel in this case.
+      Hasher hasher(HashAlgorithm::BLAKE3);
+      for (int offset = 0, step = 1; offset < vectors[i].size; step = step * 7 % 2000 + 1)
+      {
+         const int n = qMin(step, vectors[i].size - offset);
+         hasher.addData(data.constData() + offset, n);
+         offset += n;
+      }
+      QVERIFY(hasher.getResult().getByteArray() == expected.left(Hash::HASH_SIZE));
+   }
+
+   const int SIZE = 64 * 1024 * 1024; // 64 MiB, the size of a chunk.
+   const QByteArray chunk(SIZE, 'x');
+   QElapsedTimer timer;
+   timer.start();
+   Hasher hasher(HashAlgorithm::BLAKE3);
+   hasher.addData(chunk.constData(), chunk.size());
+   hasher.getResult();
+   const qint64 delta = timer.elapsed();
+   qDebug() << "BLAKE3" << (BLAKE3::isAVX2Available() ? "(AVX2)" : "") << ":" << (delta == 0 ? 0 : 1000LL * SIZE / delta / 1024 / 1024) << "MB/s";
+}
+
 void Tests::bloomFilter()
 {
    BloomFilter bloomFilter;
@@ -688,6 +882,7 @@ void Tests::bloomFilter()
       bloomFilter.reset();
       for (int j = 0; j < n; j++)
          bloomFilter.add(Common::Hash::rand());
+      QCOMPARE(bloomFilter.getSize(), n);
 
       if (bloomFilter.test(h3))
          nbOfFalsePositive++;
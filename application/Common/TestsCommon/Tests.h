@@ -55,6 +55,9 @@ private slots:
    // TransferRateCalculator
    void transferRateCalculator();
 
+   // BandwidthLimiter
+   void bandwidthLimiter();
+
    // PersistentData class.
    void writePersistentData();
    void readPersistentData();
@@ -70,7 +73,11 @@ private slots:
    void buildAnHashFromAString();
    void compareTwoHash();
    void hashMoveConstuctorAndAssignment();
+   void hashNullAndQHash();
    void hasher();
+   void sha1Backends();
+   void sha1BackendsBenchmark();
+   void blake3();
 
    // BloomFilter class.
    void bloomFilter();
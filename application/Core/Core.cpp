@@ -171,6 +171,7 @@ void Core::checkSettingsIntegrity()
    if (SETTINGS.get<QString>("nick").isEmpty())
       SETTINGS.set("nick", Common::Global::getCurrenMachineName());
 
+   this->checkSetting("block_size", 64u * 1024u, 64u * 1024u * 1024u);
    this->checkSetting("buffer_size_reading", 1024u, 32u * 1024u * 1024u);
    this->checkSetting("buffer_size_writing", 1024u, 32u * 1024u * 1024u);
    this->checkSetting("socket_buffer_size", 1024u, 32u * 1024u * 1024u);
@@ -186,6 +187,11 @@ void Core::checkSettingsIntegrity()
    }
    this->checkSetting("minimum_free_space", 0u, 4294967295u);
    this->checkSetting("save_cache_period", 1000u, 4294967295u);
+   this->checkSetting("number_of_hashing_thread", 0u, 64u);
+   this->checkSetting("number_of_scanning_thread", 0u, 256u);
+   this->checkSetting("find_cache_size", 0u, 10000u);
+   this->checkSetting("read_ahead_buffer_size", 4096u, 64u * 1024u * 1024u);
+   this->checkSetting("number_of_read_ahead_buffers", 0u, 32u);
 
    this->checkSetting("get_entries_timeout", 1000u, 60u * 1000u);
    this->checkSetting("pending_socket_timeout", 10u, 30u * 1000u);
@@ -194,17 +200,24 @@ void Core::checkSettingsIntegrity()
    this->checkSetting("max_number_idle_socket", 0u, 10u);
    this->checkSetting("get_hashes_timeout", 1000u, 60u * 1000u);
 
-   this->checkSetting("number_of_downloader", 1u, 10u);
+   this->checkSetting("number_of_downloader", 1u, 256u);
+   this->checkSetting("min_number_of_downloader", 1u, 256u);
+   this->checkSetting("max_number_of_downloader", 1u, 256u);
    this->checkSetting("lan_speed", 1024u * 1024u, 1024u * 1024u * 1024u);
    this->checkSetting("time_recheck_chunk_factor", 1.0, 10.0);
    this->checkSetting("switch_to_another_peer_factor", 1.0, 10.0);
    this->checkSetting("download_rate_valid_time_factor", 100u, 100000u);
    this->checkSetting("save_queue_period", 1000u, 4294967295u);
    this->checkSetting("block_duration_corrupted_data", 0u, 60u * 60u * 1000u);
+   this->checkSetting("rarest_first_max_peers", 0u, 1000u);
 
    this->checkSetting("upload_lifetime", 0u, 30u * 1000u);
    this->checkSetting("upload_min_nb_thread", 1u, 1000u);
    this->checkSetting("upload_thread_lifetime", 0u, 60u * 60u * 1000u);
+   this->checkSetting("number_of_upload_thread", 1u, 64u);
+
+   this->checkSetting("limited_period_begin", 0u, 24u * 60u - 1u);
+   this->checkSetting("limited_period_end", 0u, 24u * 60u - 1u);
 
    this->checkSetting("peer_imalive_period", 1000u, 60u * 1000u);
    this->checkSetting("unicast_base_port", 1u, 65535u);
@@ -212,9 +225,14 @@ void Core::checkSettingsIntegrity()
    this->checkSetting("multicast_group", 1u, 4294967295u);
    this->checkSetting("multicast_ttl", 1u, 255u);
    this->checkSetting("max_udp_datagram_size", 255u, 65535u);
+   this->checkSetting("chunks_digest_size", 0u, 32768u);
    this->checkSetting("udp_buffer_size", 255u, 6684672u);
    this->checkSetting("max_number_of_search_result_to_send", 1u, 10000u);
    this->checkSetting("max_number_of_result_shown", 1u, 100000u);
+   this->checkSetting("number_of_search_thread", 1u, 64u);
+   this->checkSetting("max_number_of_pending_search", 1u, 10000u);
+   this->checkSetting("max_search_rate_per_peer", 1u, 60000u);
+   this->checkSetting("search_deduplication_period", 0u, 60u * 1000u);
 
    this->checkSetting("max_number_of_stored_chat_messages", 1u, 1000000u);
    this->checkSetting("number_of_chat_messages_to_retrieve", 1u, 1000000u);
@@ -30,6 +30,9 @@ SOURCES += priv/FileDownload.cpp \
     priv/DownloadPredicate.cpp \
     priv/DownloadQueue.cpp \
     priv/ChunkDownloader.cpp \
+    priv/BlockDownloader.cpp \
+    priv/ConcurrencyController.cpp \
+    priv/LinkedPeers.cpp \
     priv/Utils.cpp
 HEADERS += IDownloadManager.h \
     IDownload.h \
@@ -50,4 +53,6 @@ HEADERS += IDownloadManager.h \
     Utils.h \
     priv/LinkedPeers.h \
     IChunkDownloader.h \
-    priv/ChunkDownloader.h
+    priv/ChunkDownloader.h \
+    priv/BlockDownloader.h \
+    priv/ConcurrencyController.h
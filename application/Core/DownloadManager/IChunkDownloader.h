@@ -35,12 +35,6 @@ namespace DM
         * Gets the hash of the associated chunk.
         */
       virtual Common::Hash getHash() const = 0;
-
-      /**
-        * Define (or redefine) the peers which have the chunk.
-        */
-      virtual void addPeer(PM::IPeer* peer) = 0;
-      virtual void rmPeer(PM::IPeer* peer) = 0;
    };
 }
 #endif
@@ -20,12 +20,14 @@
 #define DOWNLOADMANAGER_IDOWNLOADMANAGER_H
 
 #include <QList>
+#include <QBitArray>
 #include <QSharedPointer>
 
 #include <Protos/common.pb.h>
 #include <Protos/gui_protocol.pb.h>
 
 #include <Common/Hash.h>
+#include <Common/HashesDigest.h>
 
 #include <Core/DownloadManager/IChunkDownloader.h>
 
@@ -92,10 +94,49 @@ namespace DM
         */
       virtual QList<QSharedPointer<IChunkDownloader>> getTheOldestUnfinishedChunks(int n) = 0;
 
+      /**
+        * Define (or redefine) the peers which have the given chunks, for example from a 'ChunksOwned' message.
+        * 'peer' owns 'chunks[i]' if the bit 'i' of 'chunksOwned' is set. All the chunks are updated at once.
+        */
+      virtual void updateChunksOwned(PM::IPeer* peer, const QList<QSharedPointer<IChunkDownloader>>& chunks, const QBitArray& chunksOwned) = 0;
+
+      /**
+        * Test the unfinished chunks of the queue against the digest of the chunks owned by a peer.
+        * The chunks which may be owned by the peer aren't added to it, they have to be confirmed, see 'getTheChunksFoundInDigests(..)'.
+        */
+      virtual void chunksDigestReceived(PM::IPeer* peer, const Common::HashesDigest& digest) = 0;
+
+      /**
+        * Return and forget the n (at max) first chunks found in the digests of the other peers, they should be asked before the other ones.
+        */
+      virtual QList<QSharedPointer<IChunkDownloader>> getTheChunksFoundInDigests(int n) = 0;
+
       /**
         * @return Byte/s.
         */
       virtual int getDownloadRate() = 0;
+
+      /**
+        * @return The current limit of the download rate [byte/s], 0 if unlimited.
+        */
+      virtual int getDownloadRateLimit() = 0;
+
+      /**
+        * @return The number of chunks currently downloading, one per peer.
+        */
+      virtual int getNumberOfDownloads() = 0;
+
+      /**
+        * The number of simultaneous downloads is adapted to the download rate, the disk speed and the number of peers.
+        * @return The current maximum number of simultaneous downloads.
+        */
+      virtual int getDownloadConcurrency() = 0;
+
+      /**
+        * Estimate the time to download the queue from the current download rate. Only the chunks owned by at least one peer are taken into account.
+        * @return [s], -1 if nothing is downloading.
+        */
+      virtual int getRemainingTime() = 0;
    };
 }
 #endif
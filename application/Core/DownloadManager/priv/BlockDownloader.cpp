@@ -0,0 +1,378 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <priv/BlockDownloader.h>
+using namespace DM;
+
+#include <QElapsedTimer>
+
+#include <Common/Settings.h>
+#include <Common/ProtoHelper.h>
+#include <Core/FileManager/Exceptions.h>
+#include <Core/FileManager/IDataWriter.h>
+
+#include <priv/ChunkDownloader.h>
+#include <priv/Log.h>
+
+/**
+  * @class DM::BlockDownloader
+  *
+  * Download a chunk from one peer, starting at the beginning of a block (or at the known bytes of the chunk).
+  * When a block is finished the download continues with the next one if nobody else is downloading it,
+  * thus a chunk can be downloaded from many peers at the same time, see 'ChunkDownloader'.
+  * In endgame mode only one block is downloaded and the download stops as soon as the block is known.
+  */
+
+const int BlockDownloader::MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED(100); // [ms]
+
+BlockDownloader::BlockDownloader(ChunkDownloader& chunkDownloader, const QSharedPointer<FM::IChunk>& chunk, PM::IPeer* peer, int block, bool endgame, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter, ConcurrencyController& concurrencyController, Common::ThreadPool& threadPool) :
+   chunkDownloader(chunkDownloader),
+   chunk(chunk),
+   peer(peer),
+   block(block),
+   endgame(endgame),
+   offset(0),
+   transferRateCalculator(transferRateCalculator),
+   bandwidthLimiter(bandwidthLimiter),
+   concurrencyController(concurrencyController),
+   threadPool(threadPool),
+   socket(0),
+   remoteKnownBytes(0),
+   downloading(false),
+   closeTheSocket(false),
+   lastTransferStatus(QUEUED),
+   mainThread(QThread::currentThread())
+{
+   static const int BLOCK_SIZE = SETTINGS.get<quint32>("block_size");
+
+   // The known bytes may be in the middle of the block.
+   const int knownBytes = this->chunk->getKnownBytes();
+   this->offset = knownBytes > this->block * BLOCK_SIZE && knownBytes < (this->block + 1) * BLOCK_SIZE ? knownBytes : this->block * BLOCK_SIZE;
+}
+
+BlockDownloader::~BlockDownloader()
+{
+   this->stop();
+}
+
+/**
+  * Ask the chunk data to the peer.
+  * @return 'false' if the request can't be sent.
+  */
+bool BlockDownloader::start()
+{
+   Protos::Core::GetChunk getChunkMess;
+   Common::ProtoHelper::setHash(*getChunkMess.mutable_chunk(), this->chunk->getHash());
+   getChunkMess.set_offset(this->offset);
+   this->getChunkResult = this->peer->getChunk(getChunkMess);
+   if (this->getChunkResult.isNull())
+      return false;
+
+   L_DEBU(QString("Starting downloading a chunk from offset %1%2 : %3 from %4").arg(this->offset).arg(this->endgame ? " (endgame)" : "").arg(this->chunk->toStringLog()).arg(this->peer->getID().toStr()));
+
+   this->downloading = true;
+
+   connect(this->getChunkResult.data(), SIGNAL(result(const Protos::Core::GetChunkResult&)), this, SLOT(result(const Protos::Core::GetChunkResult&)), Qt::DirectConnection);
+   connect(this->getChunkResult.data(), SIGNAL(stream(QSharedPointer<PM::ISocket>)), this, SLOT(stream(QSharedPointer<PM::ISocket>)), Qt::DirectConnection);
+   connect(this->getChunkResult.data(), SIGNAL(timeout()), this, SLOT(getChunkTimeout()), Qt::DirectConnection);
+
+   this->getChunkResult->start();
+   return true;
+}
+
+void BlockDownloader::stop()
+{
+   if (this->downloading)
+   {
+      this->mutex.lock();
+      this->downloading = false;
+      this->mutex.unlock();
+
+      this->threadPool.wait(this);
+
+      this->downloadingEnded();
+   }
+}
+
+PM::IPeer* BlockDownloader::getPeer() const
+{
+   return this->peer;
+}
+
+int BlockDownloader::getBlock() const
+{
+   return this->block;
+}
+
+Status BlockDownloader::getLastTransferStatus() const
+{
+   return this->lastTransferStatus;
+}
+
+void BlockDownloader::init(QThread* thread)
+{
+   this->socket->moveToThread(thread);
+}
+
+void BlockDownloader::run()
+{
+   int deltaRead = 0;
+   QElapsedTimer timer;
+   timer.start();
+
+   try
+   {
+      QSharedPointer<FM::IDataWriter> writer = this->chunk->getDataWriter(this->offset);
+
+      static const int SOCKET_TIMEOUT = SETTINGS.get<quint32>("socket_timeout");
+      static const int TIME_PERIOD_CHOOSE_ANOTHER_PEER = 1000.0 * SETTINGS.get<double>("time_recheck_chunk_factor") * SETTINGS.get<quint32>("chunk_size") / SETTINGS.get<quint32>("lan_speed");
+      static const int BLOCK_SIZE = SETTINGS.get<quint32>("block_size");
+
+      static const int BUFFER_SIZE = SETTINGS.get<quint32>("buffer_size_writing");
+      char buffer[BUFFER_SIZE];
+
+      const int chunkSize = this->chunk->getChunkSize();
+      const int end = qMin(this->remoteKnownBytes, chunkSize); // The remote peer will send us the data until 'end'.
+      int blockEnd = qMin((this->block + 1) * BLOCK_SIZE, end);
+      int bytesToWrite = 0;
+
+      forever
+      {
+         this->mutex.lock();
+         if (!this->downloading)
+         {
+            L_DEBU(QString("Downloading aborted, chunk : %1%2").arg(this->chunk->toStringLog()).arg(this->chunk->isComplete() ? "" : " Not complete!"));
+            this->closeTheSocket = true; // Because some garbage from the remote uploader will continue to come in this socket.
+            this->mutex.unlock();
+            break;
+         }
+         this->mutex.unlock();
+
+         // A buffer never spans two blocks.
+         const int bytesToRead = qMin(blockEnd - this->offset - bytesToWrite, BUFFER_SIZE - bytesToWrite);
+
+         // Because of the bandwidth limit some bytes may be read only after a while, meanwhile the data stay in the socket buffer.
+         const int bytesAllowed = this->bandwidthLimiter.acquire(this, this->peer->getID(), bytesToRead);
+         if (bytesAllowed == 0)
+            continue;
+
+         int bytesRead = this->socket->read(buffer + bytesToWrite, bytesAllowed);
+         this->bandwidthLimiter.giveBack(this, bytesAllowed - qMax(bytesRead, 0));
+
+         if (bytesRead == 0)
+         {
+            if (!this->socket->waitForReadyRead(SOCKET_TIMEOUT))
+            {
+               L_WARN(QString("Connection dropped, error = %1, bytesAvailable = %2").arg(socket->errorString()).arg(socket->bytesAvailable()));
+               this->closeTheSocket = true;
+               this->lastTransferStatus = TRANSFER_ERROR;
+               break;
+            }
+            continue;
+         }
+         else if (bytesRead == -1)
+         {
+            L_WARN(QString("Socket : cannot receive data : %1").arg(this->chunk->toStringLog()));
+            this->closeTheSocket = true;
+            this->lastTransferStatus = TRANSFER_ERROR;
+            break;
+         }
+
+         deltaRead += bytesRead;
+         bytesToWrite += bytesRead;
+         this->transferRateCalculator.addData(bytesRead);
+
+         if (timer.elapsed() > TIME_PERIOD_CHOOSE_ANOTHER_PEER)
+         {
+            this->peer->setSpeed(deltaRead / timer.elapsed() * 1000);
+            L_DEBU(QString("Check for a better peer for the chunk: %1, current peer: %2 . . .").arg(this->chunk->toStringLog()).arg(this->peer->toStringLog()));
+            timer.start();
+            deltaRead = 0;
+
+            // If a another peer exists and its speed is greater than our by a factor 'switch_to_another_peer_factor'
+            // then we will try to switch to this peer.
+            PM::IPeer* peer = this->chunkDownloader.getTheFastestFreePeer();
+            if (
+               peer &&
+               peer != this->peer &&
+               peer->getSpeed() / SETTINGS.get<double>("switch_to_another_peer_factor") > this->peer->getSpeed()
+            )
+            {
+               L_DEBU(QString("Switch to a better peer: %1").arg(peer->toStringLog()));
+               this->closeTheSocket = true; // We ask to close the socket to avoid to get garbage data.
+               break;
+            }
+         }
+
+         // If the buffer is full or the end of the block is reached.
+         if (bytesToWrite == BUFFER_SIZE || this->offset + bytesToWrite == blockEnd)
+         {
+            // In endgame mode the same block is downloaded from two peers, the slowest one stops.
+            // The file may have been completed and released by the other one, it can't be written anymore.
+            if (this->chunk->getKnownBlocks().testBit(this->block))
+            {
+               L_DEBU(QString("Block %1 already downloaded by another peer, chunk : %2").arg(this->block).arg(this->chunk->toStringLog()));
+               this->closeTheSocket = true;
+               break;
+            }
+
+            QElapsedTimer writeTimer;
+            writeTimer.start();
+            writer->write(buffer, bytesToWrite);
+            this->concurrencyController.addWriteLatency(writeTimer.nsecsElapsed());
+            this->offset += bytesToWrite;
+            bytesToWrite = 0;
+
+            if (this->offset == end)
+               break;
+
+            if (this->offset == blockEnd)
+            {
+               // The next block is taken only if nobody else is downloading it.
+               if (this->endgame || !this->chunkDownloader.claimBlock(this->block, this->block + 1))
+               {
+                  this->block = this->endgame ? this->block : -1;
+                  this->closeTheSocket = true;
+                  break;
+               }
+               this->block++;
+               blockEnd = qMin((this->block + 1) * BLOCK_SIZE, end);
+            }
+         }
+      }
+   }
+   catch(FM::FileResetException)
+   {
+      L_DEBU("FileResetException");
+      this->closeTheSocket = true;
+      this->lastTransferStatus = FILE_NON_EXISTENT;
+   }
+   catch(FM::ChunkDataUnknownException)
+   {
+      L_DEBU("ChunkDataUnknownException");
+      this->closeTheSocket = true;
+      this->lastTransferStatus = UNABLE_TO_OPEN_THE_FILE;
+   }
+   catch(FM::UnableToOpenFileInWriteModeException)
+   {
+      L_DEBU("UnableToOpenFileInWriteModeException");
+      this->closeTheSocket = true;
+      this->lastTransferStatus = UNABLE_TO_OPEN_THE_FILE;
+   }
+   catch(FM::IOErrorException&)
+   {
+      L_DEBU("IOErrorException");
+      this->closeTheSocket = true;
+      if (!this->chunk->isComplete()) // The chunk may have been completed by another peer just before the write, see the endgame mode.
+         this->lastTransferStatus = FILE_IO_ERROR;
+   }
+   catch (FM::ChunkDeletedException&)
+   {
+      L_DEBU("ChunkDeletedException");
+      this->closeTheSocket = true;
+      this->lastTransferStatus = FILE_NON_EXISTENT;
+   }
+   catch (FM::TryToWriteBeyondTheEndOfChunkException&)
+   {
+      L_DEBU("TryToWriteBeyondTheEndOfChunkException");
+      this->closeTheSocket = true;
+      this->lastTransferStatus = GOT_TOO_MUCH_DATA;
+   }
+   catch (FM::hashMissmatchException)
+   {
+      // The peer which has completed the chunk is blocked even if the corrupted data may come from another one.
+      static const quint32 BLOCK_DURATION = SETTINGS.get<quint32>("block_duration_corrupted_data");
+      L_USER(QString(tr("Corrupted data received for the file \"%1\" from peer %2. Peer blocked for %3 ms")).arg(this->chunk->getFilePath()).arg(this->peer->getNick()).arg(BLOCK_DURATION));
+      /*: A reason why the user has been blocked */
+      this->peer->block(BLOCK_DURATION, tr("Has sent corrupted data"));
+      this->closeTheSocket = true;
+      this->lastTransferStatus = HASH_MISSMATCH;
+   }
+
+   if (timer.elapsed() > MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED)
+      this->peer->setSpeed(deltaRead / timer.elapsed() * 1000);
+
+   this->bandwidthLimiter.removeStream(this);
+   this->socket->setReadBufferSize(0);
+   this->socket->moveToThread(this->mainThread);
+}
+
+void BlockDownloader::finished()
+{
+   if (this->downloading)
+      this->downloadingEnded();
+}
+
+void BlockDownloader::result(const Protos::Core::GetChunkResult& result)
+{
+   if (result.status() != Protos::Core::GetChunkResult::OK)
+   {
+      L_WARN(QString("Status error from GetChunkResult : %1. Download aborted.").arg(result.status()));
+      this->chunkDownloader.rmPeer(this->peer);
+      this->downloadingEnded();
+   }
+   else
+   {
+      if (!result.has_chunk_size())
+      {
+         L_ERRO(QString("Message 'GetChunkResult' doesn't contain the size of the chunk : %1. Download aborted.").arg(this->chunk->getHash().toStr()));
+         this->closeTheSocket = true;
+         this->downloadingEnded();
+      }
+      else if (static_cast<int>(result.chunk_size()) <= this->offset)
+      {
+         L_DEBU(QString("The peer doesn't have the asked data, offset = %1, chunk size = %2. Download aborted.").arg(this->offset).arg(result.chunk_size()));
+         this->chunkDownloader.rmPeer(this->peer);
+         this->closeTheSocket = true;
+         this->downloadingEnded();
+      }
+      else
+      {
+         this->remoteKnownBytes = result.chunk_size();
+      }
+   }
+}
+
+void BlockDownloader::stream(const QSharedPointer<PM::ISocket>& socket)
+{
+   this->socket = socket;
+   static const quint32 SOCKET_BUFFER_SIZE = SETTINGS.get<quint32>("socket_buffer_size");
+   this->socket->setReadBufferSize(SOCKET_BUFFER_SIZE);
+   this->threadPool.run(this);
+}
+
+void BlockDownloader::getChunkTimeout()
+{
+   L_WARN("Timeout from GetChunkResult, Download aborted.");
+   this->downloadingEnded();
+}
+
+void BlockDownloader::downloadingEnded()
+{
+   L_DEBU(QString("Downloading ended, chunk : %1%2").arg(this->chunk->toStringLog()).arg(this->chunk->isComplete() ? "" : " Not complete!"));
+
+   if (!this->socket.isNull())
+      this->socket.clear();
+
+   this->getChunkResult->setStatus(this->closeTheSocket);
+   this->closeTheSocket = false;
+   this->getChunkResult.clear();
+
+   this->downloading = false;
+   emit downloadFinished();
+}
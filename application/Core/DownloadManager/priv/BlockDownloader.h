@@ -0,0 +1,106 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#ifndef DOWNLOADMANAGER_BLOCKDOWNLOADER_H
+#define DOWNLOADMANAGER_BLOCKDOWNLOADER_H
+
+#include <QSharedPointer>
+#include <QThread>
+#include <QMutex>
+
+#include <Protos/core_protocol.pb.h>
+
+#include <Common/TransferRateCalculator.h>
+#include <Common/BandwidthLimiter.h>
+#include <Common/Uncopyable.h>
+#include <Common/IRunnable.h>
+#include <Common/ThreadPool.h>
+#include <Core/FileManager/IChunk.h>
+#include <Core/PeerManager/IPeer.h>
+#include <Core/PeerManager/IGetChunkResult.h>
+
+#include <IDownload.h>
+#include <priv/ConcurrencyController.h>
+
+namespace DM
+{
+   class ChunkDownloader;
+
+   class BlockDownloader : public QObject, public Common::IRunnable, Common::Uncopyable
+   {
+      static const int MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED;
+
+      Q_OBJECT
+   public:
+      BlockDownloader(ChunkDownloader& chunkDownloader, const QSharedPointer<FM::IChunk>& chunk, PM::IPeer* peer, int block, bool endgame, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter, ConcurrencyController& concurrencyController, Common::ThreadPool& threadPool);
+      ~BlockDownloader();
+
+      bool start();
+      void stop();
+
+      PM::IPeer* getPeer() const;
+      int getBlock() const;
+      Status getLastTransferStatus() const;
+
+      void init(QThread* thread);
+      void run();
+      void finished();
+
+   signals:
+      /**
+        * Emitted when the download is terminated (or aborted).
+        */
+      void downloadFinished();
+
+   private slots:
+      void result(const Protos::Core::GetChunkResult& result);
+      void stream(const QSharedPointer<PM::ISocket>& socket);
+      void getChunkTimeout();
+
+   private:
+      void downloadingEnded();
+
+      ChunkDownloader& chunkDownloader;
+      QSharedPointer<FM::IChunk> chunk;
+      PM::IPeer* peer;
+
+      int block; ///< The block currently downloaded, -1 if there is none.
+      const bool endgame; ///< The block is already downloaded by another peer, only this block will be downloaded.
+      int offset; ///< The first byte asked, relative to the chunk.
+
+      Common::TransferRateCalculator& transferRateCalculator;
+      Common::BandwidthLimiter& bandwidthLimiter;
+      ConcurrencyController& concurrencyController;
+      Common::ThreadPool& threadPool;
+
+      QSharedPointer<PM::ISocket> socket;
+
+      int remoteKnownBytes; ///< The amount of data the remote peer has, given by 'GetChunkResult'.
+      QSharedPointer<PM::IGetChunkResult> getChunkResult;
+
+      bool downloading;
+      bool closeTheSocket;
+      Status lastTransferStatus;
+
+      QThread* mainThread;
+
+      mutable QMutex mutex; // To protect 'downloading'.
+   };
+}
+
+#endif
@@ -19,10 +19,7 @@
 #include <priv/ChunkDownloader.h>
 using namespace DM;
 
-#include <QElapsedTimer>
-
 #include <Common/Settings.h>
-#include <Core/FileManager/Exceptions.h>
 #include <Core/PeerManager/IPeer.h>
 
 #include <priv/Log.h>
@@ -32,24 +29,31 @@ using namespace DM;
   *
   * A class to download a file chunk. A ChunkDownloader can exist only if we know its hash.
   * It can be created when a new FileDownload is added for each chunk known in the given entry or when a FileDownload receive a hash.
+  *
+  * The chunk is divided in blocks (see the setting 'block_size') which can be downloaded from several peers at the same time, each
+  * download is handled by a 'BlockDownloader'. When all the blocks are known or being downloaded the last ones can be asked to
+  * a second peer (endgame mode), the first which finishes the block wins.
   */
 
-const int ChunkDownloader::MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED(100); // [ms]
-
-ChunkDownloader::ChunkDownloader(LinkedPeers& linkedPeers, OccupiedPeers& occupiedPeersDownloadingChunk, Common::TransferRateCalculator& transferRateCalculator, Common::ThreadPool& threadPool, Common::Hash chunkHash) :
+ChunkDownloader::ChunkDownloader(FileDownload& fileDownload, LinkedPeers& linkedPeers, OccupiedPeers& occupiedPeersDownloadingChunk, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter, ConcurrencyController& concurrencyController, Common::ThreadPool& threadPool, Common::Hash chunkHash, int num) :
+   fileDownload(fileDownload),
    linkedPeers(linkedPeers),
    occupiedPeersDownloadingChunk(occupiedPeersDownloadingChunk),
    transferRateCalculator(transferRateCalculator),
+   bandwidthLimiter(bandwidthLimiter),
+   concurrencyController(concurrencyController),
    threadPool(threadPool),
    chunkHash(chunkHash),
-   socket(0),
-   downloading(false),
-   closeTheSocket(false),
+   num(num),
+   priority(0),
+   rarity(0),
+   active(true),
+   nbPeers(0),
    lastTransferStatus(QUEUED),
-   mainThread(QThread::currentThread()),
    mutex(QMutex::Recursive)
 {
    Q_ASSERT(!chunkHash.isNull());
+   this->linkedPeers.addChunk(this);
    L_DEBU(QString("New ChunkDownloader : %1").arg(this->chunkHash.toStr()));
 }
 
@@ -57,27 +61,22 @@ ChunkDownloader::~ChunkDownloader()
 {
    this->stop();
 
-   for (QListIterator<PM::IPeer*> i(this->peers); i.hasNext();)
-      this->linkedPeers.rmLink(i.next());
+   this->unlinkAll();
+   if (this->active)
+      this->linkedPeers.rmChunk(this);
 
    L_DEBU(QString("ChunkDownloader deleted : %1").arg(this->chunkHash.toStr()));
 }
 
 /**
-  * Return true if the chunk was downloading.
+  * Stop all the downloads of the chunk.
   */
 void ChunkDownloader::stop()
 {
-   if (this->downloading)
-   {
-      this->mutex.lock();
-      this->downloading = false;
-      this->mutex.unlock();
-
-      this->threadPool.wait(this);
-
-      this->downloadingEnded();
-   }
+   // 'blockDownloaderFinished()' removes each stopped downloader from 'blockDownloaders'.
+   const QList<QSharedPointer<BlockDownloader>> blockDownloaders = this->blockDownloaders;
+   for (QListIterator<QSharedPointer<BlockDownloader>> i(blockDownloaders); i.hasNext();)
+      i.next()->stop();
 }
 
 Common::Hash ChunkDownloader::getHash() const
@@ -85,197 +84,137 @@ Common::Hash ChunkDownloader::getHash() const
    return this->chunkHash;
 }
 
-void ChunkDownloader::addPeer(PM::IPeer* peer)
+FileDownload& ChunkDownloader::getFileDownload() const
 {
-   Q_ASSERT(peer);
+   return this->fileDownload;
+}
 
+int ChunkDownloader::getNum() const
+{
+   return this->num;
+}
+
+qint64 ChunkDownloader::getPriority() const
+{
+   return this->priority;
+}
+
+/**
+  * @return The number of peers owning the chunk, bounded by 'rarest_first_max_peers' + 1 : all the chunks owned by more peers have the same rarity.
+  */
+int ChunkDownloader::getRarity() const
+{
+   return this->rarity;
+}
+
+int ChunkDownloader::getNbPeers() const
+{
    QMutexLocker locker(&this->mutex);
+   return this->nbPeers;
+}
 
-   if (this->isComplete())
+/**
+  * The chunk is indexed again with its new priority.
+  */
+void ChunkDownloader::setPriority(qint64 priority)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (priority == this->priority)
       return;
 
-   if (!this->peers.contains(peer))
-   {
-      this->peers << peer;
-      this->linkedPeers.addLink(peer);
-      emit numberOfPeersChanged();
-      this->occupiedPeersDownloadingChunk.newPeer(peer);
-   }
+   this->unlinkAll();
+   this->priority = priority;
+   this->linkAll();
 }
 
-void ChunkDownloader::rmPeer(PM::IPeer* peer)
+/**
+  * An inactive chunk (for example when its file is paused) isn't indexed in 'LinkedPeers', its peers are kept.
+  */
+void ChunkDownloader::setActive(bool active)
 {
-   Q_ASSERT(peer);
-
    QMutexLocker locker(&this->mutex);
 
-   if (this->peers.isEmpty())
+   if (active == this->active)
       return;
 
-   if (this->peers.removeOne(peer))
+   if (!active)
    {
-      this->linkedPeers.rmLink(peer);
-      emit numberOfPeersChanged();
+      this->unlinkAll();
+      this->linkedPeers.rmChunk(this);
+   }
+
+   this->active = active;
+
+   if (active)
+   {
+      this->linkedPeers.addChunk(this);
+      this->linkAll();
    }
 }
 
-void ChunkDownloader::init(QThread* thread)
+bool ChunkDownloader::isActive() const
 {
-   this->socket->moveToThread(thread);
+   QMutexLocker locker(&this->mutex);
+   return this->active;
 }
 
-void ChunkDownloader::run()
+void ChunkDownloader::addPeer(PM::IPeer* peer)
 {
-   int deltaRead = 0;
-   QElapsedTimer timer;
-   timer.start();
-   this->lastTransferStatus = QUEUED;
+   Q_ASSERT(peer);
 
-   try
+   if (this->updatePeer(this->linkedPeers.getPeerIndex(peer), true))
    {
-      QSharedPointer<FM::IDataWriter> writer = this->chunk->getDataWriter();
+      emit numberOfPeersChanged();
+      this->occupiedPeersDownloadingChunk.newPeer(peer);
+   }
+}
 
-      static const int SOCKET_TIMEOUT = SETTINGS.get<quint32>("socket_timeout");
-      static const int TIME_PERIOD_CHOOSE_ANOTHER_PEER = 1000.0 * SETTINGS.get<double>("time_recheck_chunk_factor") * SETTINGS.get<quint32>("chunk_size") / SETTINGS.get<quint32>("lan_speed");
+void ChunkDownloader::rmPeer(PM::IPeer* peer)
+{
+   Q_ASSERT(peer);
 
-      static const int BUFFER_SIZE = SETTINGS.get<quint32>("buffer_size_writing");
-      char buffer[BUFFER_SIZE];
+   if (this->updatePeer(this->linkedPeers.getPeerIndex(peer), false))
+      emit numberOfPeersChanged();
+}
 
-      const int initialKnownBytes = this->chunk->getKnownBytes();
-      int bytesToRead = this->chunkSize - initialKnownBytes;
-      int bytesToWrite = 0;
-      int bytesWritten = 0;
+/**
+  * Add or remove a peer without emitting 'numberOfPeersChanged()', to update many chunks at once, see 'DownloadManager::updateChunksOwned(..)'.
+  * @return 'true' if the peers of the chunk have changed.
+  */
+bool ChunkDownloader::updatePeer(int peerIndex, bool ownsTheChunk)
+{
+   QMutexLocker locker(&this->mutex);
 
-      forever
-      {
-         this->mutex.lock();
-         if (!this->downloading)
-         {
-            L_DEBU(QString("Downloading aborted, chunk : %1%2").arg(this->chunk->toStringLog()).arg(this->chunk->isComplete() ? "" : " Not complete!"));
-            this->closeTheSocket = true; // Because some garbage from the remote uploader will continue to come in this socket.
-            this->mutex.unlock();
-            break;
-         }
-         this->mutex.unlock();
-
-         int bytesRead = this->socket->read(buffer + bytesToWrite, bytesToRead < BUFFER_SIZE - bytesToWrite ? bytesToRead : BUFFER_SIZE - bytesToWrite);
-         bytesToRead -= bytesRead;
-
-         if (bytesRead == 0)
-         {
-            if (!this->socket->waitForReadyRead(SOCKET_TIMEOUT))
-            {
-               L_WARN(QString("Connection dropped, error = %1, bytesAvailable = %2").arg(socket->errorString()).arg(socket->bytesAvailable()));
-               this->closeTheSocket = true;
-               this->lastTransferStatus = TRANSFER_ERROR;
-               break;
-            }
-            continue;
-         }
-         else if (bytesRead == -1)
-         {
-            L_WARN(QString("Socket : cannot receive data : %1").arg(this->chunk->toStringLog()));
-            this->closeTheSocket = true;
-            this->lastTransferStatus = TRANSFER_ERROR;
-            break;
-         }
-
-         deltaRead += bytesRead;
-         bytesToWrite += bytesRead;
-
-         if (timer.elapsed() > TIME_PERIOD_CHOOSE_ANOTHER_PEER)
-         {
-            this->currentDownloadingPeer->setSpeed(deltaRead / timer.elapsed() * 1000);
-            L_DEBU(QString("Check for a better peer for the chunk: %1, current peer: %2 . . .").arg(this->chunk->toStringLog()).arg(this->currentDownloadingPeer->toStringLog()));
-            timer.start();
-            deltaRead = 0;
-
-            // If a another peer exists and its speed is greater than our by a factor 'switch_to_another_peer_factor'
-            // then we will try to switch to this peer.
-            PM::IPeer* peer = this->getTheFastestFreePeer();
-            if (
-               peer &&
-               peer != this->currentDownloadingPeer &&
-               peer->getSpeed() / SETTINGS.get<double>("switch_to_another_peer_factor") > this->currentDownloadingPeer->getSpeed()
-            )
-            {
-               L_DEBU(QString("Switch to a better peer: %1").arg(peer->toStringLog()));
-               this->closeTheSocket = true; // We ask to close the socket to avoid to get garbage data.
-               break;
-            }
-         }
-
-         // If the buffer is full or there is no more byte to read.
-         if (bytesToWrite == BUFFER_SIZE || bytesToRead == 0)
-         {
-            writer->write(buffer, bytesToWrite);
-            bytesWritten += bytesToWrite;
-            bytesToWrite = 0;
-         }
-
-         this->transferRateCalculator.addData(bytesRead);
-
-         if (initialKnownBytes + bytesWritten >= this->chunkSize)
-            break;
-      }
-   }
-   catch(FM::FileResetException)
-   {
-      L_DEBU("FileResetException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = FILE_NON_EXISTENT;
-   }
-   catch(FM::ChunkDataUnknownException)
-   {
-      L_DEBU("ChunkDataUnknownException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = UNABLE_TO_OPEN_THE_FILE;
-   }
-   catch(FM::UnableToOpenFileInWriteModeException)
-   {
-      L_DEBU("UnableToOpenFileInWriteModeException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = UNABLE_TO_OPEN_THE_FILE;
-   }
-   catch(FM::IOErrorException&)
-   {
-      L_DEBU("IOErrorException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = FILE_IO_ERROR;
-   }
-   catch (FM::ChunkDeletedException&)
-   {
-      L_DEBU("ChunkDeletedException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = FILE_NON_EXISTENT;
-   }
-   catch (FM::TryToWriteBeyondTheEndOfChunkException&)
+   if (ownsTheChunk == this->hasPeer(peerIndex) || (ownsTheChunk && this->isComplete()))
+      return false;
+
+   if (ownsTheChunk)
    {
-      L_DEBU("TryToWriteBeyondTheEndOfChunkException");
-      this->closeTheSocket = true;
-      this->lastTransferStatus = GOT_TOO_MUCH_DATA;
+      if (peerIndex >= this->peers.size())
+         this->peers.resize(peerIndex + 1);
+      this->peers.setBit(peerIndex);
+      this->nbPeers++;
+      this->link(peerIndex);
    }
-   catch (FM::hashMissmatchException)
+   else
    {
-      static const quint32 BLOCK_DURATION = SETTINGS.get<quint32>("block_duration_corrupted_data");
-      L_USER(QString(tr("Corrupted data received for the file \"%1\" from peer %2. Peer blocked for %3 ms")).arg(this->chunk->getFilePath()).arg(this->currentDownloadingPeer->getNick()).arg(BLOCK_DURATION));
-      /*: A reason why the user has been blocked */
-      this->currentDownloadingPeer->block(BLOCK_DURATION, tr("Has sent corrupted data"));
-      this->closeTheSocket = true;
-      this->lastTransferStatus = HASH_MISSMATCH;
+      this->peers.clearBit(peerIndex);
+      this->nbPeers--;
+      this->unlink(peerIndex);
    }
 
-   if (timer.elapsed() > MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED)
-      this->currentDownloadingPeer->setSpeed(deltaRead / timer.elapsed() * 1000);
-
-   this->socket->setReadBufferSize(0);
-   this->socket->moveToThread(this->mainThread);
+   this->updateRarity();
+   return true;
 }
 
-void ChunkDownloader::finished()
+/**
+  * The peer index is given by 'LinkedPeers::getPeerIndex(..)'.
+  */
+bool ChunkDownloader::isOwnedBy(int peerIndex) const
 {
-   if (this->downloading)
-      this->downloadingEnded();
+   QMutexLocker locker(&this->mutex);
+   return this->hasPeer(peerIndex);
 }
 
 void ChunkDownloader::setChunk(const QSharedPointer<FM::IChunk>& chunk)
@@ -291,11 +230,8 @@ QSharedPointer<FM::IChunk> ChunkDownloader::getChunk() const
 
 void ChunkDownloader::setPeerSource(PM::IPeer* peer, bool informOccupiedPeers)
 {
-   QMutexLocker locker(&this->mutex);
-   if (!this->peers.contains(peer))
+   if (this->updatePeer(this->linkedPeers.getPeerIndex(peer), true))
    {
-      this->peers << peer;
-      this->linkedPeers.addLink(peer);
       emit numberOfPeersChanged();
 
       if (informOccupiedPeers && peer->isAvailable())
@@ -305,23 +241,27 @@ void ChunkDownloader::setPeerSource(PM::IPeer* peer, bool informOccupiedPeers)
 
 /**
   * To be ready :
-  * - It must be have at least one peer.
   * - It isn't finished.
-  * - It isn't currently downloading.
-  * @return The number of free peer.
-  * @remarks This method may remove dead peers from the list.
+  * - It has at least one block which is unknown and not currently downloading or, in endgame mode,
+  *   a block downloaded by only one peer, see 'chooseABlock(..)'.
   */
-int ChunkDownloader::isReadyToDownload()
+bool ChunkDownloader::isReadyToDownload(bool& endgame)
 {
-   if (this->peers.isEmpty() || this->downloading || (!this->chunk.isNull() && this->chunk->isComplete()))
-      return 0;
+   endgame = false;
+
+   if (this->isComplete())
+      return false;
+
+   // The file isn't created yet.
+   if (this->chunk.isNull())
+      return true;
 
-   return this->getNumberOfFreePeer();
+   return this->chooseABlock(endgame) != -1;
 }
 
 bool ChunkDownloader::isDownloading() const
 {
-   return this->downloading;
+   return !this->blockDownloaders.isEmpty();
 }
 
 bool ChunkDownloader::isComplete() const
@@ -331,7 +271,7 @@ bool ChunkDownloader::isComplete() const
 
 bool ChunkDownloader::isPartiallyDownloaded() const
 {
-   return !this->chunk.isNull() && !this->chunk->isComplete() && this->chunk->getKnownBytes() > 0;
+   return !this->chunk.isNull() && !this->chunk->isComplete() && this->getDownloadedBytes() > 0;
 }
 
 bool ChunkDownloader::hasAtLeastAPeer()
@@ -359,12 +299,29 @@ void ChunkDownloader::resetLastTransferStatus()
    this->lastTransferStatus = QUEUED;
 }
 
+/**
+  * The known bytes of the chunk plus the blocks known after them.
+  */
 int ChunkDownloader::getDownloadedBytes() const
 {
+   static const int BLOCK_SIZE = SETTINGS.get<quint32>("block_size");
+
    if (this->chunk.isNull())
       return 0;
 
-   return this->chunk->getKnownBytes();
+   const int knownBytes = this->chunk->getKnownBytes();
+   const int chunkSize = this->chunk->getChunkSize();
+   if (knownBytes >= chunkSize)
+      return knownBytes;
+
+   // The block containing 'knownBytes' isn't known.
+   int downloadedBytes = knownBytes;
+   const QBitArray knownBlocks = this->chunk->getKnownBlocks();
+   for (int i = knownBytes / BLOCK_SIZE + 1; i < knownBlocks.size(); i++)
+      if (knownBlocks.testBit(i))
+         downloadedBytes += qMin((i + 1) * BLOCK_SIZE, chunkSize) - i * BLOCK_SIZE;
+
+   return downloadedBytes;
 }
 
 /**
@@ -375,62 +332,71 @@ QList<PM::IPeer*> ChunkDownloader::getPeers()
    QMutexLocker locker(&this->mutex);
 
    QList<PM::IPeer*> peers;
-   peers.reserve(this->peers.size());
+   peers.reserve(this->nbPeers);
 
    bool isTheNmberOfPeersHasChanged = false;
-   for (QMutableListIterator<PM::IPeer*> i(this->peers); i.hasNext();)
+   for (int i = 0; i < this->peers.size(); i++)
    {
-      PM::IPeer* peer = i.next();
+      if (!this->peers.testBit(i))
+         continue;
+
+      PM::IPeer* peer = this->linkedPeers.getPeer(i);
       if (peer->isAvailable())
          peers << peer;
       else
       {
-         i.remove();
-         this->linkedPeers.rmLink(peer);
+         this->removeDeadPeer(i);
          isTheNmberOfPeersHasChanged = true;
       }
    }
    if (isTheNmberOfPeersHasChanged)
+   {
+      this->updateRarity();
       emit numberOfPeersChanged();
+   }
    return peers;
 }
 
 /**
-  * Tell the ChunkDownloader to download the chunk from one of its peer.
-  * @return the choosen peer if the downloading has been started else return 0.
+  * Tell the ChunkDownloader to download a block of the chunk from the given peer.
+  * @return 'true' if the downloading has been started.
   */
-PM::IPeer* ChunkDownloader::startDownloading()
+bool ChunkDownloader::startDownloading(PM::IPeer* peer)
 {
    if (this->chunk.isNull())
    {
       L_WARN(QString("Unable to download without the chunk. Hash : %1").arg(this->chunkHash.toStr()));
-      return nullptr;
+      return false;
    }
 
-   this->currentDownloadingPeer = this->getTheFastestFreePeer();
-   if (!this->currentDownloadingPeer)
-      return nullptr;
+   this->mutex.lock();
 
-   Protos::Core::GetChunk getChunkMess;
-   getChunkMess.mutable_chunk()->set_hash(this->chunkHash.getData(), Common::Hash::HASH_SIZE);
-   getChunkMess.set_offset(this->chunk->getKnownBytes());
-   this->getChunkResult = this->currentDownloadingPeer->getChunk(getChunkMess);
-   if (this->getChunkResult.isNull())
-      return nullptr;
+   bool endgame;
+   const int block = this->chooseABlock(endgame);
+   if (block == -1)
+   {
+      this->mutex.unlock();
+      return false;
+   }
 
-   L_DEBU(QString("Starting downloading a chunk : %1 from %2").arg(this->chunk->toStringLog()).arg(this->currentDownloadingPeer->getID().toStr()));
+   QSharedPointer<BlockDownloader> blockDownloader(new BlockDownloader(*this, this->chunk, peer, block, endgame, this->transferRateCalculator, this->bandwidthLimiter, this->concurrencyController, this->threadPool), &QObject::deleteLater);
+   if (!blockDownloader->start())
+   {
+      this->mutex.unlock();
+      return false;
+   }
 
-   this->downloading = true;
-   emit downloadStarted();
+   this->nbDownloadersPerBlock[block]++;
+   this->mutex.unlock();
 
-   this->occupiedPeersDownloadingChunk.setPeerAsOccupied(this->currentDownloadingPeer);
+   this->blockDownloaders << blockDownloader;
+   connect(blockDownloader.data(), SIGNAL(downloadFinished()), this, SLOT(blockDownloaderFinished()), Qt::DirectConnection);
 
-   connect(this->getChunkResult.data(), SIGNAL(result(const Protos::Core::GetChunkResult&)), this, SLOT(result(const Protos::Core::GetChunkResult&)), Qt::DirectConnection);
-   connect(this->getChunkResult.data(), SIGNAL(stream(QSharedPointer<PM::ISocket>)), this, SLOT(stream(QSharedPointer<PM::ISocket>)), Qt::DirectConnection);
-   connect(this->getChunkResult.data(), SIGNAL(timeout()), this, SLOT(getChunkTimeout()), Qt::DirectConnection);
+   emit downloadStarted();
 
-   this->getChunkResult->start();
-   return this->currentDownloadingPeer;
+   this->occupiedPeersDownloadingChunk.setPeerAsOccupied(peer);
+
+   return true;
 }
 
 void ChunkDownloader::tryToRemoveItsIncompleteFile()
@@ -444,70 +410,59 @@ void ChunkDownloader::reset()
    this->chunk.clear();
 }
 
-void ChunkDownloader::result(const Protos::Core::GetChunkResult& result)
+/**
+  * Called by a 'BlockDownloader' (from its thread) when it reaches the end of 'previousBlock'.
+  * The claim on 'previousBlock' is released.
+  * @return 'true' if 'block' is free, it's then claimed by the caller.
+  */
+bool ChunkDownloader::claimBlock(int previousBlock, int block)
 {
-   if (result.status() != Protos::Core::GetChunkResult::OK)
-   {
-      L_WARN(QString("Status error from GetChunkResult : %1. Download aborted.").arg(result.status()));
-      if (this->peers.removeOne(this->currentDownloadingPeer))
-      {
-         this->linkedPeers.rmLink(this->currentDownloadingPeer);
-         emit numberOfPeersChanged();
-      }
-      this->downloadingEnded();
-   }
-   else
-   {
-      if (!result.has_chunk_size())
-      {
-         L_ERRO(QString("Message 'GetChunkResult' doesn't contain the size of the chunk : %1. Download aborted.").arg(this->chunk->getHash().toStr()));
-         this->closeTheSocket = true;
-         this->downloadingEnded();
-      }
-      else
-      {
-         this->chunkSize = result.chunk_size();
-      }
-   }
-}
+   QMutexLocker locker(&this->mutex);
 
-void ChunkDownloader::stream(const QSharedPointer<PM::ISocket>& socket)
-{
-   this->socket = socket;
-   static const quint32 SOCKET_BUFFER_SIZE = SETTINGS.get<quint32>("socket_buffer_size");
-   this->socket->setReadBufferSize(SOCKET_BUFFER_SIZE);
-   this->threadPool.run(this);
-}
+   if (previousBlock >= 0 && previousBlock < this->nbDownloadersPerBlock.size())
+      this->nbDownloadersPerBlock[previousBlock]--;
 
-void ChunkDownloader::getChunkTimeout()
-{
-   L_WARN("Timeout from GetChunkResult, Download aborted.");
-   this->downloadingEnded();
+   if (block >= this->nbDownloadersPerBlock.size() || !this->isBlockFree(this->chunk->getKnownBlocks(), block))
+      return false;
+
+   this->nbDownloadersPerBlock[block]++;
+   return true;
 }
 
-void ChunkDownloader::downloadingEnded()
+void ChunkDownloader::blockDownloaderFinished()
 {
-   L_DEBU(QString("Downloading ended, chunk : %1%2").arg(this->chunk->toStringLog()).arg(this->chunk->isComplete() ? "" : " Not complete!"));
+   BlockDownloader* blockDownloader = static_cast<BlockDownloader*>(this->sender());
 
-   if (!this->socket.isNull())
-      this->socket.clear();
+   this->mutex.lock();
+   const int block = blockDownloader->getBlock();
+   if (block >= 0 && block < this->nbDownloadersPerBlock.size())
+      this->nbDownloadersPerBlock[block]--;
+   this->mutex.unlock();
 
-   this->getChunkResult->setStatus(this->closeTheSocket);
-   this->closeTheSocket = false;
-   this->getChunkResult.clear();
+   if (blockDownloader->getLastTransferStatus() != QUEUED)
+      this->lastTransferStatus = blockDownloader->getLastTransferStatus();
 
-   this->downloading = false;
-   emit downloadFinished();
+   for (QMutableListIterator<QSharedPointer<BlockDownloader>> i(this->blockDownloaders); i.hasNext();)
+      if (i.next().data() == blockDownloader)
+      {
+         i.remove();
+         break;
+      }
 
-   // occupiedPeersDownloadingChunk can relaunch the download, so we have to set this->currentDownloadingPeer to 0 before.
-   PM::IPeer* currentPeer = this->currentDownloadingPeer;
-   this->currentDownloadingPeer = 0;
+   emit downloadFinished();
 
    // When a chunk is finished we don't care to know the associated peers.
    if (this->isComplete())
+   {
+      this->mutex.lock();
+      this->unlinkAll();
       this->peers.clear();
+      this->nbPeers = 0;
+      this->mutex.unlock();
+   }
 
-   this->occupiedPeersDownloadingChunk.setPeerAsFree(currentPeer);
+   // occupiedPeersDownloadingChunk can relaunch the download, so the downloader must be removed before.
+   this->occupiedPeersDownloadingChunk.setPeerAsFree(blockDownloader->getPeer());
 }
 
 /**
@@ -519,13 +474,15 @@ PM::IPeer* ChunkDownloader::getTheFastestFreePeer()
 
    PM::IPeer* current = nullptr;
    bool isTheNmberOfPeersHasChanged = false;
-   for (QMutableListIterator<PM::IPeer*> i(this->peers); i.hasNext();)
+   for (int i = 0; i < this->peers.size(); i++)
    {
-      PM::IPeer* peer = i.next();
+      if (!this->peers.testBit(i))
+         continue;
+
+      PM::IPeer* peer = this->linkedPeers.getPeer(i);
       if (!peer->isAvailable())
       {
-         i.remove();
-         this->linkedPeers.rmLink(peer);
+         this->removeDeadPeer(i);
          isTheNmberOfPeersHasChanged = true;
       }
       else if (this->occupiedPeersDownloadingChunk.isPeerFree(peer) && (!current || peer->getSpeed() > current->getSpeed()))
@@ -533,32 +490,122 @@ PM::IPeer* ChunkDownloader::getTheFastestFreePeer()
    }
 
    if (isTheNmberOfPeersHasChanged)
+   {
+      this->updateRarity();
       emit numberOfPeersChanged();
+   }
 
    return current;
 }
 
-int ChunkDownloader::getNumberOfFreePeer()
+/**
+  * Must be called each time 'peers' is modified, the rarest chunks of the queue are downloaded first, see 'LinkedPeers'.
+  * The chunk is indexed again only if its rarity changes, thus the common chunks are never indexed again.
+  */
+void ChunkDownloader::updateRarity()
+{
+   static const int RAREST_FIRST_MAX_PEERS = SETTINGS.get<quint32>("rarest_first_max_peers");
+
+   const int rarity = qMin(this->nbPeers, RAREST_FIRST_MAX_PEERS + 1);
+   if (rarity == this->rarity)
+      return;
+
+   // The links are indexed with the previous rarity.
+   this->unlinkAll();
+   this->rarity = rarity;
+   this->linkAll();
+}
+
+bool ChunkDownloader::hasPeer(int peerIndex) const
+{
+   return peerIndex < this->peers.size() && this->peers.testBit(peerIndex);
+}
+
+/**
+  * 'updateRarity()' must be called after.
+  */
+void ChunkDownloader::removeDeadPeer(int peerIndex)
+{
+   this->peers.clearBit(peerIndex);
+   this->nbPeers--;
+   this->unlink(peerIndex);
+}
+
+void ChunkDownloader::link(int peerIndex)
+{
+   if (this->active)
+      this->linkedPeers.addLink(peerIndex, this);
+}
+
+void ChunkDownloader::unlink(int peerIndex)
+{
+   if (this->active)
+      this->linkedPeers.rmLink(peerIndex, this);
+}
+
+void ChunkDownloader::linkAll()
+{
+   if (this->active && this->nbPeers > 0)
+      this->linkedPeers.addLinks(this->peers, this);
+}
+
+void ChunkDownloader::unlinkAll()
+{
+   if (this->active && this->nbPeers > 0)
+      this->linkedPeers.rmLinks(this->peers, this);
+}
+
+/**
+  * Choose the block to download from a new peer. The biggest range of free blocks is chosen, the download starts
+  * at the beginning of the range if it follows some known data else in its middle, thus the
+  * download in progress before the range can continue in the first half.
+  * If there is no free block a block downloaded by only one peer is chosen and 'endgame' is set to 'true'.
+  * @return -1 if there is no block to download.
+  */
+int ChunkDownloader::chooseABlock(bool& endgame)
 {
    QMutexLocker locker(&this->mutex);
 
-   int n = 0;
-   bool isTheNmberOfPeersHasChanged = false;
-   for (QMutableListIterator<PM::IPeer*> i(this->peers); i.hasNext();)
+   const QBitArray knownBlocks = this->chunk->getKnownBlocks();
+   if (this->nbDownloadersPerBlock.size() != knownBlocks.size())
+      this->nbDownloadersPerBlock.resize(knownBlocks.size());
+
+   int bestBegin = -1;
+   int bestLength = 0;
+   int endgameBlock = -1;
+   for (int i = 0; i < knownBlocks.size(); i++)
    {
-      PM::IPeer* peer = i.next();
-      if (!peer->isAvailable())
+      if (!this->isBlockFree(knownBlocks, i))
       {
-         i.remove();
-         this->linkedPeers.rmLink(peer);
-         isTheNmberOfPeersHasChanged = true;
+         if (endgameBlock == -1 && !knownBlocks.testBit(i) && this->nbDownloadersPerBlock[i] == 1)
+            endgameBlock = i;
+         continue;
       }
-      else if (this->occupiedPeersDownloadingChunk.isPeerFree(peer))
-         n++;
+
+      int length = 1;
+      while (i + length < knownBlocks.size() && this->isBlockFree(knownBlocks, i + length))
+         length++;
+
+      if (length > bestLength)
+      {
+         bestBegin = i;
+         bestLength = length;
+      }
+      i += length - 1;
    }
 
-   if (isTheNmberOfPeersHasChanged)
-      emit numberOfPeersChanged();
+   endgame = bestBegin == -1;
 
-   return n;
+   if (endgame)
+      return endgameBlock;
+
+   if (bestBegin == 0 || knownBlocks.testBit(bestBegin - 1))
+      return bestBegin;
+
+   return bestBegin + bestLength / 2;
+}
+
+bool ChunkDownloader::isBlockFree(const QBitArray& knownBlocks, int block) const
+{
+   return !knownBlocks.testBit(block) && this->nbDownloadersPerBlock[block] == 0;
 }
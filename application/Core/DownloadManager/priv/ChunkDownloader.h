@@ -21,57 +21,63 @@
 
 #include <QSharedPointer>
 #include <QList>
-#include <QThread>
-#include <QElapsedTimer>
-
-#include <Protos/core_protocol.pb.h>
+#include <QVector>
+#include <QBitArray>
+#include <QMutex>
 
 #include <Common/TransferRateCalculator.h>
+#include <Common/BandwidthLimiter.h>
 #include <Common/Hash.h>
 #include <Common/Uncopyable.h>
-#include <Common/IRunnable.h>
 #include <Common/ThreadPool.h>
 #include <Core/FileManager/IChunk.h>
-#include <Core/FileManager/IDataWriter.h>
 #include <Core/PeerManager/IPeer.h>
-#include <Core/PeerManager/IGetChunkResult.h>
 
 #include <IChunkDownloader.h>
 #include <IDownload.h>
 
 #include <priv/OccupiedPeers.h>
 #include <priv/LinkedPeers.h>
+#include <priv/BlockDownloader.h>
+#include <priv/ConcurrencyController.h>
 
 namespace PM { class IPeer; }
 
 namespace DM
 {
-   class ChunkDownloader : public QObject, public Common::IRunnable, public IChunkDownloader, Common::Uncopyable
-   {
-      static const int MINIMUM_DELTA_TIME_TO_COMPUTE_SPEED;
+   class FileDownload;
 
+   class ChunkDownloader : public QObject, public IChunkDownloader, Common::Uncopyable
+   {
       Q_OBJECT
    public:
-      ChunkDownloader(LinkedPeers& linkedPeers, OccupiedPeers& occupiedPeersDownloadingChunk, Common::TransferRateCalculator& transferRateCalculator, Common::ThreadPool& threadPool, Common::Hash chunkHash);
+      ChunkDownloader(FileDownload& fileDownload, LinkedPeers& linkedPeers, OccupiedPeers& occupiedPeersDownloadingChunk, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter, ConcurrencyController& concurrencyController, Common::ThreadPool& threadPool, Common::Hash chunkHash, int num);
       ~ChunkDownloader();
 
       void stop();
 
       Common::Hash getHash() const;
+      FileDownload& getFileDownload() const;
+      int getNum() const;
+
+      qint64 getPriority() const;
+      void setPriority(qint64 priority);
+      int getRarity() const;
+      int getNbPeers() const;
+      void setActive(bool active);
+      bool isActive() const;
 
       void addPeer(PM::IPeer* peer);
       void rmPeer(PM::IPeer* peer);
-
-      void init(QThread* thread);
-      void run();
-      void finished();
+      bool updatePeer(int peerIndex, bool ownsTheChunk);
+      bool isOwnedBy(int peerIndex) const;
 
       void setChunk(const QSharedPointer<FM::IChunk>& chunk);
       QSharedPointer<FM::IChunk> getChunk() const;
 
       void setPeerSource(PM::IPeer* peer, bool informOccupiedPeers = true);
 
-      int isReadyToDownload();
+      bool isReadyToDownload(bool& endgame);
       bool isDownloading() const;
       bool isComplete() const;
       bool isPartiallyDownloaded() const;
@@ -82,52 +88,65 @@ namespace DM
       int getDownloadedBytes() const;
       QList<PM::IPeer*> getPeers();
 
-      PM::IPeer* startDownloading();
+      bool startDownloading(PM::IPeer* peer);
       void tryToRemoveItsIncompleteFile();
       void reset();
 
+      PM::IPeer* getTheFastestFreePeer();
+      bool claimBlock(int previousBlock, int block);
+
    signals:
+      /**
+        * Emitted each time a download from a peer is started.
+        */
       void downloadStarted();
+
       /**
-        * Emitted when a downlad is terminated (or aborted).
+        * Emitted when a download from a peer is terminated (or aborted).
         */
       void downloadFinished();
       void numberOfPeersChanged();
 
    private slots:
-      void result(const Protos::Core::GetChunkResult& result);
-      void stream(const QSharedPointer<PM::ISocket>& socket);
-      void getChunkTimeout();
-
-      void downloadingEnded();
+      void blockDownloaderFinished();
 
    private:
-      PM::IPeer* getTheFastestFreePeer();
-      int getNumberOfFreePeer();
-
+      void updateRarity();
+      bool hasPeer(int peerIndex) const;
+      void removeDeadPeer(int peerIndex);
+      void link(int peerIndex);
+      void unlink(int peerIndex);
+      void linkAll();
+      void unlinkAll();
+
+      int chooseABlock(bool& endgame);
+      bool isBlockFree(const QBitArray& knownBlocks, int block) const;
+
+      FileDownload& fileDownload;
       LinkedPeers& linkedPeers;
       OccupiedPeers& occupiedPeersDownloadingChunk; // The peers from where we downloading.
       Common::TransferRateCalculator& transferRateCalculator;
+      Common::BandwidthLimiter& bandwidthLimiter;
+      ConcurrencyController& concurrencyController;
       Common::ThreadPool& threadPool;
 
       Common::Hash chunkHash;
+      const int num;
       QSharedPointer<FM::IChunk> chunk;
 
-      QList<PM::IPeer*> peers; // The peers which own this chunk.
-      PM::IPeer* currentDownloadingPeer;
+      qint64 priority; // The priority of the file, see 'Download::getPriority()'.
+      int rarity; // See 'getRarity()'.
+      bool active; // The peers are linked only when the download is active, see 'LinkedPeers'.
 
-      QSharedPointer<PM::ISocket> socket;
+      QBitArray peers; // The peers which own this chunk, indexed by 'LinkedPeers::getPeerIndex(..)'.
+      int nbPeers; // The number of bits set in 'peers'.
 
-      int chunkSize;
-      QSharedPointer<PM::IGetChunkResult> getChunkResult;
+      QList<QSharedPointer<BlockDownloader>> blockDownloaders; // One for each peer we are downloading from.
+      QVector<int> nbDownloadersPerBlock; // Two downloaders can have the same block only in endgame mode.
 
-      bool downloading;
-      bool closeTheSocket;
       Status lastTransferStatus;
 
-      QThread* mainThread;
-
-      mutable QMutex mutex; // To protect 'peers' and 'downloading'.
+      mutable QMutex mutex; // To protect 'peers', 'nbDownloadersPerBlock', 'priority', 'rarity' and 'active'.
    };
 }
 #endif
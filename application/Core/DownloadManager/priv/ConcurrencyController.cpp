@@ -0,0 +1,136 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <priv/ConcurrencyController.h>
+using namespace DM;
+
+#include <QtGlobal>
+
+#include <priv/Log.h>
+
+/**
+  * @class DM::ConcurrencyController
+  *
+  * Choose the number of simultaneous chunk downloads with an AIMD (additive increase, multiplicative decrease) scheme.
+  * 'update(..)' is called periodically:
+  *  - If the mean time to write a buffer to the disk is too long the value is decreased, the disk is the bottleneck.
+  *  - If the last increase has reduced the download rate the value is decreased.
+  *  - If there are some free peers and all the downloads are running, the value is increased while the download rate grows.
+  *    When the rate doesn't grow anymore the value is kept, an increase is tried again after a while.
+  */
+
+const int ConcurrencyController::MAX_WRITE_LATENCY(200); // [ms].
+const double ConcurrencyController::DECREASE_FACTOR(0.75);
+const double ConcurrencyController::MIN_RATE_GAIN(1.05);
+const double ConcurrencyController::MAX_RATE_LOSS(0.9);
+const int ConcurrencyController::NB_PERIODS_BEFORE_PROBING(5);
+
+ConcurrencyController::ConcurrencyController(int initialValue, int minValue, int maxValue) :
+   minValue(minValue),
+   maxValue(qMax(minValue, maxValue)),
+   value(qBound(this->minValue, initialValue, this->maxValue)),
+   rateAtLastChange(-1),
+   lastChangeWasAnIncrease(false),
+   nbPeriodsWithoutChange(0),
+   totalWriteLatency(0),
+   nbWrites(0)
+{
+}
+
+/**
+  * Called by the download threads each time a buffer is written.
+  * @param latency The duration of the write [ns].
+  */
+void ConcurrencyController::addWriteLatency(qint64 latency)
+{
+   QMutexLocker locker(&this->mutex);
+   this->totalWriteLatency += latency;
+   this->nbWrites++;
+}
+
+int ConcurrencyController::getConcurrency() const
+{
+   return this->value;
+}
+
+int ConcurrencyController::getMaxConcurrency() const
+{
+   return this->maxValue;
+}
+
+/**
+  * @param downloadRate The current total download rate [B/s].
+  * @param nbDownloads The number of running downloads.
+  * @param nbFreePeers The number of peers which have some chunks to give us and from which we aren't downloading.
+  * @return The new value.
+  */
+int ConcurrencyController::update(int downloadRate, int nbDownloads, int nbFreePeers)
+{
+   this->mutex.lock();
+   const qint64 meanWriteLatency = this->nbWrites == 0 ? 0 : this->totalWriteLatency / this->nbWrites / 1000000;
+   this->totalWriteLatency = 0;
+   this->nbWrites = 0;
+   this->mutex.unlock();
+
+   this->nbPeriodsWithoutChange++;
+
+   if (meanWriteLatency > MAX_WRITE_LATENCY)
+   {
+      L_DEBU(QString("ConcurrencyController: mean write latency: %1 ms").arg(meanWriteLatency));
+      this->decrease(downloadRate);
+   }
+   else if (this->lastChangeWasAnIncrease && downloadRate < MAX_RATE_LOSS * this->rateAtLastChange)
+   {
+      this->decrease(downloadRate);
+   }
+   // The value can be increased only if it's reached and if there is someone to download from.
+   else if (nbDownloads >= this->value && nbFreePeers > 0)
+   {
+      if (this->rateAtLastChange == -1 || downloadRate > MIN_RATE_GAIN * this->rateAtLastChange || this->nbPeriodsWithoutChange > NB_PERIODS_BEFORE_PROBING)
+         this->increase(downloadRate);
+   }
+
+   return this->value;
+}
+
+void ConcurrencyController::increase(int downloadRate)
+{
+   if (this->value >= this->maxValue)
+      return;
+
+   this->value++;
+   this->rateAtLastChange = downloadRate;
+   this->lastChangeWasAnIncrease = true;
+   this->nbPeriodsWithoutChange = 0;
+   L_DEBU(QString("ConcurrencyController: increased to %1").arg(this->value));
+}
+
+void ConcurrencyController::decrease(int downloadRate)
+{
+   const int newValue = qMax(this->minValue, static_cast<int>(DECREASE_FACTOR * this->value));
+
+   this->rateAtLastChange = downloadRate;
+   this->lastChangeWasAnIncrease = false;
+   this->nbPeriodsWithoutChange = 0;
+
+   if (newValue == this->value)
+      return;
+
+   this->value = newValue;
+   L_DEBU(QString("ConcurrencyController: decreased to %1").arg(this->value));
+}
@@ -0,0 +1,63 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#ifndef DOWNLOADMANAGER_CONCURRENCYCONTROLLER_H
+#define DOWNLOADMANAGER_CONCURRENCYCONTROLLER_H
+
+#include <QMutex>
+
+#include <Common/Uncopyable.h>
+
+namespace DM
+{
+   class ConcurrencyController : Common::Uncopyable
+   {
+      static const int MAX_WRITE_LATENCY; // [ms].
+      static const double DECREASE_FACTOR;
+      static const double MIN_RATE_GAIN;
+      static const double MAX_RATE_LOSS;
+      static const int NB_PERIODS_BEFORE_PROBING;
+
+   public:
+      ConcurrencyController(int initialValue, int minValue, int maxValue);
+
+      void addWriteLatency(qint64 latency);
+
+      int getConcurrency() const;
+      int getMaxConcurrency() const;
+      int update(int downloadRate, int nbDownloads, int nbFreePeers);
+
+   private:
+      void increase(int downloadRate);
+      void decrease(int downloadRate);
+
+      const int minValue;
+      const int maxValue;
+      int value;
+
+      int rateAtLastChange; // [B/s]. -1 if unknown.
+      bool lastChangeWasAnIncrease;
+      int nbPeriodsWithoutChange;
+
+      qint64 totalWriteLatency; // [ns]. Since the last update.
+      int nbWrites;
+      mutable QMutex mutex; // To protect 'totalWriteLatency' and 'nbWrites', the writes are done by the download threads.
+   };
+}
+
+#endif
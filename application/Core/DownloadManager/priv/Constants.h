@@ -26,6 +26,9 @@ namespace DM
    const int RETRY_PEER_GET_HASHES_PERIOD = 10000; // [ms]. If the hashes cannot be retrieve frome a peer, we wait 10s before retrying.
    const int RETRY_GET_ENTRIES_PERIOD = 10000; // [ms]. If a directory can't be browsed, we wait 10s before retrying.
    const int RESTART_DOWNLOADS_PERIOD_IF_ERROR = 10000; // [ms]. If one or more download has a status >= 0x20 then it will be restarted periodically.
+   const int UPDATE_CONCURRENCY_PERIOD = 2000; // [ms]. The number of simultaneous downloads is adapted periodically, see 'ConcurrencyController'.
+   const int UPDATE_REMAINING_BYTES_PERIOD = 30000; // [ms]. The remaining bytes of the whole queue are computed periodically, see 'DownloadManager::getRemainingTime()'.
+   const int MAX_NUMBER_OF_CHUNKS_FOUND_IN_DIGESTS = 4096; // The chunks found in the digests of the other peers above this number are ignored until the next digests.
 
    // 2 -> 3 : BLAKE -> Sha-1
    // 3 -> 4 : Replace Entry::complete by a status.
@@ -35,7 +35,7 @@ Download::Download(
    const Protos::Common::Entry& remoteEntry,
    const Protos::Common::Entry& localEntry
 ) :
-   fileManager(fileManager), ID(currentID++), peerSource(peerSource), remoteEntry(remoteEntry), localEntry(localEntry), status(QUEUED)
+   fileManager(fileManager), ID(currentID++), peerSource(peerSource), remoteEntry(remoteEntry), localEntry(localEntry), status(QUEUED), priority(0)
 {
    // Special case when downloading the root of a drive like "C:/". In this case "C:" is the name of the entry and it becomes a part of the local entry path.
    std::replace(this->localEntry.mutable_path()->begin(), this->localEntry.mutable_path()->end(), ':', '_');
@@ -66,6 +66,19 @@ quint64 Download::getID() const
    return this->ID;
 }
 
+qint64 Download::getPriority() const
+{
+   return this->priority;
+}
+
+/**
+  * Set by the queue, the lowest value is the first download.
+  */
+void Download::setPriority(qint64 priority)
+{
+   this->priority = priority;
+}
+
 quint64 Download::getDownloadedBytes() const
 {
    return 0;
@@ -64,6 +64,9 @@ namespace DM
       virtual void populateQueueEntry(Protos::Queue::Queue::Entry* entry) const;
 
       quint64 getID() const;
+
+      qint64 getPriority() const;
+      virtual void setPriority(qint64 priority);
       inline Status getStatus() const { return this->status; }
 
       inline bool isStatusErroneous() const { return this->status >= 0x20; }
@@ -103,6 +106,7 @@ namespace DM
       Protos::Common::Entry localEntry; ///< To.
 
       Status status;
+      qint64 priority; ///< The downloads are sorted by priority in the queue, see 'DownloadQueue'.
    };
 }
 #endif
@@ -20,6 +20,10 @@
 using namespace DM;
 
 #include <QStringBuilder>
+#include <QTime>
+#include <QtAlgorithms>
+
+#include <limits>
 
 #include <Protos/queue.pb.h>
 
@@ -37,16 +41,24 @@ using namespace DM;
 LOG_INIT_CPP(DownloadManager)
 
 DownloadManager::DownloadManager(QSharedPointer<FM::IFileManager> fileManager, QSharedPointer<PM::IPeerManager> peerManager) :
-   NUMBER_OF_DOWNLOADER(static_cast<int>(SETTINGS.get<quint32>("number_of_downloader"))),
    fileManager(fileManager),
    peerManager(peerManager),
-   threadPool(NUMBER_OF_DOWNLOADER),
+   concurrencyController(SETTINGS.get<quint32>("number_of_downloader"), SETTINGS.get<quint32>("min_number_of_downloader"), SETTINGS.get<quint32>("max_number_of_downloader")),
+   threadPool(SETTINGS.get<quint32>("min_number_of_downloader")),
    numberOfDownloadThreadRunning(0),
+   remainingBytes(0),
    queueChanged(false),
    queueLoaded(false)
 {
    this->threadPool.setStackSize(MIN_DOWNLOAD_THREAD_STACK_SIZE + SETTINGS.get<quint32>("buffer_size_writing"));
 
+   this->bandwidthLimiter.setLimits(SETTINGS.get<quint32>("download_rate_limit"), SETTINGS.get<quint32>("download_rate_limit_per_peer"));
+   this->bandwidthLimiter.setLimitedPeriod(
+      QTime(0, 0).addSecs(60 * SETTINGS.get<quint32>("limited_period_begin")),
+      QTime(0, 0).addSecs(60 * SETTINGS.get<quint32>("limited_period_end")),
+      SETTINGS.get<quint32>("download_rate_limit_during_period")
+   );
+
    connect(&this->occupiedPeersAskingForHashes, SIGNAL(newFreePeer(PM::IPeer*)), this, SLOT(peerNoLongerAskingForHashes(PM::IPeer*)));
    connect(&this->occupiedPeersAskingForEntries, SIGNAL(newFreePeer(PM::IPeer*)), this, SLOT(peerNoLongerAskingForEntries(PM::IPeer*)));
    connect(&this->occupiedPeersDownloadingChunk, SIGNAL(newFreePeer(PM::IPeer*)), this, SLOT(peerNoLongerDownloadingChunk(PM::IPeer*)));
@@ -61,6 +73,13 @@ DownloadManager::DownloadManager(QSharedPointer<FM::IFileManager> fileManager, Q
    this->saveTimer.setInterval(SETTINGS.get<quint32>("save_queue_period"));
    connect(&this->saveTimer, SIGNAL(timeout()), this, SLOT(saveQueueToFile()));
 
+   this->concurrencyTimer.setInterval(UPDATE_CONCURRENCY_PERIOD);
+   connect(&this->concurrencyTimer, SIGNAL(timeout()), this, SLOT(updateConcurrency()));
+   this->concurrencyTimer.start();
+
+   this->remainingBytesTimer.setInterval(UPDATE_REMAINING_BYTES_PERIOD);
+   connect(&this->remainingBytesTimer, SIGNAL(timeout()), this, SLOT(updateRemainingBytes()));
+
    connect(this->peerManager.data(), SIGNAL(peerBecomesAvailable(PM::IPeer*)), this, SLOT(peerBecomesAvailable(PM::IPeer*)));
 }
 
@@ -172,6 +191,8 @@ Download* DownloadManager::addDownload(const Protos::Common::Entry& remoteEntry,
             remoteEntry,
             localEntry,
             this->transferRateCalculator,
+            this->bandwidthLimiter,
+            this->concurrencyController,
             status
          );
          newDownload = fileDownload;
@@ -266,11 +287,107 @@ QList<QSharedPointer<IChunkDownloader>> DownloadManager::getTheOldestUnfinishedC
    return this->downloadQueue.getTheOldestUnfinishedChunks(n);
 }
 
+/**
+  * The status of each file and the free peer are updated once for all the chunks.
+  */
+void DownloadManager::updateChunksOwned(PM::IPeer* peer, const QList<QSharedPointer<IChunkDownloader>>& chunks, const QBitArray& chunksOwned)
+{
+   const int peerIndex = this->linkedPeers.getPeerIndex(peer);
+
+   QSet<FileDownload*> fileDownloadsChanged;
+   bool newChunksOwned = false;
+   for (int i = 0; i < chunks.size() && i < chunksOwned.size(); i++)
+   {
+      ChunkDownloader* chunkDownloader = static_cast<ChunkDownloader*>(chunks[i].data());
+      if (chunkDownloader->updatePeer(peerIndex, chunksOwned.testBit(i)))
+      {
+         // The file of an inactive chunk may have been removed from the queue.
+         if (chunkDownloader->isActive())
+            fileDownloadsChanged.insert(&chunkDownloader->getFileDownload());
+         newChunksOwned |= chunksOwned.testBit(i);
+      }
+   }
+
+   for (QSetIterator<FileDownload*> i(fileDownloadsChanged); i.hasNext();)
+      i.next()->updateStatus();
+
+   if (newChunksOwned)
+      this->occupiedPeersDownloadingChunk.newPeer(peer);
+}
+
+/**
+  * Only the active chunks of the shard of the digest are tested, see 'LinkedPeers::getChunks(..)'.
+  */
+void DownloadManager::chunksDigestReceived(PM::IPeer* peer, const Common::HashesDigest& digest)
+{
+   const int peerIndex = this->linkedPeers.getPeerIndex(peer);
+
+   const QList<ChunkDownloader*> chunks = this->linkedPeers.getChunks(digest.getShard(), digest.getNbShards());
+   for (QListIterator<ChunkDownloader*> i(chunks); i.hasNext() && this->chunksFoundInDigests.size() < MAX_NUMBER_OF_CHUNKS_FOUND_IN_DIGESTS;)
+   {
+      ChunkDownloader* chunkDownloader = i.next();
+      if (!digest.test(chunkDownloader->getHash()) || chunkDownloader->isComplete() || chunkDownloader->isOwnedBy(peerIndex))
+         continue;
+
+      const QSharedPointer<IChunkDownloader> chunk = chunkDownloader->getFileDownload().getChunkDownloader(chunkDownloader->getNum());
+      if (!chunk.isNull() && !this->chunksFoundInDigestsSet.contains(chunk.data()))
+      {
+         this->chunksFoundInDigests << chunk;
+         this->chunksFoundInDigestsSet.insert(chunk.data());
+      }
+   }
+}
+
+QList<QSharedPointer<IChunkDownloader>> DownloadManager::getTheChunksFoundInDigests(int n)
+{
+   QList<QSharedPointer<IChunkDownloader>> chunks;
+
+   while (chunks.size() < n && !this->chunksFoundInDigests.isEmpty())
+   {
+      const QSharedPointer<IChunkDownloader> chunk = this->chunksFoundInDigests.takeFirst();
+      this->chunksFoundInDigestsSet.remove(chunk.data());
+      ChunkDownloader* chunkDownloader = static_cast<ChunkDownloader*>(chunk.data());
+
+      // The chunk may have been completed or its file removed or paused since.
+      if (chunkDownloader->isActive() && !chunkDownloader->isComplete())
+         chunks << chunk;
+   }
+
+   return chunks;
+}
+
 int DownloadManager::getDownloadRate()
 {
    return this->transferRateCalculator.getTransferRate();
 }
 
+int DownloadManager::getDownloadRateLimit()
+{
+   return this->bandwidthLimiter.getRate();
+}
+
+int DownloadManager::getNumberOfDownloads()
+{
+   return this->numberOfDownloadThreadRunning;
+}
+
+int DownloadManager::getDownloadConcurrency()
+{
+   return this->concurrencyController.getConcurrency();
+}
+
+/**
+  * The remaining bytes are only computed each 'UPDATE_REMAINING_BYTES_PERIOD' ms, it needs to scan the whole queue.
+  */
+int DownloadManager::getRemainingTime()
+{
+   const int rate = this->transferRateCalculator.getTransferRate();
+   if (rate <= 0)
+      return -1;
+
+   return static_cast<int>(qMin<quint64>(this->remainingBytes / rate, std::numeric_limits<int>::max()));
+}
+
 void DownloadManager::peerBecomesAvailable(PM::IPeer* peer)
 {     
    this->downloadQueue.peerBecomesAvailable(peer);
@@ -352,43 +469,39 @@ void DownloadManager::peerNoLongerDownloadingChunk(PM::IPeer* peer)
 }
 
 /**
-  * Search a chunk to download.
+  * Search a chunk to download for each free peer, the chunks are started by priority, see 'LinkedPeers::Priority'.
   */
 void DownloadManager::scanTheQueue()
 {
    L_DEBU("Scanning the queue . . .");
 
-   int numberOfDownloadThreadRunningCopy = this->numberOfDownloadThreadRunning;
-
-   QSharedPointer<ChunkDownloader> chunkDownloader;
-   FileDownload* fileDownload = nullptr;
-
-   // To know the number of peers not occupied that own at least one chunk in the queue.
+   // The peers not occupied that own at least one chunk in the queue.
    QSet<PM::IPeer*> linkedPeersNotOccupied = this->linkedPeers.getPeers().toSet();
    linkedPeersNotOccupied -= this->occupiedPeersDownloadingChunk.getOccupiedPeers();
 
-   DownloadQueue::ScanningIterator<IsDownloable> i(this->downloadQueue);
-
-   while (numberOfDownloadThreadRunningCopy < NUMBER_OF_DOWNLOADER && !linkedPeersNotOccupied.isEmpty())
+   QList<QPair<LinkedPeers::Priority, QPair<ChunkDownloader*, PM::IPeer*>>> chunksToDownload;
+   for (QSetIterator<PM::IPeer*> i(linkedPeersNotOccupied); i.hasNext();)
    {
-      if (chunkDownloader.isNull()) // We can ask many chunks to download from the same file.
-         if (!(fileDownload = static_cast<FileDownload*>(i.next())))
-             break;
-
-      if (fileDownload->isStatusErroneous())
+      PM::IPeer* peer = i.next();
+      if (!peer->isAvailable())
          continue;
 
-      chunkDownloader = fileDownload->getAChunkToDownload();
+      if (ChunkDownloader* chunkDownloader = this->linkedPeers.getAChunkToDownload(peer))
+         if (!chunkDownloader->getFileDownload().isStatusErroneous())
+            chunksToDownload << qMakePair(LinkedPeers::getPriority(chunkDownloader), qMakePair(chunkDownloader, peer));
+   }
+   qSort(chunksToDownload);
 
-      if (chunkDownloader.isNull())
-         continue;
+   for (int i = 0; i < chunksToDownload.size() && this->numberOfDownloadThreadRunning < this->concurrencyController.getConcurrency(); i++)
+   {
+      ChunkDownloader* chunkDownloader = chunksToDownload[i].second.first;
+      PM::IPeer* peer = chunksToDownload[i].second.second;
 
-      if (PM::IPeer* currentPeer = chunkDownloader->startDownloading())
+      if (chunkDownloader->getFileDownload().startDownloading(chunkDownloader, peer))
       {
-         connect(chunkDownloader.data(), SIGNAL(downloadFinished()), this, SLOT(chunkDownloaderFinished()), Qt::DirectConnection);
-         linkedPeersNotOccupied -= currentPeer;
+         // A chunk can be downloaded from many peers, 'downloadFinished()' is emitted for each of them.
+         connect(chunkDownloader, SIGNAL(downloadFinished()), this, SLOT(chunkDownloaderFinished()), static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
          this->numberOfDownloadThreadRunning++;
-         numberOfDownloadThreadRunningCopy = this->numberOfDownloadThreadRunning;
       }
    }
 
@@ -418,10 +531,22 @@ void DownloadManager::restartErroneousDownloads()
 void DownloadManager::chunkDownloaderFinished()
 {
    L_DEBU(QString("DownloadManager::chunkDownloaderFinished, numberOfDownloadThreadRunning = %1").arg(this->numberOfDownloadThreadRunning));
-   this->sender()->disconnect(this, SLOT(chunkDownloaderFinished()));
    this->numberOfDownloadThreadRunning--;
 }
 
+/**
+  * The queue is scanned again if more downloads are allowed.
+  */
+void DownloadManager::updateConcurrency()
+{
+   QSet<PM::IPeer*> linkedPeersNotOccupied = this->linkedPeers.getPeers().toSet();
+   linkedPeersNotOccupied -= this->occupiedPeersDownloadingChunk.getOccupiedPeers();
+
+   const int previousConcurrency = this->concurrencyController.getConcurrency();
+   if (this->concurrencyController.update(this->transferRateCalculator.getTransferRate(), this->numberOfDownloadThreadRunning, linkedPeersNotOccupied.size()) > previousConcurrency)
+      this->scanTheQueue();
+}
+
 /**
   * When a download status become erroneous a timer is activated. This will check
   * the erroneous downloads periodically.
@@ -455,6 +580,9 @@ void DownloadManager::loadQueueFromFile()
 
    this->queueLoaded = true;
    this->saveTimer.start();
+
+   this->updateRemainingBytes();
+   this->remainingBytesTimer.start();
 }
 
 void DownloadManager::saveQueueToFile()
@@ -470,6 +598,15 @@ void DownloadManager::saveQueueToFile()
    }
 }
 
+void DownloadManager::updateRemainingBytes()
+{
+   quint64 remainingBytes = 0;
+   DownloadQueue::ScanningIterator<IsDownloable> i(this->downloadQueue);
+   while (FileDownload* fileDownload = static_cast<FileDownload*>(i.next()))
+      remainingBytes += fileDownload->getRemainingBytesOwnedByPeers();
+   this->remainingBytes = remainingBytes;
+}
+
 /**
   * Called each time the queue is modified.
   * It may persist the queue.
@@ -26,6 +26,7 @@
 #include <QMultiHash>
 
 #include <Common/TransferRateCalculator.h>
+#include <Common/BandwidthLimiter.h>
 #include <Common/ThreadPool.h>
 
 #include <Core/FileManager/IFileManager.h>
@@ -36,6 +37,7 @@
 #include <priv/DownloadPredicate.h>
 #include <priv/OccupiedPeers.h>
 #include <priv/LinkedPeers.h>
+#include <priv/ConcurrencyController.h>
 #include <priv/Log.h>
 
 namespace PM
@@ -75,8 +77,15 @@ namespace DM
 
       QList<QSharedPointer<IChunkDownloader>> getTheFirstUnfinishedChunks(int n);
       QList<QSharedPointer<IChunkDownloader>> getTheOldestUnfinishedChunks(int n);
+      void updateChunksOwned(PM::IPeer* peer, const QList<QSharedPointer<IChunkDownloader>>& chunks, const QBitArray& chunksOwned);
+      void chunksDigestReceived(PM::IPeer* peer, const Common::HashesDigest& digest);
+      QList<QSharedPointer<IChunkDownloader>> getTheChunksFoundInDigests(int n);
 
       int getDownloadRate();
+      int getDownloadRateLimit();
+      int getNumberOfDownloads();
+      int getDownloadConcurrency();
+      int getRemainingTime();
 
    private slots:
       void peerBecomesAvailable(PM::IPeer* peer);
@@ -92,6 +101,7 @@ namespace DM
       void scanTheQueue();
       void restartErroneousDownloads();
       void chunkDownloaderFinished();
+      void updateConcurrency();
       void downloadStatusBecomeErroneous(Download* download);
 
    private:
@@ -100,18 +110,20 @@ namespace DM
    private slots:
       void saveQueueToFile();
       void setQueueChanged();
+      void updateRemainingBytes();
 
    private:
       LOG_INIT_H("DownloadManager");
 
       static const quint32 MIN_DOWNLOAD_THREAD_STACK_SIZE;
-      const int NUMBER_OF_DOWNLOADER;
 
       QSharedPointer<FM::IFileManager> fileManager;
       QSharedPointer<PM::IPeerManager> peerManager;
       LinkedPeers linkedPeers; // Number of 'ChunkDownloader' each peer owns.
 
       Common::TransferRateCalculator transferRateCalculator;
+      Common::BandwidthLimiter bandwidthLimiter;
+      ConcurrencyController concurrencyController; // Gives the number of simultaneous chunk downloads.
 
       OccupiedPeers occupiedPeersAskingForHashes;
       OccupiedPeers occupiedPeersAskingForEntries;
@@ -121,10 +133,17 @@ namespace DM
 
       DownloadQueue downloadQueue;
 
+      QList<QSharedPointer<IChunkDownloader>> chunksFoundInDigests; // To be confirmed by the next 'IMAlive' messages.
+      QSet<IChunkDownloader*> chunksFoundInDigestsSet; // The same chunks as 'chunksFoundInDigests', to know quickly if a chunk is already in it.
+
       int numberOfDownloadThreadRunning;
+      QTimer concurrencyTimer; // To update 'concurrencyController' periodically.
 
       QTimer startErroneousDownloadTimer; // When one or more downloads are in error state, we try to relaunch them periodically.
 
+      quint64 remainingBytes; // The bytes owned by the peers which remain to download, updated by 'remainingBytesTimer'.
+      QTimer remainingBytesTimer;
+
       QTimer saveTimer; // To know when to save the queue, for exemple each 5min.
       bool queueChanged;
       bool queueLoaded;
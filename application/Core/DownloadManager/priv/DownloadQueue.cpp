@@ -40,6 +40,8 @@ using namespace DM;
   *  - Persist/load the queue to/from a file.
   */
 
+const qint64 DownloadQueue::PRIORITY_STEP(Q_INT64_C(1) << 32);
+
 DownloadQueue::DownloadQueue()
 {
 }
@@ -63,6 +65,7 @@ void DownloadQueue::insert(int position, Download* download)
    this->updateMarkersInsert(position, download);
 
    this->downloads.insert(position, download);
+   this->updatePriority(position);
    this->downloadsIndexedBySourcePeer.insert(download->getPeerSource(), download);
 
    if (FileDownload* fileDownload = dynamic_cast<FileDownload*>(download))
@@ -135,6 +138,7 @@ void DownloadQueue::moveDownloads(const QList<quint64>& downloadIDRefs, const QL
 
             this->downloads.insert(whereToInsert, this->downloads[i]);
             this->downloads.removeAt(whereToRemove);
+            this->updatePriority(whereToInsert);
             continue;
          }
          else
@@ -177,6 +181,7 @@ void DownloadQueue::moveDownloads(const QList<quint64>& downloadIDRefs, const QL
 
                this->downloads.insert(whereToInsert, this->downloads[whereToRemove]);
                this->downloads.removeAt(whereToRemove);
+               this->updatePriority(whereToInsert - 1); // The removed download was before.
                shift--;
             }
          }
@@ -369,6 +374,40 @@ void DownloadQueue::fileDownloadTimeChanged(QTime oldTime)
    this->downloadsSortedByTime.insert(fileDownload->getLastTimeGetAllUnfinishedChunks(), fileDownload);
 }
 
+/**
+  * Set the priority of the download at the given position between the priorities of its neighbours.
+  * When there is no room left between them all the priorities are reset.
+  */
+void DownloadQueue::updatePriority(int position)
+{
+   Download* download = this->downloads[position];
+   const bool hasPrevious = position > 0;
+   const bool hasNext = position < this->downloads.size() - 1;
+
+   if (!hasPrevious && !hasNext)
+      download->setPriority(0);
+   else if (!hasNext)
+      download->setPriority(this->downloads[position - 1]->getPriority() + PRIORITY_STEP);
+   else if (!hasPrevious)
+      download->setPriority(this->downloads[position + 1]->getPriority() - PRIORITY_STEP);
+   else
+   {
+      const qint64 previous = this->downloads[position - 1]->getPriority();
+      const qint64 next = this->downloads[position + 1]->getPriority();
+      if (next - previous >= 2)
+         download->setPriority(previous + (next - previous) / 2);
+      else
+         this->resetPriorities();
+   }
+}
+
+void DownloadQueue::resetPriorities()
+{
+   L_DEBU("DownloadQueue: reset the priorities");
+   for (int i = 0; i < this->downloads.size(); i++)
+      this->downloads[i]->setPriority(i * PRIORITY_STEP);
+}
+
 void DownloadQueue::updateMarkersInsert(int position, Download* download)
 {
    for (QMutableListIterator<Marker> i(this->markers); i.hasNext();)
@@ -45,6 +45,8 @@ namespace DM
 
    class DownloadQueue : public QObject, Common::Uncopyable
    {
+      static const qint64 PRIORITY_STEP;
+
       Q_OBJECT
    public:
       DownloadQueue();
@@ -93,6 +95,9 @@ namespace DM
       };
 
    private:
+      void updatePriority(int position);
+      void resetPriorities();
+
       void updateMarkersInsert(int position, Download* download);
       void updateMarkersRemove(int position);
       void updateMarkersMove(int insertPosition, int removePosition, Download* download);
@@ -21,8 +21,6 @@ using namespace DM;
 
 #include <QTimer>
 
-#include <limits>
-
 #include <Common/Settings.h>
 #include <Common/ProtoHelper.h>
 #include <Common/Hashes.h>
@@ -32,8 +30,6 @@ using namespace DM;
 #include <priv/Log.h>
 #include <priv/Constants.h>
 
-MTRand FileDownload::mtrand;
-
 FileDownload::FileDownload(
    QSharedPointer<FM::IFileManager> fileManager,
    LinkedPeers& linkedPeers,
@@ -44,6 +40,8 @@ FileDownload::FileDownload(
    const Protos::Common::Entry& remoteEntry,
    const Protos::Common::Entry& localEntry,
    Common::TransferRateCalculator& transferRateCalculator,
+   Common::BandwidthLimiter& bandwidthLimiter,
+   ConcurrencyController& concurrencyController,
    Protos::Queue::Queue::Entry::Status status
 ) :
    Download(fileManager, peerSource, remoteEntry, localEntry),
@@ -54,7 +52,9 @@ FileDownload::FileDownload(
    occupiedPeersDownloadingChunk(occupiedPeersDownloadingChunk),
    threadPool(threadPool),
    nbHashesKnown(0),
-   transferRateCalculator(transferRateCalculator)
+   transferRateCalculator(transferRateCalculator),
+   bandwidthLimiter(bandwidthLimiter),
+   concurrencyController(concurrencyController)
 {
    L_DEBU(QString("New FileDownload : peer source = %1, remoteEntry : \n%2\nlocalEntry : \n%3").
       arg(this->peerSource->toStringLog()).
@@ -64,11 +64,17 @@ FileDownload::FileDownload(
 
    this->setStatus(static_cast<Status>(status));
 
+   // The entries of the search results only have the first chunk hash, the other chunks are added as unknown.
+   while (this->remoteEntry.chunk_size() < this->NB_CHUNK)
+      this->remoteEntry.add_chunk();
+   while (this->localEntry.chunk_size() < this->NB_CHUNK)
+      this->localEntry.add_chunk();
+
    // We create a 'ChunkDownloader' for each known chunk in the entry.
    for (int i = 0; i < this->NB_CHUNK; i++)
    {
       QSharedPointer<ChunkDownloader> chunkDownloader = (i < this->remoteEntry.chunk_size() && this->remoteEntry.chunk(i).has_hash()) ?
-         QSharedPointer<ChunkDownloader>(new ChunkDownloader(this->linkedPeers, this->occupiedPeersDownloadingChunk, this->transferRateCalculator, this->threadPool, Common::Hash(this->remoteEntry.chunk(i).hash())))
+         QSharedPointer<ChunkDownloader>(new ChunkDownloader(*this, this->linkedPeers, this->occupiedPeersDownloadingChunk, this->transferRateCalculator, this->bandwidthLimiter, this->concurrencyController, this->threadPool, Common::ProtoHelper::getHash(this->remoteEntry.chunk(i)), i))
          : QSharedPointer<ChunkDownloader>();
 
       this->chunkDownloaders << chunkDownloader;
@@ -76,7 +82,7 @@ FileDownload::FileDownload(
       if (!chunkDownloader.isNull())
       {
          this->nbHashesKnown++;
-         this->connectChunkDownloaderSignals(this->chunkDownloaders.last());
+         this->initChunkDownloader(this->chunkDownloaders.last());
       }
    }
 }
@@ -171,7 +177,7 @@ void FileDownload::populateQueueEntry(Protos::Queue::Queue::Entry* entry) const
 
    for (int i = 0; i < this->chunkDownloaders.size() && i < entry->remote_entry().chunk_size(); i++)
       if (!entry->remote_entry().chunk(i).has_hash() && !this->chunkDownloaders[i].isNull())
-         entry->mutable_remote_entry()->mutable_chunk(i)->set_hash(this->chunkDownloaders[i]->getHash().getData(), Common::Hash::HASH_SIZE);
+         Common::ProtoHelper::setHash(*entry->mutable_remote_entry()->mutable_chunk(i), this->chunkDownloaders[i]->getHash());
 }
 
 quint64 FileDownload::getDownloadedBytes() const
@@ -189,6 +195,26 @@ quint64 FileDownload::getDownloadedBytes() const
    return knownBytes;
 }
 
+/**
+  * The chunks owned by no peer can't be downloaded, they are ignored.
+  */
+quint64 FileDownload::getRemainingBytesOwnedByPeers() const
+{
+   static const quint64 CHUNK_SIZE = SETTINGS.get<quint32>("chunk_size");
+
+   if (!isActive(this->status))
+      return 0;
+
+   quint64 remainingBytes = 0;
+   for (int i = 0; i < this->chunkDownloaders.size(); i++)
+   {
+      const QSharedPointer<ChunkDownloader>& chunkDownloader = this->chunkDownloaders[i];
+      if (!chunkDownloader.isNull() && chunkDownloader->getNbPeers() > 0)
+         remainingBytes += qMin(CHUNK_SIZE, this->remoteEntry.size() - i * CHUNK_SIZE) - chunkDownloader->getDownloadedBytes();
+   }
+   return remainingBytes;
+}
+
 QSet<PM::IPeer*> FileDownload::getPeers() const
 {
    QSet<PM::IPeer*> peers;
@@ -202,70 +228,49 @@ QSet<PM::IPeer*> FileDownload::getPeers() const
 }
 
 /**
-  * If there is a ChunkDownloader with a free peer (we do not already download from this peer) the return the chunk.
+  * Start to download the given chunk from the given peer, the chunk is chosen by 'LinkedPeers::getAChunkToDownload(..)'.
   * The file is created on the fly with IFileManager::newFile(..) if we don't have the IChunks.
-  * @return The chunk to download, can return a null pointer if an error occurs.
+  * @return 'true' if the download has been started.
   */
-QSharedPointer<ChunkDownloader> FileDownload::getAChunkToDownload()
+bool FileDownload::startDownloading(ChunkDownloader* chunkDownloader, PM::IPeer* peer)
 {
-   if (this->status == COMPLETE || this->status == DELETED || this->status == PAUSED)
-      return QSharedPointer<ChunkDownloader>();
-
-   // Choose a chunk with the less number of peer. (rarest first).
-   // Choose first a partially downloaded chunk.
-   QList<QSharedPointer<ChunkDownloader>> chunksReadyToDownload;
-   int bestNbPeer = std::numeric_limits<int>::max();
-   for (QListIterator<QSharedPointer<ChunkDownloader>> i(this->chunkDownloaders); i.hasNext();)
-   {
-      auto chunkDownloader = i.next();
-      if (chunkDownloader.isNull())
-         continue;
-
-      const int nbPeer = chunkDownloader->isReadyToDownload();
-
-      if (nbPeer == 0)
-      {
-         continue;
-      }
-      else
-      {
-         if (chunkDownloader->isPartiallyDownloaded())
-         {
-            chunksReadyToDownload.clear();
-            chunksReadyToDownload << chunkDownloader;
-            break;
-         }
-         else if (nbPeer == bestNbPeer)
-            chunksReadyToDownload << chunkDownloader;
-         else if (nbPeer < bestNbPeer)
-         {
-            chunksReadyToDownload.clear();
-            chunksReadyToDownload << chunkDownloader;
-            bestNbPeer = nbPeer;
-         }
-      }
-   }
-
-   if (chunksReadyToDownload.isEmpty())
-      return QSharedPointer<ChunkDownloader>();
-
-   // If there is many chunk with the same number of peer we choose randomly one of them.
-   QSharedPointer<ChunkDownloader> chunkDownloader = chunksReadyToDownload.size() == 1 ? chunksReadyToDownload.first() : chunksReadyToDownload[mtrand.randInt(chunksReadyToDownload.size() - 1)];
+   if (!isActive(this->status))
+      return false;
 
    if (!this->localEntry.exists())
    {
       if (!this->createFile())
-         return QSharedPointer<ChunkDownloader>();
+         return false;
 
       // 'newFile(..)' above can return some completed chunks.
       if (!chunkDownloader->getChunk().isNull() && chunkDownloader->getChunk()->isComplete())
       {
          this->updateStatus(); // Maybe all the file is complete, so we update the status.
-         return QSharedPointer<ChunkDownloader>();
+         return false;
       }
    }
 
-   return chunkDownloader;
+   return chunkDownloader->startDownloading(peer);
+}
+
+/**
+  * Return the chunk downloader of the chunk 'num', null if its hash isn't known.
+  */
+QSharedPointer<ChunkDownloader> FileDownload::getChunkDownloader(int num) const
+{
+   return this->chunkDownloaders.value(num);
+}
+
+void FileDownload::setPriority(qint64 priority)
+{
+   Download::setPriority(priority);
+
+   for (QListIterator<QSharedPointer<ChunkDownloader>> i(this->chunkDownloaders); i.hasNext();)
+   {
+      auto chunkDownloader = i.next();
+      if (!chunkDownloader.isNull())
+         chunkDownloader->setPriority(priority);
+   }
 }
 
 /**
@@ -468,7 +473,7 @@ void FileDownload::nextHash(const Protos::Core::HashResult& hashResult)
       return;
    }
 
-   Common::Hash hash { hashResult.hash().hash() };
+   const Common::Hash hash = Common::ProtoHelper::getHash(hashResult.hash());
    quint32 num = hashResult.num();
 
    L_DEBU(QString("New Hash received %2 num %1").arg(num).arg(hash.toStr()));
@@ -493,7 +498,7 @@ void FileDownload::nextHash(const Protos::Core::HashResult& hashResult)
       return;
    }
 
-   QSharedPointer<ChunkDownloader> chunkDownloader = QSharedPointer<ChunkDownloader>(new ChunkDownloader(this->linkedPeers, this->occupiedPeersDownloadingChunk, this->transferRateCalculator, this->threadPool, hash));
+   QSharedPointer<ChunkDownloader> chunkDownloader = QSharedPointer<ChunkDownloader>(new ChunkDownloader(*this, this->linkedPeers, this->occupiedPeersDownloadingChunk, this->transferRateCalculator, this->bandwidthLimiter, this->concurrencyController, this->threadPool, hash, num));
    this->chunkDownloaders[num] = chunkDownloader;
 
    // If the file has already been created, the chunks are known.
@@ -510,11 +515,11 @@ void FileDownload::nextHash(const Protos::Core::HashResult& hashResult)
       this->updateStatus();
    }
 
-   this->connectChunkDownloaderSignals(chunkDownloader);
+   this->initChunkDownloader(chunkDownloader);
    chunkDownloader->setPeerSource(this->peerSource); // May start a download.
 
    if (num < static_cast<quint32>(this->remoteEntry.chunk_size()))
-      this->remoteEntry.mutable_chunk(num)->set_hash(hash.getData(), Common::Hash::HASH_SIZE); // Used during the saving of the queue, see Download::populateEntry(..).
+      Common::ProtoHelper::setHash(*this->remoteEntry.mutable_chunk(num), hash); // Used during the saving of the queue, see Download::populateEntry(..).
 
    emit newHashKnown();
 }
@@ -571,13 +576,42 @@ bool FileDownload::tryToLinkToAnExistingFile()
    return this->localEntry.exists();
 }
 
-void FileDownload::connectChunkDownloaderSignals(const QSharedPointer<ChunkDownloader>& chunkDownloader)
+/**
+  * Connect the signals of a new 'ChunkDownloader' and give it the priority and the state of the file.
+  */
+void FileDownload::initChunkDownloader(const QSharedPointer<ChunkDownloader>& chunkDownloader)
 {
+   chunkDownloader->setPriority(this->getPriority());
+   chunkDownloader->setActive(isActive(this->status));
+
    connect(chunkDownloader.data(), SIGNAL(downloadStarted()), this, SLOT(chunkDownloaderStarted()), Qt::DirectConnection);
    connect(chunkDownloader.data(), SIGNAL(downloadFinished()), this, SLOT(chunkDownloaderFinished()), Qt::DirectConnection);
    connect(chunkDownloader.data(), SIGNAL(numberOfPeersChanged()), this, SLOT(updateStatus()), Qt::DirectConnection);
 }
 
+/**
+  * The chunks are indexed by peer only when the file can be downloaded, see 'LinkedPeers'.
+  */
+void FileDownload::setStatus(Status newStatus)
+{
+   const bool wasActive = isActive(this->status);
+
+   Download::setStatus(newStatus);
+
+   if (wasActive != isActive(this->status))
+      for (QListIterator<QSharedPointer<ChunkDownloader>> i(this->chunkDownloaders); i.hasNext();)
+      {
+         auto chunkDownloader = i.next();
+         if (!chunkDownloader.isNull())
+            chunkDownloader->setActive(!wasActive);
+      }
+}
+
+bool FileDownload::isActive(Status status)
+{
+   return status != COMPLETE && status != DELETED && status != PAUSED && status < 0x20;
+}
+
 /**
   * Try to create the file.
   * May change the status of the download if an error occurs.
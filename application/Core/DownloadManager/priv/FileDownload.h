@@ -24,8 +24,6 @@
 #include <QSharedPointer>
 #include <QTime>
 
-#include <Libs/MersenneTwister.h>
-
 #include <Common/ThreadPool.h>
 
 #include <Core/FileManager/IChunk.h>
@@ -38,13 +36,13 @@
 #include <priv/LinkedPeers.h>
 #include <priv/Download.h>
 #include <priv/ChunkDownloader.h>
+#include <priv/ConcurrencyController.h>
 
 namespace DM
 {
    class FileDownload : public Download
    {
       Q_OBJECT
-      static MTRand mtrand;
    public:
       FileDownload(
          QSharedPointer<FM::IFileManager> fileManager,
@@ -56,6 +54,8 @@ namespace DM
          const Protos::Common::Entry& remoteEntry,
          const Protos::Common::Entry& localEntry,
          Common::TransferRateCalculator& transferRateCalculator,
+         Common::BandwidthLimiter& bandwidthLimiter,
+         ConcurrencyController& concurrencyController,
          Protos::Queue::Queue::Entry::Status status = Protos::Queue::Queue::Entry::QUEUED
       );
       ~FileDownload();
@@ -70,9 +70,13 @@ namespace DM
       void populateQueueEntry(Protos::Queue::Queue::Entry* entry) const;
 
       quint64 getDownloadedBytes() const;
+      quint64 getRemainingBytesOwnedByPeers() const;
       QSet<PM::IPeer*> getPeers() const;
 
-      QSharedPointer<ChunkDownloader> getAChunkToDownload();
+      bool startDownloading(ChunkDownloader* chunkDownloader, PM::IPeer* peer);
+      QSharedPointer<ChunkDownloader> getChunkDownloader(int num) const;
+
+      void setPriority(qint64 priority);
 
       void getUnfinishedChunks(QList<QSharedPointer<IChunkDownloader>>& chunks, int nMax, bool notAlreadyAsked = true);
 
@@ -96,9 +100,14 @@ namespace DM
       void chunkDownloaderStarted();
       void chunkDownloaderFinished();
 
+   protected:
+      void setStatus(Status newStatus);
+
    private:
+      static bool isActive(Status status);
+
       bool tryToLinkToAnExistingFile();
-      void connectChunkDownloaderSignals(const QSharedPointer<ChunkDownloader>& chunkDownload);
+      void initChunkDownloader(const QSharedPointer<ChunkDownloader>& chunkDownloader);
       bool createFile();
       void giveChunksToDownloaders();
       void reset();
@@ -122,6 +131,8 @@ namespace DM
       QSharedPointer<PM::IGetHashesResult> getHashesResult;
 
       Common::TransferRateCalculator& transferRateCalculator;
+      Common::BandwidthLimiter& bandwidthLimiter;
+      ConcurrencyController& concurrencyController;
 
       QTime lastTimeGetAllUnfinishedChunks; // Updated when ALL hashes are send via the method 'getTheFirstUnfinishedChunks(..)'. Null if never.
    };
@@ -0,0 +1,215 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <priv/LinkedPeers.h>
+using namespace DM;
+
+#include <limits>
+
+#include <priv/ChunkDownloader.h>
+
+/**
+  * @class DM::LinkedPeers
+  *
+  * Index the chunks to download by peer. For each peer the chunks it owns are sorted by priority:
+  * the number of peers owning them (rarest first) up to 'rarest_first_max_peers', the position of their file in the queue
+  * then their number. Thus a chunk owned by a single peer is downloaded before this peer goes away, whatever the position of its file.
+  * If a peer has no chunk he is not returned by 'getPeers()'.
+  * A chunk is linked to its peers as long as its download is active, see 'ChunkDownloader::setActive(..)'.
+  *
+  * The active chunks are also indexed by the low bits of the prefix of their hash, like the shards of 'Common::HashesDigest',
+  * thus a digest received from a peer is only tested against the chunks of its shard, see 'getChunks(..)'.
+  */
+
+const quint32 LinkedPeers::NB_PREFIX_BUCKETS;
+
+LinkedPeers::LinkedPeers() :
+   chunksByPrefix(NB_PREFIX_BUCKETS)
+{
+}
+
+/**
+  * The peers are referenced by a dense index, thus a chunk can store its peers as a bit array, see 'ChunkDownloader'.
+  * An index is never reused, the peers are never deleted by the 'PeerManager'.
+  */
+int LinkedPeers::getPeerIndex(PM::IPeer* peer)
+{
+   QMutexLocker locker(&this->mutex);
+
+   auto i = this->peerIndexes.constFind(peer);
+   if (i != this->peerIndexes.constEnd())
+      return i.value();
+
+   const int peerIndex = this->peers.size();
+   this->peerIndexes.insert(peer, peerIndex);
+   this->peers << peer;
+   this->chunks.resize(this->peers.size());
+   return peerIndex;
+}
+
+PM::IPeer* LinkedPeers::getPeer(int peerIndex) const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->peers[peerIndex];
+}
+
+QList<PM::IPeer*> LinkedPeers::getPeers() const
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<PM::IPeer*> peers;
+   for (int i = 0; i < this->chunks.size(); i++)
+      if (!this->chunks[i].isEmpty())
+         peers << this->peers[i];
+   return peers;
+}
+
+void LinkedPeers::addLink(int peerIndex, ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+   this->chunks[peerIndex].insert(getPriority(chunkDownloader), chunkDownloader);
+}
+
+void LinkedPeers::rmLink(int peerIndex, ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+
+   QMap<Priority, ChunkDownloader*>& chunksOfThePeer = this->chunks[peerIndex];
+   const Priority priority = getPriority(chunkDownloader);
+   if (chunksOfThePeer.value(priority) == chunkDownloader)
+      chunksOfThePeer.remove(priority);
+}
+
+/**
+  * Link all the peers of a chunk with a single lock.
+  */
+void LinkedPeers::addLinks(const QBitArray& peers, ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+
+   const Priority priority = getPriority(chunkDownloader);
+   for (int i = 0; i < peers.size(); i++)
+      if (peers.testBit(i))
+         this->chunks[i].insert(priority, chunkDownloader);
+}
+
+void LinkedPeers::rmLinks(const QBitArray& peers, ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+
+   const Priority priority = getPriority(chunkDownloader);
+   for (int i = 0; i < peers.size(); i++)
+      if (peers.testBit(i) && this->chunks[i].value(priority) == chunkDownloader)
+         this->chunks[i].remove(priority);
+}
+
+/**
+  * Return the chunk with the highest priority which can be downloaded from the given peer.
+  * If there is none a chunk which is completely downloading may be returned (endgame mode), see 'ChunkDownloader::isReadyToDownload(..)'.
+  * Only the chunks whose blocks are all downloading are skipped, there are at most one per running download.
+  * @return 0 if there is no chunk to download from the given peer.
+  */
+ChunkDownloader* LinkedPeers::getAChunkToDownload(PM::IPeer* peer) const
+{
+   ChunkDownloader* endgameChunk = nullptr;
+   Priority from(std::numeric_limits<int>::min(), std::numeric_limits<qint64>::min(), std::numeric_limits<int>::min());
+
+   forever
+   {
+      // The lock isn't kept while a chunk is checked because the chunk can call 'rmLink(..)'.
+      this->mutex.lock();
+      auto i = this->peerIndexes.constFind(peer);
+      if (i == this->peerIndexes.constEnd())
+      {
+         this->mutex.unlock();
+         break;
+      }
+      const QMap<Priority, ChunkDownloader*>& chunksOfThePeer = this->chunks[i.value()];
+      auto j = chunksOfThePeer.lowerBound(from);
+      if (j == chunksOfThePeer.constEnd())
+      {
+         this->mutex.unlock();
+         break;
+      }
+      ChunkDownloader* chunkDownloader = j.value();
+      ++j;
+      const bool isTheLast = j == chunksOfThePeer.constEnd();
+      if (!isTheLast)
+         from = j.key();
+      this->mutex.unlock();
+
+      bool endgame;
+      if (chunkDownloader->isReadyToDownload(endgame))
+      {
+         if (!endgame)
+            return chunkDownloader;
+         if (!endgameChunk)
+            endgameChunk = chunkDownloader;
+      }
+
+      if (isTheLast)
+         break;
+   }
+
+   return endgameChunk;
+}
+
+void LinkedPeers::addChunk(ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+   this->chunksByPrefix[chunkDownloader->getHash().getPrefix() & (NB_PREFIX_BUCKETS - 1)].insert(chunkDownloader);
+}
+
+void LinkedPeers::rmChunk(ChunkDownloader* chunkDownloader)
+{
+   QMutexLocker locker(&this->mutex);
+   this->chunksByPrefix[chunkDownloader->getHash().getPrefix() & (NB_PREFIX_BUCKETS - 1)].remove(chunkDownloader);
+}
+
+/**
+  * Return the active chunks whose hash is in the given shard, see 'Common::HashesDigest::covers(..)'.
+  * If there is more shards than buckets some chunks of the bucket may be out of the shard.
+  */
+QList<ChunkDownloader*> LinkedPeers::getChunks(quint32 shard, quint32 nbShards) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   QList<ChunkDownloader*> result;
+   for (quint32 i = shard & (NB_PREFIX_BUCKETS - 1); i < NB_PREFIX_BUCKETS; i += nbShards)
+   {
+      for (QSetIterator<ChunkDownloader*> j(this->chunksByPrefix[i]); j.hasNext();)
+         result << j.next();
+      if (nbShards >= NB_PREFIX_BUCKETS)
+         break;
+   }
+   return result;
+}
+
+LinkedPeers::Priority LinkedPeers::getPriority(ChunkDownloader* chunkDownloader)
+{
+   return Priority(chunkDownloader->getRarity(), chunkDownloader->getPriority(), chunkDownloader->getNum());
+}
+
+bool LinkedPeers::Priority::operator<(const Priority& other) const
+{
+   if (this->rarity != other.rarity)
+      return this->rarity < other.rarity;
+   if (this->filePriority != other.filePriority)
+      return this->filePriority < other.filePriority;
+   return this->num < other.num;
+}
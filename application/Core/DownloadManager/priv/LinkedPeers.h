@@ -19,42 +19,61 @@
 #ifndef DOWNLOADMANAGER_LINKEDPEERS_H
 #define DOWNLOADMANAGER_LINKEDPEERS_H
 
+#include <QHash>
 #include <QMap>
+#include <QSet>
 #include <QList>
+#include <QVector>
+#include <QBitArray>
+#include <QMutex>
 
+#include <Common/Uncopyable.h>
 #include <Core/PeerManager/IPeer.h>
 
-#include <priv/Log.h>
-
 namespace DM
 {
-   /**
-     * @class LinkedPeers
-     * Count the number of chunks that each peer owns. If a peer has no chunk he is not referenced.
-     */
-   class LinkedPeers : private QMap<PM::IPeer*, quint32>
+   class ChunkDownloader;
+
+   class LinkedPeers : Common::Uncopyable
    {
    public:
-      inline QList<PM::IPeer*> getPeers()
+      struct Priority
       {
-         return this->keys();
-      }
+         Priority(int rarity, qint64 filePriority, int num) : rarity(rarity), filePriority(filePriority), num(num) {}
+         bool operator<(const Priority& other) const;
 
-      inline void addLink(PM::IPeer* peer)
-      {
-         quint32& n = (*this)[peer];
-         n++;
-         L_DEBU(QString("addLink(..): peer: %1, n = %2").arg(peer->toStringLog()).arg(n));
-      }
+         int rarity; // The rarest chunks of all the queue first, see 'ChunkDownloader::getRarity()'.
+         qint64 filePriority; // Then the first files of the queue.
+         int num; // Then the first chunks of the file. Thus each chunk of the queue has a different priority.
+      };
+      static Priority getPriority(ChunkDownloader* chunkDownloader);
 
-      inline void rmLink(PM::IPeer* peer)
-      {
-         quint32& n = (*this)[peer];
-         n--;
-         if (n == 0)
-            this->remove(peer);
-         L_DEBU(QString("rmLink(..): peer: %1, n = %2").arg(peer->toStringLog()).arg(n));
-      }
+      LinkedPeers();
+
+      int getPeerIndex(PM::IPeer* peer);
+      PM::IPeer* getPeer(int peerIndex) const;
+
+      QList<PM::IPeer*> getPeers() const;
+
+      void addLink(int peerIndex, ChunkDownloader* chunkDownloader);
+      void rmLink(int peerIndex, ChunkDownloader* chunkDownloader);
+      void addLinks(const QBitArray& peers, ChunkDownloader* chunkDownloader);
+      void rmLinks(const QBitArray& peers, ChunkDownloader* chunkDownloader);
+
+      ChunkDownloader* getAChunkToDownload(PM::IPeer* peer) const;
+
+      void addChunk(ChunkDownloader* chunkDownloader);
+      void rmChunk(ChunkDownloader* chunkDownloader);
+      QList<ChunkDownloader*> getChunks(quint32 shard, quint32 nbShards) const;
+
+   private:
+      static const quint32 NB_PREFIX_BUCKETS = 1024; // Must be a power of two.
+
+      QHash<PM::IPeer*, int> peerIndexes;
+      QVector<PM::IPeer*> peers; // Indexed by the peer indexes.
+      QVector<QMap<Priority, ChunkDownloader*>> chunks; // The chunks owned by each peer, indexed by the peer indexes.
+      QVector<QSet<ChunkDownloader*>> chunksByPrefix; // The active chunks, indexed by the low bits of the prefix of their hash.
+      mutable QMutex mutex; // Links can be removed by the download threads.
    };
 }
 
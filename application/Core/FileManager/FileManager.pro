@@ -39,6 +39,7 @@ SOURCES += priv/Builder.cpp \
     priv/FileManager.cpp \
     priv/FileUpdater/FileUpdater.cpp \
     priv/FileUpdater/DirWatcher.cpp \
+    priv/FileUpdater/DirScanner.cpp \
     priv/Cache/Entry.cpp \
     priv/Cache/File.cpp \
     priv/Cache/Directory.cpp \
@@ -57,8 +58,12 @@ SOURCES += priv/Builder.cpp \
     priv/Global.cpp \
     priv/Cache/FilePool.cpp \
     priv/Cache/FileHasher.cpp \
+    priv/Cache/FileHasherPool.cpp \
+    priv/Cache/ReadAheadReader.cpp \
+    priv/Cache/FileCacheLog.cpp \
     priv/GetEntriesResult.cpp \
-    priv/SizeIndexEntries.cpp
+    priv/SizeIndexEntries.cpp \
+    priv/FindCache.cpp
 HEADERS += IGetHashesResult.h \
     IFileManager.h \
     IChunk.h \
@@ -67,6 +72,7 @@ HEADERS += IGetHashesResult.h \
     priv/FileManager.h \
     priv/FileUpdater/FileUpdater.h \
     priv/FileUpdater/DirWatcher.h \
+    priv/FileUpdater/DirScanner.h \
     priv/Cache/Entry.h \
     priv/Cache/File.h \
     priv/Cache/Directory.h \
@@ -74,6 +80,7 @@ HEADERS += IGetHashesResult.h \
     priv/ChunkIndex/Chunks.h \
     priv/WordIndex/WordIndex.h \
     priv/WordIndex/Node.h \
+    priv/WordIndex/SmallVector.h \
     ../../Protos/core_protocol.pb.h \
     ../../Protos/common.pb.h \
     IDataReader.h \
@@ -92,8 +99,12 @@ HEADERS += IGetHashesResult.h \
     priv/FileUpdater/DirWatcherLinux.h \
     priv/Cache/FilePool.h \
     priv/Cache/FileHasher.h \
+    priv/Cache/FileHasherPool.h \
+    priv/Cache/ReadAheadReader.h \
+    priv/Cache/FileCacheLog.h \
     IGetEntriesResult.h \
     priv/GetEntriesResult.h \
     priv/ExtensionIndex.h \
-    priv/SizeIndexEntries.h
+    priv/SizeIndexEntries.h \
+    priv/FindCache.h
 OTHER_FILES +=
@@ -20,6 +20,7 @@
 #define FILEMANAGER_ICHUNK_H
 
 #include <QSharedPointer>
+#include <QBitArray>
 
 #include <Protos/common.pb.h>
 
@@ -67,6 +68,8 @@ namespace FM
 
       /**
         * The caller must not delete the IChunk as long as data is written with the IDataWriter.
+        * The data are written from 'offset' which must be the number of known bytes or the beginning of a block, see 'getKnownBlocks()'.
+        * Many writers can write the same chunk at the same time.
         * The exceptions (except 'UnableToOpenFileInWriteMode') may occur only if the settings
         * 'check_received_data_integrity' is true.
         * @exception FileResetException Occurs when the file has been created and we already got some known bytes.
@@ -75,7 +78,7 @@ namespace FM
         * @exception ChunkDeletedException
         * @exception ChunkDataUnknownException
         */
-      virtual QSharedPointer<IDataWriter> getDataWriter() = 0;
+      virtual QSharedPointer<IDataWriter> getDataWriter(int offset) = 0;
 
       /**
         * Number of the chunk, start at 0.
@@ -98,8 +101,17 @@ namespace FM
         */
       virtual void setHash(const Common::Hash&) = 0;
 
+      /**
+        * Returns the number of contiguous known bytes from the beginning of the chunk.
+        */
       virtual int getKnownBytes() const = 0;
 
+      /**
+        * The data of a chunk can be written in any order by blocks of 'block_size' bytes, the last block may be smaller.
+        * Returns one bit per block, set if the block is known. The blocks included in 'getKnownBytes()' are set.
+        */
+      virtual QBitArray getKnownBlocks() const = 0;
+
       virtual int getChunkSize() const = 0;
 
       /**
@@ -29,6 +29,9 @@ namespace FM
    class IDataReader
    {
    public:
+      static const int WOULD_BLOCK = -1; ///< See 'send(..)'.
+      static const int NOT_SUPPORTED = -2; ///< See 'send(..)'.
+
       virtual ~IDataReader() {}
 
       /**
@@ -37,6 +40,18 @@ namespace FM
         * @exception ChunkDataUnknownException
         */
       virtual int read(char* buffer, uint offset) = 0;
+
+      /**
+        * Send the data directly from the file to a socket, they are copied by the kernel without going through the user space (zero-copy).
+        * Only available on Linux, 'read(..)' must be used when 'NOT_SUPPORTED' is returned.
+        * @param socketDescriptor A non-blocking socket, the data waiting in its user space buffer must be written before.
+        * @param maxBytesToSend The kernel may send less.
+        * @exception IOErrorException
+        * @exception ChunkDeletedException
+        * @exception ChunkDataUnknownException
+        * @return The number of bytes sent, 0 if the end of the chunk is reached, 'WOULD_BLOCK' if the socket buffer is full or 'NOT_SUPPORTED'.
+        */
+      virtual int send(int socketDescriptor, uint offset, int maxBytesToSend) = 0;
    };
 }
 
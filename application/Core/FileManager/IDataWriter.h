@@ -30,6 +30,9 @@ namespace FM
       virtual ~IDataWriter() {}
 
       /**
+        * Write the data after the ones previously written.
+        * When the chunk is complete its hash is checked if the setting 'check_received_data_integrity' is enabled.
+        * @return 'true' if this write has completed the chunk.
         * @exception IOErrorException
         * @exception ChunkDeletedException When trying to write to a deleted chunk.
         * @exception TryToWriteBeyondTheEndOfChunkException
@@ -20,6 +20,7 @@
 #define FILEMANAGER_IFILEMANAGER_H
 
 #include <QList>
+#include <QVector>
 #include <QStringList>
 #include <QBitArray>
 #include <QPair>
@@ -27,6 +28,7 @@
 
 #include <Common/Hash.h>
 #include <Common/Hashes.h>
+#include <Common/HashesDigest.h>
 #include <Common/SharedDir.h>
 
 #include <Protos/common.pb.h>
@@ -113,6 +115,7 @@ namespace FM
       /**
         * Return the hashes from a FileEntry. If the hashes don't exist they will be computed on the fly. However this
         * Method is non-blocking, when the hashes are ready a signal will be emited by the IGetHashesResult object.
+        * The entry may have less chunks than the file (for example an entry from a search result), the missing ones are considered unknown.
         */
       virtual QSharedPointer<IGetHashesResult> getHashes(const Protos::Common::Entry& file) = 0;
 
@@ -138,15 +141,35 @@ namespace FM
         * @param maxSize This is the size in bytes each 'FindResult' can't exceed. (Because UDP datagrams have a maximum size).
         * It should not be here but it's far more harder to split the result outside this method.
         * @remarks Will not fill the fields 'FindResult.tag' and 'FindResult.peer_id'.
+        * @remarks The files only have their first chunk hash, the other ones can be asked with 'getHashes(..)'.
         */
       virtual QList<Protos::Common::FindResult> find(const QString& words, int maxNbResult, int maxSize) = 0;
       virtual QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize) = 0;
 
+      /**
+        * The results of 'find(..)' are cached.
+        * @return The number of searches answered by the cache (first) and the number of the other searches (second).
+        */
+      virtual QPair<quint64, quint64> getFindCacheStats() const = 0;
+
       /**
         * Ask if we have the given hashes. For each hashes a bit is set (1 if the hash is known or 0 otherwise) into the returned QBitArray.
         * Returns a null QBitArray if we own any of the given hashes.
         */
-      virtual QBitArray haveChunks(const QList<Common::Hash>& hashes) = 0;
+      virtual QBitArray haveChunks(const QVector<Common::Hash>& hashes) = 0;
+
+      /**
+        * Same as above for the prefixes of the hashes, see 'Common::Hash::getPrefix()'.
+        * A chunk whose hash has the same prefix but not the same hash may be taken for a requested one.
+        */
+      virtual QBitArray haveChunks(const QVector<quint64>& hashPrefixes) = 0;
+
+      /**
+        * Return a digest of 'size' bytes of the shard 'n' (modulo the number of shards) of the hashes of our chunks.
+        * The number of shards is the smallest power of two for which a shard doesn't exceed the capacity of a digest.
+        * Returns a null digest if we don't have any chunk.
+        */
+      virtual Common::HashesDigest getChunksDigest(quint32 n, int size) = 0;
 
       /**
         * Return the amount of shared data.
@@ -164,7 +187,8 @@ namespace FM
 
       /**
         * Return the progress of the current action returned by 'getCacheStatus()'.
-        * @return An integer from 0 to 100.
+        * During the scanning there is no progress, the throughput of the scanning is returned instead.
+        * @return An integer from 0 to 10000 or the number of entries (files and directories) scanned per second.
         */
       virtual int getProgress() const = 0;
 
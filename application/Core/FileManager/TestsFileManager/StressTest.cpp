@@ -471,7 +471,7 @@ void StressTest::haveChunk()
 
    qDebug() << "===== StressTest::haveChunk() =====";
 
-   QList<Common::Hash> hashes;
+   QVector<Common::Hash> hashes;
 
    int n = this->randGen.rand(10000) + 1000;
    while (n--)
@@ -651,7 +651,7 @@ void Downloader::run()
 
    try
    {
-      QSharedPointer<IDataWriter> writer = chunk->getDataWriter();
+      QSharedPointer<IDataWriter> writer = chunk->getDataWriter(chunk->getKnownBytes());
 
       const int BUFFER_SIZE = SETTINGS.get<quint32>("buffer_size_writing");
       char buffer[BUFFER_SIZE];
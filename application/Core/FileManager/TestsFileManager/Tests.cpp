@@ -22,6 +22,11 @@ using namespace FM;
 #include <string>
 using namespace std;
 
+#if defined(Q_OS_LINUX)
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
 #include <QtDebug>
 #include <QRegExp>
 #include <QFile>
@@ -45,6 +50,8 @@ using namespace std;
 #include <Exceptions.h>
 #include <priv/Constants.h>
 #include <priv/WordIndex/WordIndex.h>
+#include <priv/Cache/ReadAheadReader.h>
+#include <priv/Cache/Chunk.h>
 
 #include <HashesReceiver.h>
 
@@ -140,6 +147,203 @@ void Tests::testWordIndex()
 
    QList<int> result10 = WordIndex<int>::resultToList(index.search("arb"));
    QVERIFY(result10.size() == 0);
+
+   // Several terms: the items matching all the terms come first, then by level, whatever the order of the items.
+   WordIndex<int> index2;
+   index2.addItem(QStringList() << "foo" << "bar", 10);
+   index2.addItem(QStringList() << "foot" << "bar", 5); // Partial match for "foo".
+   index2.addItem("foo", 20);
+   index2.addItem(QStringList() << "bar" << "barrel", 30); // Found twice for "bar", kept once.
+
+   const QStringList terms = QStringList() << "foo" << "bar";
+   QCOMPARE(WordIndex<int>::resultToList(index2.search(terms)), QList<int>() << 10 << 5 << 20 << 30); // -1: no limit.
+   QCOMPARE(WordIndex<int>::resultToList(index2.search(terms, 3)), QList<int>() << 10 << 5 << 20);
+   QCOMPARE(WordIndex<int>::resultToList(index2.search(terms, 1)), QList<int>() << 10);
+   QCOMPARE(WordIndex<int>::resultToList(index2.search(terms, -1, [](const int& item) { return item != 10; })), QList<int>() << 5 << 20 << 30);
+
+   index2.rmItem("bar", 5);
+   QCOMPARE(WordIndex<int>::resultToList(index2.search(terms)), QList<int>() << 10 << 20 << 30 << 5);
+}
+
+/**
+  * Write some records in a file cache, append new versions of them and check the last ones are read.
+  */
+#include <priv/Cache/FileCacheLog.h>
+void Tests::testFileCacheLog()
+{
+   qDebug() << "===== testFileCacheLog() =====";
+
+   const QString filename("test_cache_log.bin");
+   const Common::Hash sharedDirID = Common::Hash::rand();
+   const FileCacheLog::DirKey rootKey(sharedDirID, "/");
+   const FileCacheLog::DirKey subDirKey(sharedDirID, "/a/");
+
+   Protos::FileCache::Hashes header;
+   header.set_version(FILE_CACHE_VERSION);
+   header.set_chunksize(1024);
+   Protos::FileCache::Hashes::SharedDir* sharedDir = header.add_shareddir();
+   sharedDir->mutable_id()->set_hash(sharedDirID.getData(), Common::Hash::HASH_SIZE);
+   sharedDir->set_path("/shared/");
+
+   auto makeDir = [](int nbFiles) {
+      Protos::FileCache::Hashes::Dir dir;
+      for (int i = 0; i < nbFiles; i++)
+      {
+         Protos::FileCache::Hashes::File* file = dir.add_file();
+         file->set_filename(QString("file%1").arg(i).toStdString());
+         file->set_size(i);
+         file->set_date_last_modified(i);
+      }
+      return dir;
+   };
+
+   {
+      FileCacheLog log(filename);
+      QVERIFY(log.startWriting()); // The file doesn't exist, everything must be written.
+      log.writeHeader(header);
+      log.writeDir(rootKey, makeDir(2));
+      log.writeDir(subDirKey, makeDir(3));
+      log.finishWriting();
+
+      // Only the changed directories are appended.
+      QVERIFY(!log.startWriting());
+      log.writeHeader(header); // Not written because it hasn't changed.
+      log.writeDir(rootKey, makeDir(4));
+      log.finishWriting();
+   }
+
+   {
+      FileCacheLog log(filename);
+      QVERIFY(log.load());
+      QCOMPARE(log.getHeader().shareddir_size(), 1);
+      QCOMPARE(log.getNbFiles(), 7);
+
+      Protos::FileCache::Hashes::Dir dir;
+      QVERIFY(log.getDir(rootKey, dir));
+      QCOMPARE(dir.file_size(), 4);
+      QVERIFY(log.getDir(subDirKey, dir));
+      QCOMPARE(dir.file_size(), 3);
+      QVERIFY(!log.getDir(FileCacheLog::DirKey(sharedDirID, "/b/"), dir));
+
+      // A record without file removes the directory.
+      QVERIFY(!log.startWriting());
+      log.writeDir(subDirKey, makeDir(0));
+      log.finishWriting();
+   }
+
+   // A truncated record at the end is ignored.
+   {
+      QFile file(Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + filename);
+      QVERIFY(file.open(QIODevice::Append));
+      file.write(QByteArray(3, '\x02'));
+   }
+
+   {
+      FileCacheLog log(filename);
+      QVERIFY(log.load());
+      QCOMPARE(log.getNbFiles(), 4);
+
+      Protos::FileCache::Hashes::Dir dir;
+      QVERIFY(!log.getDir(subDirKey, dir));
+      log.remove();
+   }
+}
+
+/**
+  * 'DirScanner::listDir(..)' must return the same entries as 'QDir'.
+  */
+#include <priv/FileUpdater/DirScanner.h>
+void Tests::testDirScanner()
+{
+   qDebug() << "===== testDirScanner() =====";
+
+   const QString path = QDir::currentPath();
+
+   QMap<QString, QFileInfo> expected;
+   foreach (QFileInfo fileInfo, QDir(path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks))
+      expected.insert(fileInfo.fileName(), fileInfo);
+
+   const QList<DirScanner::Entry> entries = DirScanner::listDir(path);
+   QCOMPARE(entries.size(), expected.size());
+
+   foreach (DirScanner::Entry entry, entries)
+   {
+      QVERIFY(expected.contains(entry.name));
+      const QFileInfo& fileInfo = expected[entry.name];
+      QCOMPARE(entry.isDir, fileInfo.isDir());
+      if (!entry.isDir)
+      {
+         QCOMPARE(entry.size, fileInfo.size());
+         QCOMPARE(entry.dateLastModified.toMSecsSinceEpoch() / 1000, fileInfo.lastModified().toMSecsSinceEpoch() / 1000);
+      }
+   }
+}
+
+/**
+  * The entries are only compared by address, fake ones are used.
+  */
+#include <priv/FindCache.h>
+void Tests::testFindCache()
+{
+   qDebug() << "===== testFindCache() =====";
+
+   FindCache cache(2);
+   const FindCache::Pattern pattern1("Aaa bbb", QList<QString>(), 0, 100, Protos::Common::FindPattern::FILE_DIR, 300, 1000);
+   const FindCache::Pattern pattern2("aaa   BBB", QList<QString>(), 0, 100, Protos::Common::FindPattern::FILE_DIR, 300, 1000);
+   const FindCache::Pattern pattern3("ccc", QList<QString>(), 0, 100, Protos::Common::FindPattern::FILE_DIR, 300, 1000);
+   const FindCache::Pattern pattern4("ddd", QList<QString>(), 0, 100, Protos::Common::FindPattern::FILE_DIR, 300, 1000);
+   QCOMPARE(pattern1.key, pattern2.key); // The words are normalized.
+
+   const Entry* entry1 = reinterpret_cast<const Entry*>(0x10);
+   const Entry* entry2 = reinterpret_cast<const Entry*>(0x20);
+
+   QList<Protos::Common::FindResult> results;
+   results << Protos::Common::FindResult();
+   results.last().add_entry()->set_level(42);
+
+   QList<Protos::Common::FindResult> cachedResults;
+   quint64 token, staleToken;
+   QVERIFY(!cache.get(pattern1, cachedResults, token));
+   cache.put(pattern1, token, results, QList<const Entry*>() << entry1);
+   QVERIFY(cache.get(pattern2, cachedResults, token));
+   QCOMPARE(cachedResults.size(), 1);
+   QCOMPARE(cachedResults.first().entry(0).level(), 42u);
+
+   // A result changing while being computed isn't kept, even if the pattern is asked again in the meantime.
+   QVERIFY(!cache.get(pattern3, cachedResults, staleToken));
+   cache.clear();
+   QVERIFY(!cache.get(pattern3, cachedResults, token));
+   QVERIFY(token != staleToken);
+   cache.put(pattern3, staleToken, results, QList<const Entry*>() << entry2);
+   QVERIFY(!cache.get(pattern3, cachedResults, staleToken));
+   QCOMPARE(staleToken, token); // The same result is being computed.
+   cache.put(pattern3, token, results, QList<const Entry*>() << entry2);
+   QVERIFY(cache.get(pattern3, cachedResults, token));
+
+   // The entries of a result being computed aren't known, any change removes it.
+   QVERIFY(!cache.get(pattern1, cachedResults, staleToken));
+   cache.entryChanged(entry1);
+   QVERIFY(!cache.get(pattern1, cachedResults, token));
+   QVERIFY(token != staleToken);
+   cache.put(pattern1, staleToken, results, QList<const Entry*>() << entry1);
+   QVERIFY(cache.get(pattern3, cachedResults, staleToken));
+   cache.put(pattern1, token, results, QList<const Entry*>() << entry1);
+
+   // Only the results containing the changed entry are removed.
+   cache.entryChanged(entry2);
+   QVERIFY(cache.get(pattern1, cachedResults, token));
+   QVERIFY(!cache.get(pattern3, cachedResults, token));
+   cache.put(pattern3, token, results, QList<const Entry*>() << entry2);
+
+   // The least recently used pattern is forgotten.
+   QVERIFY(cache.get(pattern1, cachedResults, token));
+   QVERIFY(!cache.get(pattern4, cachedResults, token));
+   cache.put(pattern4, token, results, QList<const Entry*>());
+   QVERIFY(cache.get(pattern1, cachedResults, token));
+   QVERIFY(!cache.get(pattern3, cachedResults, token));
+
+   QCOMPARE(cache.getNbHits(), quint64(6));
+   QCOMPARE(cache.getNbMisses(), quint64(9));
 }
 
 void Tests::createFileManager()
@@ -408,6 +612,85 @@ void Tests::createAnEmptyFile()
    }
 }
 
+/**
+  * Write the blocks of a chunk out of order like several 'BlockDownloader' and check the chunk is completed
+  * only when all its blocks are known. The hash is checked by the writer completing the chunk, whatever its offset.
+  */
+void Tests::writeAChunkByBlocks()
+{
+   qDebug() << "===== writeAChunkByBlocks() =====";
+
+   const int BLOCK_SIZE = SETTINGS.get<quint32>("block_size");
+   const int FILE_SIZE = 2 * BLOCK_SIZE + BLOCK_SIZE / 2; // A single chunk of three blocks, the last one is partial.
+
+   QByteArray data(FILE_SIZE, 0);
+   for (int i = 0; i < data.size(); i++)
+      data[i] = static_cast<char>(i * 7 + i / 4096);
+
+   Common::Hasher hasher(Chunk::HASH_ALGORITHM);
+   hasher.addData(data.constData(), data.size());
+   const Common::Hash hash = hasher.getResult();
+
+   // The order of the blocks and the block to corrupt (-1 for none).
+   struct Case { QString name; QList<int> blocks; int corruptedBlock; };
+   const QList<Case> cases {
+      Case { "blocksReversed.bin", QList<int>() << 2 << 1 << 0, -1 }, // Completed by the writer at 0.
+      Case { "blocksShuffled.bin", QList<int>() << 0 << 2 << 1, -1 }, // Completed by a writer not at 0, the data before are read back.
+      Case { "blocksCorrupted.bin", QList<int>() << 1 << 2 << 0, 1 }
+   };
+
+   foreach (Case c, cases)
+   {
+      Protos::Common::Entry remoteEntry;
+      remoteEntry.set_path("/remoteShare1/");
+      remoteEntry.set_name(c.name.toStdString());
+      remoteEntry.set_size(FILE_SIZE);
+      remoteEntry.add_chunk()->set_hash(hash.getData(), Common::Hash::HASH_SIZE);
+
+      QList<QSharedPointer<IChunk>> chunks = this->fileManager->newFile(remoteEntry);
+      QCOMPARE(chunks.size(), 1);
+      QSharedPointer<IChunk> chunk = chunks.first();
+
+      for (int i = 0; i < c.blocks.size(); i++)
+      {
+         const int block = c.blocks[i];
+         const int offset = block * BLOCK_SIZE;
+         QByteArray blockData = data.mid(offset, BLOCK_SIZE);
+         if (block == c.corruptedBlock)
+            blockData[0] = static_cast<char>(~blockData[0]);
+
+         QSharedPointer<IDataWriter> writer = chunk->getDataWriter(offset);
+         const bool lastBlock = i == c.blocks.size() - 1;
+
+         if (lastBlock && c.corruptedBlock != -1)
+         {
+            try
+            {
+               writer->write(blockData.constData(), blockData.size());
+               QFAIL("The hash of the corrupted chunk must not match");
+            }
+            catch (hashMissmatchException&)
+            {
+            }
+            QCOMPARE(chunk->getKnownBytes(), 0);
+            QCOMPARE(chunk->getKnownBlocks(), QBitArray(3));
+            QVERIFY(!chunk->isComplete());
+            break;
+         }
+
+         QCOMPARE(writer->write(blockData.constData(), blockData.size()), lastBlock);
+         QVERIFY(chunk->getKnownBlocks().testBit(block));
+         QCOMPARE(chunk->isComplete(), lastBlock);
+      }
+
+      if (c.corruptedBlock == -1)
+      {
+         QCOMPARE(chunk->getKnownBytes(), FILE_SIZE);
+         QCOMPARE(chunk->getKnownBlocks(), QBitArray(3, true));
+      }
+   }
+}
+
 void Tests::getAnExistingChunk()
 {
    qDebug() << "===== getAExistingChunk() =====";
@@ -605,8 +888,11 @@ void Tests::findFilesWithResultFragmentation()
    qDebug() << "Nb fragment: " << results.size();
    for (int i = 0; i < results.size(); i++)
    {
+      results[i].set_tag(std::numeric_limits<quint64>::max()); // The biggest tag.
       qDebug() << "Fragment number " << i << ", size = " << results[i].ByteSize();
       QVERIFY(results[i].ByteSize() <= FRAGMENT_MAX_SIZE);
+      for (int j = 0; j < results[i].entry_size(); j++)
+         QVERIFY(results[i].entry(j).entry().chunk_size() <= 1); // Only the first hash.
       this->printSearch(terms, results[i]);
    }
 }
@@ -698,7 +984,7 @@ void Tests::haveChunks()
 {
    qDebug() << "===== haveChunks() =====";
 
-   QList<Common::Hash> hashes;
+   QVector<Common::Hash> hashes;
    hashes
       << Common::Hash::fromStr("f6126deaa5e1d9692d54e3bef0507721372ee7f8") // "/sharedDirs/share3/aaaa bbbb cccc.txt"
       << Common::Hash::fromStr("4c24e58c47746ea04296df9342185d9b3a447899") // "/sharedDirs/share1/v.txt"
@@ -719,6 +1005,19 @@ void Tests::haveChunks()
       QVERIFY(result[i] == expectedResult[i]);
       qDebug() << hashes[i].toStr() << ":" << (result[i] ? "Yes" : "No");
    }
+
+   QVector<quint64> hashPrefixes;
+   for (int i = 0; i < hashes.size(); i++)
+      hashPrefixes << hashes[i].getPrefix();
+
+   QCOMPARE(this->fileManager->haveChunks(hashPrefixes), expectedResult);
+
+   // There is only a few chunks, a digest covers all of them.
+   const Common::HashesDigest& digest = this->fileManager->getChunksDigest(0, 4096);
+   QVERIFY(digest.isValid());
+   QCOMPARE(digest.getNbShards(), 1u);
+   QVERIFY(digest.test(hashes[0]));
+   QVERIFY(digest.test(hashes[1]));
 }
 
 void Tests::printAmount()
@@ -737,9 +1036,9 @@ void Tests::rmSharedDirectory()
 }
 
 /**
-  * The following case tests the Bloom filter performance
-  * used in the class 'Chunks'.
-  * The bloom filter can be enable in "Chunks.h".
+  * The following case tests the lookup performance of the class 'Chunks' with
+  * 1'000'000 and 10'000'000 known chunks, half of the tested hashes are known
+  * then all the tested hashes are unknown (the common case, answered by the Bloom filter).
   */
 #include <priv/ChunkIndex/Chunks.h>
 #include <priv/Cache/Chunk.h>
@@ -748,34 +1047,166 @@ void Tests::rmSharedDirectory()
 void Tests::chunksPerformance()
 {
    qDebug() << "===== chunksPerformance() =====";
-     
-   const int HASH_POOL_SIZE = 100000;
-   const int NB_HASHES_TO_CHECK = 10000000;
- 
-   Chunks chunks;
-  
-   for (int i = 0; i < HASH_POOL_SIZE; i++)
+
+   const int NB_HASHES_TO_CHECK = 10000;
+   const int NB_ROUNDS = 200;
+
+   foreach (int hashPoolSize, QList<int>() << 1000000 << 10000000)
    {
-      QSharedPointer<Chunk> chunk(new Chunk(nullptr, 0, 0));
-      chunk->setHash(Common::Hash::rand());
-      chunks.add(chunk);
+      Chunks chunks;
+      QVector<Common::Hash> hashes;
+
+      QElapsedTimer timer;
+      timer.start();
+
+      for (int i = 0; i < hashPoolSize; i++)
+      {
+         QSharedPointer<Chunk> chunk(new Chunk(nullptr, 0, 0));
+         chunk->setHash(Common::Hash::rand());
+         chunks.add(chunk);
+
+         if (i % (hashPoolSize / NB_HASHES_TO_CHECK * 2) == 0)
+            hashes << chunk->getHash() << Common::Hash::rand();
+      }
+
+      qDebug() << "Time to add" << hashPoolSize << "chunks:" << timer.elapsed() << "ms";
+
+      timer.start();
+      for (int n = 0; n < NB_ROUNDS; n++)
+         for (int i = 0; i < hashes.size(); i++)
+            if (chunks.contains(hashes[i]) != (i % 2 == 0))
+               QFAIL("'contains(..)' returns a wrong result");
+      qDebug() << "Time to check" << NB_ROUNDS * hashes.size() << "hashes one by one among a pool of" << hashPoolSize << "hashes:" << timer.elapsed() << "ms";
+
+      timer.start();
+      for (int n = 0; n < NB_ROUNDS; n++)
+         if (chunks.containsMany(hashes).count(true) != hashes.size() / 2)
+            QFAIL("'containsMany(..)' returns a wrong result");
+      qDebug() << "Time to check" << NB_ROUNDS * hashes.size() << "hashes by batch of" << hashes.size() << "among a pool of" << hashPoolSize << "hashes:" << timer.elapsed() << "ms";
+
+      QVector<Common::Hash> unknownHashes;
+      for (int i = 0; i < hashes.size(); i++)
+         unknownHashes << Common::Hash::rand();
+
+      QTest::qWait(3000); // Let the Bloom filter be rebuilt in the background.
+
+      timer.start();
+      for (int n = 0; n < NB_ROUNDS; n++)
+         if (chunks.containsMany(unknownHashes).count(true) != 0)
+            QFAIL("chunks cannot contains a random chunk");
+      qDebug() << "Time to check" << NB_ROUNDS * unknownHashes.size() << "unknown hashes by batch of" << unknownHashes.size() << "among a pool of" << hashPoolSize << "hashes:" << timer.elapsed() << "ms";
    }
+}
 
-   Common::Hashes hashes;
-   const int nbHashes = 100;
-   for (int i = 0; i < nbHashes; i++)
-      hashes << Common::Hash::rand();
+/**
+  * Hash a big file with and without the read-ahead pipeline and print the throughput of both.
+  * On Linux the file is evicted from the page cache before each measure to time the reading from the disk,
+  * elsewhere the file may still be in cache and the gain of the read-ahead doesn't show.
+  */
+void Tests::readAheadPerformance()
+{
+   qDebug() << "===== readAheadPerformance() =====";
+
+   const QString filePath("bigFileReadAhead.bin");
+   const int FILE_SIZE = 256 * 1024 * 1024; // 256 MiB.
+   const int CHUNK_SIZE = SETTINGS.get<quint32>("chunk_size");
+   const int BUFFER_SIZE = SETTINGS.get<quint32>("buffer_size_reading");
+
+   {
+      QFile file(filePath);
+      QVERIFY(file.open(QIODevice::WriteOnly));
+      QByteArray data(1024 * 1024, 0);
+      for (int i = 0; i < FILE_SIZE / data.size(); i++)
+      {
+         for (int j = 0; j < data.size(); j++)
+            data[j] = static_cast<char>(i * 31 + j);
+         file.write(data);
+      }
+#if defined(Q_OS_LINUX)
+      file.flush();
+      QCOMPARE(fdatasync(file.handle()), 0); // The dirty pages can't be evicted.
+#endif
+   }
+
+   Common::Hashes hashesWithoutReadAhead;
+   Common::Hashes hashesWithReadAhead;
+
+   for (int readAhead = 0; readAhead <= 1; readAhead++)
+   {
+      Common::Hashes& hashes = readAhead ? hashesWithReadAhead : hashesWithoutReadAhead;
+
+      QFile file(filePath);
+      QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+#if defined(Q_OS_LINUX)
+      QCOMPARE(posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED), 0);
+#endif
+
+      QScopedPointer<ReadAheadReader> reader(readAhead ? new ReadAheadReader(SETTINGS.get<quint32>("read_ahead_buffer_size"), SETTINGS.get<quint32>("number_of_read_ahead_buffers")) : nullptr);
+      QScopedArrayPointer<char> buffer(new char[BUFFER_SIZE]);
 
-   QElapsedTimer timer;
-   timer.start();
+      QElapsedTimer timer;
+      timer.start();
+
+      {
+         AutoStoppedReading reading(reader.data(), file, CHUNK_SIZE);
+
+         Common::Hasher hasher;
+         int bytesReadChunk = 0;
+         forever
+         {
+            const char* data = buffer.data();
+            const int bytesRead = reader ? reader->read(data) : file.read(buffer.data(), qMin(BUFFER_SIZE, CHUNK_SIZE - bytesReadChunk));
+            QVERIFY(bytesRead >= 0);
+
+            if (bytesRead > 0)
+            {
+               hasher.addData(data, bytesRead);
+               bytesReadChunk += bytesRead;
+               if (reader)
+                  reader->releaseData();
+            }
+
+            if (bytesReadChunk == CHUNK_SIZE || (bytesRead == 0 && bytesReadChunk > 0))
+            {
+               hashes << hasher.getResult();
+               hasher.reset();
+               bytesReadChunk = 0;
+            }
+
+            if (bytesRead == 0)
+               break;
+         }
+      }
+
+      const qint64 delta = timer.elapsed();
+      qDebug() << "Hashing speed" << (readAhead ? "with" : "without") << "read-ahead:" << (delta == 0 ? 0 : 1000LL * FILE_SIZE / delta / 1024 / 1024) << "MB/s";
+   }
 
-   for (int i = 0; i < NB_HASHES_TO_CHECK; i++)
+   QCOMPARE(hashesWithReadAhead.size(), FILE_SIZE / CHUNK_SIZE);
+   QVERIFY(hashesWithReadAhead == hashesWithoutReadAhead);
+
+   // The reading of a single chunk stops at its end.
    {
-      if(chunks.contains(hashes[i % nbHashes]))
-         QFAIL("chunks cannot contains a random chunk");
+      QFile file(filePath);
+      QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+      file.seek(CHUNK_SIZE);
+
+      ReadAheadReader reader(SETTINGS.get<quint32>("read_ahead_buffer_size"), SETTINGS.get<quint32>("number_of_read_ahead_buffers"));
+      AutoStoppedReading reading(&reader, file, CHUNK_SIZE, 2LL * CHUNK_SIZE);
+
+      Common::Hasher hasher;
+      const char* data;
+      int bytesRead;
+      while ((bytesRead = reader.read(data)) > 0)
+      {
+         hasher.addData(data, bytesRead);
+         reader.releaseData();
+      }
+      QCOMPARE(bytesRead, 0);
+      QVERIFY(hasher.getResult() == hashesWithReadAhead[1]);
    }
 
-   qDebug() << "Time to check if" << NB_HASHES_TO_CHECK << "hashes exist among a pool of" << HASH_POOL_SIZE << "hashes:" << timer.elapsed() << "ms";
+   QFile::remove(filePath);
 }
 
 void Tests::cleanupTestCase()
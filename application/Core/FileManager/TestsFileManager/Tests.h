@@ -40,6 +40,9 @@ private slots:
    void initTestCase();
 
    void testWordIndex();
+   void testFileCacheLog();
+   void testDirScanner();
+   void testFindCache();
 
    void createFileManager();
 
@@ -68,6 +71,7 @@ private slots:
    void moveADirectoryContainingFiles();
    void removeADirectory();
    void createAnEmptyFile();
+   void writeAChunkByBlocks();
 
    /***** Ask for chunks by hash *****/
    void getAnExistingChunk();
@@ -106,6 +110,9 @@ private slots:
    /***** Speed test of the class 'Chunks' *****/
    void chunksPerformance();
 
+   /***** Speed test of the class 'ReadAheadReader' *****/
+   void readAheadPerformance();
+
    void cleanupTestCase();
 
 private:
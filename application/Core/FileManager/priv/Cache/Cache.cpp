@@ -41,7 +41,7 @@ using namespace FM;
   *  - Browse directories and files.
   *  - Create a new file.
   *  - Add or remove a shared directory (root).
-  *  - Serialize or deserialize the hashes of the files in a 'Protos::FileCache::Hashes' structure (to be saved/loaded in/from a physical file).
+  *  - Persist the hashes of the files in a 'FileCacheLog' and define the shared directories from it.
   */
 
 Cache::Cache() :
@@ -150,6 +150,27 @@ Directory* Cache::getDirectory(const Protos::Common::Entry& dir) const
    return nullptr;
 }
 
+/**
+  * @return The directory identified by its shared directory and its relative path, 'nullptr' if it doesn't exist.
+  */
+Directory* Cache::getDirectory(const FileCacheLog::DirKey& key) const
+{
+   QMutexLocker locker(&this->mutex);
+
+   SharedDirectory* sharedDir = this->getSharedDirectory(key.first);
+   if (!sharedDir)
+      return nullptr;
+
+   Directory* currentDir = sharedDir;
+   foreach (QString folder, key.second.split('/', QString::SkipEmptyParts))
+   {
+      currentDir = currentDir->getSubDir(folder);
+      if (!currentDir)
+         return nullptr;
+   }
+   return currentDir;
+}
+
 /**
   * @param path The absolute path to a directory or a file.
   * @return Returns a directory or a file, it can be a shared directory. Returns 'nullptr' if no entry found.
@@ -612,24 +633,82 @@ void Cache::createSharedDirs(const Protos::FileCache::Hashes& hashes)
 }
 
 /**
-  * Populates the given structure to be persisted later.
+  * Writes the header and the records of the given directories in the file cache.
+  * If the file cache is compacted all the directories are written, see 'FileCacheLog::startWriting()'.
+  * The records are copied while holding 'mutex' and written once it's released.
+  * @param changedDirs The directories whose files have changed.
+  * @param changedDirTrees The directories whose files or sub directories files have changed, for example after a renaming.
+  * @exception PersistentDataIOException
   */
-void Cache::populateHashes(Protos::FileCache::Hashes& hashes) const
+void Cache::persistHashes(FileCacheLog& fileCacheLog, const QSet<FileCacheLog::DirKey>& changedDirs, const QSet<FileCacheLog::DirKey>& changedDirTrees) const
 {
-   QMutexLocker locker(&this->mutex);
+   const bool writeAll = fileCacheLog.startWriting();
 
-   hashes.set_version(FILE_CACHE_VERSION);
-   hashes.set_chunksize(SETTINGS.get<quint32>("chunk_size"));
+   Protos::FileCache::Hashes header;
+   QList<QPair<FileCacheLog::DirKey, Protos::FileCache::Hashes::Dir>> dirRecords;
+   QList<FileCacheLog::DirKey> removedDirs;
 
-   for (QListIterator<SharedDirectory*> i(this->sharedDirs); i.hasNext();)
    {
-      SharedDirectory* sharedDir = i.next();
-      Protos::FileCache::Hashes_SharedDir* sharedDirMess = hashes.add_shareddir();
-      sharedDirMess->mutable_id()->set_hash(sharedDir->getId().getData(), Common::Hash::HASH_SIZE);
-      Common::ProtoHelper::setStr(*sharedDirMess, &Protos::FileCache::Hashes_SharedDir::set_path, sharedDir->getFullPath());
+      QMutexLocker locker(&this->mutex);
+
+      header.set_version(FILE_CACHE_VERSION);
+      header.set_chunksize(SETTINGS.get<quint32>("chunk_size"));
+      header.set_chunkhashalgorithm(static_cast<Protos::Common::Hash::Algorithm>(Chunk::HASH_ALGORITHM)); // Warning, enums must be compatible.
+
+      for (QListIterator<SharedDirectory*> i(this->sharedDirs); i.hasNext();)
+      {
+         SharedDirectory* sharedDir = i.next();
+         Protos::FileCache::Hashes_SharedDir* sharedDirMess = header.add_shareddir();
+         sharedDirMess->mutable_id()->set_hash(sharedDir->getId().getData(), Common::Hash::HASH_SIZE);
+         Common::ProtoHelper::setStr(*sharedDirMess, &Protos::FileCache::Hashes_SharedDir::set_path, sharedDir->getFullPath());
+      }
 
-      sharedDir->populateHashesDir(*sharedDirMess->mutable_root());
+      QSet<Directory*> dirsToWrite;
+      if (writeAll)
+      {
+         foreach (SharedDirectory* sharedDir, this->sharedDirs)
+            for (DirIterator i(sharedDir, true); Directory* dir = i.next();)
+               dirsToWrite << dir;
+      }
+      else
+      {
+         foreach (FileCacheLog::DirKey key, changedDirs)
+            if (Directory* dir = this->getDirectory(key))
+               dirsToWrite << dir;
+
+         foreach (FileCacheLog::DirKey key, changedDirTrees)
+            if (Directory* dir = this->getDirectory(key))
+               for (DirIterator i(dir, true); Directory* subDir = i.next();)
+                  dirsToWrite << subDir;
+
+         // Some directories may have been removed, renamed or moved.
+         if (!changedDirTrees.isEmpty())
+            removedDirs = fileCacheLog.getUnknownDirs([this](const FileCacheLog::DirKey& key) { return this->getDirectory(key) != nullptr; });
+      }
+
+      foreach (Directory* dir, dirsToWrite)
+      {
+         Protos::FileCache::Hashes::Dir dirMess;
+         dir->populateHashesDir(dirMess);
+
+         // An empty directory is only written to remove a previous record.
+         if (dirMess.file_size() > 0 || !writeAll)
+            dirRecords << qMakePair(FileCacheLog::DirKey(dir->getRoot()->getId(), dir->getRelativePath()), dirMess);
+      }
    }
+
+   fileCacheLog.writeHeader(header);
+
+   foreach (FileCacheLog::DirKey key, removedDirs)
+      fileCacheLog.writeDir(key, Protos::FileCache::Hashes::Dir());
+
+   for (QListIterator<QPair<FileCacheLog::DirKey, Protos::FileCache::Hashes::Dir>> i(dirRecords); i.hasNext();)
+   {
+      const QPair<FileCacheLog::DirKey, Protos::FileCache::Hashes::Dir>& dirRecord = i.next();
+      fileCacheLog.writeDir(dirRecord.first, dirRecord.second);
+   }
+
+   fileCacheLog.finishWriting();
 }
 
 quint64 Cache::getAmount() const
@@ -657,6 +736,11 @@ void Cache::onEntryRenamed(Entry* entry, const QString& oldName)
    emit entryRenamed(entry, oldName);
 }
 
+void Cache::onEntryMoved(Entry* entry)
+{
+   emit entryMoved(entry);
+}
+
 void Cache::onEntryResizing(Entry* entry)
 {
    emit entryResizing(entry);
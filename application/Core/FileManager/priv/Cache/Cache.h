@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QPair>
 #include <QList>
+#include <QSet>
 #include <QStringList>
 #include <QMutex>
 #include <QSharedPointer>
@@ -36,6 +37,7 @@
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Chunk.h>
 #include <priv/Cache/FilePool.h>
+#include <priv/Cache/FileCacheLog.h>
 
 namespace FM
 {
@@ -54,6 +56,7 @@ namespace FM
       Protos::Common::Entries getSharedEntries() const;
       Protos::Common::Entries getEntries(const Protos::Common::Entry& dir) const;
       Directory* getDirectory(const Protos::Common::Entry& dir) const;
+      Directory* getDirectory(const FileCacheLog::DirKey& key) const;
 
       Entry* getEntry(const QString& path) const;
       File* getFile(const Protos::Common::Entry& fileEntry) const;
@@ -73,7 +76,7 @@ namespace FM
       Directory* getFittestDirectory(const QString& path) const;
 
       void createSharedDirs(const Protos::FileCache::Hashes& hashes);
-      void populateHashes(Protos::FileCache::Hashes& hashes) const;
+      void persistHashes(FileCacheLog& fileCacheLog, const QSet<FileCacheLog::DirKey>& changedDirs, const QSet<FileCacheLog::DirKey>& changedDirTrees) const;
 
       quint64 getAmount() const;
 
@@ -82,6 +85,7 @@ namespace FM
       void onEntryAdded(Entry* entry);
       void onEntryRemoved(Entry* entry);
       void onEntryRenamed(Entry* entry, const QString& oldName);
+      void onEntryMoved(Entry* entry);
       void onEntryResizing(Entry* entry);
       void onEntryResized(Entry* entry, qint64 oldSize);
 
@@ -97,6 +101,7 @@ namespace FM
       void entryAdded(Entry* entry);
       void entryRemoved(Entry* entry);
       void entryRenamed(Entry* entry, const QString& oldName);
+      void entryMoved(Entry* entry);
       void entryResizing(Entry* entry);
       void entryResized(Entry* entry, qint64 oldSize);
 
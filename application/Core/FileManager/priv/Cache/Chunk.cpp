@@ -33,12 +33,16 @@ using namespace FM;
   *
   * A chunk is a part of a file. It's identified by a hash which can be unknown when a chunk is created and be set later by 'setHash(..)'.
   * A chunk can be read or write, when a chunk is written the 'knownBytes' member is increased.
+  * The data of a chunk can also be written by blocks in any order (for example from several peers at the same time),
+  * the blocks written after 'knownBytes' are remembered and 'knownBytes' skips them when it reaches them.
   * Each chunk of a file has a unique number which begins at 0 and define the order of data, chunk#1 represents the data right after chunk#0 and so on.
   *
   * Concurrent accesses are protected by the 'QSharedPointer', see the 'File' class.
   */
 
 int Chunk::CHUNK_SIZE(0);
+Common::HashAlgorithm Chunk::HASH_ALGORITHM(Common::HashAlgorithm::SHA1);
+int Chunk::BLOCK_SIZE(0);
 
 Chunk::Chunk(File* file, int num, quint32 knownBytes) :
    file(file), num(num), knownBytes(knownBytes)
@@ -70,7 +74,7 @@ Chunk* Chunk::restoreFromFileCache(const Protos::FileCache::Hashes_Chunk& chunk)
    this->knownBytes = chunk.known_bytes();
 
    if (chunk.has_hash())
-      this->hash = chunk.hash().hash();
+      this->hash = Common::ProtoHelper::getHash(chunk.hash());
    return this;
 }
 
@@ -78,7 +82,7 @@ void Chunk::populateHashesChunk(Protos::FileCache::Hashes_Chunk& chunk) const
 {
    chunk.set_known_bytes(this->knownBytes);
    if (!this->hash.isNull())
-      chunk.mutable_hash()->set_hash(this->hash.getData(), Common::Hash::HASH_SIZE);
+      Common::ProtoHelper::setHash(*chunk.mutable_hash(), this->hash);
 }
 
 void Chunk::removeItsIncompleteFile()
@@ -104,14 +108,22 @@ QString Chunk::getFilePath() const
    return QString();
 }
 
+/**
+  * @return The file of the chunk or 'nullptr' if the file has been deleted.
+  */
+File* Chunk::getFile() const
+{
+   return this->file;
+}
+
 QSharedPointer<IDataReader> Chunk::getDataReader()
 {
    return QSharedPointer<IDataReader>(new DataReader(*this));
 }
 
-QSharedPointer<IDataWriter> Chunk::getDataWriter()
+QSharedPointer<IDataWriter> Chunk::getDataWriter(int offset)
 {
-   return QSharedPointer<IDataWriter>(new DataWriter(*this));
+   return QSharedPointer<IDataWriter>(new DataWriter(*this, offset));
 }
 
 void Chunk::newDataWriterCreated()
@@ -189,14 +201,47 @@ void Chunk::setHash(const Common::Hash& hash)
    this->hash = hash;
 }
 
+/**
+  * Called by 'DataWriter' when the chunk has been completed and checked.
+  */
+void Chunk::setAsComplete()
+{
+   if (this->file)
+      this->file->chunkComplete(this);
+}
+
 int Chunk::getKnownBytes() const
 {
+   QMutexLocker locker(&this->mutex);
    return this->knownBytes;
 }
 
+/**
+  * The known blocks after 'bytes' are forgotten.
+  */
 void Chunk::setKnownBytes(int bytes)
 {
+   QMutexLocker locker(&this->mutex);
    this->knownBytes = bytes;
+   this->knownBlocks.clear();
+}
+
+QBitArray Chunk::getKnownBlocks() const
+{
+   const int chunkSize = this->getChunkSize();
+   QBitArray blocks(chunkSize / BLOCK_SIZE + (chunkSize % BLOCK_SIZE == 0 ? 0 : 1));
+
+   QMutexLocker locker(&this->mutex);
+
+   const int nbBlocksKnown = this->knownBytes >= chunkSize ? blocks.size() : this->knownBytes / BLOCK_SIZE;
+   if (nbBlocksKnown > 0)
+      blocks.fill(true, 0, nbBlocksKnown);
+
+   for (int i = nbBlocksKnown; i < blocks.size() && i < this->knownBlocks.size(); i++)
+      if (this->knownBlocks.testBit(i))
+         blocks.setBit(i);
+
+   return blocks;
 }
 
 int Chunk::getChunkSize() const
@@ -214,6 +259,52 @@ int Chunk::getChunkSize() const
       return size;
 }
 
+/**
+  * Update 'knownBytes' and 'knownBlocks' after 'nbBytes' bytes have been written at 'offset'.
+  * A block is known when its end is written, the data before in the block are known, see 'write(..)'.
+  * @return 'true' if the chunk has been completed.
+  */
+bool Chunk::dataWritten(int offset, int nbBytes, int chunkSize)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->knownBytes >= chunkSize)
+      return false;
+
+   if (offset <= this->knownBytes && offset + nbBytes > this->knownBytes)
+      this->knownBytes = offset + nbBytes;
+
+   // The blocks whose end has been written.
+   for (int block = offset / BLOCK_SIZE; block * BLOCK_SIZE < offset + nbBytes; block++)
+   {
+      const int blockEnd = qMin((block + 1) * BLOCK_SIZE, chunkSize);
+      if (blockEnd > offset + nbBytes || blockEnd <= this->knownBytes)
+         continue;
+
+      if (this->knownBlocks.isEmpty())
+         this->knownBlocks.resize(chunkSize / BLOCK_SIZE + (chunkSize % BLOCK_SIZE == 0 ? 0 : 1));
+      this->knownBlocks.setBit(block);
+   }
+
+   // 'knownBytes' skips the known blocks.
+   while (this->knownBytes < chunkSize && this->knownBytes / BLOCK_SIZE < this->knownBlocks.size() && this->knownBlocks.testBit(this->knownBytes / BLOCK_SIZE))
+      this->knownBytes = qMin((this->knownBytes / BLOCK_SIZE + 1) * BLOCK_SIZE, chunkSize);
+
+   if (this->knownBytes > chunkSize) // Should never be true.
+   {
+      L_ERRO("Chunk::dataWritten(..) : this->knownBytes > getChunkSize");
+      this->knownBytes = chunkSize;
+   }
+
+   if (this->knownBytes == chunkSize)
+   {
+      this->knownBlocks.clear();
+      return true;
+   }
+
+   return false;
+}
+
 bool Chunk::isComplete() const
 {
    return this->file && this->knownBytes >= this->getChunkSize(); // Should be '==' but we are never 100% sure ;).
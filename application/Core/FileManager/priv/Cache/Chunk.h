@@ -22,6 +22,8 @@
 #include <exception>
 
 #include <QByteArray>
+#include <QBitArray>
+#include <QMutex>
 
 #include <Protos/files_cache.pb.h>
 
@@ -45,6 +47,8 @@ namespace FM
    {
    public:      
       static int CHUNK_SIZE;
+      static Common::HashAlgorithm HASH_ALGORITHM; ///< The algorithm used to compute the hashes of all the chunks.
+      static int BLOCK_SIZE; ///< The data can be written by blocks of this size in any order, see 'getKnownBlocks()'.
 
       /**
         * Create a new empty chunk.
@@ -64,9 +68,10 @@ namespace FM
       bool populateEntry(Protos::Common::Entry* entry) const;
 
       QString getFilePath() const;
+      File* getFile() const;
 
       QSharedPointer<IDataReader> getDataReader();
-      QSharedPointer<IDataWriter> getDataWriter();
+      QSharedPointer<IDataWriter> getDataWriter(int offset);
 
       void newDataWriterCreated();
       void newDataReaderCreated();
@@ -77,7 +82,9 @@ namespace FM
       void fileDeleted();
 
       inline int read(char* buffer, int offset);
-      inline bool write(const char* buffer, int nbBytes);
+      inline int send(int socketDescriptor, int offset, int maxBytesToSend);
+      inline bool write(const char* buffer, int nbBytes, int offset);
+      void setAsComplete();
 
       int getNum() const;
       int getNbTotalChunk() const;
@@ -89,6 +96,7 @@ namespace FM
 
       int getKnownBytes() const;
       void setKnownBytes(int bytes);
+      QBitArray getKnownBlocks() const;
 
       int getChunkSize() const;
       bool isComplete() const;
@@ -98,9 +106,13 @@ namespace FM
       bool matchesEntry(const Protos::Common::Entry& entry) const;
 
    private:
+      bool dataWritten(int offset, int nbBytes, int chunkSize);
+
       File* file;
       const int num; // First is 0.
       int knownBytes; ///< Relative offset, 0 means we don't have any byte and 'getChunkSize()' means we have all the chunk data.
+      QBitArray knownBlocks; ///< The blocks written after 'knownBytes', empty if there is none. They aren't persisted.
+      mutable QMutex mutex; ///< Protect 'knownBytes' and 'knownBlocks', many 'DataWriter' can write the chunk at the same time.
       Common::Hash hash;
    };
 }
@@ -135,36 +147,52 @@ inline int FM::Chunk::read(char* buffer, int offset)
 }
 
 /**
-  * Write the given buffer after 'knownBytes'.
+  * Send the data of the chunk to the given socket, see 'IDataReader::send(..)'.
+  *
+  * @exception IOErrorException
+  * @exception ChunkDeletedException
+  * @exception ChunkDataUnknownException
+  * @param offset The offset relative to the chunk.
+  */
+inline int FM::Chunk::send(int socketDescriptor, int offset, int maxBytesToSend)
+{
+   if (!this->file)
+      throw ChunkDeletedException();
+
+   if (this->knownBytes == 0)
+      throw ChunkDataUnknownException();
+
+   if (offset >= this->knownBytes)
+      return 0;
+
+   const int bytesRemaining = this->getChunkSize() - offset;
+   return this->file->send(socketDescriptor, offset + static_cast<qint64>(this->num) * CHUNK_SIZE, bytesRemaining >= maxBytesToSend ? maxBytesToSend : bytesRemaining);
+}
+
+/**
+  * Write the given buffer at 'offset'. The data before 'offset' in its block must be known, see 'DataWriter'.
+  * 'setAsComplete()' must be called when the chunk is complete. Nothing is written to a complete chunk, its file may be released.
   * @exception IOErrorException
   * @exception ChunkDeletedException
   * @exception TryToWriteBeyondTheEndOfChunkException
-  * @return 'true' if end of chunk reached.
+  * @return 'true' if the chunk has been completed by this write.
   */
-inline bool FM::Chunk::write(const char* buffer, int nbBytes)
+inline bool FM::Chunk::write(const char* buffer, int nbBytes, int offset)
 {
    if (!this->file)
       throw ChunkDeletedException();
 
    const int CURRENT_CHUNK_SIZE = this->getChunkSize();
 
-   if (this->knownBytes + nbBytes > CURRENT_CHUNK_SIZE)
+   if (offset + nbBytes > CURRENT_CHUNK_SIZE)
       throw TryToWriteBeyondTheEndOfChunkException();
 
-   this->knownBytes += this->file->write(buffer, nbBytes, this->knownBytes + static_cast<qint64>(this->num) * CHUNK_SIZE);
-
-   if (this->knownBytes > CURRENT_CHUNK_SIZE) // Should never be true.
-   {
-      L_ERRO("Chunk::write(..) : this->knownBytes > getChunkSize");
-      this->knownBytes = CURRENT_CHUNK_SIZE;
-   }
-
-   const bool COMPLETE = this->knownBytes == CURRENT_CHUNK_SIZE;
+   if (this->isComplete()) // Completed by another writer.
+      return false;
 
-   if (COMPLETE)
-      this->file->chunkComplete(this);
+   const int bytesWritten = this->file->write(buffer, nbBytes, offset + static_cast<qint64>(this->num) * CHUNK_SIZE);
 
-   return COMPLETE;
+   return this->dataWritten(offset, bytesWritten, CURRENT_CHUNK_SIZE);
 }
 
 #endif
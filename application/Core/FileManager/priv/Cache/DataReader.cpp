@@ -39,3 +39,8 @@ int DataReader::read(char* buffer, uint offset)
 {
    return this->chunk.read(buffer, offset);
 }
+
+int DataReader::send(int socketDescriptor, uint offset, int maxBytesToSend)
+{
+   return this->chunk.send(socketDescriptor, offset, maxBytesToSend);
+}
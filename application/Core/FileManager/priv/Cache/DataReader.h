@@ -33,6 +33,7 @@ namespace FM
       ~DataReader();
 
       int read(char* buffer, uint offset);
+      int send(int socketDescriptor, uint offset, int maxBytesToSend);
 
    protected:
       void run();
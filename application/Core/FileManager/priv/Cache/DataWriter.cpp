@@ -27,14 +27,16 @@ using namespace FM;
 
 /**
   * @remarks The setting "check_received_data_integrity" can be changed at runtime.
+  * @param offset Where the data will be written, see 'IChunk::getDataWriter(..)'.
   * @exception IOErrorException
   * @exception ChunkDeletedException
   * @exception ChunkDataUnknownException
   */
-DataWriter::DataWriter(Chunk& chunk) :
-   CHECK_DATA_INTEGRITY(SETTINGS.get<bool>("check_received_data_integrity")), chunk(chunk)
+DataWriter::DataWriter(Chunk& chunk, int offset) :
+   CHECK_DATA_INTEGRITY(SETTINGS.get<bool>("check_received_data_integrity")), hasher(Chunk::HASH_ALGORITHM), hashedBytes(0), chunk(chunk), offset(offset)
 {
-   this->computeChunkHash();
+   if (this->offset == this->chunk.getKnownBytes())
+      this->computeChunkHash(this->offset);
    this->chunk.newDataWriterCreated();
 }
 
@@ -43,27 +45,45 @@ DataWriter::~DataWriter()
    this->chunk.dataWriterDeleted();
 }
 
+/**
+  * Only the writer which completes the chunk checks its hash. The data written by this writer
+  * are hashed on the fly as long as they follow the hashed ones, the rest is read back from the file.
+  */
 bool DataWriter::write(const char* buffer, int nbBytes)
 {
-   if (this->CHECK_DATA_INTEGRITY)
+   if (this->CHECK_DATA_INTEGRITY && this->hashedBytes == this->offset)
    {
       this->hasher.addData(buffer, nbBytes);
-      if (this->chunk.getKnownBytes() + nbBytes == this->chunk.getChunkSize() && this->hasher.getResult() != this->chunk.getHash())
+      this->hashedBytes += nbBytes;
+   }
+
+   const bool complete = this->chunk.write(buffer, nbBytes, this->offset);
+   this->offset += nbBytes;
+
+   if (complete)
+   {
+      if (this->CHECK_DATA_INTEGRITY)
       {
-         this->chunk.setKnownBytes(0);
-         throw hashMissmatchException();
+         this->computeChunkHash(this->chunk.getChunkSize());
+         if (this->hashedBytes != this->chunk.getChunkSize() || this->hasher.getResult() != this->chunk.getHash())
+         {
+            this->chunk.setKnownBytes(0);
+            throw hashMissmatchException();
+         }
       }
+
+      this->chunk.setAsComplete();
    }
 
-   return this->chunk.write(buffer, nbBytes);
+   return complete;
 }
 
 /**
-  * Compute the hash of the first known data of the current chunk ('this->chunk'), the result is held by 'this->hasher'.
+  * Compute the hash of the known data of the current chunk ('this->chunk') from 'hashedBytes' to 'end', the result is held by 'this->hasher'.
   */
-void DataWriter::computeChunkHash()
+void DataWriter::computeChunkHash(int end)
 {
-   if (this->CHECK_DATA_INTEGRITY && this->chunk.getKnownBytes() > 0)
+   if (this->CHECK_DATA_INTEGRITY && this->hashedBytes < end)
    {
       try
       {
@@ -71,13 +91,13 @@ void DataWriter::computeChunkHash()
          char buffer[BUFFER_SIZE];
 
          DataReader reader(this->chunk);
-         int offset = 0;
          int bytesRead = 0;
 
-         while (bytesRead = reader.read(buffer, offset))
+         while (this->hashedBytes < end && (bytesRead = reader.read(buffer, this->hashedBytes)))
          {
+            bytesRead = qMin(bytesRead, end - this->hashedBytes);
             this->hasher.addData(buffer, bytesRead);
-            offset += bytesRead;
+            this->hashedBytes += bytesRead;
          }
       }
       // If the file can't be read it may be created later.
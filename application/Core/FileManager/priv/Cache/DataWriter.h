@@ -30,18 +30,20 @@ namespace FM
    class DataWriter : public IDataWriter, Common::Uncopyable
    {
    public:
-      DataWriter(Chunk& chunk);
+      DataWriter(Chunk& chunk, int offset);
       ~DataWriter();
 
       bool write(const char* buffer, int nbBytes);
 
    private:
-      void computeChunkHash();
+      void computeChunkHash(int end);
 
       const bool CHECK_DATA_INTEGRITY;
 
       Common::Hasher hasher;
+      int hashedBytes; ///< The data of the chunk from 0 to 'hashedBytes' have been given to 'hasher'.
       Chunk& chunk;
+      int offset; ///< The position of the next write, relative to the chunk.
    };
 }
 
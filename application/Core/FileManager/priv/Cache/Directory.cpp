@@ -21,7 +21,6 @@ using namespace FM;
 
 #include <QDir>
 
-#include <Common/ProtoHelper.h>
 #include <Common/Global.h>
 
 #include <priv/Global.h>
@@ -30,6 +29,7 @@ using namespace FM;
 #include <priv/FileManager.h>
 #include <priv/Cache/File.h>
 #include <priv/Cache/SharedDirectory.h>
+#include <priv/Cache/FileCacheLog.h>
 
 /**
   * @exception UnableToCreateNewDirException (may be thrown only if 'createPhysically' is true).
@@ -84,25 +84,25 @@ void Directory::del(bool invokeDelete)
 }
 
 /**
-  * Retore the hashes from the cache.
+  * Retore the hashes from the cache, the sub directories are also restored.
   * All file which are not complete and not in the cache are physically removed.
   * Only files ending with the setting "unfinished_suffix_term" will be removed.
   * @return The files which have all theirs hashes (complete).
   */
-QList<File*> Directory::restoreFromFileCache(const Protos::FileCache::Hashes::Dir& dir)
+QList<File*> Directory::restoreFromFileCache(const FileCacheLog& fileCache)
 {
    QMutexLocker locker(&this->mutex);
 
    QList<File*> ret;
 
-   if (Common::ProtoHelper::getStr(dir, &Protos::FileCache::Hashes_Dir::name) == this->getName())
-   {
-      // Sub directories . . .
-      for (int i = 0; i < dir.dir_size(); i++)
-         for (QLinkedListIterator<Directory*> d(this->subDirs.getList()); d.hasNext();)
-            ret << d.next()->restoreFromFileCache(dir.dir(i));
+   // Sub directories . . .
+   for (QLinkedListIterator<Directory*> d(this->subDirs.getList()); d.hasNext();)
+      ret << d.next()->restoreFromFileCache(fileCache);
 
-      // . . . And files.
+   // . . . And files.
+   Protos::FileCache::Hashes::Dir dir;
+   if (fileCache.getDir(FileCacheLog::DirKey(this->getRoot()->getId(), this->getRelativePath()), dir))
+   {
       QLinkedList<File*> filesNotInDir = this->files.getList();
       for (int i = 0; i < dir.file_size(); i++)
          for (QLinkedListIterator<File*> j(this->files.getList()); j.hasNext();)
@@ -130,15 +130,15 @@ QList<File*> Directory::restoreFromFileCache(const Protos::FileCache::Hashes::Di
    return ret;
 }
 
+/**
+  * Only the files of this directory are populated, the sub directories have their own record, see 'FileCacheLog'.
+  */
 void Directory::populateHashesDir(Protos::FileCache::Hashes::Dir& dirToFill) const
 {
-   QLinkedList<Directory*> subDirsCopy;
    QLinkedList<File*> filesCopy;
 
    {
       QMutexLocker locker(&this->mutex);
-      Common::ProtoHelper::setStr(dirToFill, &Protos::FileCache::Hashes_Dir::set_name, this->getName());
-      subDirsCopy = this->subDirs.getList();
       filesCopy = this->files.getList();
    }
 
@@ -152,14 +152,9 @@ void Directory::populateHashesDir(Protos::FileCache::Hashes::Dir& dirToFill) con
          f->populateHashesFile(*file);
       }
    }
-
-   for (QLinkedListIterator<Directory*> dir(subDirsCopy); dir.hasNext();)
-   {
-      dir.next()->populateHashesDir(*dirToFill.add_dir());
-   }
 }
 
-void Directory::populateEntry(Protos::Common::Entry* dir, bool setSharedDir) const
+void Directory::populateEntry(Protos::Common::Entry* dir, bool setSharedDir, bool) const
 {
    QMutexLocker locker(&this->mutex);
 
@@ -211,6 +206,9 @@ void Directory::moveInto(Directory* directory)
    this->parent->subDirDeleted(this);
    directory->add(this);
    this->parent = directory;
+
+   locker.unlock();
+   this->cache->onEntryMoved(this);
 }
 
 /**
@@ -244,6 +242,18 @@ QString Directory::getPath() const
    return path;
 }
 
+/**
+  * The path of the directory relative to its shared directory, "/" for a shared directory.
+  * For example "/a/b/" for the directory "b" in "/a/". It's the same as 'File::getPath()' for its files.
+  */
+QString Directory::getRelativePath() const
+{
+   if (!this->parent)
+      return QString('/');
+
+   return this->getPath().append(this->getName()).append('/');
+}
+
 /**
   * We use "this->name" instead of "this->getName()" to improve a bit the performance during searching (See 'QSort(..)' in 'FileManager::find(..)').
   */
@@ -37,6 +37,7 @@ namespace FM
    class File;
    class Cache;
    class SharedDirectory;
+   class FileCacheLog;
 
    class Directory : public Entry
    {
@@ -50,10 +51,10 @@ namespace FM
       virtual ~Directory();
       virtual void del(bool invokeDelete = true);
 
-      QList<File*> restoreFromFileCache(const Protos::FileCache::Hashes::Dir& dir);
+      QList<File*> restoreFromFileCache(const FileCacheLog& fileCache);
       void populateHashesDir(Protos::FileCache::Hashes::Dir& dirToFill) const;
 
-      virtual void populateEntry(Protos::Common::Entry* dir, bool setSharedDir = false) const;
+      virtual void populateEntry(Protos::Common::Entry* dir, bool setSharedDir = false, bool onlyFirstHash = false) const;
 
       virtual void removeUnfinishedFiles();
 
@@ -67,6 +68,7 @@ namespace FM
    public:
       virtual QString getPath() const;
       virtual QString getFullPath() const;
+      QString getRelativePath() const;
       virtual SharedDirectory* getRoot() const;
 
       void rename(const QString& newName);
@@ -47,7 +47,7 @@ void Entry::del(bool invokeDelete)
       QMetaObject::invokeMethod(this->cache, "deleteEntry", Qt::QueuedConnection, Q_ARG(Entry*, this));
 }
 
-void Entry::populateEntry(Protos::Common::Entry* entry, bool setSharedDir) const
+void Entry::populateEntry(Protos::Common::Entry* entry, bool setSharedDir, bool) const
 {
    Common::ProtoHelper::setStr(*entry, &Protos::Common::Entry::set_path, this->getPath());
    Common::ProtoHelper::setStr(*entry, &Protos::Common::Entry::set_name, this->getName());
@@ -41,7 +41,7 @@ namespace FM
       virtual ~Entry();
       virtual void del(bool invokeDelete = true);
 
-      virtual void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false) const;
+      virtual void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false, bool onlyFirstHash = false) const;
       void populateEntrySharedDir(Protos::Common::Entry* entry) const;
 
       Cache* getCache();
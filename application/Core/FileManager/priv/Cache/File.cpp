@@ -25,6 +25,11 @@ using namespace FM;
    #include <WinIoCtl.h>
 #endif
 
+#ifdef Q_OS_LINUX
+   #include <errno.h>
+   #include <sys/sendfile.h>
+#endif
+
 #include <QString>
 #include <QFile>
 
@@ -33,6 +38,7 @@ using namespace FM;
 #include <Common/ProtoHelper.h>
 
 #include <Exceptions.h>
+#include <IDataReader.h>
 #include <priv/Global.h>
 #include <priv/Exceptions.h>
 #include <priv/Log.h>
@@ -166,7 +172,7 @@ bool File::restoreFromFileCache(const Protos::FileCache::Hashes::File& file)
       Common::ProtoHelper::getStr(file, &Protos::FileCache::Hashes_File::filename) == this->getName() &&
          (
             Global::isFileUnfinished(this->getName()) ||
-            (qint64)file.date_last_modified() == this->getDateLastModified().toMSecsSinceEpoch() // We test the date only for finished files.
+            (qint64)file.date_last_modified() / 1000 == this->getDateLastModified().toMSecsSinceEpoch() / 1000 // We test the date only for finished files, to the second like in 'correspondTo(..)'.
           ) &&
       this->chunks.size() == file.chunk_size()
    )
@@ -205,8 +211,10 @@ void File::populateHashesFile(Protos::FileCache::Hashes_File& fileToFill) const
 
 /**
   * Will add the hashes to the entry.
+  * @param onlyFirstHash Only the first chunk is added, it's enough to identify the file in a search result.
+  *  The other hashes can be asked later, see 'IFileManager::getHashes(..)'.
   */
-void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir) const
+void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir, bool onlyFirstHash) const
 {
    QMutexLocker locker(&this->mutex);
 
@@ -215,12 +223,12 @@ void File::populateEntry(Protos::Common::Entry* entry, bool setSharedDir) const
    entry->set_type(Protos::Common::Entry_Type_FILE);
 
    entry->clear_chunk();
-   for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext();)
+   for (QVectorIterator<QSharedPointer<Chunk>> i(this->chunks); i.hasNext() && !(onlyFirstHash && entry->chunk_size() == 1);)
    {
       Common::Hash hash = i.next()->getHash();
       Protos::Common::Hash* protoHash = entry->add_chunk();
       if (!hash.isNull())
-         protoHash->set_hash(hash.getData(), Common::Hash::HASH_SIZE);
+         Common::ProtoHelper::setHash(*protoHash, hash);
    }
 }
 
@@ -237,10 +245,11 @@ bool File::matchesEntry(const Protos::Common::Entry& entry) const
 
 /**
   * Return true if the size and the last modification date correspond to the given file information.
+  * The dates are compared to the second, their precision depends of their source ('QFileInfo' or 'DirScanner').
   */
-bool File::correspondTo(const QFileInfo& fileInfo, bool checkTheDateToo)
+bool File::correspondTo(qint64 size, const QDateTime& dateLastModified, bool checkTheDateToo)
 {
-   return this->getSize() == fileInfo.size() && (!checkTheDateToo || this->getDateLastModified() == fileInfo.lastModified());
+   return this->getSize() == size && (!checkTheDateToo || this->getDateLastModified().toMSecsSinceEpoch() / 1000 == dateLastModified.toMSecsSinceEpoch() / 1000);
 }
 
 QString File::getPath() const
@@ -262,6 +271,11 @@ SharedDirectory* File::getRoot() const
    return this->dir->getRoot();
 }
 
+Directory* File::getDirectory() const
+{
+   return this->dir;
+}
+
 void File::rename(const QString& newName)
 {
    QMutexLocker locker(&this->mutex);
@@ -415,6 +429,43 @@ qint64 File::read(char* buffer, qint64 offset, int maxBytesToRead)
    return bytesRead;
 }
 
+/**
+  * Send the bytes of the file from the given offset to a socket with 'sendfile(..)', see 'IDataReader::send(..)'.
+  * The position of the file isn't used, the lock avoids the file being closed during the sending.
+  * @param maxBytesToSend The number of bytes to send, the kernel may send less.
+  * @return The number of bytes sent, 'IDataReader::WOULD_BLOCK' or 'IDataReader::NOT_SUPPORTED'.
+  */
+int File::send(int socketDescriptor, qint64 offset, int maxBytesToSend)
+{
+#ifdef Q_OS_LINUX
+   QMutexLocker locker(&this->readLock);
+
+   if (!this->fileInReadMode || offset >= this->getSize())
+      return 0;
+
+   off_t fileOffset = offset;
+   const ssize_t bytesSent = ::sendfile(socketDescriptor, this->fileInReadMode->handle(), &fileOffset, maxBytesToSend);
+
+   if (bytesSent == -1)
+   {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+         return IDataReader::WOULD_BLOCK;
+
+      if (errno == EINVAL || errno == ENOSYS) // The file system doesn't support it.
+         return IDataReader::NOT_SUPPORTED;
+
+      throw IOErrorException();
+   }
+
+   return static_cast<int>(bytesSent);
+#else
+   Q_UNUSED(socketDescriptor);
+   Q_UNUSED(offset);
+   Q_UNUSED(maxBytesToSend);
+   return IDataReader::NOT_SUPPORTED;
+#endif
+}
+
 QVector<QSharedPointer<Chunk>> File::getChunks() const
 {
    return this->chunks;
@@ -521,6 +572,9 @@ void File::moveInto(Directory* directory)
    this->dir->fileDeleted(this);
    directory->add(this);
    this->dir = directory;
+
+   locker.unlock();
+   this->cache->onEntryMoved(this);
 }
 
 void File::changeDirectory(Directory* dir)
@@ -68,14 +68,15 @@ namespace FM
       bool restoreFromFileCache(const Protos::FileCache::Hashes::File& file);
       void populateHashesFile(Protos::FileCache::Hashes_File& fileToFill) const;
 
-      void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false) const;
+      void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false, bool onlyFirstHash = false) const;
       bool matchesEntry(const Protos::Common::Entry& entry) const;
 
-      bool correspondTo(const QFileInfo& fileInfo, bool checkTheDateToo = true);
+      bool correspondTo(qint64 size, const QDateTime& dateLastModified, bool checkTheDateToo = true);
 
       QString getPath() const;
       QString getFullPath() const;
       SharedDirectory* getRoot() const;
+      Directory* getDirectory() const;
       void rename(const QString& newName);
       QDateTime getDateLastModified() const;
 
@@ -87,6 +88,7 @@ namespace FM
 
       qint64 write(const char* buffer, int nbBytes, qint64 offset);
       qint64 read(char* buffer, qint64 offset, int maxBytesToRead);
+      int send(int socketDescriptor, qint64 offset, int maxBytesToSend);
 
       QVector<QSharedPointer<Chunk>> getChunks() const;
       bool hasAllHashes();
@@ -0,0 +1,436 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/FileCacheLog.h>
+using namespace FM;
+
+#include <QDataStream>
+
+#include <Common/Global.h>
+#include <Common/PersistentData.h>
+
+#include <priv/Constants.h>
+#include <priv/Log.h>
+
+/**
+  * @class FM::FileCacheLog
+  *
+  * The file cache is persisted as a log of records, a record is appended each time the files of a directory
+  * change thus the whole cache isn't written each time something changes.
+  *
+  * Format of the file (big endian):
+  *  - The version ('FILE_CACHE_VERSION', 32 bits).
+  *  - A list of records:
+  *     - The type of the record ('RecordType', 8 bits).
+  *     - For a directory: the ID of the shared directory (20 bytes), the relative path of the directory (QString
+  *       serialized by QDataStream) and the number of files (32 bits).
+  *     - The size of the message (32 bits) followed by the message ('Protos::FileCache::Hashes' or 'Protos::FileCache::Hashes::Dir').
+  *
+  * The last record of a header or of a directory replaces the previous ones, a directory record without file removes the directory. When the file becomes twice bigger than
+  * its last records it's compacted: the whole cache is written in a new file, see 'startWriting()'.
+  *
+  * At loading the file is mapped in memory and only the headers of the records are read. The messages of the directories
+  * are parsed one by one when the directories are restored, see 'getDir(..)'.
+  * A truncated record at the end of the file (the application has been killed during a writing) is ignored and overwritten.
+  */
+
+namespace
+{
+   const qint64 MIN_SIZE_TO_COMPACT = 1024 * 1024; // [byte].
+   const qint64 MIN_AVAILABLE_DISK_SPACE = 20 * 1024 * 1024; // [byte]. See 'PersistentData::setValueFilepath(..)'.
+}
+
+FileCacheLog::FileCacheLog(const QString& filename) :
+   filename(filename), data(nullptr), size(0), liveSize(0), compacting(false)
+{
+}
+
+FileCacheLog::~FileCacheLog()
+{
+   this->unload();
+}
+
+/**
+  * Map the file and read the headers of the records.
+  * @exception UnknownValueException if the file doesn't exist.
+  * @exception PersistentDataIOException
+  * @return false if the file is corrupted or if its version doesn't match.
+  */
+bool FileCacheLog::load()
+{
+   this->unload();
+   this->dirs.clear();
+   this->headerData.clear();
+   this->size = 0;
+   this->liveSize = 0;
+
+   try
+   {
+      this->filepath = Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + this->filename;
+   }
+   catch (Common::Global::UnableToGetFolder& e)
+   {
+      throw Common::PersistentDataIOException(e.errorMessage);
+   }
+
+   this->file.setFileName(this->filepath);
+   if (!this->file.open(QIODevice::ReadOnly))
+      throw Common::UnknownValueException();
+
+   const qint64 fileSize = this->file.size();
+   if (fileSize == 0 || !(this->data = this->file.map(0, fileSize)))
+   {
+      this->unload();
+      return false;
+   }
+
+   QDataStream stream(QByteArray::fromRawData(reinterpret_cast<const char*>(this->data), fileSize));
+
+   quint32 version;
+   stream >> version;
+   if (stream.status() != QDataStream::Ok || version != static_cast<quint32>(FILE_CACHE_VERSION))
+   {
+      this->unload();
+      return false;
+   }
+
+   bool headerFound = false;
+   qint64 position = sizeof(version);
+
+   forever
+   {
+      quint8 type;
+      stream >> type;
+
+      Common::Hash sharedDirID;
+      QString path;
+      quint32 nbFiles = 0;
+      if (type == DIR)
+      {
+         char hash[Common::Hash::HASH_SIZE];
+         stream.readRawData(hash, Common::Hash::HASH_SIZE);
+         sharedDirID = Common::Hash(hash);
+         stream >> path >> nbFiles;
+      }
+
+      quint32 messageSize;
+      stream >> messageSize;
+
+      const qint64 messageOffset = stream.device()->pos();
+      if (stream.status() != QDataStream::Ok || (type != HEADER && type != DIR) || messageOffset + messageSize > fileSize)
+         break;
+
+      if (type == HEADER)
+      {
+         if (!this->header.ParseFromArray(this->data + messageOffset, messageSize))
+            break;
+         this->headerData = QByteArray(reinterpret_cast<const char*>(this->data + messageOffset), messageSize);
+         headerFound = true;
+      }
+      else
+      {
+         const Record record = { messageOffset, static_cast<int>(messageSize), static_cast<int>(messageOffset - position), static_cast<int>(nbFiles) };
+         this->setRecord(DirKey(sharedDirID, path), record);
+      }
+
+      stream.skipRawData(messageSize);
+      position = messageOffset + messageSize;
+   }
+
+   if (!headerFound)
+   {
+      this->unload();
+      this->dirs.clear();
+      return false;
+   }
+
+   this->size = position;
+   if (this->size < fileSize)
+      L_WARN(QString("The file cache \"%1\" contains a truncated record, it will be overwritten").arg(this->filepath));
+
+   return true;
+}
+
+/**
+  * Release the mapped file, 'getDir(..)' can't be used anymore.
+  */
+void FileCacheLog::unload()
+{
+   if (this->data)
+   {
+      this->file.unmap(this->data);
+      this->data = nullptr;
+   }
+   this->file.close();
+}
+
+const Protos::FileCache::Hashes& FileCacheLog::getHeader() const
+{
+   return this->header;
+}
+
+/**
+  * The total number of files in the last records of the directories.
+  */
+int FileCacheLog::getNbFiles() const
+{
+   int nbFiles = 0;
+   for (QHashIterator<DirKey, Record> i(this->dirs); i.hasNext();)
+      nbFiles += i.next().value().nbFiles;
+   return nbFiles;
+}
+
+/**
+  * Parse the last record of the given directory.
+  * @return false if the directory doesn't exist or if the file isn't loaded.
+  */
+bool FileCacheLog::getDir(const DirKey& key, Protos::FileCache::Hashes::Dir& dir) const
+{
+   if (!this->data)
+      return false;
+
+   QHash<DirKey, Record>::const_iterator i = this->dirs.find(key);
+   if (i == this->dirs.end())
+      return false;
+
+   return dir.ParseFromArray(this->data + i.value().offset, i.value().size);
+}
+
+/**
+  * Open the file to append some records or, if a compaction is needed, to write the whole cache in a new file.
+  * In the second case all the directories must be written.
+  * @exception PersistentDataIOException
+  * @return true if the file is compacted, all the directories must be written.
+  */
+bool FileCacheLog::startWriting()
+{
+   this->unload();
+
+   try
+   {
+      this->filepath = Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL) + '/' + this->filename;
+
+      if (Common::Global::availableDiskSpace(Common::Global::getDataFolder(Common::Global::DataFolderType::LOCAL)) < MIN_AVAILABLE_DISK_SPACE)
+         throw Common::PersistentDataIOException(QString("Not enough disk space to write the file cache: %1").arg(this->filepath));
+   }
+   catch (Common::Global::UnableToGetFolder& e)
+   {
+      throw Common::PersistentDataIOException(e.errorMessage);
+   }
+
+   this->compacting = this->isCompactionNeeded();
+
+   if (this->compacting)
+   {
+      this->dirs.clear();
+      this->headerData.clear();
+      this->liveSize = 0;
+      this->size = 0;
+
+      this->file.setFileName(this->filepath + ".temp");
+      if (!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+         throw Common::PersistentDataIOException(QString("Unable to open the file in write mode : %1, error : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+
+      QDataStream stream(&this->file);
+      stream << static_cast<quint32>(FILE_CACHE_VERSION);
+      this->size = sizeof(quint32);
+   }
+   else
+   {
+      this->file.setFileName(this->filepath);
+      if (!this->file.open(QIODevice::ReadWrite))
+         throw Common::PersistentDataIOException(QString("Unable to open the file in write mode : %1, error : %2").arg(this->filepath).arg(this->file.errorString()));
+
+      // A truncated record is removed.
+      if (this->file.size() != this->size && !this->file.resize(this->size))
+         throw Common::PersistentDataIOException(QString("Unable to truncate the file : %1, error : %2").arg(this->filepath).arg(this->file.errorString()));
+      this->file.seek(this->size);
+   }
+
+   return this->compacting;
+}
+
+/**
+  * The header is written only if it has changed since the last time.
+  * @exception PersistentDataIOException
+  */
+void FileCacheLog::writeHeader(const Protos::FileCache::Hashes& header)
+{
+   QByteArray headerData(header.ByteSize(), 0);
+   header.SerializeToArray(headerData.data(), headerData.size());
+   if (headerData == this->headerData)
+      return;
+
+   this->write(nullptr, 0, header);
+   this->header = header;
+   this->headerData = headerData;
+}
+
+/**
+  * @exception PersistentDataIOException
+  */
+void FileCacheLog::writeDir(const DirKey& key, const Protos::FileCache::Hashes::Dir& dir)
+{
+   this->write(&key, dir.file_size(), dir);
+}
+
+/**
+  * @exception PersistentDataIOException
+  */
+void FileCacheLog::finishWriting()
+{
+   const bool flushed = this->file.flush();
+   this->file.close();
+
+   if (!flushed)
+   {
+      this->size = 0; // The whole cache will be written next time.
+      throw Common::PersistentDataIOException(QString("Unable to write the file cache : %1").arg(this->file.fileName()));
+   }
+
+   if (this->compacting)
+   {
+      this->compacting = false;
+      if (!Common::Global::rename(this->filepath + ".temp", this->filepath))
+      {
+         this->size = 0;
+         throw Common::PersistentDataIOException(QString("Unable to rename the file cache : %1").arg(this->filepath));
+      }
+   }
+}
+
+/**
+  * Called after an error during the writing, the whole cache will be written next time.
+  */
+void FileCacheLog::abortWriting()
+{
+   this->file.close();
+   this->compacting = false;
+   this->size = 0;
+}
+
+/**
+  * Return the directories which have a record but don't exist anymore (removed, renamed or moved).
+  * An empty record must be written for each of them with 'writeDir(..)' otherwise they are restored by the next loading.
+  */
+QList<FileCacheLog::DirKey> FileCacheLog::getUnknownDirs(const std::function<bool(const DirKey&)>& isKnown) const
+{
+   QList<DirKey> unknownDirs;
+   for (QHashIterator<DirKey, Record> i(this->dirs); i.hasNext();)
+   {
+      i.next();
+      if (!isKnown(i.key()))
+         unknownDirs << i.key();
+   }
+   return unknownDirs;
+}
+
+/**
+  * Forget the records of the directories which don't exist anymore (removed, renamed or moved).
+  * Their records are still in the file but will be removed by the next compaction.
+  */
+void FileCacheLog::removeUnknownDirs(const std::function<bool(const DirKey&)>& isKnown)
+{
+   for (QMutableHashIterator<DirKey, Record> i(this->dirs); i.hasNext();)
+   {
+      i.next();
+      if (!isKnown(i.key()))
+      {
+         this->liveSize -= i.value().headerSize + i.value().size;
+         i.remove();
+      }
+   }
+}
+
+/**
+  * Return true if the file doesn't exist or is corrupted or is too big compared to its last records.
+  */
+bool FileCacheLog::isCompactionNeeded() const
+{
+   return this->size == 0 || this->size > 2 * this->liveSize + MIN_SIZE_TO_COMPACT;
+}
+
+void FileCacheLog::remove()
+{
+   this->unload();
+   this->dirs.clear();
+   this->headerData.clear();
+   this->size = 0;
+   this->liveSize = 0;
+
+   if (!this->filepath.isEmpty())
+      QFile::remove(this->filepath);
+}
+
+/**
+  * @param key The directory or 'nullptr' for a header.
+  * @exception PersistentDataIOException
+  */
+void FileCacheLog::write(const DirKey* key, int nbFiles, const google::protobuf::Message& message)
+{
+   const int messageSize = message.ByteSize();
+
+   QByteArray buffer;
+   {
+      QDataStream stream(&buffer, QIODevice::WriteOnly);
+      stream << static_cast<quint8>(key ? DIR : HEADER);
+      if (key)
+      {
+         stream.writeRawData(key->first.getData(), Common::Hash::HASH_SIZE);
+         stream << key->second << static_cast<quint32>(nbFiles);
+      }
+      stream << static_cast<quint32>(messageSize);
+   }
+
+   const int headerSize = buffer.size();
+   buffer.resize(headerSize + messageSize);
+   message.SerializeToArray(buffer.data() + headerSize, messageSize);
+
+   if (this->file.write(buffer) != buffer.size())
+   {
+      this->size = 0; // The whole cache will be written next time.
+      throw Common::PersistentDataIOException(QString("Unable to write the file cache : %1, error : %2").arg(this->file.fileName()).arg(this->file.errorString()));
+   }
+
+   if (key)
+   {
+      const Record record = { this->size + headerSize, messageSize, headerSize, nbFiles };
+      this->setRecord(*key, record);
+   }
+
+   this->size += buffer.size();
+}
+
+/**
+  * A record without file removes the directory.
+  */
+void FileCacheLog::setRecord(const DirKey& key, const Record& record)
+{
+   QHash<DirKey, Record>::iterator i = this->dirs.find(key);
+   if (i != this->dirs.end())
+   {
+      this->liveSize -= i.value().headerSize + i.value().size;
+      this->dirs.erase(i);
+   }
+
+   if (record.nbFiles > 0)
+   {
+      this->dirs.insert(key, record);
+      this->liveSize += record.headerSize + record.size;
+   }
+}
@@ -0,0 +1,98 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_FILECACHELOG_H
+#define FILEMANAGER_FILECACHELOG_H
+
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QList>
+
+#include <functional>
+
+#include <Protos/files_cache.pb.h>
+
+#include <Common/Hash.h>
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class FileCacheLog : Common::Uncopyable
+   {
+   public:
+      typedef QPair<Common::Hash, QString> DirKey; ///< The ID of the shared directory and the relative path of the directory, see 'Directory::getRelativePath()'.
+
+      FileCacheLog(const QString& filename);
+      ~FileCacheLog();
+
+      bool load();
+      void unload();
+
+      const Protos::FileCache::Hashes& getHeader() const;
+      int getNbFiles() const;
+      bool getDir(const DirKey& key, Protos::FileCache::Hashes::Dir& dir) const;
+
+      bool startWriting();
+      void writeHeader(const Protos::FileCache::Hashes& header);
+      void writeDir(const DirKey& key, const Protos::FileCache::Hashes::Dir& dir);
+      void finishWriting();
+      void abortWriting();
+
+      QList<DirKey> getUnknownDirs(const std::function<bool(const DirKey&)>& isKnown) const;
+      void removeUnknownDirs(const std::function<bool(const DirKey&)>& isKnown);
+      bool isCompactionNeeded() const;
+
+      void remove();
+
+   private:
+      enum RecordType
+      {
+         HEADER = 1,
+         DIR = 2
+      };
+
+      struct Record
+      {
+         qint64 offset; // Position of the message in the file.
+         int size; // Size of the message.
+         int headerSize; // Size of the record without its message.
+         int nbFiles;
+      };
+
+      void write(const DirKey* key, int nbFiles, const google::protobuf::Message& message);
+      void setRecord(const DirKey& key, const Record& record);
+
+      const QString filename;
+      QString filepath;
+
+      QFile file;
+      uchar* data; // The mapped file, only during the loading.
+
+      Protos::FileCache::Hashes header;
+      QByteArray headerData; // The last written header, to avoid to write it again if nothing has changed.
+      QHash<DirKey, Record> dirs; // The last record of each directory.
+
+      qint64 size; // The size of the valid records, a truncated record is overwritten by the next writing.
+      qint64 liveSize; // The size of the last records of each directory, headers included.
+      bool compacting; // Set by 'startWriting()' when the whole cache must be written in a new file.
+   };
+}
+
+#endif
@@ -46,6 +46,10 @@ FileHasher::FileHasher() :
    hashing(false),
    toStopHashing(false)
 {
+   // See the settings 'read_ahead_buffer_size' and 'number_of_read_ahead_buffers'.
+   const int nbReadAheadBuffers = SETTINGS.get<quint32>("number_of_read_ahead_buffers");
+   if (nbReadAheadBuffers > 0)
+      this->readAheadReader.reset(new ReadAheadReader(SETTINGS.get<quint32>("read_ahead_buffer_size"), nbReadAheadBuffers));
 }
 
 /**
@@ -54,12 +58,16 @@ FileHasher::FileHasher() :
   * This method can be called from an another thread than the main one. For example,
   * from 'FileUpdated' thread.
   *
+  * Many 'FileHasher' may work on the same file at the same time as long as they don't hash the same chunk
+  * and only one of them hash the last chunk (see 'FileHasherPool').
+  *
   * @param fileCache The file to hash.
   * @param n Number of hashes to compute, 0 if we want to compute all the hashes.
   * @param[out] amountHashed Write the number of bytes hashed. It may be a null pointer ('nullptr') if this information isn't needed.
+  * @param firstChunk The number of the first chunk to hash. If -1 the already known hashes at the begining of the file are skipped.
   * @exception IOErrorException Thrown when the file cannot be opened or read. Some chunk may be computed before this exception is thrown.
   */
-bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
+bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed, int firstChunk)
 {
    QMutexLocker locker(&this->hashingMutex);
 
@@ -78,7 +86,8 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
 
    const QString& filePath = this->currentFileCache->getFullPath();
 
-   L_USER(tr("Computing hashes of %1 . . .").arg(filePath));
+   if (firstChunk <= 0)
+      L_USER(tr("Computing hashes of %1 . . .").arg(filePath));
 
    // Same performance with or without "QIODevice::Unbuffered".
    AutoReleasedFile file(FileHasher::filePool, filePath, QIODevice::ReadOnly | QIODevice::Unbuffered, this->currentFileCache->getSize() <= Chunk::CHUNK_SIZE);
@@ -96,17 +105,26 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
 
    const QVector<QSharedPointer<Chunk>>& chunks = this->currentFileCache->getChunks();
 
-   // Skip the already known full hashes.
    qint64 bytesSkipped = 0;
    int chunkNum = 0;
-   while (
-      chunkNum < chunks.size() &&
-      chunks[chunkNum]->hasHash() &&
-      chunks[chunkNum]->getKnownBytes() == Chunk::CHUNK_SIZE) // Maybe the file has grown and the last chunk must be recomputed.
+   if (firstChunk >= 0)
    {
-      bytesSkipped += Chunk::CHUNK_SIZE;
-      chunkNum++;
-      file->seek(file->pos() + Chunk::CHUNK_SIZE);
+      chunkNum = firstChunk;
+      bytesSkipped = static_cast<qint64>(firstChunk) * Chunk::CHUNK_SIZE;
+      file->seek(bytesSkipped);
+   }
+   else
+   {
+      // Skip the already known full hashes.
+      while (
+         chunkNum < chunks.size() &&
+         chunks[chunkNum]->hasHash() &&
+         chunks[chunkNum]->getKnownBytes() == Chunk::CHUNK_SIZE) // Maybe the file has grown and the last chunk must be recomputed.
+      {
+         bytesSkipped += Chunk::CHUNK_SIZE;
+         chunkNum++;
+         file->seek(file->pos() + Chunk::CHUNK_SIZE);
+      }
    }
 
 #if DEBUG
@@ -117,7 +135,10 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
    static const int BUFFER_SIZE = SETTINGS.get<quint32>("buffer_size_reading");
    char buffer[BUFFER_SIZE];
 
-   Common::Hasher hasher;
+   // If the read-ahead is enabled the file is read by 'readAheadReader' in its own thread, only the 'n' chunks to hash are read.
+   AutoStoppedReading reading(this->readAheadReader.data(), *file, Chunk::CHUNK_SIZE, n > 0 ? file->pos() + static_cast<qint64>(n) * Chunk::CHUNK_SIZE : -1);
+
+   Common::Hasher hasher(Chunk::HASH_ALGORITHM);
    bool endOfFile = false;
    qint64 bytesReadTotal = 0;
 
@@ -140,22 +161,28 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
             return false;
          }
 
+         const char* data = buffer;
          int bytesRead = 0;
          {
-            Common::FileLocker fileLocker(*file, BUFFER_SIZE, Common::FileLocker::READ);
-            if (!fileLocker.isLocked())
+            if (this->readAheadReader)
+            {
+               bytesRead = this->readAheadReader->read(data);
+            }
+            else
             {
+               Common::FileLocker fileLocker(*file, BUFFER_SIZE, Common::FileLocker::READ);
+               bytesRead = fileLocker.isLocked() ? file->read(buffer, BUFFER_SIZE) : ReadAheadReader::LOCK_ERROR;
+            }
+
+            switch (bytesRead)
+            {
+            case ReadAheadReader::LOCK_ERROR:
                this->toStopHashing = false;
                this->hashing = false;
                this->currentFileCache = 0;
                L_WARN(QString("Unable to acquire the lock for this file : %1").arg(filePath));
                throw IOErrorException();
-            }
-
-            bytesRead = file->read(buffer, BUFFER_SIZE);
-            switch (bytesRead)
-            {
-            case -1:
+            case ReadAheadReader::READ_ERROR:
                this->toStopHashing = false;
                this->hashing = false;
                this->currentFileCache = 0;
@@ -168,7 +195,10 @@ bool FileHasher::start(FileForHasher* fileCache, int n, int* amountHashed)
             }
          }
 
-         hasher.addData(buffer, bytesRead);
+         hasher.addData(data, bytesRead);
+
+         if (this->readAheadReader)
+            this->readAheadReader->releaseData();
 
          bytesReadChunk += bytesRead;
       }
@@ -22,10 +22,12 @@
 #include <QObject>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QScopedPointer>
 
 #include <Common/Uncopyable.h>
 
 #include <priv/Cache/FilePool.h>
+#include <priv/Cache/ReadAheadReader.h>
 
 namespace FM
 {
@@ -38,7 +40,7 @@ namespace FM
    public:
       FileHasher();
 
-      bool start(FileForHasher* fileCache, int n = 0, int* amountHashed = nullptr);
+      bool start(FileForHasher* fileCache, int n = 0, int* amountHashed = nullptr, int firstChunk = -1);
       void stop();
 
    private slots:
@@ -54,6 +56,8 @@ namespace FM
       QWaitCondition hashingStopped;
       QMutex hashingMutex;
 
+      QScopedPointer<ReadAheadReader> readAheadReader; ///< Null if the read-ahead is disabled.
+
       static FilePool filePool;
    };
 }
@@ -0,0 +1,243 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/FileHasherPool.h>
+using namespace FM;
+
+#include <QMutexLocker>
+
+#include <Exceptions.h>
+#include <priv/Log.h>
+#include <priv/Cache/File.h>
+
+/**
+  * @class FM::FileHasherPool
+  *
+  * A set of threads, each one owning a 'FileHasher'. A job is the hashing of one chunk of a file,
+  * thus many files or many chunks of the same file can be hashed at the same time.
+  *
+  * The owner (see 'FileUpdater::computeSomeHashes()') gives a job to an idle worker with 'hash(..)'
+  * and then waits the results with 'waitResult()'. It's up to the owner to not give the same chunk
+  * twice and to hash the last chunk of a file only when no other chunk of this file is being hashed, because
+  * the last chunk can add or remove some chunks to the file if its size has changed.
+  */
+
+FileHasherPool::FileHasherPool(int nbThreads)
+{
+   for (int i = 0; i < nbThreads; i++)
+      this->workers << new Worker(this);
+}
+
+FileHasherPool::~FileHasherPool()
+{
+   this->stop();
+
+   foreach (Worker* worker, this->workers)
+      delete worker;
+}
+
+int FileHasherPool::getNbThreads() const
+{
+   return this->workers.size();
+}
+
+bool FileHasherPool::hasAnIdleWorker() const
+{
+   QMutexLocker locker(&this->mutex);
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+      if (i.next()->isIdle())
+         return true;
+   return false;
+}
+
+/**
+  * Return the number of worker currently hashing plus the number of results not yet retrieved with 'waitResult()'.
+  */
+int FileHasherPool::getNbActiveWorkers() const
+{
+   QMutexLocker locker(&this->mutex);
+   int n = this->results.size();
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+      if (!i.next()->isIdle())
+         n++;
+   return n;
+}
+
+bool FileHasherPool::isHashing(File* file) const
+{
+   QMutexLocker locker(&this->mutex);
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+      if (i.next()->getFile() == file)
+         return true;
+   return false;
+}
+
+bool FileHasherPool::isHashing(File* file, int chunkNum) const
+{
+   QMutexLocker locker(&this->mutex);
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+   {
+      Worker* worker = i.next();
+      if (worker->getFile() == file && worker->getChunkNum() == chunkNum)
+         return true;
+   }
+   return false;
+}
+
+/**
+  * Give the chunk 'chunkNum' of 'file' to an idle worker.
+  * Do nothing if all the workers are busy, see 'hasAnIdleWorker()'.
+  */
+void FileHasherPool::hash(File* file, int chunkNum)
+{
+   QMutexLocker locker(&this->mutex);
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+   {
+      Worker* worker = i.next();
+      if (worker->isIdle())
+      {
+         worker->hash(file, chunkNum);
+         return;
+      }
+   }
+}
+
+/**
+  * Wait until a worker has finished its job and return its result.
+  * Must not be called if 'getNbActiveWorkers()' returns 0.
+  */
+FileHasherPool::Result FileHasherPool::waitResult()
+{
+   QMutexLocker locker(&this->mutex);
+   while (this->results.isEmpty())
+      this->resultAdded.wait(&this->mutex);
+   return this->results.takeFirst();
+}
+
+/**
+  * Stop all the current hashing processes, the workers will return a result as soon as possible.
+  * If a worker is idle its next hashing process will be stopped, see 'FileHasher::stop()'.
+  */
+void FileHasherPool::stop()
+{
+   // The mutex must not be locked here because a worker needs it to give its result.
+   foreach (Worker* worker, this->workers)
+      worker->stopHashing();
+}
+
+void FileHasherPool::workerFinished(const Result& result)
+{
+   this->results << result;
+   this->resultAdded.wakeOne();
+}
+
+/////
+
+FileHasherPool::Worker::Worker(FileHasherPool* pool) :
+   pool(pool),
+   file(nullptr),
+   chunkNum(0),
+   toStop(false)
+{
+   this->start();
+}
+
+FileHasherPool::Worker::~Worker()
+{
+   this->pool->mutex.lock();
+   this->toStop = true;
+   this->jobAdded.wakeOne();
+   this->pool->mutex.unlock();
+
+   this->wait();
+}
+
+/**
+  * The pool mutex must be locked.
+  */
+void FileHasherPool::Worker::hash(File* file, int chunkNum)
+{
+   this->file = file;
+   this->chunkNum = chunkNum;
+   this->jobAdded.wakeOne();
+}
+
+void FileHasherPool::Worker::stopHashing()
+{
+   this->fileHasher.stop();
+}
+
+/**
+  * The pool mutex must be locked.
+  */
+bool FileHasherPool::Worker::isIdle() const
+{
+   return !this->file;
+}
+
+/**
+  * The pool mutex must be locked.
+  */
+File* FileHasherPool::Worker::getFile() const
+{
+   return this->file;
+}
+
+/**
+  * The pool mutex must be locked.
+  */
+int FileHasherPool::Worker::getChunkNum() const
+{
+   return this->chunkNum;
+}
+
+void FileHasherPool::Worker::run()
+{
+   QString threadName = "FileHasher";
+#if DEBUG
+   threadName.append("_").append(QString::number((intptr_t)QThread::currentThreadId()));
+#endif
+   QThread::currentThread()->setObjectName(threadName);
+
+   QMutexLocker locker(&this->pool->mutex);
+
+   forever
+   {
+      while (!this->file && !this->toStop)
+         this->jobAdded.wait(&this->pool->mutex);
+
+      if (this->toStop)
+         return;
+
+      Result result { this->file, this->chunkNum, 0, false, false };
+      locker.unlock();
+
+      try
+      {
+         result.lastChunkHashed = this->fileHasher.start(result.file->asFileForHasher(), 1, &result.amountHashed, result.chunkNum);
+      }
+      catch (IOErrorException&)
+      {
+         result.error = true;
+      }
+
+      locker.relock();
+      this->file = nullptr;
+      this->pool->workerFinished(result);
+   }
+}
@@ -0,0 +1,99 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_FILEHASHERPOOL_H
+#define FILEMANAGER_FILEHASHERPOOL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+#include <Common/Uncopyable.h>
+
+#include <priv/Cache/FileHasher.h>
+
+namespace FM
+{
+   class File;
+
+   class FileHasherPool : Common::Uncopyable
+   {
+   public:
+      struct Result
+      {
+         File* file;
+         int chunkNum;
+         int amountHashed;
+         bool lastChunkHashed; ///< 'true' if the last chunk has been hashed and the size of the file didn't change.
+         bool error; ///< 'true' if the file cannot be opened or read.
+      };
+
+      FileHasherPool(int nbThreads);
+      ~FileHasherPool();
+
+      int getNbThreads() const;
+      bool hasAnIdleWorker() const;
+      int getNbActiveWorkers() const;
+      bool isHashing(File* file) const;
+      bool isHashing(File* file, int chunkNum) const;
+
+      void hash(File* file, int chunkNum);
+      Result waitResult();
+
+      void stop();
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(FileHasherPool* pool);
+         ~Worker();
+
+         void hash(File* file, int chunkNum);
+         void stopHashing();
+
+         bool isIdle() const;
+         File* getFile() const;
+         int getChunkNum() const;
+
+      protected:
+         void run();
+
+      private:
+         FileHasherPool* pool;
+         FileHasher fileHasher;
+
+         File* file; ///< The file currently hashed, 'nullptr' if the worker is idle.
+         int chunkNum;
+         bool toStop;
+
+         QWaitCondition jobAdded;
+      };
+
+      void workerFinished(const Result& result);
+
+      QList<Worker*> workers;
+      QList<Result> results;
+
+      mutable QMutex mutex; ///< Protect the state of the workers and 'results'.
+      QWaitCondition resultAdded;
+   };
+}
+
+#endif
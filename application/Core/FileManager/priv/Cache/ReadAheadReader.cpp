@@ -0,0 +1,190 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/Cache/ReadAheadReader.h>
+using namespace FM;
+
+#if defined(Q_OS_LINUX)
+   #include <fcntl.h>
+#endif
+
+#include <QMutexLocker>
+
+#include <Common/FileLocker.h>
+
+/**
+  * @class FM::ReadAheadReader
+  *
+  * A thread which reads a file in advance into a ring of buffers while the data
+  * of the previous buffers are consumed by another thread. Used by 'FileHasher' to
+  * overlap the disk latency with the time spent computing the hashes.
+  *
+  * The owner calls 'startReading(..)' then 'read(..)' + 'releaseData()' for each buffer and
+  * finally 'stopReading()' before releasing the file. 'AutoStoppedReading' can be used to
+  * be sure 'stopReading()' is always called.
+  */
+
+/**
+  * The buffers are aligned on a memory page to help the system to avoid copies.
+  */
+ReadAheadReader::ReadAheadReader(int bufferSize, int nbBuffers) :
+   bufferSize(bufferSize),
+   buffers(nbBuffers),
+   bytesInBuffers(nbBuffers),
+   file(nullptr),
+   pos(0),
+   end(-1),
+   blockSize(0),
+   readIndex(0),
+   nbFilledBuffers(0),
+   endReached(false),
+   reading(false),
+   toStop(false)
+{
+   for (int i = 0; i < this->buffers.size(); i++)
+      this->buffers[i] = static_cast<char*>(qMallocAligned(this->bufferSize, 4096));
+
+   this->start();
+}
+
+ReadAheadReader::~ReadAheadReader()
+{
+   this->stopReading();
+
+   this->mutex.lock();
+   this->toStop = true;
+   this->bufferReleased.wakeOne();
+   this->mutex.unlock();
+
+   this->wait();
+
+   for (int i = 0; i < this->buffers.size(); i++)
+      qFreeAligned(this->buffers[i]);
+}
+
+/**
+  * Begin to fill the buffers from the current position of the given file.
+  * @param blockSize A read never crosses a multiple of this value, it's used to not mix two chunks in the same buffer.
+  * @param end The position where the reading stops, 'read(..)' then returns 0 like at the end of the file. -1 to read the whole file.
+  */
+void ReadAheadReader::startReading(QFile& file, int blockSize, qint64 end)
+{
+#if defined(Q_OS_LINUX)
+   posix_fadvise(file.handle(), file.pos(), end >= 0 ? end - file.pos() : 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+   QMutexLocker locker(&this->mutex);
+   this->file = &file;
+   this->pos = file.pos();
+   this->end = end;
+   this->blockSize = blockSize;
+   this->readIndex = 0;
+   this->nbFilledBuffers = 0;
+   this->endReached = false;
+   this->bufferReleased.wakeOne();
+}
+
+/**
+  * Wait for the next buffer to be filled. 'releaseData()' must be called once the data has been consumed.
+  * @param[out] data A pointer to the read data.
+  * @return The number of bytes read, 0 if the end of file is reached, 'READ_ERROR' or 'LOCK_ERROR' if the file can't be read.
+  */
+int ReadAheadReader::read(const char*& data)
+{
+   QMutexLocker locker(&this->mutex);
+   while (this->nbFilledBuffers == 0)
+      this->bufferFilled.wait(&this->mutex);
+
+   data = this->buffers[this->readIndex];
+   return this->bytesInBuffers[this->readIndex];
+}
+
+void ReadAheadReader::releaseData()
+{
+   QMutexLocker locker(&this->mutex);
+   if (this->nbFilledBuffers == 0)
+      return;
+
+   this->readIndex = (this->readIndex + 1) % this->buffers.size();
+   this->nbFilledBuffers--;
+   this->bufferReleased.wakeOne();
+}
+
+/**
+  * Abort the current reading and wait until the file isn't used anymore by the reader thread.
+  */
+void ReadAheadReader::stopReading()
+{
+   QMutexLocker locker(&this->mutex);
+   this->file = nullptr;
+   while (this->reading)
+      this->readingStopped.wait(&this->mutex);
+}
+
+void ReadAheadReader::run()
+{
+   QMutexLocker locker(&this->mutex);
+
+   forever
+   {
+      while (!this->toStop && (!this->file || this->endReached || this->nbFilledBuffers == this->buffers.size()))
+         this->bufferReleased.wait(&this->mutex);
+
+      if (this->toStop)
+         return;
+
+      QFile* file = this->file;
+      const int index = (this->readIndex + this->nbFilledBuffers) % this->buffers.size();
+      const qint64 bytesRemainingInBlock = this->blockSize - this->pos % this->blockSize;
+      int bytesToRead = bytesRemainingInBlock < this->bufferSize ? bytesRemainingInBlock : this->bufferSize;
+      if (this->end >= 0 && this->end - this->pos < bytesToRead)
+         bytesToRead = this->end - this->pos;
+
+      this->reading = true;
+      locker.unlock();
+
+      int bytesRead = 0;
+      if (bytesToRead > 0)
+      {
+         Common::FileLocker fileLocker(*file, bytesToRead, Common::FileLocker::READ);
+         if (!fileLocker.isLocked())
+            bytesRead = LOCK_ERROR;
+         else
+            bytesRead = file->read(this->buffers[index], bytesToRead);
+      }
+
+      locker.relock();
+      this->reading = false;
+
+      if (this->file != file) // The reading has been stopped in the meantime.
+      {
+         this->readingStopped.wakeAll();
+         continue;
+      }
+
+      this->bytesInBuffers[index] = bytesRead < 0 ? (bytesRead == LOCK_ERROR ? LOCK_ERROR : READ_ERROR) : bytesRead;
+      this->nbFilledBuffers++;
+
+      if (bytesRead <= 0)
+         this->endReached = true;
+      else
+         this->pos += bytesRead;
+
+      this->bufferFilled.wakeOne();
+   }
+}
@@ -0,0 +1,88 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_READAHEADREADER_H
+#define FILEMANAGER_READAHEADREADER_H
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class ReadAheadReader : public QThread, Common::Uncopyable
+   {
+   public:
+      static const int READ_ERROR = -1;
+      static const int LOCK_ERROR = -2;
+
+      ReadAheadReader(int bufferSize, int nbBuffers);
+      ~ReadAheadReader();
+
+      void startReading(QFile& file, int blockSize, qint64 end = -1);
+      int read(const char*& data);
+      void releaseData();
+      void stopReading();
+
+   protected:
+      void run();
+
+   private:
+      const int bufferSize;
+      QVector<char*> buffers;
+      QVector<int> bytesInBuffers;
+
+      QFile* file; ///< The file being read, 'nullptr' if there is no reading.
+      qint64 pos;
+      qint64 end; ///< The reading stops at this position, -1 means the end of the file.
+      int blockSize;
+
+      int readIndex; ///< The next buffer given by 'read(..)'.
+      int nbFilledBuffers;
+      bool endReached; ///< Set when the end of file or an error is reached, the reader waits for 'stopReading()'.
+      bool reading; ///< 'true' while the reader thread is reading the file without holding the mutex.
+      bool toStop;
+
+      QMutex mutex;
+      QWaitCondition bufferFilled;
+      QWaitCondition bufferReleased; ///< Also used to wake up the reader when a new reading is started.
+      QWaitCondition readingStopped;
+   };
+
+   /**
+     * Little helper to stop the reading when going out of scope, see 'AutoReleasedFile'.
+     * The reader may be a null pointer, in this case nothing is done.
+     */
+   class AutoStoppedReading
+   {
+   public:
+      AutoStoppedReading(ReadAheadReader* reader, QFile& file, int blockSize, qint64 end = -1) :
+         reader(reader) { if (this->reader) this->reader->startReading(file, blockSize, end); }
+
+      ~AutoStoppedReading() { if (this->reader) this->reader->stopReading(); }
+
+   private:
+      ReadAheadReader* reader;
+   };
+}
+
+#endif
@@ -74,7 +74,7 @@ void SharedDirectory::mergeSubSharedDirectories()
    }
 }
 
-void SharedDirectory::populateEntry(Protos::Common::Entry* entry, bool setSharedDir) const
+void SharedDirectory::populateEntry(Protos::Common::Entry* entry, bool setSharedDir, bool) const
 {
    // The 'shared_dir' field is always filled for a 'SharedDirectory', it doesn't depend of 'setSharedDir'.
    Directory::populateEntry(entry, true);
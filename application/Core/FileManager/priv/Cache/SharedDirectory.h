@@ -37,7 +37,7 @@ namespace FM
 
       void mergeSubSharedDirectories();
 
-      void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false) const;
+      void populateEntry(Protos::Common::Entry* entry, bool setSharedDir = false, bool onlyFirstHash = false) const;
 
    private:
       void init();
@@ -15,10 +15,14 @@
   * You should have received a copy of the GNU General Public License
   * along with this program.  If not, see <http://www.gnu.org/licenses/>.
   */
-  
+
 #include <priv/ChunkIndex/Chunks.h>
 using namespace FM;
 
+#include <cstring>
+
+#include <QThread>
+
 #include <priv/Cache/Chunk.h>
 #include <priv/Log.h>
 
@@ -29,62 +33,587 @@ using namespace FM;
   * - Add identical files 'a' and 'b'.
   * - remove 'a'. 'b' wouldn't be remove from Chunks at the same time.
   *
-  * We may use a Bloom filter to reduce the time of a call to 'contains(..)', 'value(..)' and 'values(..)'.
-  * Some measurements (compiled with GCC 4.6 and -02):
-  *  - The filter reduces the call time of 'contains()' from about 20% with 30'000 hashes
-  *    and about 15% with 100'000 hashes.
-  *  - The filter increases the call time of 'contains()' from about 100% with 1'000'000 hashes.
-  *  - 100'000'000 calls of 'contains(..)' for 100'000 known chunks takes 3.6s on a i5 @ 2.5 GHz.
-  *    It's 36 ns per call.
+  * The chunks are spread over 'NB_SHARDS' open addressing tables (linear probing), one per shard.
+  * A writer only locks the mutex of its shard. 'contains(..)' and 'containsMany(..)' don't lock anything:
+  *  - A slot is filled by writing its hash then its tag, it's only emptied by replacing its tag by 'TOMBSTONE'.
+  *    The hash of a used slot is never modified thus a reader can't see a partial hash.
+  *  - When a table has to grow or has too many tombstones, a new table is built and published.
+  *    The old one is deleted only when all the readers which may use it have left their read section (see 'waitForReaders()').
+  * 'value(..)' and 'values(..)' have to lock the shard mutex to copy the chunk pointers.
+  *
+  * A Bloom filter is tested before the tables: most of the requested hashes are unknown and are rejected with
+  * one cache miss. The filter is sized with the number of chunks, when it becomes saturated or when too many chunks
+  * have been removed a new one is built in the background by 'BloomFilterBuilder' and replaces the old one.
+  *
+  * The digests of our hashes sent to the other peers are kept up to date the same way, see 'getDigest(..)'.
+  *
+  * 'containsMany(..)' is the fastest way to test a lot of hashes, it enters only once in a read section
+  * and it computes the positions of a group of hashes before probing them to hide the memory latency.
+  * Some measurements (compiled with GCC 12 and -O2 on a Xeon) for unknown hashes, with and without the Bloom filter:
+  *  - 1'000'000 chunks: 36 ns instead of 104 ns per call of 'contains(..)', 24 ns instead of 56 ns per hash with 'containsMany(..)'.
+  *  - 10'000'000 chunks: 46 ns instead of 178 ns per call of 'contains(..)', 36 ns instead of 81 ns per hash with 'containsMany(..)'.
+  * When half of the hashes are known the filter costs about 10%.
   * See the method 'chunksPerformance()' in 'TestsFileManager' for more information.
   */
 
+const int Chunks::MIN_BLOOM_FILTER_CAPACITY;
+
+Chunks::Chunks() :
+   epoch(0),
+   bloomFilter(new Common::BloomFilter(MIN_BLOOM_FILTER_CAPACITY)),
+   nextBloomFilter(nullptr),
+   nbRemovedSinceBloomFilterBuilt(0),
+   bloomFilterRebuildRequested(false),
+   bloomFilterBuilder(*this)
+{
+   this->nbReaders[0] = 0;
+   this->nbReaders[1] = 0;
+   this->bloomFilterBuilder.start();
+}
+
+Chunks::~Chunks()
+{
+   this->bloomFilterBuilder.stop();
+
+   for (int i = 0; i < NB_SHARDS; i++)
+      delete this->shards[i].table.load();
+   delete this->bloomFilter.load();
+}
+
 void Chunks::add(const QSharedPointer<Chunk>& chunk)
 {
-   QMutexLocker locker(&this->mutex);
-   this->insert(chunk->getHash(), chunk);
-#ifdef BLOOM_FILTER_ON
-   this->bloomFilter.add(chunk->getHash());
-#endif
+   const Common::Hash& hash = chunk->getHash();
+   const Position position(hash);
+   Shard& shard = this->shards[position.shard];
+
+   QMutexLocker locker(&shard.mutex);
+
+   Table* table = shard.table.load(std::memory_order_relaxed);
+
+   // The load factor, tombstones included, is kept under 3/4.
+   if (4 * (shard.nbChunks + shard.nbTombstones + 1) > 3 * (table->mask + 1))
+   {
+      quint32 capacity = table->mask + 1;
+      while (2 * (shard.nbChunks + 1) > capacity)
+         capacity *= 2;
+      this->resize(shard, capacity);
+      table = shard.table.load(std::memory_order_relaxed);
+   }
+
+   // The tombstones aren't reused, the readers may still compare their hash.
+   quint32 i = position.index & table->mask;
+   while (table->slots[i].tag.load(std::memory_order_relaxed) != EMPTY)
+      i = (i + 1) & table->mask;
+
+   // The hash must be in the filter before being visible in the table.
+   this->addToBloomFilter(hash);
+
+   Slot& slot = table->slots[i];
+   slot.hash = hash;
+   slot.chunk = chunk;
+   slot.tag.store(position.tag, std::memory_order_release);
+   shard.nbChunks++;
+
+   this->addToDigests(hash);
 }
 
 void Chunks::rm(const QSharedPointer<Chunk>& chunk)
 {
-   QMutexLocker locker(&this->mutex);
-   this->remove(chunk->getHash(), chunk);
-#ifdef BLOOM_FILTER_ON
-   if (this->isEmpty())
-      this->bloomFilter.reset();
-#endif
+   const Common::Hash& hash = chunk->getHash();
+   const Position position(hash);
+   Shard& shard = this->shards[position.shard];
+
+   QMutexLocker locker(&shard.mutex);
+
+   bool removed = false;
+
+   Table* table = shard.table.load(std::memory_order_relaxed);
+   for (quint32 i = position.index & table->mask;; i = (i + 1) & table->mask)
+   {
+      Slot& slot = table->slots[i];
+      const quint32 tag = slot.tag.load(std::memory_order_relaxed);
+      if (tag == EMPTY)
+         break;
+      if (tag == position.tag && slot.chunk == chunk)
+      {
+         slot.chunk.clear();
+         slot.tag.store(TOMBSTONE, std::memory_order_release);
+         shard.nbChunks--;
+         shard.nbTombstones++;
+         removed = true;
+         this->nbRemovedSinceBloomFilterBuilt.fetch_add(1, std::memory_order_relaxed);
+      }
+   }
+
+   // A hash can't be removed from a digest, the digest of its shard will be rebuilt.
+   if (removed)
+   {
+      QMutexLocker digestsLocker(&this->digestsMutex);
+      if (!this->digests.isEmpty())
+         this->staleDigests.setBit(hash.getPrefix() & (this->digests.size() - 1));
+   }
+
+   // Too many tombstones: the table is rebuilt, smaller if it's mostly empty.
+   const quint32 capacity = table->mask + 1;
+   if (4 * shard.nbTombstones > capacity)
+   {
+      quint32 newCapacity = capacity;
+      while (newCapacity > MIN_CAPACITY && 8 * shard.nbChunks < newCapacity)
+         newCapacity /= 2;
+      this->resize(shard, newCapacity);
+   }
+
+   locker.unlock();
+
+   {
+      ReadSection readSection(*this);
+      this->rebuildBloomFilterIfNeeded(this->bloomFilter.load(std::memory_order_acquire));
+   }
+
    L_DEBU(QString("Nb chunks: %1").arg(this->size()));
 }
 
 QSharedPointer<Chunk> Chunks::value(const Common::Hash& hash) const
 {
-   QMutexLocker locker(&this->mutex);
-#ifdef BLOOM_FILTER_ON
-   if (!this->bloomFilter.test(hash))
+   if (!this->mayContain(hash))
       return QSharedPointer<Chunk>();
-#endif
-   return QMultiHash<Common::Hash, QSharedPointer<Chunk>>::value(hash);
+
+   const Position position(hash);
+   const Shard& shard = this->shards[position.shard];
+
+   QMutexLocker locker(&shard.mutex);
+
+   const Table* table = shard.table.load(std::memory_order_relaxed);
+   for (quint32 i = position.index & table->mask;; i = (i + 1) & table->mask)
+   {
+      const Slot& slot = table->slots[i];
+      const quint32 tag = slot.tag.load(std::memory_order_relaxed);
+      if (tag == EMPTY)
+         return QSharedPointer<Chunk>();
+      if (tag == position.tag && slot.hash == hash)
+         return slot.chunk;
+   }
 }
 
 QList<QSharedPointer<Chunk>> Chunks::values(const Common::Hash& hash) const
 {
-   QMutexLocker locker(&this->mutex);
-#ifdef BLOOM_FILTER_ON
-   if (!this->bloomFilter.test(hash))
+   if (!this->mayContain(hash))
       return QList<QSharedPointer<Chunk>>();
-#endif
-   return QMultiHash<Common::Hash, QSharedPointer<Chunk>>::values(hash);
+
+   const Position position(hash);
+   const Shard& shard = this->shards[position.shard];
+
+   QList<QSharedPointer<Chunk>> result;
+
+   QMutexLocker locker(&shard.mutex);
+
+   const Table* table = shard.table.load(std::memory_order_relaxed);
+   for (quint32 i = position.index & table->mask;; i = (i + 1) & table->mask)
+   {
+      const Slot& slot = table->slots[i];
+      const quint32 tag = slot.tag.load(std::memory_order_relaxed);
+      if (tag == EMPTY)
+         return result;
+      if (tag == position.tag && slot.hash == hash)
+         result << slot.chunk;
+   }
 }
 
 bool Chunks::contains(const Common::Hash& hash) const
 {
-   QMutexLocker locker(&this->mutex);   
-#ifdef BLOOM_FILTER_ON
-   if (!this->bloomFilter.test(hash))
+   const Position position(hash);
+   ReadSection readSection(*this);
+   if (!this->bloomFilter.load(std::memory_order_acquire)->test(hash))
       return false;
+   return Chunks::lookup(this->shards[position.shard].table.load(std::memory_order_acquire), position, hash);
+}
+
+/**
+  * Return a bit array with the same size as 'hashes', a bit is set if the corresponding hash is known.
+  */
+QBitArray Chunks::containsMany(const QVector<Common::Hash>& hashes) const
+{
+   static const int GROUP_SIZE = 16;
+
+   QBitArray result(hashes.size());
+
+   ReadSection readSection(*this);
+   const Common::BloomFilter* bloomFilter = this->bloomFilter.load(std::memory_order_acquire);
+
+   for (int i = 0; i < hashes.size(); i += GROUP_SIZE)
+   {
+      const int groupSize = qMin(GROUP_SIZE, hashes.size() - i);
+      int candidates[GROUP_SIZE]; // The hashes which pass the filter.
+      const Table* tables[GROUP_SIZE];
+      int nbCandidates = 0;
+
+      for (int j = i; j < i + groupSize; j++)
+         if (bloomFilter->test(hashes[j]))
+         {
+            const Position position(hashes[j]);
+            const Table* table = this->shards[position.shard].table.load(std::memory_order_acquire);
+#ifdef __GNUC__
+            __builtin_prefetch(&table->slots[position.index & table->mask]);
 #endif
-   return QMultiHash<Common::Hash, QSharedPointer<Chunk>>::contains(hash);
+            tables[nbCandidates] = table;
+            candidates[nbCandidates++] = j;
+         }
+
+      for (int j = 0; j < nbCandidates; j++)
+      {
+         const Common::Hash& hash = hashes[candidates[j]];
+         if (Chunks::lookup(tables[j], Position(hash), hash))
+            result.setBit(candidates[j]);
+      }
+   }
+
+   return result;
+}
+
+/**
+  * Same as 'containsMany(..)' for the prefixes of the hashes, see 'Common::Hash::getPrefix()'.
+  * The first eight bytes give the shard and the position in the table but not the tag, and the Bloom filter
+  * uses the last bytes of the hashes: each prefix costs a probe.
+  */
+QBitArray Chunks::containsManyPrefixes(const QVector<quint64>& prefixes) const
+{
+   QBitArray result(prefixes.size());
+
+   ReadSection readSection(*this);
+
+   for (int i = 0; i < prefixes.size(); i++)
+   {
+      uchar data[Common::Hash::PREFIX_SIZE];
+      qToLittleEndian(prefixes[i], data);
+      quint32 words[2];
+      memcpy(words, data, sizeof(words));
+
+      const Table* table = this->shards[words[0] & (NB_SHARDS - 1)].table.load(std::memory_order_acquire);
+      for (quint32 j = words[1] & table->mask;; j = (j + 1) & table->mask)
+      {
+         const Slot& slot = table->slots[j];
+         const quint32 tag = slot.tag.load(std::memory_order_acquire);
+         if (tag == EMPTY)
+            break;
+         if (tag != TOMBSTONE && slot.hash.getPrefix() == prefixes[i])
+         {
+            result.setBit(i);
+            break;
+         }
+      }
+   }
+
+   return result;
+}
+
+/**
+  * Return the digest of the shard 'n' (modulo the number of shards) of our hashes. The number of shards is the smallest
+  * power of two for which a shard doesn't exceed the capacity of a digest of 'size' bytes, see 'Common::HashesDigest'.
+  * The digests of all the shards are built in one pass and kept: the added hashes are put in them, they are all rebuilt only
+  * when the number of shards or the size changes. When a hash is removed only the digest of its shard is rebuilt, see 'rebuildDigest(..)'.
+  * Returns a null digest if there is no chunk.
+  */
+Common::HashesDigest Chunks::getDigest(quint32 n, int size)
+{
+   static const quint32 MAX_NB_SHARDS = 65536;
+
+   const int nbChunks = this->size(); // Must be called without 'digestsMutex', see 'add(..)'.
+   if (nbChunks == 0 || size <= 0)
+      return Common::HashesDigest();
+
+   const qint64 capacity = qMax(1, Common::HashesDigest::getCapacity(size));
+   quint32 nbShards = 1;
+   while (nbShards < MAX_NB_SHARDS && nbShards * capacity < nbChunks)
+      nbShards *= 2;
+
+   QMutexLocker locker(&this->digestsMutex);
+
+   if (static_cast<quint32>(this->digests.size()) != nbShards || this->digests.first().getBits().size() != size)
+      this->rebuildDigests(nbShards, size);
+
+   const quint32 shard = n & (nbShards - 1);
+   if (this->staleDigests.testBit(shard))
+      this->rebuildDigest(shard);
+
+   return this->digests[shard];
+}
+
+int Chunks::size() const
+{
+   int size = 0;
+   for (int i = 0; i < NB_SHARDS; i++)
+   {
+      QMutexLocker locker(&this->shards[i].mutex);
+      size += this->shards[i].nbChunks;
+   }
+   return size;
+}
+
+Chunks::ReadSection::ReadSection(const Chunks& chunks)
+{
+   // If the epoch has changed during the registration a writer may not have seen us, we retry with the new epoch.
+   forever
+   {
+      const quint32 epoch = chunks.epoch.load();
+      this->nbReaders = &chunks.nbReaders[epoch & 1];
+      this->nbReaders->fetch_add(1);
+      if (chunks.epoch.load() == epoch)
+         break;
+      this->nbReaders->fetch_sub(1);
+   }
+}
+
+Chunks::ReadSection::~ReadSection()
+{
+   this->nbReaders->fetch_sub(1);
+}
+
+Chunks::Position::Position(const Common::Hash& hash)
+{
+   quint32 words[3];
+   memcpy(words, hash.getData(), sizeof(words));
+
+   // The hashes are uniformly distributed, their bits can be used directly.
+   this->shard = words[0] & (NB_SHARDS - 1);
+   this->index = words[1];
+   this->tag = words[2] <= TOMBSTONE ? words[2] + 2 : words[2];
+}
+
+/**
+  * Return false if the hash is certainly unknown.
+  */
+bool Chunks::mayContain(const Common::Hash& hash) const
+{
+   ReadSection readSection(*this);
+   return this->bloomFilter.load(std::memory_order_acquire)->test(hash);
+}
+
+bool Chunks::lookup(const Table* table, const Position& position, const Common::Hash& hash)
+{
+   for (quint32 i = position.index & table->mask;; i = (i + 1) & table->mask)
+   {
+      const Slot& slot = table->slots[i];
+      const quint32 tag = slot.tag.load(std::memory_order_acquire);
+      if (tag == EMPTY)
+         return false;
+      if (tag == position.tag && slot.hash == hash)
+         return true;
+   }
+}
+
+/**
+  * Move all the chunks of the shard into a new table and delete the old one.
+  * The shard mutex must be locked.
+  */
+void Chunks::resize(Shard& shard, quint32 capacity)
+{
+   Table* oldTable = shard.table.load(std::memory_order_relaxed);
+   Table* newTable = new Table(capacity);
+
+   for (quint32 i = 0; i <= oldTable->mask; i++)
+   {
+      Slot& oldSlot = oldTable->slots[i];
+      const quint32 tag = oldSlot.tag.load(std::memory_order_relaxed);
+      if (tag == EMPTY || tag == TOMBSTONE)
+         continue;
+
+      quint32 j = Position(oldSlot.hash).index & newTable->mask;
+      while (newTable->slots[j].tag.load(std::memory_order_relaxed) != EMPTY)
+         j = (j + 1) & newTable->mask;
+
+      Slot& newSlot = newTable->slots[j];
+      newSlot.hash = oldSlot.hash;
+      newSlot.chunk.swap(oldSlot.chunk); // The readers without the mutex don't access the chunks.
+      newSlot.tag.store(tag, std::memory_order_relaxed);
+   }
+
+   shard.table.store(newTable, std::memory_order_release);
+   shard.nbTombstones = 0;
+
+   this->waitForReaders();
+   delete oldTable;
+}
+
+/**
+  * Wait until all the readers which have started before the call have left their read section.
+  * The new readers are counted with the next epoch parity, so they can't starve the writer.
+  */
+void Chunks::waitForReaders()
+{
+   QMutexLocker locker(&this->waitForReadersMutex);
+
+   const quint32 epoch = this->epoch.fetch_add(1);
+   while (this->nbReaders[epoch & 1].load() != 0)
+      QThread::yieldCurrentThread();
+}
+
+/**
+  * Add the hash to the current Bloom filter and to the one being built, if any.
+  * The shard mutex must be locked.
+  */
+void Chunks::addToBloomFilter(const Common::Hash& hash)
+{
+   ReadSection readSection(*this);
+
+   // 'nextBloomFilter' must be read first, see 'rebuildBloomFilter()'.
+   Common::BloomFilter* nextBloomFilter = this->nextBloomFilter.load();
+   Common::BloomFilter* bloomFilter = this->bloomFilter.load();
+
+   bloomFilter->add(hash);
+   if (nextBloomFilter && nextBloomFilter != bloomFilter)
+      nextBloomFilter->add(hash);
+
+   this->rebuildBloomFilterIfNeeded(bloomFilter);
+}
+
+/**
+  * The shard mutex must be locked.
+  */
+void Chunks::addToDigests(const Common::Hash& hash)
+{
+   QMutexLocker locker(&this->digestsMutex);
+   if (!this->digests.isEmpty())
+      this->digests[hash.getPrefix() & (this->digests.size() - 1)].add(hash);
+}
+
+/**
+  * 'digestsMutex' must be locked. The tables are read without locking them, a hash added concurrently
+  * is put in the new digests by 'addToDigests(..)' once the rebuild is finished.
+  */
+void Chunks::rebuildDigests(quint32 nbShards, int size)
+{
+   this->digests.clear();
+   this->digests.reserve(nbShards);
+   for (quint32 i = 0; i < nbShards; i++)
+      this->digests << Common::HashesDigest(i, nbShards, size);
+   this->staleDigests = QBitArray(nbShards);
+
+   ReadSection readSection(*this);
+
+   for (int i = 0; i < NB_SHARDS; i++)
+   {
+      const Table* table = this->shards[i].table.load(std::memory_order_acquire);
+      for (quint32 j = 0; j <= table->mask; j++)
+      {
+         const Slot& slot = table->slots[j];
+         const quint32 tag = slot.tag.load(std::memory_order_acquire);
+         if (tag != EMPTY && tag != TOMBSTONE)
+            this->digests[slot.hash.getPrefix() & (nbShards - 1)].add(slot.hash);
+      }
+   }
+
+   L_DEBU(QString("Digests rebuilt, number of shards: %1").arg(nbShards));
+}
+
+/**
+  * Rebuild the digest of one shard, 'digestsMutex' must be locked.
+  * The shard of a table and the shard of a digest are given by the low bits of the hashes, only the tables
+  * which may contain some hashes of the digest are read.
+  */
+void Chunks::rebuildDigest(quint32 shard)
+{
+   Common::HashesDigest& digest = this->digests[shard];
+   digest = Common::HashesDigest(shard, digest.getNbShards(), digest.getBits().size());
+   this->staleDigests.clearBit(shard);
+
+   ReadSection readSection(*this);
+
+   const quint32 step = qMin(digest.getNbShards(), static_cast<quint32>(NB_SHARDS));
+   for (quint32 i = shard & (step - 1); i < static_cast<quint32>(NB_SHARDS); i += step)
+   {
+      const Table* table = this->shards[i].table.load(std::memory_order_acquire);
+      for (quint32 j = 0; j <= table->mask; j++)
+      {
+         const Slot& slot = table->slots[j];
+         const quint32 tag = slot.tag.load(std::memory_order_acquire);
+         if (tag != EMPTY && tag != TOMBSTONE && digest.covers(slot.hash))
+            digest.add(slot.hash);
+      }
+   }
+}
+
+/**
+  * Ask a rebuild if the filter is saturated or if more than half of its hashes have been removed.
+  */
+void Chunks::rebuildBloomFilterIfNeeded(const Common::BloomFilter* bloomFilter)
+{
+   if (
+      (bloomFilter->getSize() > bloomFilter->getCapacity() || 2 * this->nbRemovedSinceBloomFilterBuilt.load(std::memory_order_relaxed) > bloomFilter->getCapacity()) &&
+      !this->bloomFilterRebuildRequested.exchange(true)
+   )
+      this->bloomFilterBuilder.request();
+}
+
+/**
+  * Build a new Bloom filter for the current chunks and replace the old one.
+  * During the construction the added chunks are put in the both filters.
+  * A shard is read with its mutex locked thus a chunk added concurrently is either read from
+  * the table or put by 'addToBloomFilter(..)' in the new filter.
+  */
+void Chunks::rebuildBloomFilter()
+{
+   Common::BloomFilter* newBloomFilter = new Common::BloomFilter(qMax(MIN_BLOOM_FILTER_CAPACITY, 2 * this->size()));
+   this->nextBloomFilter.store(newBloomFilter);
+   this->nbRemovedSinceBloomFilterBuilt.store(0);
+
+   for (int i = 0; i < NB_SHARDS; i++)
+   {
+      QMutexLocker locker(&this->shards[i].mutex);
+      const Table* table = this->shards[i].table.load(std::memory_order_relaxed);
+      for (quint32 j = 0; j <= table->mask; j++)
+      {
+         const quint32 tag = table->slots[j].tag.load(std::memory_order_relaxed);
+         if (tag != EMPTY && tag != TOMBSTONE)
+            newBloomFilter->add(table->slots[j].hash);
+      }
+   }
+
+   Common::BloomFilter* oldBloomFilter = this->bloomFilter.exchange(newBloomFilter);
+   this->nextBloomFilter.store(nullptr);
+
+   this->waitForReaders();
+   delete oldBloomFilter;
+
+   L_DEBU(QString("Bloom filter rebuilt, capacity: %1").arg(newBloomFilter->getCapacity()));
+
+   this->bloomFilterRebuildRequested.store(false);
+}
+
+Chunks::BloomFilterBuilder::BloomFilterBuilder(Chunks& chunks) :
+   chunks(chunks), requested(false), toStop(false)
+{
+}
+
+void Chunks::BloomFilterBuilder::request()
+{
+   QMutexLocker locker(&this->mutex);
+   this->requested = true;
+   this->waitCondition.wakeOne();
+}
+
+void Chunks::BloomFilterBuilder::stop()
+{
+   {
+      QMutexLocker locker(&this->mutex);
+      this->toStop = true;
+      this->waitCondition.wakeOne();
+   }
+   this->wait();
+}
+
+void Chunks::BloomFilterBuilder::run()
+{
+   forever
+   {
+      {
+         QMutexLocker locker(&this->mutex);
+         while (!this->requested && !this->toStop)
+            this->waitCondition.wait(&this->mutex);
+         if (this->toStop)
+            return;
+         this->requested = false;
+      }
+
+      this->chunks.rebuildBloomFilter();
+   }
 }
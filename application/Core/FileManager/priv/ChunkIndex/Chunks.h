@@ -15,43 +15,150 @@
   * You should have received a copy of the GNU General Public License
   * along with this program.  If not, see <http://www.gnu.org/licenses/>.
   */
-  
+
 #ifndef FILEMANAGER_CHUNKS_H
 #define FILEMANAGER_CHUNKS_H
 
-// Uncomment this directive to enable the Bloom filter.
-// It will speed up the call to the methods 'value(..)', 'values(..)' and 'contains(..)' by 15% for less than 100'000 chunks in memory
-// but slow down by 100% for more than 1'000'000 chunks in memory, this is why it is disable by default.
-// #define BLOOM_FILTER_ON
+#include <atomic>
 
-#include <QHash>
 #include <QSharedPointer>
+#include <QList>
+#include <QVector>
+#include <QBitArray>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
 
 #include <Common/Hash.h>
-#ifdef BLOOM_FILTER_ON
-   #include <Common/BloomFilter.h>
-#endif
+#include <Common/BloomFilter.h>
+#include <Common/HashesDigest.h>
+#include <Common/Uncopyable.h>
 
 namespace FM
 {
    class Chunk;
 
-   class Chunks : private QMultiHash<Common::Hash, QSharedPointer<Chunk>>
+   class Chunks : Common::Uncopyable
    {
    public:
+      Chunks();
+      ~Chunks();
+
       void add(const QSharedPointer<Chunk>& chunk);
       void rm(const QSharedPointer<Chunk>& chunk);
       QSharedPointer<Chunk> value(const Common::Hash& hash) const;
       QList<QSharedPointer<Chunk>> values(const Common::Hash& hash) const;
       bool contains(const Common::Hash& hash) const;
+      QBitArray containsMany(const QVector<Common::Hash>& hashes) const;
+      QBitArray containsManyPrefixes(const QVector<quint64>& prefixes) const;
+      Common::HashesDigest getDigest(quint32 n, int size);
+      int size() const;
 
    private:
-      mutable QMutex mutex; // From the documentation : "they (containers) are thread-safe in situations where they are used as read-only containers by all threads used to access them.".
+      static const int NB_SHARDS = 64; // Must be a power of two.
+      static const quint32 MIN_CAPACITY = 64; // Must be a power of two.
+      static const int MIN_BLOOM_FILTER_CAPACITY = 65536;
 
-#ifdef BLOOM_FILTER_ON
-      BloomFilter bloomFilter;
-#endif
+      // Special tag values, a tag computed from a hash is never one of them.
+      static const quint32 EMPTY = 0;
+      static const quint32 TOMBSTONE = 1;
+
+      struct Slot
+      {
+         Slot() : tag(EMPTY) {}
+         std::atomic<quint32> tag; // Written last when the slot is filled, the hash is never modified after.
+         Common::Hash hash;
+         QSharedPointer<Chunk> chunk; // Only accessed with the shard mutex locked.
+      };
+
+      struct Table
+      {
+         Table(quint32 capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+         ~Table() { delete[] this->slots; }
+         const quint32 mask;
+         Slot* const slots;
+      };
+
+      struct Shard
+      {
+         Shard() : table(new Table(MIN_CAPACITY)), nbChunks(0), nbTombstones(0) {}
+         mutable QMutex mutex; // Taken by the writers and by the readers which need the chunks.
+         std::atomic<Table*> table;
+         quint32 nbChunks;
+         quint32 nbTombstones;
+      };
+
+      /**
+        * The lock-free readers must stay in a read section as long as they use a table.
+        */
+      class ReadSection : Common::Uncopyable
+      {
+      public:
+         ReadSection(const Chunks& chunks);
+         ~ReadSection();
+      private:
+         std::atomic<int>* nbReaders;
+      };
+
+      struct Position
+      {
+         Position(const Common::Hash& hash);
+         int shard;
+         quint32 index;
+         quint32 tag;
+      };
+
+      /**
+        * Rebuild the Bloom filter when it's asked by 'Chunks', see 'rebuildBloomFilter()'.
+        */
+      class BloomFilterBuilder : public QThread
+      {
+      public:
+         BloomFilterBuilder(Chunks& chunks);
+         void request();
+         void stop();
+
+      protected:
+         void run();
+
+      private:
+         Chunks& chunks;
+         QMutex mutex;
+         QWaitCondition waitCondition;
+         bool requested;
+         bool toStop;
+      };
+
+      static bool lookup(const Table* table, const Position& position, const Common::Hash& hash);
+      bool mayContain(const Common::Hash& hash) const;
+      void resize(Shard& shard, quint32 capacity);
+      void waitForReaders();
+
+      void addToBloomFilter(const Common::Hash& hash);
+      void addToDigests(const Common::Hash& hash);
+      void rebuildDigests(quint32 nbShards, int size);
+      void rebuildDigest(quint32 shard);
+      void rebuildBloomFilterIfNeeded(const Common::BloomFilter* bloomFilter);
+      void rebuildBloomFilter();
+
+      Shard shards[NB_SHARDS];
+
+      mutable std::atomic<quint32> epoch;
+      mutable std::atomic<int> nbReaders[2]; // The number of readers for each epoch parity.
+      QMutex waitForReadersMutex;
+
+      // The Bloom filter answers most of the requests for the hashes we don't have without reading the tables.
+      // A removed hash can't be removed from the filter: when there is too many removed hashes or when the filter is saturated a new one is built.
+      std::atomic<Common::BloomFilter*> bloomFilter;
+      std::atomic<Common::BloomFilter*> nextBloomFilter; // Not null during a rebuild, the added hashes are put in both filters.
+      std::atomic<int> nbRemovedSinceBloomFilterBuilt;
+      std::atomic<bool> bloomFilterRebuildRequested;
+      BloomFilterBuilder bloomFilterBuilder;
+
+      // The digests of all the shards sent to the other peers, see 'getDigest(..)'. Empty when they have to be rebuilt.
+      QMutex digestsMutex; // Taken after a shard mutex.
+      QVector<Common::HashesDigest> digests;
+      QBitArray staleDigests; // The digests from which a hash has been removed, they are rebuilt when they are asked.
    };
 }
 #endif
@@ -24,7 +24,8 @@
 namespace FM
 {
    // 2 -> 3 : BLAKE -> Sha-1
-   const int FILE_CACHE_VERSION = 3;
+   // 3 -> 4 : Log of directory records, see 'FileCacheLog'.
+   const int FILE_CACHE_VERSION = 4;
 }
 
 #endif
@@ -30,6 +30,7 @@ using namespace FM;
 #include <QMutableListIterator>
 
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/io/coded_stream.h>
 
 #include <Protos/files_cache.pb.h>
 
@@ -55,15 +56,20 @@ LOG_INIT_CPP(FileManager)
 FileManager::FileManager() :
    fileUpdater(this),
    cache(),
+   fileCacheLog(Common::Constants::FILE_CACHE),
+   findCache(SETTINGS.get<quint32>("find_cache_size")),
    mutexPersistCache(QMutex::Recursive),
    cacheLoading(true),
    cacheChanged(false)
 {
    Chunk::CHUNK_SIZE = SETTINGS.get<quint32>("chunk_size");
+   Chunk::HASH_ALGORITHM = static_cast<Common::HashAlgorithm>(SETTINGS.get<quint32>("chunk_hash_algorithm"));
+   Chunk::BLOCK_SIZE = SETTINGS.get<quint32>("block_size");
 
    connect(&this->cache, SIGNAL(entryAdded(Entry*)), this, SLOT(entryAdded(Entry*)), Qt::DirectConnection);
    connect(&this->cache, SIGNAL(entryRemoved(Entry*)), this, SLOT(entryRemoved(Entry*)), Qt::DirectConnection);
    connect(&this->cache, SIGNAL(entryRenamed(Entry*, QString)), this, SLOT(entryRenamed(Entry*, QString)), Qt::DirectConnection);
+   connect(&this->cache, SIGNAL(entryMoved(Entry*)), this, SLOT(entryMoved(Entry*)), Qt::DirectConnection);
    connect(&this->cache, SIGNAL(chunkHashKnown(QSharedPointer<Chunk>)), this, SLOT(chunkHashKnown(QSharedPointer<Chunk>)), Qt::DirectConnection);
    connect(&this->cache, SIGNAL(chunkRemoved(QSharedPointer<Chunk>)), this, SLOT(chunkRemoved(QSharedPointer<Chunk>)), Qt::DirectConnection);
 
@@ -197,6 +203,12 @@ QList<Protos::Common::FindResult> FileManager::find(const QString& words, const
    bool filterByCategoryOn = category != Protos::Common::FindPattern::FILE_DIR;
    bool filterOn = filterBySizeOn || filterByExtensionsOn || filterByCategoryOn;
 
+   const FindCache::Pattern pattern(words, extensions, minFileSize, maxFileSize, category, maxNbResult, maxSize);
+   QList<Protos::Common::FindResult> findResults;
+   quint64 findCacheToken;
+   if (this->findCache.get(pattern, findResults, findCacheToken))
+      return findResults;
+
    QList<NodeResult<Entry*>> result;
 
    if (!words.isEmpty())
@@ -236,60 +248,75 @@ QList<Protos::Common::FindResult> FileManager::find(const QString& words, const
          result << NodeResult<Entry*>(i.next());
    }
 
-   QList<Protos::Common::FindResult> findResults;
-   findResults << Protos::Common::FindResult();
-   findResults.last().set_tag(std::numeric_limits<quint64>::max()); // Worst case to compute the size (int fields have a variable size).
-
-   const int EMPTY_FIND_RESULT_SIZE = findResults.last().ByteSize();
-   int findResultCurrentSize = EMPTY_FIND_RESULT_SIZE; // [Byte].
+   Protos::Common::FindResult emptyFindResult;
+   emptyFindResult.set_tag(std::numeric_limits<quint64>::max()); // Worst case to compute the size (int fields have a variable size).
+   const int EMPTY_FIND_RESULT_SIZE = emptyFindResult.ByteSize();
+   int findResultCurrentSize = 0; // [Byte].
 
    for (QListIterator<NodeResult<Entry*>> i(result); i.hasNext();)
    {
       const NodeResult<Entry*>& entry = i.next();
-      Protos::Common::FindResult::EntryLevel* entryLevel = findResults.last().add_entry();
+      Protos::Common::FindResult::EntryLevel* entryLevel = new Protos::Common::FindResult::EntryLevel();
       entryLevel->set_level(entry.level);
-      entry.value->populateEntry(entryLevel->mutable_entry(), true);
+      entry.value->populateEntry(entryLevel->mutable_entry(), true, true);
 
-      // We wouldn't use 'findResults.last().ByteSize()' because is too slow. Instead we call 'ByteSize()' for each entry and sum it.
-      const int entryByteSize = entryLevel->ByteSize() + 8; // Each entry take a bit of memory overhead . . . (Value found in an empiric way . . .).
-      findResultCurrentSize += entryByteSize;
+      // The exact size taken by the entry in a 'FindResult': the key of the field 'entry', the length of the message and the message.
+      // Without the chunk hashes the size of an entry is cheap to compute.
+      const int entryLevelSize = entryLevel->ByteSize();
+      const int entryByteSize = 1 + google::protobuf::io::CodedOutputStream::VarintSize32(entryLevelSize) + entryLevelSize;
 
-      if (findResultCurrentSize > maxSize)
+      if (findResults.isEmpty() || findResultCurrentSize + entryByteSize > maxSize && findResults.last().entry_size() > 0)
       {
-         google::protobuf::RepeatedPtrField<Protos::Common::FindResult::EntryLevel>* entries = findResults.last().mutable_entry();
          findResults << Protos::Common::FindResult();
-         if (entries->size() > 0)
-         {
-            findResults.last().add_entry()->CopyFrom(entries->Get(entries->size()-1));
-            entries->RemoveLast();
-         }
-         findResultCurrentSize = EMPTY_FIND_RESULT_SIZE + entryByteSize;
+         findResultCurrentSize = EMPTY_FIND_RESULT_SIZE;
       }
+
+      findResults.last().mutable_entry()->AddAllocated(entryLevel);
+      findResultCurrentSize += entryByteSize;
    }
 
-   if (findResults.last().entry_size() == 0)
-      findResults.removeLast();
+   QList<const Entry*> entries;
+   entries.reserve(result.size());
+   for (QListIterator<NodeResult<Entry*>> i(result); i.hasNext();)
+      entries << i.next().value;
+   this->findCache.put(pattern, findCacheToken, findResults, entries);
 
    return findResults;
 }
 
-QBitArray FileManager::haveChunks(const QList<Common::Hash>& hashes)
+QBitArray FileManager::haveChunks(const QVector<Common::Hash>& hashes)
 {
-   QBitArray result(hashes.size()); // All bits to 0 by default.
-   bool ownsAtLeastOneChunk = false;
-   for (int i = 0; i < hashes.size(); i++)
-      if (this->chunks.contains(hashes[i]))
-      {
-         result.setBit(i, true);
-         ownsAtLeastOneChunk = true;
-      }
+   const QBitArray& result = this->chunks.containsMany(hashes);
+
+   if (result.count(true) == 0)
+      return QBitArray();
+
+   return result;
+}
+
+QBitArray FileManager::haveChunks(const QVector<quint64>& hashPrefixes)
+{
+   const QBitArray& result = this->chunks.containsManyPrefixes(hashPrefixes);
 
-   if (!ownsAtLeastOneChunk)
+   if (result.count(true) == 0)
       return QBitArray();
 
    return result;
 }
 
+Common::HashesDigest FileManager::getChunksDigest(quint32 n, int size)
+{
+   return this->chunks.getDigest(n, size);
+}
+
+/**
+  * Return the number of searches answered by the cache of results and the number of the other searches.
+  */
+QPair<quint64, quint64> FileManager::getFindCacheStats() const
+{
+   return qMakePair(this->findCache.getNbHits(), this->findCache.getNbMisses());
+}
+
 quint64 FileManager::getAmount()
 {
    return this->cache.getAmount();
@@ -311,6 +338,8 @@ FileManager::CacheStatus FileManager::getCacheStatus() const
 
 int FileManager::getProgress() const
 {
+   if (this->getCacheStatus() == SCANNING_IN_PROGRESS)
+      return this->fileUpdater.getScanRate();
    return this->fileUpdater.getProgress();
 }
 
@@ -373,12 +402,14 @@ Entry* FileManager::getEntry(const QString& path)
 
 void FileManager::newSharedDirectory(SharedDirectory* sharedDir)
 {
+   this->findCache.clear();
    this->fileUpdater.addRoot(sharedDir);
    this->forcePersistCacheToFile();
 }
 
 void FileManager::sharedDirectoryRemoved(SharedDirectory* sharedDir, Directory* dir)
 {
+   this->findCache.clear();
    this->fileUpdater.rmRoot(sharedDir, dir);
    this->forcePersistCacheToFile();
 }
@@ -399,6 +430,8 @@ void FileManager::entryAdded(Entry* entry)
    if (!this->cacheLoading)
       this->sizeIndex.addItem(entry);
    L_DEBU("Entry added to the index");
+
+   this->findCache.entryMatchChanged(entry);
 }
 
 void FileManager::entryRemoved(Entry* entry)
@@ -412,6 +445,13 @@ void FileManager::entryRemoved(Entry* entry)
    this->extensionIndex.rmItem(entry->getExtension(), entry);
    this->sizeIndex.rmItem(entry);
    L_DEBU("Entry removed from the index");
+
+   this->findCache.entryMatchChanged(entry);
+
+   if (File* file = dynamic_cast<File*>(entry))
+      this->setDirectoryChanged(file->getDirectory());
+   else if (Directory* dir = dynamic_cast<Directory*>(entry))
+      this->setDirectoryChanged(dir, true);
 }
 
 void FileManager::entryRenamed(Entry* entry, const QString& oldName)
@@ -420,6 +460,27 @@ void FileManager::entryRenamed(Entry* entry, const QString& oldName)
    this->wordIndex.renameItem(Common::StringUtils::splitInWords(oldName), Common::StringUtils::splitInWords(entry->getName()), entry);
    this->extensionIndex.changeItem(Common::KnownExtensions::getExtension(oldName), entry->getExtension(), entry);
    L_DEBU("Entry renamed in the index");
+
+   this->findCache.entryMatchChanged(entry);
+
+   this->entryMoved(entry);
+}
+
+/**
+  * The records of a moved directory are written with its new path.
+  */
+void FileManager::entryMoved(Entry* entry)
+{
+   if (File* file = dynamic_cast<File*>(entry))
+   {
+      this->setDirectoryChanged(file->getDirectory());
+      this->findCache.entryChanged(file);
+   }
+   else if (Directory* dir = dynamic_cast<Directory*>(entry))
+   {
+      this->setDirectoryChanged(dir, true);
+      this->findCache.clear(); // The paths of all its sub entries have changed.
+   }
 }
 
 void FileManager::entryResizing(Entry* entry)
@@ -430,6 +491,7 @@ void FileManager::entryResizing(Entry* entry)
 void FileManager::entryResized(Entry* entry, qint64 oldSize)
 {
    this->sizeIndex.addItem(entry);
+   this->findCache.entryMatchChanged(entry);
 }
 
 void FileManager::chunkHashKnown(const QSharedPointer<Chunk>& chunk)
@@ -437,7 +499,14 @@ void FileManager::chunkHashKnown(const QSharedPointer<Chunk>& chunk)
    L_DEBU(QString("Adding chunk '%1' to the index . . .").arg(chunk->getHash().toStr()));
    this->chunks.add(chunk);
    L_DEBU("Chunk added to the index");
-   this->setCacheChanged();
+
+   if (File* file = chunk->getFile())
+   {
+      // The hashes restored from the file cache don't have to be written again.
+      if (!this->cacheLoading)
+         this->setDirectoryChanged(file->getDirectory());
+      this->findCache.entryChanged(file);
+   }
 }
 
 void FileManager::chunkRemoved(const QSharedPointer<Chunk>& chunk)
@@ -445,7 +514,12 @@ void FileManager::chunkRemoved(const QSharedPointer<Chunk>& chunk)
    L_DEBU(QString("Removing chunk '%1' from the index . . .").arg(chunk->getHash().toStr()));
    this->chunks.rm(chunk);
    L_DEBU("Chunk removed from the index");
-   this->setCacheChanged();
+
+   if (File* file = chunk->getFile())
+   {
+      this->setDirectoryChanged(file->getDirectory());
+      this->findCache.entryChanged(file);
+   }
 }
 
 /**
@@ -456,24 +530,27 @@ void FileManager::chunkRemoved(const QSharedPointer<Chunk>& chunk)
   */
 void FileManager::loadCacheFromFile()
 {
-   // This hashes will be unallocated by the fileUpdater.
-   Protos::FileCache::Hashes* savedCache = new Protos::FileCache::Hashes();
-
    try
    {
-      Common::PersistentData::getValue(Common::Constants::FILE_CACHE, *savedCache, Common::Global::DataFolderType::LOCAL);
-      if (static_cast<int>(savedCache->version()) != FILE_CACHE_VERSION)
+      if (!this->fileCacheLog.load())
       {
-         L_ERRO(QString("The version (%1) of the file cache \"%2\" doesn't match the current version (%3)").arg(savedCache->version()).arg(Common::Constants::FILE_CACHE).arg(FILE_CACHE_VERSION));
-         Common::PersistentData::rmValue(Common::Constants::FILE_CACHE, Common::Global::DataFolderType::LOCAL);
-         delete savedCache;
+         L_ERRO(QString("The file cache \"%1\" is corrupted or its version doesn't match the current version (%2)").arg(Common::Constants::FILE_CACHE).arg(FILE_CACHE_VERSION));
+         this->fileCacheLog.remove();
+         return;
+      }
+
+      // The hashes computed with another algorithm are useless, all the files will be hashed again.
+      if (static_cast<Common::HashAlgorithm>(this->fileCacheLog.getHeader().chunkhashalgorithm()) != Chunk::HASH_ALGORITHM)
+      {
+         L_WARN(QString("The hashes of the file cache \"%1\" have been computed with another algorithm, they are discarded").arg(Common::Constants::FILE_CACHE));
+         this->fileCacheLog.remove();
          return;
       }
 
       // Scan the shared directories and try to match the files against the saved cache.
       try
       {
-         this->cache.createSharedDirs(*savedCache);
+         this->cache.createSharedDirs(this->fileCacheLog.getHeader());
       }
       catch (DirsNotFoundException& e)
       {
@@ -485,16 +562,20 @@ void FileManager::loadCacheFromFile()
    {
       L_WARN(QString("The persisted file cache cannot be retrived (the file doesn't exist) : %1").arg(Common::Constants::FILE_CACHE));
    }
+   catch (Common::PersistentDataIOException& e)
+   {
+      L_WARN(QString("The persisted file cache cannot be retrived : %1").arg(e.message));
+   }
    catch (...)
    {
       L_WARN(QString("The persisted file cache cannot be retrived (Unkown exception) : %1").arg(Common::Constants::FILE_CACHE));
    }
 
-   this->fileUpdater.setFileCache(savedCache);
+   this->fileUpdater.setFileCache(&this->fileCacheLog);
 }
 
 /**
-  * Save the cache to a file.
+  * Save the changed directories to the file cache.
   * Restart the timer at the end of the operation.
   * Called by the fileUpdater when it needs to persist the cache.
   */
@@ -505,27 +586,30 @@ void FileManager::persistCacheToFile()
    QMutexLocker lockerCacheChanged(&this->mutexCacheChanged);
    if (this->cacheChanged && !this->cacheLoading)
    {
+      QSet<FileCacheLog::DirKey> changedDirs;
+      QSet<FileCacheLog::DirKey> changedDirTrees;
+      changedDirs.swap(this->changedDirs);
+      changedDirTrees.swap(this->changedDirTrees);
+      this->cacheChanged = false;
       lockerCacheChanged.unlock();
 
       L_DEBU("Persisting cache . . .");
 
-      Protos::FileCache::Hashes hashes;
-      this->cache.populateHashes(hashes);
-
       try
       {
-         Common::PersistentData::setValue(Common::Constants::FILE_CACHE, hashes, Common::Global::DataFolderType::LOCAL);
+         this->cache.persistHashes(this->fileCacheLog, changedDirs, changedDirTrees);
       }
       catch (Common::PersistentDataIOException& err)
       {
          L_ERRO(err.message);
+         this->fileCacheLog.abortWriting(); // The whole cache will be written next time.
+         this->setCacheChanged();
       }
 
-      lockerCacheChanged.relock();
-      this->cacheChanged = false;
-
       L_DEBU("Persisting cache finished");
    }
+   else
+      lockerCacheChanged.unlock();
 
    this->timerPersistCache.start();
 }
@@ -549,8 +633,32 @@ void FileManager::setCacheChanged()
    this->cacheChanged = true;
 }
 
+/**
+  * The directory, or the whole tree if 'wholeTree' is true, will be written in the file cache by the next 'persistCacheToFile()'.
+  * @warning Can be called from differents thread like a 'Downloader' or the 'FileUpdater'.
+  */
+void FileManager::setDirectoryChanged(Directory* dir, bool wholeTree)
+{
+   if (!dir)
+      return;
+
+   const FileCacheLog::DirKey key(dir->getRoot()->getId(), dir->getRelativePath());
+
+   QMutexLocker locker(&this->mutexCacheChanged);
+   if (wholeTree)
+      this->changedDirTrees.insert(key);
+   else
+      this->changedDirs.insert(key);
+   this->cacheChanged = true;
+}
+
 void FileManager::fileCacheLoadingComplete()
 {
+   // The records of the directories which don't exist anymore will be removed by the next compaction.
+   this->mutexPersistCache.lock();
+   this->fileCacheLog.removeUnknownDirs([this](const FileCacheLog::DirKey& key) { return this->cache.getDirectory(key) != nullptr; });
+   this->mutexPersistCache.unlock();
+
    this->timerPersistCache.start();
    this->cacheLoading = false;
 
@@ -24,6 +24,7 @@
 #include <QObject>
 #include <QSharedPointer>
 #include <QList>
+#include <QSet>
 #include <QBitArray>
 #include <QMutex>
 #include <QTimer>
@@ -38,10 +39,12 @@
 #include <priv/FileUpdater/FileUpdater.h>
 #include <priv/Cache/Cache.h>
 #include <priv/Cache/Entry.h>
+#include <priv/Cache/FileCacheLog.h>
 #include <priv/ChunkIndex/Chunks.h>
 #include <priv/WordIndex/WordIndex.h>
 #include <priv/ExtensionIndex.h>
 #include <priv/SizeIndexEntries.h>
+#include <priv/FindCache.h>
 
 namespace FM
 {
@@ -75,7 +78,10 @@ namespace FM
 
       inline QList<Protos::Common::FindResult> find(const QString& words, int maxNbResult, int maxSize) { return this->find(words, QList<QString>(), 0, std::numeric_limits<qint64>::max(), Protos::Common::FindPattern::FILE_DIR, maxNbResult, maxSize); }
       QList<Protos::Common::FindResult> find(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize);
-      QBitArray haveChunks(const QList<Common::Hash>& hashes);
+      QPair<quint64, quint64> getFindCacheStats() const;
+      QBitArray haveChunks(const QVector<Common::Hash>& hashes);
+      QBitArray haveChunks(const QVector<quint64>& hashPrefixes);
+      Common::HashesDigest getChunksDigest(quint32 n, int size);
       quint64 getAmount();
       CacheStatus getCacheStatus() const;
       int getProgress() const;
@@ -93,6 +99,7 @@ namespace FM
       void entryAdded(Entry* entry);
       void entryRemoved(Entry* entry);
       void entryRenamed(Entry* entry, const QString& oldName);
+      void entryMoved(Entry* entry);
       void entryResizing(Entry* entry);
       void entryResized(Entry* entry, qint64 oldSize);
       void chunkHashKnown(const QSharedPointer<Chunk>& chunk);
@@ -100,6 +107,7 @@ namespace FM
 
    private:
       void loadCacheFromFile();
+      void setDirectoryChanged(Directory* dir, bool wholeTree = false);
 
    private slots:
       void persistCacheToFile();
@@ -112,17 +120,22 @@ namespace FM
 
       FileUpdater fileUpdater;
       Cache cache; ///< The files and directories.
+      FileCacheLog fileCacheLog; ///< Where the hashes of the files are persisted.
       Chunks chunks; ///< The indexed chunks. It contains only completed chunks.
 
       WordIndex<Entry*> wordIndex;
       ExtensionIndex<Entry*> extensionIndex;
       SizeIndexEntries sizeIndex;
 
+      FindCache findCache; ///< The last results of 'find(..)'.
+
       QTimer timerPersistCache;
       QMutex mutexPersistCache;
       QMutex mutexCacheChanged; ///< We use a second mutex (instead of using 'mutexPersistCache') to avoid deadlock created by "File -> chunkHashKnown()" and "persistCacheToFile() -> File".
       bool cacheLoading; ///< Set to 'true' during cache loading. It avoids to persist the cache during loading.
       bool cacheChanged;
+      QSet<FileCacheLog::DirKey> changedDirs; ///< The directories to write in the file cache. Protected by 'mutexCacheChanged'.
+      QSet<FileCacheLog::DirKey> changedDirTrees; ///< The directories to write with all their sub directories. Protected by 'mutexCacheChanged'.
    };
 }
 #endif
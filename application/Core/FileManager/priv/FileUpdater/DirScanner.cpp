@@ -0,0 +1,232 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FileUpdater/DirScanner.h>
+using namespace FM;
+
+#include <QtCore/QtCore> // For the Q_OS_* defines.
+#include <QMutexLocker>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+
+#if defined(Q_OS_LINUX)
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <dirent.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#endif
+
+#include <priv/Log.h>
+#include <priv/Cache/Directory.h>
+
+/**
+  * @class FM::DirScanner
+  *
+  * A set of threads reading the content of the directories, the scanning of a tree is mostly waiting
+  * for the file system (network mounts, big arrays) thus many directories are read at the same time.
+  *
+  * The owner (see 'FileUpdater::scan(..)') gives the directories to read with 'scan(..)' and gets their
+  * entries with 'waitResult()'. The cache is only modified by the owner: when it creates a sub directory
+  * from a result it gives it back with 'scan(..)', the breadth of the tree keeps all the workers busy.
+  * The workers only share the queue of the directories to read and the list of results.
+  *
+  * On Linux the directories are read with 'getdents64' and only the files are stat'ed with 'fstatat', the
+  * type of the entries given by 'getdents64' is enough for the directories and the symbolic links.
+  * The other platforms use 'QDir'.
+  */
+
+DirScanner::DirScanner(int nbThreads) :
+   nbJobsInProgress(0), generation(0), toStop(false)
+{
+   for (int i = 0; i < nbThreads; i++)
+      this->workers << new Worker(this);
+}
+
+DirScanner::~DirScanner()
+{
+   this->mutex.lock();
+   this->toStop = true;
+   this->jobAdded.wakeAll();
+   this->mutex.unlock();
+
+   foreach (Worker* worker, this->workers)
+   {
+      worker->wait();
+      delete worker;
+   }
+}
+
+int DirScanner::getNbThreads() const
+{
+   return this->workers.size();
+}
+
+/**
+  * Ask to read the content of the given directory, the result will be returned by 'waitResult(..)'.
+  */
+void DirScanner::scan(Directory* dir)
+{
+   const Job job = { dir, dir->getFullPath() };
+
+   QMutexLocker locker(&this->mutex);
+   this->jobs.enqueue(job);
+   this->jobAdded.wakeOne();
+}
+
+/**
+  * Wait the content of one of the directories given to 'scan(..)'.
+  * @return false if there is no more directory to read.
+  */
+bool DirScanner::waitResult(Result& result)
+{
+   QMutexLocker locker(&this->mutex);
+   while (this->results.isEmpty() && (!this->jobs.isEmpty() || this->nbJobsInProgress > 0))
+      this->resultAdded.wait(&this->mutex);
+
+   if (this->results.isEmpty())
+      return false;
+
+   result = this->results.takeFirst();
+   return true;
+}
+
+/**
+  * Forget all the waiting directories and the results not yet retrieved.
+  * The directories currently read by the workers are finished but their results are dropped.
+  */
+void DirScanner::abort()
+{
+   QMutexLocker locker(&this->mutex);
+   this->jobs.clear();
+   this->results.clear();
+   this->generation++;
+}
+
+/**
+  * Return the directories and the files of the given directory like 'QDir::entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)':
+  * the hidden entries, the symbolic links and the special files (devices, sockets, fifos) are ignored.
+  * An empty list is returned if the directory can't be read.
+  */
+QList<DirScanner::Entry> DirScanner::listDir(const QString& path)
+{
+   QList<Entry> entries;
+
+#if defined(Q_OS_LINUX)
+   struct Dirent64
+   {
+      quint64 d_ino;
+      qint64 d_off;
+      unsigned short d_reclen;
+      unsigned char d_type;
+      char d_name[1];
+   };
+
+   const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (fd < 0)
+      return entries;
+
+   alignas(8) char buffer[32 * 1024];
+   long n;
+   while ((n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0)
+   {
+      for (long position = 0; position < n;)
+      {
+         const Dirent64* dirent = reinterpret_cast<const Dirent64*>(buffer + position);
+         position += dirent->d_reclen;
+
+         const char* name = dirent->d_name;
+         if (name[0] == '.') // '.', '..' and the hidden entries.
+            continue;
+
+         unsigned char type = dirent->d_type;
+         struct stat st;
+
+         // Some file systems don't give the type.
+         if (type == DT_REG || type == DT_UNKNOWN)
+         {
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+               continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+         }
+
+         if (type == DT_DIR)
+         {
+            const Entry entry = { QFile::decodeName(name), true, 0, QDateTime() };
+            entries << entry;
+         }
+         else if (type == DT_REG)
+         {
+            const Entry entry = {
+               QFile::decodeName(name),
+               false,
+               static_cast<qint64>(st.st_size),
+               QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000)
+            };
+            entries << entry;
+         }
+      }
+   }
+
+   close(fd);
+#else
+   foreach (QFileInfo fileInfo, QDir(path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)) // TODO: Add an option to follow or not symlinks.
+   {
+      const Entry entry = { fileInfo.fileName(), fileInfo.isDir(), fileInfo.isDir() ? 0 : fileInfo.size(), fileInfo.isDir() ? QDateTime() : fileInfo.lastModified() };
+      entries << entry;
+   }
+#endif
+
+   return entries;
+}
+
+/////
+
+DirScanner::Worker::Worker(DirScanner* scanner) :
+   scanner(scanner)
+{
+   this->start();
+}
+
+void DirScanner::Worker::run()
+{
+   QMutexLocker locker(&this->scanner->mutex);
+
+   forever
+   {
+      while (this->scanner->jobs.isEmpty() && !this->scanner->toStop)
+         this->scanner->jobAdded.wait(&this->scanner->mutex);
+
+      if (this->scanner->toStop)
+         return;
+
+      const Job job = this->scanner->jobs.dequeue();
+      const quint32 generation = this->scanner->generation;
+      this->scanner->nbJobsInProgress++;
+
+      locker.unlock();
+      const Result result = { job.dir, DirScanner::listDir(job.path) };
+      locker.relock();
+
+      this->scanner->nbJobsInProgress--;
+      if (generation == this->scanner->generation)
+         this->scanner->results << result;
+      this->scanner->resultAdded.wakeOne();
+   }
+}
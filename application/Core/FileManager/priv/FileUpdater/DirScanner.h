@@ -0,0 +1,97 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_DIRSCANNER_H
+#define FILEMANAGER_DIRSCANNER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QList>
+#include <QQueue>
+#include <QDateTime>
+
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class Directory;
+
+   class DirScanner : Common::Uncopyable
+   {
+   public:
+      struct Entry
+      {
+         QString name;
+         bool isDir;
+         qint64 size; ///< Only for the files.
+         QDateTime dateLastModified; ///< Only for the files.
+      };
+
+      struct Result
+      {
+         Directory* dir;
+         QList<Entry> entries;
+      };
+
+      DirScanner(int nbThreads);
+      ~DirScanner();
+
+      int getNbThreads() const;
+
+      void scan(Directory* dir);
+      bool waitResult(Result& result);
+      void abort();
+
+      static QList<Entry> listDir(const QString& path);
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(DirScanner* scanner);
+
+      protected:
+         void run();
+
+      private:
+         DirScanner* scanner;
+      };
+
+      struct Job
+      {
+         Directory* dir;
+         QString path;
+      };
+
+      QList<Worker*> workers;
+
+      QQueue<Job> jobs;
+      QList<Result> results;
+      int nbJobsInProgress;
+      quint32 generation; ///< Incremented by 'abort()', the results of the jobs started before are dropped.
+      bool toStop;
+
+      mutable QMutex mutex; ///< Protect 'jobs', 'results' and the counters.
+      QWaitCondition jobAdded;
+      QWaitCondition resultAdded;
+   };
+}
+
+#endif
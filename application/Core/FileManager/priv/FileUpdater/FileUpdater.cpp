@@ -34,6 +34,8 @@ using namespace FM;
 #include <priv/Cache/SharedDirectory.h>
 #include <priv/Cache/Directory.h>
 #include <priv/Cache/File.h>
+#include <priv/Cache/Chunk.h>
+#include <priv/Cache/FileCacheLog.h>
 #include <priv/FileUpdater/WaitCondition.h>
 
 /**
@@ -50,7 +52,10 @@ FileUpdater::FileUpdater(FileManager* fileManager) :
    progress(0),
    mutex(QMutex::Recursive),
    currentScanningDir(nullptr),
+   dirScanner(FileUpdater::getNbScanningThreads()),
+   nbEntriesScanned(0),
    toStopHashing(false),
+   fileHasherPool(FileUpdater::getNbHashingThreads()),
    remainingSizeToHash(0)
 {
    this->dirEvent = WaitCondition::getNewWaitCondition();
@@ -126,7 +131,7 @@ void FileUpdater::rmRoot(SharedDirectory* dir, Directory* dir2)
    {
       QMutexLocker locker(&this->hashingMutex);
 
-      this->fileHasher.stop();
+      this->fileHasherPool.stop();
       this->toStopHashing = true;
 
       // TODO: Find a more elegant way!
@@ -146,9 +151,9 @@ void FileUpdater::rmRoot(SharedDirectory* dir, Directory* dir2)
   * Set the file cache to retrieve the hashes frome it.
   * Muste be called before starting the fileUpdater.
   * The shared dirs in fileCache must be previously added by 'addRoot(..)'.
-  * This object must unallocated the hashes.
+  * The file cache is unloaded when all the shared directories are restored.
   */
-void FileUpdater::setFileCache(const Protos::FileCache::Hashes* fileCache)
+void FileUpdater::setFileCache(FileCacheLog* fileCache)
 {
    this->fileCacheInformation = new FileCacheInformation(fileCache);
 }
@@ -177,7 +182,7 @@ void FileUpdater::prioritizeAFileToHash(File* file)
       // Commmented to avoid this behavior:
       // When a lot of unhashed tiny file are asked the hashing process will constently abort the current hashing file
       // and will never finish it thus slow down the global hashing rate.
-      // this->fileHasher.stop();
+      // this->fileHasherPool.stop();
 
       this->toStopHashing = true;
    }
@@ -186,6 +191,29 @@ void FileUpdater::prioritizeAFileToHash(File* file)
 
 }
 
+/**
+  * The number of threads used to compute the hashes, see the setting 'number_of_hashing_thread'.
+  */
+int FileUpdater::getNbHashingThreads()
+{
+   const int nbThreads = SETTINGS.get<quint32>("number_of_hashing_thread");
+   if (nbThreads > 0)
+      return nbThreads;
+   return qMax(1, QThread::idealThreadCount());
+}
+
+/**
+  * The number of threads used to read the directories, see the setting 'number_of_scanning_thread'.
+  * The threads mostly wait for the file system thus there is more threads than processor cores.
+  */
+int FileUpdater::getNbScanningThreads()
+{
+   const int nbThreads = SETTINGS.get<quint32>("number_of_scanning_thread");
+   if (nbThreads > 0)
+      return nbThreads;
+   return qMax(4, 2 * QThread::idealThreadCount());
+}
+
 bool FileUpdater::isScanning() const
 {
    QMutexLocker scanningLocker(&this->scanningMutex);
@@ -204,6 +232,19 @@ int FileUpdater::getProgress() const
    return this->progress;
 }
 
+/**
+  * Return the number of entries (files and directories) scanned per second by the current scanning, 0 if there is no scanning.
+  */
+int FileUpdater::getScanRate() const
+{
+   QMutexLocker scanningLocker(&this->scanningMutex);
+   if (!this->currentScanningDir)
+      return 0;
+
+   const qint64 elapsed = this->scanningTimer.elapsed();
+   return elapsed == 0 ? 0 : 1000LL * this->nbEntriesScanned / elapsed;
+}
+
 void FileUpdater::run()
 {
    this->timerScanUnwatchable.start();
@@ -315,6 +356,8 @@ void FileUpdater::run()
 
 /**
   * It will take some files from 'filesWithoutHashesPrioritized' or 'fileWithoutHashes' and compute theirs hashes.
+  * The chunks are given to the workers of 'fileHasherPool', thus many files and many chunks of the same file
+  * can be hashed in parallel. When this method returns there is no more chunk being hashed.
   * The minimum duration of the compuation is equal to the setting 'minimum_duration_when_hashing'.
   */
 void FileUpdater::computeSomeHashes()
@@ -335,59 +378,58 @@ void FileUpdater::computeSomeHashes()
    QElapsedTimer timer;
    timer.start();
 
-   // We take the file from the prioritized list first.
-   QList<QList<File*>*> fileLists { &this->filesWithoutHashesPrioritized, &this->filesWithoutHashes };
-   for (QMutableListIterator<QList<File*>*> i(fileLists); i.hasNext();)
-   {
-      QList<File*>* fileList = i.next();
-      while (!fileList->empty())
-      {
-         File* nextFileToHash = fileList->first();
+   bool toStop = false; // Once set, no more chunk is given to the workers, we only wait the current ones.
 
-         if (nextFileToHash->isComplete()) // A file can change its state from 'completed' to 'unfinished' if it's redownloaded.
+   forever
+   {
+      if (!toStop)
+         while (this->fileHasherPool.hasAnIdleWorker())
          {
-            locker.unlock();
-            bool gotAllHashes;
-            try
-            {
-               int hashedAmount = 0;
-               gotAllHashes = this->fileHasher.start(nextFileToHash->asFileForHasher(), 1, &hashedAmount); // Be carreful of methods 'prioritizeAFileToHash(..)' and 'rmRoot(..)' called concurrently here.
-               this->remainingSizeToHash -= hashedAmount;
-               this->updateHashingProgress();
-            }
-            catch (IOErrorException&)
-            {
-               gotAllHashes = true; // The hashes may be recomputed when a peer ask the hashes with a GET_HASHES request.
-            }
-            locker.relock();
+            File* file;
+            int chunkNum;
+            if (!this->nextChunkToHash(file, chunkNum))
+               break;
+            this->fileHasherPool.hash(file, chunkNum);
+         }
 
-            // The current hashing file may have been removed from 'filesWithoutHashes' or 'filesWithoutHashesPrioritized' by 'rmRoot(..)'.
-            if (gotAllHashes && !fileList->isEmpty() && fileList->first() == nextFileToHash)
-               fileList->removeFirst();
+      if (this->fileHasherPool.getNbActiveWorkers() == 0)
+         break;
 
-            // Special case for the prioritized list, we put the file at the end after the computation of a hash.
-            else if (fileList == &this->filesWithoutHashesPrioritized && fileList->size() > 1 && fileList->first() == nextFileToHash)
-               fileList->move(0, fileList->size() - 1);
-         }
-         else
-         {
-            this->remainingSizeToHash -= fileList->first()->getSize();
-            fileList->removeFirst();
-         }
+      locker.unlock();
+      const FileHasherPool::Result result = this->fileHasherPool.waitResult(); // Be carreful of methods 'prioritizeAFileToHash(..)' and 'rmRoot(..)' called concurrently here.
+      locker.relock();
 
-         if (this->toStopHashing)
+      this->remainingSizeToHash -= result.amountHashed;
+      this->updateHashingProgress();
+
+      // The file may have been removed from 'filesWithoutHashes' or 'filesWithoutHashesPrioritized' by 'rmRoot(..)'.
+      QList<File*>* fileList =
+         this->filesWithoutHashesPrioritized.contains(result.file) ? &this->filesWithoutHashesPrioritized :
+         this->filesWithoutHashes.contains(result.file) ? &this->filesWithoutHashes : nullptr;
+
+      if (fileList)
+      {
+         // In case of error the hashes may be recomputed when a peer ask the hashes with a GET_HASHES request.
+         if (result.error || ((result.lastChunkHashed || !this->fileHasherPool.isHashing(result.file)) && result.file->hasAllHashes()))
          {
-            this->toStopHashing = false;
-            goto end;
+            fileList->removeOne(result.file);
          }
+         // Special case for the prioritized list, we put the file at the end after the computation of a hash.
+         else if (fileList == &this->filesWithoutHashesPrioritized && fileList->size() > 1 && fileList->first() == result.file)
+            fileList->move(0, fileList->size() - 1);
+      }
 
-         static const quint32 MINIMUM_DURATION_WHEN_HASHING = SETTINGS.get<quint32>("minimum_duration_when_hashing");
-         if (static_cast<quint32>(timer.elapsed()) >= MINIMUM_DURATION_WHEN_HASHING)
-            goto end;
+      if (this->toStopHashing)
+      {
+         this->toStopHashing = false;
+         toStop = true;
       }
+
+      static const quint32 MINIMUM_DURATION_WHEN_HASHING = SETTINGS.get<quint32>("minimum_duration_when_hashing");
+      if (static_cast<quint32>(timer.elapsed()) >= MINIMUM_DURATION_WHEN_HASHING)
+         toStop = true;
    }
 
-end:
    L_DEBU(QString("Computing some hashes ended. this->filesWithoutHashes.size(): %1, this->filesWithoutHashesPrioritized.size(): %2").arg(this->filesWithoutHashes.size()).arg(this->filesWithoutHashesPrioritized.size()));
 
    if (this->filesWithoutHashes.isEmpty() && this->filesWithoutHashesPrioritized.isEmpty())
@@ -397,6 +439,71 @@ end:
    }
 }
 
+/**
+  * Look for the next chunk to give to the hasher pool. The prioritized files are taken first.
+  * The last chunk of a file is only given when no other chunk of the same file is being hashed and no other chunk is given while it's hashed, see 'FileHasherPool'.
+  * The files which aren't complete anymore are removed from the lists.
+  * 'hashingMutex' must be locked.
+  * @return 'false' if there is no chunk to hash for the moment.
+  */
+bool FileUpdater::nextChunkToHash(File*& file, int& chunkNum)
+{
+   QList<QList<File*>*> fileLists { &this->filesWithoutHashesPrioritized, &this->filesWithoutHashes };
+   for (QListIterator<QList<File*>*> i(fileLists); i.hasNext();)
+   {
+      QList<File*>* fileList = i.next();
+      for (QMutableListIterator<File*> j(*fileList); j.hasNext();)
+      {
+         File* f = j.next();
+
+         if (!f->isComplete()) // A file can change its state from 'completed' to 'unfinished' if it's redownloaded.
+         {
+            if (!this->fileHasherPool.isHashing(f))
+            {
+               this->remainingSizeToHash -= f->getSize();
+               j.remove();
+            }
+            continue;
+         }
+
+         const QVector<QSharedPointer<Chunk>>& chunks = f->getChunks();
+         const bool fileBeingHashed = this->fileHasherPool.isHashing(f);
+
+         // An empty chunk list means we don't know the size of the file, it will be handled like the last chunk.
+         if (chunks.isEmpty())
+         {
+            if (fileBeingHashed)
+               continue;
+            file = f;
+            chunkNum = 0;
+            return true;
+         }
+
+         // The last chunk may add or remove some chunks, no other chunk is given until it's done.
+         if (fileBeingHashed && this->fileHasherPool.isHashing(f, chunks.size() - 1))
+            continue;
+
+         for (int k = 0; k < chunks.size(); k++)
+         {
+            const bool isLastChunk = k == chunks.size() - 1;
+
+            // A full chunk already hashed is skipped. The last one is always recomputed because maybe the file has grown.
+            if ((!isLastChunk && chunks[k]->hasHash() && chunks[k]->getKnownBytes() == Chunk::CHUNK_SIZE) || this->fileHasherPool.isHashing(f, k))
+               continue;
+
+            if (isLastChunk && fileBeingHashed)
+               break;
+
+            file = f;
+            chunkNum = k;
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
 void FileUpdater::updateHashingProgress()
 {
    const quint64 totalAmountOfData = this->fileManager->getAmount();
@@ -413,7 +520,7 @@ void FileUpdater::stopHashing()
    QMutexLocker lockerHashing(&this->hashingMutex);
    L_DEBU("Stop hashing . . .");
 
-   this->fileHasher.stop();
+   this->fileHasherPool.stop();
 
    L_DEBU("Hashing stopped");
    this->toStopHashing = true;
@@ -425,6 +532,7 @@ void FileUpdater::stopHashing()
   * in dir. Create the associated cached tree structure under the
   * given 'Directory*'.
   * The directories may already exist in the cache.
+  * The directories are read in parallel by 'dirScanner', the cache is only modified by this thread.
   */
 void FileUpdater::scan(Directory* dir, bool addUnfinished)
 {
@@ -432,41 +540,46 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
 
    this->scanningMutex.lock();
    this->currentScanningDir = dir;
+   this->nbEntriesScanned = 0;
+   this->scanningTimer.start();
    this->scanningMutex.unlock();
 
-   QLinkedList<Directory*> dirsToVisit;
-   dirsToVisit << dir;
+   this->dirScanner.scan(dir);
 
-   while (!dirsToVisit.isEmpty())
+   DirScanner::Result result;
+   while (this->dirScanner.waitResult(result))
    {
-      Directory* currentDir = dirsToVisit.takeFirst();
+      Directory* currentDir = result.dir;
 
       QLinkedList<Directory*> currentSubDirs = currentDir->getSubDirs();
       QList<File*> currentFiles = currentDir->getCompleteFiles(); // We don't care about the unfinished files.
 
-      foreach (QFileInfo entry, QDir(currentDir->getFullPath()).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::NoSymLinks)) // TODO: Add an option to follow or not symlinks.
+      foreach (DirScanner::Entry entry, result.entries)
       {
          QMutexLocker locker(&this->scanningMutex);
 
          if (!this->currentScanningDir || this->toStop)
          {
             L_DEBU("Scanning aborted : " + dir->getFullPath());
+            this->dirScanner.abort();
             this->currentScanningDir = nullptr;
             this->scanningStopped.wakeOne();
             return;
          }
 
-         if (entry.isDir())
+         this->nbEntriesScanned++;
+
+         if (entry.isDir)
          {
-            Directory* dir = currentDir->createSubDir(entry.fileName());
+            Directory* dir = currentDir->createSubDir(entry.name);
             dir->setScanned(false);
-            dirsToVisit << dir;
+            this->dirScanner.scan(dir);
 
             currentSubDirs.removeOne(dir);
          }
-         else if (addUnfinished || !Global::isFileUnfinished(entry.fileName()))
+         else if (addUnfinished || !Global::isFileUnfinished(entry.name))
          {
-            File* file = currentDir->getFile(entry.fileName());
+            File* file = currentDir->getFile(entry.name);
             QMutexLocker locker(&this->mutex);
 
             // Only used when loading the cache to compute the progress.
@@ -482,7 +595,7 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
                    !this->filesWithoutHashes.contains(file) && // The case where a file is being copied and a lot of modification event is thrown (thus the file is in this->filesWithoutHashes).
                    !this->filesWithoutHashesPrioritized.contains(file) &&
                    file->isComplete() &&
-                   !file->correspondTo(entry, file->hasAllHashes()) // If the hashes of a file can't be computed (IO error, the file is being written for example) we only compare their sizes.
+                   !file->correspondTo(entry.size, entry.dateLastModified, file->hasAllHashes()) // If the hashes of a file can't be computed (IO error, the file is being written for example) we only compare their sizes.
                )
                   file = nullptr;
                else
@@ -494,9 +607,9 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
                // Very special case : there is a file 'a' without File* in cache and a file 'a.unfinished'.
                // This case occure when a file is redownloaded, the File* 'a' is renamed as 'a.unfinished' but the physical file 'a'
                // is not deleted.
-               File* unfinishedFile = currentDir->getFile(entry.fileName().append(Global::getUnfinishedSuffix()));
+               File* unfinishedFile = currentDir->getFile(QString(entry.name).append(Global::getUnfinishedSuffix()));
                if (!unfinishedFile)
-                  file = new File(currentDir, entry.fileName(), entry.size(), entry.lastModified());
+                  file = new File(currentDir, entry.name, entry.size, entry.dateLastModified);
                else
                {
                   currentFiles.removeOne(unfinishedFile);
@@ -523,7 +636,9 @@ void FileUpdater::scan(Directory* dir, bool addUnfinished)
       currentDir->setScanned(true);
    }
 
+   const int scanRate = this->getScanRate(); // Takes 'scanningMutex'.
    this->scanningMutex.lock();
+   L_DEBU(QString("%1 entries scanned at %2 entries/s").arg(this->nbEntriesScanned).arg(scanRate));
    this->currentScanningDir = nullptr;
    this->scanningStopped.wakeOne();
    this->scanningMutex.unlock();
@@ -639,23 +754,17 @@ void FileUpdater::restoreFromFileCache(SharedDirectory* dir)
       return;
    }
 
-   for (int i = 0; i < this->fileCacheInformation->getFileCache()->shareddir_size(); i++)
-      if (this->fileCacheInformation->getFileCache()->shareddir(i).id().hash() == dir->getId())
-      {
-         QSet<File*> filesWithHashes = dir->restoreFromFileCache(this->fileCacheInformation->getFileCache()->shareddir(i).root()).toSet();
-
-         for (QMutableListIterator<File*> i(this->filesWithoutHashes); i.hasNext();)
-         {
-            File* f = i.next();
-            if (filesWithHashes.contains(f))
-            {
-               this->remainingSizeToHash -= f->getSize();
-               i.remove();
-            }
-         }
+   QSet<File*> filesWithHashes = dir->restoreFromFileCache(*this->fileCacheInformation->getFileCache()).toSet();
 
-         break;
+   for (QMutableListIterator<File*> i(this->filesWithoutHashes); i.hasNext();)
+   {
+      File* f = i.next();
+      if (filesWithHashes.contains(f))
+      {
+         this->remainingSizeToHash -= f->getSize();
+         i.remove();
       }
+   }
 
    L_DEBU("Restoring terminated: " + dir->getFullPath());
 }
@@ -745,16 +854,14 @@ bool FileUpdater::processEvents(const QList<WatcherEvent>& events)
 
 /////
 
-FileUpdater::FileCacheInformation::FileCacheInformation(const Protos::FileCache::Hashes* fileCache) :
-   fileCache(fileCache), fileCacheNbFiles(0), fileCacheNbFilesLoaded(0)
+FileUpdater::FileCacheInformation::FileCacheInformation(FileCacheLog* fileCache) :
+   fileCache(fileCache), fileCacheNbFiles(fileCache->getNbFiles()), fileCacheNbFilesLoaded(0)
 {
-   for (int i = 0; i < this->fileCache->shareddir_size(); i++)
-      this->computeFileCacheNbFiles(this->fileCache->shareddir(i).root());
 }
 
 FileUpdater::FileCacheInformation::~FileCacheInformation()
 {
-   delete this->fileCache;
+   this->fileCache->unload();
 }
 
 void FileUpdater::FileCacheInformation::newFile()
@@ -764,7 +871,7 @@ void FileUpdater::FileCacheInformation::newFile()
    this->fileCacheNbFilesLoaded++;
 }
 
-const Protos::FileCache::Hashes* FileUpdater::FileCacheInformation::getFileCache()
+const FileCacheLog* FileUpdater::FileCacheInformation::getFileCache()
 {
    return this->fileCache;
 }
@@ -778,11 +885,3 @@ int FileUpdater::FileCacheInformation::getProgress() const
       return 0;
    return 10000LL * this->fileCacheNbFilesLoaded / this->fileCacheNbFiles;
 }
-
-void FileUpdater::FileCacheInformation::computeFileCacheNbFiles(const Protos::FileCache::Hashes::Dir& dir)
-{
-   for (int i = 0; i < dir.dir_size(); i++)
-      this->computeFileCacheNbFiles(dir.dir(i));
-
-   this->fileCacheNbFiles += dir.file_size();
-}
@@ -29,7 +29,8 @@
 #include <Protos/files_cache.pb.h>
 
 #include <priv/FileUpdater/DirWatcher.h>
-#include <priv/Cache/FileHasher.h>
+#include <priv/FileUpdater/DirScanner.h>
+#include <priv/Cache/FileHasherPool.h>
 
 namespace FM
 {
@@ -39,6 +40,7 @@ namespace FM
    class File;
    class Entry;
    class WaitCondition;
+   class FileCacheLog;
 
    class FileUpdater : public QThread
    {
@@ -49,12 +51,13 @@ namespace FM
       ~FileUpdater();
 
       void stop();
-      void setFileCache(const Protos::FileCache::Hashes* fileCache);
+      void setFileCache(FileCacheLog* fileCache);
       void prioritizeAFileToHash(File* file);
 
       bool isScanning() const;
       bool isHashing() const;
       int getProgress() const;
+      int getScanRate() const;
 
    public slots:
       void addRoot(SharedDirectory* dir);
@@ -69,6 +72,7 @@ namespace FM
 
    private:
       void computeSomeHashes();
+      bool nextChunkToHash(File*& file, int& chunkNum);
       void updateHashingProgress();
 
       void stopHashing();
@@ -83,6 +87,9 @@ namespace FM
 
       void restoreFromFileCache(SharedDirectory* dir);
 
+      static int getNbHashingThreads();
+      static int getNbScanningThreads();
+
       bool processEvents(const QList<WatcherEvent>& events);
 
       const int SCAN_PERIOD_UNWATCHABLE_DIRS;
@@ -93,17 +100,15 @@ namespace FM
       class FileCacheInformation
       {
       public:
-         FileCacheInformation(const Protos::FileCache::Hashes* fileCache);
+         FileCacheInformation(FileCacheLog* fileCache);
          ~FileCacheInformation();
 
          void newFile();
-         const Protos::FileCache::Hashes* getFileCache();
+         const FileCacheLog* getFileCache();
          int getProgress() const;
 
       private:
-         void computeFileCacheNbFiles(const Protos::FileCache::Hashes::Dir& dir);
-
-         const Protos::FileCache::Hashes* fileCache; ///< The hashes from the saved file cache. Used only temporally at the begining of 'run()'.
+         FileCacheLog* fileCache; ///< The hashes from the saved file cache. Used only temporally at the begining of 'run()'.
          int fileCacheNbFiles;
          int fileCacheNbFilesLoaded;
       };
@@ -122,10 +127,13 @@ namespace FM
       Directory* currentScanningDir;
       QWaitCondition scanningStopped;
       mutable QMutex scanningMutex;
+      DirScanner dirScanner;
+      quint64 nbEntriesScanned; ///< During the current scanning, protected by 'scanningMutex'.
+      QElapsedTimer scanningTimer;
 
       mutable QMutex hashingMutex;
       bool toStopHashing;
-      FileHasher fileHasher;
+      FileHasherPool fileHasherPool;
 
       QList<SharedDirectory*> dirsToRemove;
 
@@ -0,0 +1,217 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FindCache.h>
+using namespace FM;
+
+#include <QMutexLocker>
+#include <QDataStream>
+
+#include <Common/StringUtils.h>
+
+#include <priv/Cache/Entry.h>
+#include <priv/Cache/File.h>
+#include <priv/Cache/Directory.h>
+
+/**
+  * @class FM::FindCache
+  *
+  * The last results of 'FileManager::find(..)', the same searches are often sent by many peers at the same time.
+  * The least recently used pattern is forgotten when there is more than 'MAX_NB_PATTERNS' patterns.
+  *
+  * A result is removed when one of its entries changes ('entryChanged(..)') or when an entry which may be found
+  * by its pattern is added, removed or renamed ('entryMatchChanged(..)'). A pattern given to 'get(..)' is kept
+  * as not ready until its result is given to 'put(..)' with the token returned by 'get(..)'. The entries of a result
+  * being computed aren't known: any change removes it and its result isn't kept, even if the pattern has been asked again.
+  */
+
+FindCache::Pattern::Pattern(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize) :
+   words(Common::StringUtils::splitInWords(words)),
+   extensions(extensions),
+   minFileSize(minFileSize),
+   maxFileSize(maxFileSize),
+   category(category),
+   maxNbResult(maxNbResult),
+   maxSize(maxSize)
+{
+   qSort(this->extensions);
+
+   QDataStream stream(&this->key, QIODevice::WriteOnly);
+   stream << this->words << this->extensions << this->minFileSize << this->maxFileSize << static_cast<qint32>(this->category) << this->maxNbResult << this->maxSize;
+}
+
+FindCache::FindCache(int maxNbPatterns) :
+   MAX_NB_PATTERNS(maxNbPatterns), useCounter(0), tokenCounter(0), nbHits(0), nbMisses(0)
+{
+}
+
+/**
+  * @param[out] token Set when the result isn't known, it must be given to 'put(..)'.
+  * @return 'true' if the result of the pattern is known. Otherwise the result should be given later to 'put(..)'.
+  */
+bool FindCache::get(const Pattern& pattern, QList<Protos::Common::FindResult>& results, quint64& token)
+{
+   QMutexLocker locker(&this->mutex);
+
+   token = 0;
+
+   if (this->MAX_NB_PATTERNS == 0)
+      return false;
+
+   QHash<QByteArray, Item>::iterator item = this->items.find(pattern.key);
+   if (item != this->items.end())
+   {
+      item->lastUse = ++this->useCounter;
+      if (item->ready)
+      {
+         this->nbHits++;
+         results = item->results;
+         return true;
+      }
+      token = item->token;
+   }
+   else
+   {
+      if (this->items.size() >= this->MAX_NB_PATTERNS)
+         this->removeLeastRecentlyUsed();
+
+      token = ++this->tokenCounter;
+      const Item newItem = { pattern, false, token, QList<Protos::Common::FindResult>(), QSet<const Entry*>(), ++this->useCounter };
+      this->items.insert(pattern.key, newItem);
+   }
+
+   this->nbMisses++;
+   return false;
+}
+
+/**
+  * The result is dropped if an entry has changed since the call to 'get(..)'.
+  * @param token The one given by 'get(..)'.
+  * @param entries The entries of the result.
+  */
+void FindCache::put(const Pattern& pattern, quint64 token, const QList<Protos::Common::FindResult>& results, const QList<const Entry*>& entries)
+{
+   QMutexLocker locker(&this->mutex);
+
+   QHash<QByteArray, Item>::iterator item = this->items.find(pattern.key);
+   if (item == this->items.end() || item->ready || item->token != token)
+      return;
+
+   item->ready = true;
+   item->results = results;
+   item->entries = entries.toSet();
+}
+
+/**
+  * The data of an entry has changed (for example its hashes), the results containing it and the ones being computed are removed.
+  */
+void FindCache::entryChanged(const Entry* entry)
+{
+   QMutexLocker locker(&this->mutex);
+
+   for (QMutableHashIterator<QByteArray, Item> i(this->items); i.hasNext();)
+   {
+      const Item& item = i.next().value();
+      if (!item.ready || item.entries.contains(entry))
+         i.remove();
+   }
+}
+
+/**
+  * An entry has been added, removed, renamed or resized, the results containing it or whose pattern may find it are removed.
+  */
+void FindCache::entryMatchChanged(const Entry* entry)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->items.isEmpty())
+      return;
+
+   const QStringList& entryWords = Common::StringUtils::splitInWords(entry->getNameWithoutExtension());
+
+   for (QMutableHashIterator<QByteArray, Item> i(this->items); i.hasNext();)
+   {
+      const Item& item = i.next().value();
+      if (!item.ready || item.entries.contains(entry) || FindCache::match(item.pattern, entry, entryWords))
+         i.remove();
+   }
+}
+
+void FindCache::clear()
+{
+   QMutexLocker locker(&this->mutex);
+   this->items.clear();
+}
+
+/**
+  * The number of calls to 'get(..)' which have found a result.
+  */
+quint64 FindCache::getNbHits() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbHits;
+}
+
+quint64 FindCache::getNbMisses() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbMisses;
+}
+
+/**
+  * Return 'true' if the entry may be found by the pattern. An entry matches the words of a pattern if one of
+  * its words begins with one of the words of the pattern, it may give more entries than the word index.
+  */
+bool FindCache::match(const Pattern& pattern, const Entry* entry, const QStringList& entryWords)
+{
+   if (
+      pattern.category == Protos::Common::FindPattern::FILE && !dynamic_cast<const File*>(entry) ||
+      pattern.category == Protos::Common::FindPattern::DIR && !dynamic_cast<const Directory*>(entry)
+   )
+      return false;
+
+   if (!pattern.extensions.isEmpty() && !pattern.extensions.contains(entry->getExtension()))
+      return false;
+
+   if (entry->getSize() < pattern.minFileSize || entry->getSize() > pattern.maxFileSize)
+      return false;
+
+   if (pattern.words.isEmpty())
+      return true;
+
+   for (QStringListIterator i(pattern.words); i.hasNext();)
+   {
+      const QString& word = i.next();
+      for (QStringListIterator j(entryWords); j.hasNext();)
+         if (j.next().startsWith(word))
+            return true;
+   }
+
+   return false;
+}
+
+void FindCache::removeLeastRecentlyUsed()
+{
+   QHash<QByteArray, Item>::iterator leastRecentlyUsed = this->items.begin();
+   for (QHash<QByteArray, Item>::iterator i = this->items.begin(); i != this->items.end(); ++i)
+      if (i->lastUse < leastRecentlyUsed->lastUse)
+         leastRecentlyUsed = i;
+
+   if (leastRecentlyUsed != this->items.end())
+      this->items.erase(leastRecentlyUsed);
+}
@@ -0,0 +1,95 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_FINDCACHE_H
+#define FILEMANAGER_FINDCACHE_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+
+#include <Protos/common.pb.h>
+
+#include <Common/Uncopyable.h>
+
+namespace FM
+{
+   class Entry;
+
+   class FindCache : Common::Uncopyable
+   {
+   public:
+      struct Pattern
+      {
+         Pattern(const QString& words, const QList<QString>& extensions, qint64 minFileSize, qint64 maxFileSize, Protos::Common::FindPattern_Category category, int maxNbResult, int maxSize);
+
+         QStringList words; ///< Split and normalized, see 'Common::StringUtils::splitInWords(..)'.
+         QList<QString> extensions; ///< Sorted.
+         qint64 minFileSize;
+         qint64 maxFileSize;
+         Protos::Common::FindPattern_Category category;
+         int maxNbResult;
+         int maxSize;
+
+         QByteArray key;
+      };
+
+      FindCache(int maxNbPatterns);
+
+      bool get(const Pattern& pattern, QList<Protos::Common::FindResult>& results, quint64& token);
+      void put(const Pattern& pattern, quint64 token, const QList<Protos::Common::FindResult>& results, const QList<const Entry*>& entries);
+
+      void entryChanged(const Entry* entry);
+      void entryMatchChanged(const Entry* entry);
+      void clear();
+
+      quint64 getNbHits() const;
+      quint64 getNbMisses() const;
+
+   private:
+      struct Item
+      {
+         Pattern pattern;
+         bool ready; ///< 'false' while the result is being computed.
+         quint64 token; ///< Given by 'get(..)' when the item is created, 'put(..)' must give the same.
+         QList<Protos::Common::FindResult> results;
+         QSet<const Entry*> entries;
+         quint64 lastUse;
+      };
+
+      static bool match(const Pattern& pattern, const Entry* entry, const QStringList& entryWords);
+      void removeLeastRecentlyUsed();
+
+      const int MAX_NB_PATTERNS;
+
+      QHash<QByteArray, Item> items;
+      quint64 useCounter;
+      quint64 tokenCounter;
+
+      quint64 nbHits;
+      quint64 nbMisses;
+
+      mutable QMutex mutex;
+   };
+}
+
+#endif
@@ -25,6 +25,8 @@
 
 #include <Protos/core_protocol.pb.h>
 
+#include <Common/ProtoHelper.h>
+
 #include <priv/Cache/File.h>
 #include <priv/Cache/Chunk.h>
 #include <priv/Log.h>
@@ -64,9 +66,10 @@ Protos::Core::GetHashesResult GetHashesResult::start()
    }
    const QVector<QSharedPointer<Chunk>>& chunks = this->file->getChunks();
 
-   if (this->fileEntry.chunk_size() != chunks.size())
+   // The entry may have less chunks than the file, the entries of the search results only have the first one.
+   if (this->fileEntry.chunk_size() > chunks.size())
    {
-      L_ERRO("The number of chunks of the given file entry doesn't match the cache file number.");
+      L_ERRO("The number of chunks of the given file entry is greater than the cache file number.");
       result.set_status(Protos::Core::GetHashesResult_Status_ERROR_UNKNOWN);
       return result;
    }
@@ -82,9 +85,10 @@ Protos::Core::GetHashesResult GetHashesResult::start()
       for (QVectorIterator<QSharedPointer<Chunk>> i(chunks); i.hasNext();)
       {
          auto chunk = i.next();
-         const Protos::Common::Hash& protoChunk = this->fileEntry.chunk(j++);
+         const bool hashKnown = j < this->fileEntry.chunk_size() && this->fileEntry.chunk(j).has_hash();
+         j++;
 
-         if (!protoChunk.has_hash())
+         if (!hashKnown)
          {
             nbOfHashWillBeSent++;
             if (chunk->hasHash())
@@ -136,6 +140,6 @@ void GetHashesResult::sendNextHash(QSharedPointer<Chunk> chunk, bool direct)
 
    Protos::Core::HashResult hashResult;
    hashResult.set_num(chunk->getNum());
-   hashResult.mutable_hash()->set_hash(chunk->getHash().getData(), Common::Hash::HASH_SIZE);
+   Common::ProtoHelper::setHash(*hashResult.mutable_hash(), chunk->getHash());
    emit nextHash(hashResult);
 }
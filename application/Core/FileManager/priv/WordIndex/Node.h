@@ -21,18 +21,29 @@
 
 #include <functional>
 
+#include <algorithm>
+
 #include <QList>
+#include <QVector>
 #include <QSet>
 #include <QString>
-#include <QPair>
+#include <QChar>
 
 #include <Common/Uncopyable.h>
-#include <Common/StringUtils.h>
+
+#include <priv/WordIndex/SmallVector.h>
 
 /**
   * @class FM::Node
   *
   * Indexed item by string, see the class 'WordIndex' for more explanations.
+  *
+  * The nodes form a radix tree: each node owns the part of the words between its parent and itself.
+  * A node is a single allocation most of the time, its part, its children and its items are kept in
+  * 'SmallVector's which only use the heap when they outgrow their inline capacity.
+  * The children are sorted by their first character, this character is kept in a separate array ('keys')
+  * to find the child to follow without touching the other children.
+  * The items of a node are sorted, the posting list of a word is a merge of the items of its nodes, see 'search(..)'.
   */
 
 namespace FM
@@ -42,30 +53,11 @@ namespace FM
    {
       NodeResult() : level(0) {}
       NodeResult(T v, bool level = 0) : value(v), level(level) {}
-      static void intersect(QSet<NodeResult<T>>& s1, const QSet<NodeResult<T>>& s2, int matchValue);
 
       T value;
       int level;
    };
 
-   /**
-     * s1 <- s1 & s2.
-     * For all common items the 'level' fields are summed.
-     */
-   template <typename T>
-   void NodeResult<T>::intersect(QSet<NodeResult<T>>& s1, const QSet<NodeResult<T>>& s2, int matchValue)
-   {
-      for (QMutableSetIterator<NodeResult<T>> i(s1); i.hasNext();)
-      {
-         const NodeResult<T>& node = i.next();
-         typename QSet<NodeResult<T>>::const_iterator j = s2.find(node);
-         if (j == s2.constEnd())
-            i.remove();
-         else
-            const_cast<NodeResult<T>&>(node).level += j->level ? matchValue : 0;
-      }
-   }
-
    /**
      * To sort from the best level (the lowest value) to the worse (the hightest value).
      */
@@ -101,7 +93,7 @@ namespace FM
 
       /**
         * Add an item to the node.
-        * If the item already exists (using operator==) nothing is added.
+        * If the item already exists it's added one more time.
         */
       void addItem(const QStringRef& word, const T& item);
 
@@ -112,26 +104,36 @@ namespace FM
       bool rmItem(const QString& word, const T& item);
 
       QList<NodeResult<T>> search(const QString& word, bool alsoFromSubNodes = false, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
+      void search(const QString& word, bool alsoFromSubNodes, std::function<bool(const T&)> predicat, QVector<NodeResult<T>>& result) const;
 
       QString toStringDebug() const;
 
    private:
-      Node(const QString& part);
-      Node(const QString& part, const T& item);
+      Node(const QChar* part, int size);
+
+      int childIndex(QChar c) const;
+      void insertChild(Node<T>* child);
+      int commonPrefix(const QChar* word, int size) const;
+      void mergeChild();
 
-      QPair<Node<T>*, int> getNode(const QString& word, bool exactMatch = false) const;
+      const Node<T>* getNode(const QString& word, bool exactMatch) const;
 
       /**
         * Return all items from the current node and its sub nodes (recursively) if 'alsoFromSubNodes' is true.
         * For all direct sub nodes NodeResult::level is set to 0, for other sub nodes level is set to 1.
         */
-      QList<NodeResult<T>> getItems(bool alsoFromSubNodes = false, int maxNbResult = -1, std::function<bool(const T&)> predicat = nullptr) const;
+      template <typename Container>
+      void getItems(bool alsoFromSubNodes, int maxNbResult, std::function<bool(const T&)> predicat, Container& result) const;
+
+      void getPostingList(bool alsoFromSubNodes, std::function<bool(const T&)> predicat, QVector<NodeResult<T>>& result) const;
+      void insertItem(const T& item);
 
-      void remove(int i);
+      static const int LINEAR_SEARCH_MAX_NB_CHILDREN = 8; ///< Below this number of children 'keys' is scanned rather than bisected.
 
-      QString part;
-      QList<Node<T>*> children; ///< The children nodes.
-      QList<T> items; ///< The indexed items.
+      SmallVector<QChar, 8> part;
+      SmallVector<QChar, 4> keys; ///< The first character of each child, sorted.
+      SmallVector<Node<T>*, 1> children; ///< The children nodes, in the same order as 'keys'.
+      SmallVector<T, 1> items; ///< The indexed items, sorted.
    };
 }
 
@@ -140,95 +142,128 @@ FM::Node<T>::Node()
 {
 }
 
-
 template <typename T>
 FM::Node<T>::~Node()
 {
-   for (QListIterator<Node<T>*>i(this->children); i.hasNext();)
-      delete i.next();
+   for (int i = 0; i < this->children.size(); i++)
+      delete this->children[i];
 }
 
 template <typename T>
 void FM::Node<T>::addItem(const QStringRef& word, const T& item)
 {
-   if (this->children.isEmpty())
-   {
-      this->children << new Node(word.toString(), item);
-   }
-   else
+   const QChar* chars = word.unicode();
+   const int size = word.size();
+   if (size == 0)
+      return;
+
+   Node<T>* node = this;
+   int position = 0;
+   while (position < size)
    {
-      for (int i = 0; i < this->children.size(); ++i)
+      const int i = node->childIndex(chars[position]);
+      if (i == -1)
       {
-         Node<T>* child = this->children[i];
-         const int p = Common::StringUtils::commonPrefix(word, &child->part);
-         if (p != 0)
-         {
-            if (p == word.size())
-            {
-                // The word and the sub-part are equal.
-               if (p == child->part.size())
-               {
-                  child->items << item;
-               }
-               else // The word is the begining of the the sub-part.
-               {
-                  Node<T>* newNode = new Node<T>(word.toString(), item);
-                  child->part.remove(0, p);
-                  this->children.replace(i, newNode);
-                  newNode->children << child;
-               }
-            }
-            else if (p == child->part.size()) // The sub part is the begining of the word.
-            {
-               child->addItem(word.string()->midRef(word.position() + p, word.size() - p), item);
-            }
-            else
-            {
-               // The word and the sub part share at least one character from the begining.
-               Node<T>* newNodeSplit = new Node<T>(word.string()->mid(word.position(), p));
-               child->part.remove(0, p);
-               this->children.replace(i, newNodeSplit);
-               newNodeSplit->children << child;
-
-               Node<T>* newNode = new Node<T>(word.string()->mid(word.position() + p, word.size() - p), item);
-               newNodeSplit->children << newNode;
-            }
-            return;
-         }
+         Node<T>* newNode = new Node<T>(chars + position, size - position);
+         newNode->insertItem(item);
+         node->insertChild(newNode);
+         return;
+      }
+
+      Node<T>* child = node->children[i];
+      const int p = child->commonPrefix(chars + position, size - position);
+
+      // The word and the part of the child share only the 'p' first characters: the child is split.
+      if (p < child->part.size())
+      {
+         Node<T>* newNodeSplit = new Node<T>(chars + position, p);
+         child->part.remove(0, p);
+         newNodeSplit->insertChild(child);
+         node->children[i] = newNodeSplit; // The first character doesn't change, 'keys' stays sorted.
+         child = newNodeSplit;
       }
-      this->children << new Node<T>(word.toString(), item);
+
+      node = child;
+      position += p;
    }
+
+   node->insertItem(item);
 }
 
 template <typename T>
 bool FM::Node<T>::rmItem(const QString& word, const T& item)
 {
-   QPair<Node<T>*, int> nodes = this->getNode(word, true);
-   if (!nodes.first)
+   const QChar* chars = word.unicode();
+   const int size = word.size();
+   if (size == 0)
       return false;
 
-   Node<T>* node = nodes.first->children[nodes.second];
-
-   if (node->items.size() == 1 && node->items[0] == item)
+   Node<T>* parent = nullptr;
+   Node<T>* grandParent = nullptr;
+   Node<T>* node = this;
+   int position = 0;
+   while (position < size)
    {
-      node->items.clear();
-      nodes.first->remove(nodes.second);
-      return true;
+      const int i = node->childIndex(chars[position]);
+      if (i == -1)
+         return false;
+
+      Node<T>* child = node->children[i];
+      const int p = child->commonPrefix(chars + position, size - position);
+      if (p < child->part.size())
+         return false;
+
+      grandParent = parent;
+      parent = node;
+      node = child;
+      position += p;
    }
-   else
+
+   const T* itemPosition = std::lower_bound(node->items.begin(), node->items.end(), item);
+   if (itemPosition == node->items.end() || !(*itemPosition == item))
+      return false;
+   node->items.remove(itemPosition - node->items.begin());
+
+   // Keep the tree compact: a node without item has at least two children.
+   if (node->items.isEmpty())
    {
-      return node->items.removeOne(item);
+      if (node->children.isEmpty())
+      {
+         const int i = parent->childIndex(node->part[0]);
+         parent->keys.remove(i);
+         parent->children.remove(i);
+         delete node;
+
+         if (grandParent && parent->items.isEmpty() && parent->children.size() == 1)
+            parent->mergeChild();
+      }
+      else if (node->children.size() == 1)
+      {
+         node->mergeChild();
+      }
    }
+
+   return true;
 }
 
 template <typename T>
 QList<FM::NodeResult<T>> FM::Node<T>::search(const QString& word, bool alsoFromSubNodes, int maxNbResult, std::function<bool(const T&)> predicat) const
 {
-   QPair<Node<T>*, int> nodes = this->getNode(word, !alsoFromSubNodes);
-   if (!nodes.first)
-      return QList<NodeResult<T>>();
+   QList<NodeResult<T>> result;
+   if (const Node<T>* node = this->getNode(word, !alsoFromSubNodes))
+      node->getItems(alsoFromSubNodes, maxNbResult, predicat, result);
+   return result;
+}
 
-   return nodes.first->children[nodes.second]->getItems(alsoFromSubNodes, maxNbResult, predicat);
+/**
+  * Set 'result' to the posting list of the given word: all the matching items sorted, without limit.
+  * An item found many times is kept once with its best level.
+  */
+template <typename T>
+void FM::Node<T>::search(const QString& word, bool alsoFromSubNodes, std::function<bool(const T&)> predicat, QVector<NodeResult<T>>& result) const
+{
+   if (const Node<T>* node = this->getNode(word, !alsoFromSubNodes))
+      node->getPostingList(alsoFromSubNodes, predicat, result);
 }
 
 template <typename T>
@@ -248,141 +283,207 @@ QString FM::Node<T>::toStringDebug() const
    {
       SubNode current = nodesToProcess.takeFirst();
       result.append(QString().fill(' ', INDENTATION * current.level));
-      result.append(current.node->part).append(current.node->items.isEmpty() ? "" : QString(" N = %1").arg(current.node->items.size())).append('\n');
+      result.append(QString(current.node->part.data(), current.node->part.size())).append(current.node->items.isEmpty() ? "" : QString(" N = %1").arg(current.node->items.size())).append('\n');
 
-      QListIterator<Node<T>*> i(current.node->children);
-      i.toBack();
-      while (i.hasPrevious())
-         nodesToProcess.prepend(SubNode { current.level + 1, i.previous() });
+      for (int i = current.node->children.size() - 1; i >= 0; i--)
+         nodesToProcess.prepend(SubNode { current.level + 1, current.node->children[i] });
    }
 
    return result;
 }
 
 template <typename T>
-FM::Node<T>::Node(const QString& part) :
-   part(part)
+FM::Node<T>::Node(const QChar* part, int size)
 {
+   this->part.reserve(size);
+   for (int i = 0; i < size; i++)
+      this->part.append(part[i]);
 }
 
+/**
+  * Return the index of the child beginning with the given character or -1 if there is none.
+  */
 template <typename T>
-FM::Node<T>::Node(const QString& part, const T& item) :
-   part(part)
+int FM::Node<T>::childIndex(QChar c) const
 {
-   this->items << item;
+   const QChar* keys = this->keys.data();
+   const int n = this->keys.size();
+
+   if (n <= LINEAR_SEARCH_MAX_NB_CHILDREN)
+   {
+      for (int i = 0; i < n; i++)
+         if (keys[i] == c)
+            return i;
+      return -1;
+   }
+
+   const QChar* key = std::lower_bound(keys, keys + n, c, [](QChar c1, QChar c2) { return c1.unicode() < c2.unicode(); });
+   return key != keys + n && *key == c ? key - keys : -1;
+}
+
+template <typename T>
+void FM::Node<T>::insertChild(Node<T>* child)
+{
+   const ushort c = child->part[0].unicode();
+   int i = 0;
+   while (i < this->keys.size() && this->keys[i].unicode() < c)
+      i++;
+
+   this->keys.insert(i, child->part[0]);
+   this->children.insert(i, child);
+}
+
+/**
+  * Return the number of characters shared by the beginning of the given word and the part of the node.
+  */
+template <typename T>
+int FM::Node<T>::commonPrefix(const QChar* word, int size) const
+{
+   const QChar* part = this->part.data();
+   const int n = qMin(size, this->part.size());
+   int i = 0;
+   while (i < n && part[i] == word[i])
+      i++;
+   return i;
+}
+
+/**
+  * Absorb the only child, the current node must not have any item.
+  */
+template <typename T>
+void FM::Node<T>::mergeChild()
+{
+   Node<T>* child = this->children[0];
+
+   this->part.reserve(this->part.size() + child->part.size());
+   for (int i = 0; i < child->part.size(); i++)
+      this->part.append(child->part[i]);
+
+   this->items.moveFrom(child->items);
+   this->keys.moveFrom(child->keys);
+   this->children.moveFrom(child->children); // 'child' has no more children, its destructor won't delete them.
+
+   delete child;
 }
 
 /**
-  * Returns the node matching the given word as the 'QPair::second'th child of its parent 'QPair::first'.
+  * Return the node matching the given word. If 'exactMatch' is false the word may end inside the part of the returned node.
   */
 template <typename T>
-QPair<FM::Node<T>*, int> FM::Node<T>::getNode(const QString& word, bool exactMatch) const
+const FM::Node<T>* FM::Node<T>::getNode(const QString& word, bool exactMatch) const
 {
-   QString part = word;
-   Node<T>* currentParent = const_cast<Node<T>*>(this);
-   for (int i = 0; i < currentParent->children.size(); ++i)
+   const QChar* chars = word.unicode();
+   const int size = word.size();
+
+   const Node<T>* node = this;
+   int position = 0;
+   while (position < size)
    {
-      Node<T>* child = currentParent->children[i];
-      int p = Common::StringUtils::commonPrefix(&part, &child->part);
+      const int i = node->childIndex(chars[position]);
+      if (i == -1)
+         return nullptr;
 
-      if (p != 0)
-      {
-         if (p == child->part.size())
-         {
-            if (p == part.size())
-               return qMakePair(currentParent, i);
+      const Node<T>* child = node->children[i];
+      const int p = child->commonPrefix(chars + position, size - position);
+      if (p < child->part.size())
+         return !exactMatch && position + p == size ? child : nullptr;
 
-            currentParent = child;
-            part.remove(0, p);
-            i = -1;
-            continue;
-         }
-         else if (p == part.size())
-         {
-            if (exactMatch)
-               break;
-            else
-               return qMakePair(currentParent, i);
-         }
-         break;
-      }
+      node = child;
+      position += p;
    }
-   return QPair<Node<T>*, int>(nullptr, 0);
+
+   return node == this ? nullptr : node;
 }
 
 template <typename T>
-QList<FM::NodeResult<T>> FM::Node<T>::getItems(bool alsoFromSubNodes, int maxNbResult, std::function<bool(const T&)> predicat) const
+template <typename Container>
+void FM::Node<T>::getItems(bool alsoFromSubNodes, int maxNbResult, std::function<bool(const T&)> predicat, Container& result) const
 {
-   QList<NodeResult<T>> result;
-   QList<Node<T>*> nodesToVisit;
+   QVector<const Node<T>*> nodesToVisit;
 
-   nodesToVisit.append(const_cast<Node<T>*>(this));
+   nodesToVisit << this;
 
-   while (!nodesToVisit.empty())
+   for (int n = 0; n < nodesToVisit.size(); n++)
    {
-      const Node<T>* current = nodesToVisit.takeFirst();
+      const Node<T>* current = nodesToVisit[n];
 
-      for (QListIterator<T> i(current->items); i.hasNext();)
+      for (const T* i = current->items.begin(); i != current->items.end(); ++i)
       {
-         const T& item = i.next();
-         if (!predicat || predicat(item))
+         if (!predicat || predicat(*i))
          {
-            result << NodeResult<T>(item, current == this ? 0 : 1); // 'level' == 0 means the item matches exactly, it's a bit tricky.
+            result << NodeResult<T>(*i, current == this ? 0 : 1); // 'level' == 0 means the item matches exactly, it's a bit tricky.
             if (result.size() == maxNbResult)
-               return result;
+               return;
          }
       }
 
       if (!alsoFromSubNodes)
          break;
 
-      nodesToVisit.append(current->children);
+      for (int i = 0; i < current->children.size(); i++)
+         nodesToVisit << current->children[i];
    }
-
-   return result;
 }
 
 /**
-  * Try to remove the i'th child.
+  * Merge the sorted items of the current node (level 0) and, if 'alsoFromSubNodes' is true, of its sub nodes (level 1).
+  * The equal items are consecutive and the one of the current node comes first, only the first one is kept.
   */
 template <typename T>
-void FM::Node<T>::remove(int i)
+void FM::Node<T>::getPostingList(bool alsoFromSubNodes, std::function<bool(const T&)> predicat, QVector<NodeResult<T>>& result) const
 {
-   if (i >= this->children.size())
-      return;
-
-   Node<T>* nodeToDelete = this->children[i];
-
-   // If the node to delete has nothing to merge we just remove it.
-   if (nodeToDelete->children.isEmpty() && nodeToDelete->items.isEmpty())
+   struct Range
    {
-      this->children.removeAt(i);
-      delete nodeToDelete;
+      const T* begin;
+      const T* end;
+      int level;
+   };
 
-      // If we have only one child maybe we can delete it.
-      if (this->children.size() == 1)
-         this->remove(0);
-   }
-   // If the parent has no item and only one child (nodeToDelete) then we merge its child and delete it.
-   else if (this->items.isEmpty() && this->children.size() == 1)
+   // A heap of the ranges, the one with the lowest item on top.
+   QVector<Range> ranges;
+   auto higher = [](const Range& r1, const Range& r2) { return *r2.begin < *r1.begin || (!(*r1.begin < *r2.begin) && r2.level < r1.level); };
+
+   QVector<const Node<T>*> nodesToVisit;
+   nodesToVisit << this;
+   for (int n = 0; n < nodesToVisit.size(); n++)
    {
-      this->items << nodeToDelete->items;
-      this->children << nodeToDelete->children;
-      this->part.append(nodeToDelete->part);
+      const Node<T>* current = nodesToVisit[n];
+      if (!current->items.isEmpty())
+         ranges << Range { current->items.begin(), current->items.end(), current == this ? 0 : 1 };
 
-      this->children.removeAt(i);
-      nodeToDelete->children.clear();
-      delete nodeToDelete;
+      if (!alsoFromSubNodes)
+         break;
 
-      // If we have only one child maybe we can delete it.
-      if (this->children.size() == 1)
-         this->remove(0);
+      for (int i = 0; i < current->children.size(); i++)
+         nodesToVisit << current->children[i];
    }
-   // If the node to delete has one child and no item we can merge its child.
-   else if (nodeToDelete->children.size() == 1 && nodeToDelete->items.isEmpty())
+   std::make_heap(ranges.begin(), ranges.end(), higher);
+
+   const T* previous = nullptr;
+   while (!ranges.isEmpty())
    {
-      nodeToDelete->remove(0);
+      std::pop_heap(ranges.begin(), ranges.end(), higher);
+      Range& range = ranges.last();
+      const T* item = range.begin;
+
+      if ((!previous || !(*previous == *item)) && (!predicat || predicat(*item)))
+         result << NodeResult<T>(*item, range.level);
+      previous = item;
+
+      if (++range.begin == range.end)
+         ranges.removeLast();
+      else
+         std::push_heap(ranges.begin(), ranges.end(), higher);
    }
 }
 
+/**
+  * Insert the item after its equal items to keep 'items' sorted.
+  */
+template <typename T>
+void FM::Node<T>::insertItem(const T& item)
+{
+   this->items.insert(std::upper_bound(this->items.begin(), this->items.end(), item) - this->items.begin(), item);
+}
+
 #endif
@@ -0,0 +1,202 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef FILEMANAGER_SMALLVECTOR_H
+#define FILEMANAGER_SMALLVECTOR_H
+
+#include <new>
+#include <utility>
+
+#include <QtGlobal>
+
+#include <Common/Uncopyable.h>
+
+/**
+  * @class FM::SmallVector
+  *
+  * A vector keeping up to 'N' elements inside itself, the heap is only used when there is more elements.
+  * Its size is 8 bytes plus the biggest of 'N' elements and a pointer, it is made to be embedded many
+  * times in the nodes of the word index: most of the nodes have a short part, one child and one item.
+  */
+
+namespace FM
+{
+   template <typename E, int N>
+   class SmallVector : Common::Uncopyable
+   {
+   public:
+      SmallVector() : n(0), capacity(N) {}
+      ~SmallVector() { this->clear(); }
+
+      inline int size() const { return this->n; }
+      inline bool isEmpty() const { return this->n == 0; }
+
+      inline const E* data() const { return this->capacity > N ? this->heap : reinterpret_cast<const E*>(this->storage); }
+      inline E* data() { return this->capacity > N ? this->heap : reinterpret_cast<E*>(this->storage); }
+
+      inline const E& operator[](int i) const { return this->data()[i]; }
+      inline E& operator[](int i) { return this->data()[i]; }
+
+      inline const E* begin() const { return this->data(); }
+      inline const E* end() const { return this->data() + this->n; }
+
+      void reserve(int size);
+      void insert(int i, const E& e);
+      inline void append(const E& e) { this->insert(this->n, e); }
+      void remove(int i, int count = 1);
+      bool removeOne(const E& e);
+      void moveFrom(SmallVector<E, N>& other);
+      void clear();
+
+   private:
+      void reallocate(quint32 newCapacity);
+
+      quint32 n;
+      quint32 capacity; ///< Equal to 'N' while the elements are inside 'storage'.
+      union
+      {
+         E* heap;
+         alignas(E) char storage[N > 0 ? N * sizeof(E) : 1];
+      };
+   };
+}
+
+template <typename E, int N>
+void FM::SmallVector<E, N>::reserve(int size)
+{
+   if (static_cast<quint32>(size) > this->capacity)
+      this->reallocate(size);
+}
+
+template <typename E, int N>
+void FM::SmallVector<E, N>::insert(int i, const E& e)
+{
+   E copy(e); // 'e' may be one of our elements.
+
+   if (this->n == this->capacity)
+      this->reallocate(this->capacity < 2 ? 2 : this->capacity * 2);
+
+   E* d = this->data();
+   if (static_cast<quint32>(i) == this->n)
+   {
+      new (d + this->n) E(std::move(copy));
+   }
+   else
+   {
+      new (d + this->n) E(std::move(d[this->n - 1]));
+      for (int j = this->n - 1; j > i; j--)
+         d[j] = std::move(d[j - 1]);
+      d[i] = std::move(copy);
+   }
+   this->n++;
+}
+
+template <typename E, int N>
+void FM::SmallVector<E, N>::remove(int i, int count)
+{
+   E* d = this->data();
+   for (quint32 j = i; j + count < this->n; j++)
+      d[j] = std::move(d[j + count]);
+   for (quint32 j = this->n - count; j < this->n; j++)
+      d[j].~E();
+   this->n -= count;
+
+   // Give back the memory of the lists which have shrunk a lot.
+   if (this->capacity > N && this->n <= this->capacity / 4)
+      this->reallocate(qMax(static_cast<quint32>(N), this->n * 2));
+}
+
+template <typename E, int N>
+bool FM::SmallVector<E, N>::removeOne(const E& e)
+{
+   const E* d = this->data();
+   for (quint32 i = 0; i < this->n; i++)
+      if (d[i] == e)
+      {
+         this->remove(i);
+         return true;
+      }
+   return false;
+}
+
+/**
+  * Take the elements of 'other', it becomes empty. The current elements are removed.
+  */
+template <typename E, int N>
+void FM::SmallVector<E, N>::moveFrom(SmallVector<E, N>& other)
+{
+   this->clear();
+
+   if (other.capacity > N)
+   {
+      this->heap = other.heap;
+      this->capacity = other.capacity;
+      this->n = other.n;
+      other.n = 0;
+      other.capacity = N;
+   }
+   else
+   {
+      for (quint32 i = 0; i < other.n; i++)
+         this->append(std::move(other.data()[i]));
+      other.clear();
+   }
+}
+
+template <typename E, int N>
+void FM::SmallVector<E, N>::clear()
+{
+   E* d = this->data();
+   for (quint32 i = 0; i < this->n; i++)
+      d[i].~E();
+
+   if (this->capacity > N)
+      ::operator delete(this->heap);
+
+   this->n = 0;
+   this->capacity = N;
+}
+
+/**
+  * Move the elements to a new buffer of the given capacity, back inside the object if it is not greater than 'N'.
+  */
+template <typename E, int N>
+void FM::SmallVector<E, N>::reallocate(quint32 newCapacity)
+{
+   const bool onHeap = this->capacity > N;
+   if (!onHeap && newCapacity <= static_cast<quint32>(N))
+      return;
+
+   E* oldData = this->data(); // 'heap' shares its memory with 'storage', it must be read before moving the elements.
+   E* newData = newCapacity > static_cast<quint32>(N) ? static_cast<E*>(::operator new(newCapacity * sizeof(E))) : reinterpret_cast<E*>(this->storage);
+
+   for (quint32 i = 0; i < this->n; i++)
+   {
+      new (newData + i) E(std::move(oldData[i]));
+      oldData[i].~E();
+   }
+
+   if (onHeap)
+      ::operator delete(oldData);
+
+   this->capacity = newCapacity > static_cast<quint32>(N) ? newCapacity : N;
+   if (this->capacity > N)
+      this->heap = newData;
+}
+
+#endif
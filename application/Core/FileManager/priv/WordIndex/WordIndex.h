@@ -20,14 +20,19 @@
 #define FILEMANAGER_WORDINDEX_H
 
 #include <functional>
+#include <algorithm>
+#include <limits>
 
 #include <QList>
+#include <QVector>
+#include <QSet>
 #include <QString>
 #include <QChar>
-#include <QMutex>
+#include <QReadWriteLock>
 
 #include <Common/Uncopyable.h>
 #include <Common/Global.h>
+#include <Common/StringUtils.h>
 #include <Common/LogManager/ILoggable.h>
 
 #include <priv/WordIndex/Node.h>
@@ -37,7 +42,9 @@
   *
   * The purpose of the class 'WordIndex' is to index a set of item of type 'T' by string.
   *
-  * This class is thread safe.
+  * This class is thread safe. The searches only take the lock in read mode thus they run in parallel with each other,
+  * for example the remote searches and the GUI searches. A modification (adding, removing or renaming an item) takes it
+  * in write mode for the time of a single item, a search never waits for a whole scan.
   */
 
 namespace FM
@@ -66,8 +73,12 @@ namespace FM
       static QList<T> resultToList(const QList<NodeResult<T>>& result);
 
    private:
+      QList<NodeResult<T>> searchWord(const QString& word, int maxNbResult, std::function<bool(const T&)> predicat) const;
+      static bool isPartialMatch(const QString& word);
+      static int gallop(const QVector<NodeResult<T>>& list, int from, const T& value);
+
       Node<T> root;
-      mutable QMutex mutex;
+      mutable QReadWriteLock lock;
    };
 }
 
@@ -78,21 +89,20 @@ template<typename T>
 const int FM::WordIndex<T>::MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN(1);
 
 template<typename T>
-   FM::WordIndex<T>::WordIndex() :
-      mutex(QMutex::Recursive)
+   FM::WordIndex<T>::WordIndex()
 {}
 
 template<typename T>
 void FM::WordIndex<T>::addItem(const QString& word, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    this->root.addItem(&word, item);
 }
 
 template<typename T>
 void FM::WordIndex<T>::addItem(const QStringList& words, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    for (QStringListIterator i(words); i.hasNext();)
       this->root.addItem(&i.next(), item);
 }
@@ -100,7 +110,7 @@ void FM::WordIndex<T>::addItem(const QStringList& words, const T& item)
 template<typename T>
 bool FM::WordIndex<T>::rmItem(const QString& word, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    return this->root.rmItem(word, item);
 }
 
@@ -110,7 +120,7 @@ bool FM::WordIndex<T>::rmItem(const QString& word, const T& item)
 template<typename T>
 bool FM::WordIndex<T>::rmItem(const QStringList& words, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    bool itemRemoved = false;
    for (QStringListIterator i(words); i.hasNext();)
       itemRemoved |= this->root.rmItem(i.next(), item);
@@ -120,7 +130,7 @@ bool FM::WordIndex<T>::rmItem(const QStringList& words, const T& item)
 template<typename T>
 void FM::WordIndex<T>::renameItem(const QString& oldWord, const QString& newWord, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    this->root.rmItem(oldWord, item);
    this->root.addItem(&newWord, item);
 }
@@ -128,7 +138,7 @@ void FM::WordIndex<T>::renameItem(const QString& oldWord, const QString& newWord
 template<typename T>
 void FM::WordIndex<T>::renameItem(const QStringList& oldWords, const QStringList& newWords, const T& item)
 {
-   QMutexLocker locker(&this->mutex);
+   QWriteLocker locker(&this->lock);
    for (QStringListIterator i(oldWords); i.hasNext();)
       this->root.rmItem(i.next(), item);
    for (QStringListIterator i(newWords); i.hasNext();)
@@ -142,74 +152,156 @@ void FM::WordIndex<T>::renameItem(const QStringList& oldWords, const QStringList
 template<typename T>
 QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QString& word, int maxNbResult, std::function<bool(const T&)> predicat) const
 {
-   QMutexLocker locker(&this->mutex);
-   return this->root.search(word, word.size() >= (Common::StringUtils::isKorean(word) ? MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN : MIN_WORD_SIZE_PARTIAL_MATCH), maxNbResult, predicat);
+   QReadLocker locker(&this->lock);
+   return this->searchWord(word, maxNbResult, predicat);
+}
+
+/**
+  * The lock must be taken.
+  */
+template<typename T>
+QList<FM::NodeResult<T>> FM::WordIndex<T>::searchWord(const QString& word, int maxNbResult, std::function<bool(const T&)> predicat) const
+{
+   return this->root.search(word, this->isPartialMatch(word), maxNbResult, predicat);
 }
 
 /**
+  * Return the items matching the most terms first. For example, for the terms [a, b, c], the groups of results are:
+  *  * a & b & c
+  *  * (a & b) \ c
+  *    (a & c) \ b
+  *    (b & c) \ a
+  *  * a \ b \ c
+  *    b \ a \ c
+  *    c \ a \ b
+  * The level of a result is given by its combination and by the number of terms it only matches partially,
+  * a group is sorted by level.
+  *
+  * Each term gives a posting list sorted by item, merged from the sorted items of the nodes (see 'Node::search(..)').
+  * The combinations are computed by going through the shortest list of the combination and by looking for its
+  * items in the other lists with a galloping search.
+  * The results of a group are kept in a bounded heap, the search stops as soon as 'maxNbResult' results are known.
+  * If 'maxNbResult' is -1 all the results are returned.
+  *
   * @see http://dev.euphorik.ch/wiki/pmp/Algorithms#Word-indexing for more information.
   */
 template<typename T>
 QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int maxNbResult, std::function<bool(const T&)> predicat) const
 {
-   QMutexLocker locker(&this->mutex);
+   QReadLocker locker(&this->lock);
 
    const int N = words.size();
+   QList<NodeResult<T>> finalResult;
+
+   if (N == 0)
+      return finalResult;
+
+   // With only one term the number of results can be limited directly.
+   if (N == 1)
+   {
+      QSet<T> alreadyAdded;
+      for (QListIterator<NodeResult<T>> i(this->searchWord(words.first(), maxNbResult, predicat)); i.hasNext();)
+      {
+         const NodeResult<T>& result = i.next();
+         if (!alreadyAdded.contains(result.value))
+         {
+            alreadyAdded.insert(result.value);
+            finalResult << result;
+         }
+      }
+      qStableSort(finalResult);
+      return finalResult;
+   }
 
-   // Launch a search for each term.
-   QVector<QSet<NodeResult<T>>> results(N);
+   QVector<QVector<NodeResult<T>>> postingLists(N);
    for (int i = 0; i < N; i++)
-      // We can only limit the number of result for one term. When there is more than one term and thus some results set, say [a, b, c] for example, some good result may be contained in intersect, for example a & b or a & c.
-      results[i] += this->search(words[i], N == 1 ? maxNbResult : -1, predicat).toSet();
+      this->root.search(words[i], this->isPartialMatch(words[i]), predicat, postingLists[i]);
 
-   QList<NodeResult<T>> finalResult;
+   QVector<int> positions(N);
+   QVector<bool> inCombination(N);
+
+   // The heap of the best results of the current group, the worst one on top.
+   QVector<NodeResult<T>> bestResults;
+   auto worseLevel = [](const NodeResult<T>& nr1, const NodeResult<T>& nr2) { return nr1.level < nr2.level; };
 
    int level = 0;
 
-   // For each group of intersection number.
-   // For example, [a, b, c] :
-   //  * a & b & c
-   //  * (a & b) \ c
-   //    (a & c) \ b
-   //    (b & c) \ a
-   //  * a \ b \ c
-   for (int i = 0; i < N && finalResult.size() < maxNbResult; i++)
+   for (int i = 0; i < N && (maxNbResult < 0 || finalResult.size() < maxNbResult); i++)
    {
       const int NB_INTERSECTS = N - i; // Number of set intersected.
-      int intersect[NB_INTERSECTS]; // A array of the results wich will be intersected.
+      int intersect[NB_INTERSECTS]; // A array of the posting lists wich will be intersected.
       for (int j = 0; j < NB_INTERSECTS; j++)
          intersect[j] = j;
 
+      const int nbResultsToFind = maxNbResult < 0 ? std::numeric_limits<int>::max() : maxNbResult - finalResult.size();
+      int nbResultsFound = 0; // Not only the ones kept in 'bestResults'.
+      bestResults.clear();
+
       // For each combination of the current intersection group.
       // For 2 intersections (NB_INTERSECTS == 2) among 3 elements [a, b, c]:
       //  * (a, b)
       //  * (a, c)
       //  * (b, c)
-      QList<NodeResult<T>> nodesToSort;
       const int NB_COMBINATIONS = Common::Global::nCombinations(N, NB_INTERSECTS);
-      for (int j = 0; j < NB_COMBINATIONS && nodesToSort.size() + finalResult.size() < maxNbResult; j++)
+      for (int j = 0; j < NB_COMBINATIONS && nbResultsFound < nbResultsToFind; j++)
       {
-         // Apply intersects.
-         QSet<NodeResult<T>> currentLevelSet = results[intersect[0]];
-         for (QSetIterator<NodeResult<T>> k(currentLevelSet); k.hasNext();)
+         int shortest = intersect[0];
+         inCombination.fill(false);
+         for (int k = 0; k < NB_INTERSECTS; k++)
          {
-            NodeResult<T>& node = const_cast<NodeResult<T>&>(k.next());
-            node.level = node.level ? NB_COMBINATIONS : 0;
+            inCombination[intersect[k]] = true;
+            if (postingLists[intersect[k]].size() < postingLists[shortest].size())
+               shortest = intersect[k];
          }
+         positions.fill(0);
+
+         // Each item of the shortest list must be in the other lists of the combination and in none of the others.
+         const QVector<NodeResult<T>>& shortestList = postingLists[shortest];
+         for (int k = 0; k < shortestList.size(); k++)
+         {
+            // The next items of this combination and of the next ones can't be better than the ones we have.
+            if (bestResults.size() == nbResultsToFind && bestResults.first().level <= level)
+               break;
 
-         for (int k = 1; k < NB_INTERSECTS; k++)
-            NodeResult<T>::intersect(currentLevelSet, results[intersect[k]], NB_COMBINATIONS);
+            const T& value = shortestList[k].value;
+            int nbPartialMatches = 0;
+            bool match = true;
+            for (int l = 0; l < N && match; l++)
+            {
+               const QVector<NodeResult<T>>& list = postingLists[l];
+               positions[l] = gallop(list, positions[l], value);
+               const bool found = positions[l] < list.size() && list[positions[l]].value == value;
+               if (inCombination[l])
+               {
+                  match = found;
+                  if (found && list[positions[l]].level)
+                     nbPartialMatches++;
+               }
+               else
+               {
+                  match = !found;
+               }
+            }
 
-         // Apply substracts.
-         for (int k = -1; k < NB_INTERSECTS; k++)
-            for (int l = (k == -1 ? 0 : intersect[k] + 1); l < (k == NB_INTERSECTS - 1 ? N : intersect[k+1]); l++)
-               currentLevelSet -= results[l];
+            if (!match)
+               continue;
 
-         for (QSetIterator<NodeResult<T>> k(currentLevelSet); k.hasNext();)
-            const_cast<NodeResult<T>&>(k.next()).level += level;
+            nbResultsFound++;
+            NodeResult<T> result(value);
+            result.level = nbPartialMatches * NB_COMBINATIONS + level;
 
-         // Sort by level.
-         nodesToSort << currentLevelSet.toList();
+            if (bestResults.size() < nbResultsToFind)
+            {
+               bestResults << result;
+               std::push_heap(bestResults.begin(), bestResults.end(), worseLevel);
+            }
+            else if (result.level < bestResults.first().level)
+            {
+               std::pop_heap(bestResults.begin(), bestResults.end(), worseLevel);
+               bestResults.last() = result;
+               std::push_heap(bestResults.begin(), bestResults.end(), worseLevel);
+            }
+         }
 
          // Define positions of each intersect term.
          for (int k = NB_INTERSECTS - 1; k >= 0; k--)
@@ -224,23 +316,51 @@ QList<FM::NodeResult<T>> FM::WordIndex<T>::search(const QStringList& words, int
          level += 1;
       }
 
-      qSort(nodesToSort); // Sort by level
-
-      finalResult << nodesToSort;
+      std::sort_heap(bestResults.begin(), bestResults.end(), worseLevel); // Sort by level.
+      for (int j = 0; j < bestResults.size(); j++)
+         finalResult << bestResults[j];
 
       level += NB_COMBINATIONS * NB_INTERSECTS;
    }
 
-   if (finalResult.size() > maxNbResult)
-      finalResult.erase(finalResult.end() - (finalResult.size() - maxNbResult), finalResult.end());
-
    return finalResult;
 }
 
+/**
+  * The terms below 'MIN_WORD_SIZE_PARTIAL_MATCH' must match entirely.
+  */
+template<typename T>
+bool FM::WordIndex<T>::isPartialMatch(const QString& word)
+{
+   return word.size() >= (Common::StringUtils::isKorean(word) ? MIN_WORD_SIZE_PARTIAL_MATCH_KOREAN : MIN_WORD_SIZE_PARTIAL_MATCH);
+}
+
+/**
+  * Return the position of the first item not lower than 'value' in 'list', starting from 'from'.
+  * The step is doubled until an item not lower is found then the last step is bisected.
+  */
+template<typename T>
+int FM::WordIndex<T>::gallop(const QVector<NodeResult<T>>& list, int from, const T& value)
+{
+   const int size = list.size();
+   int step = 1;
+   int end = from;
+   while (end < size && list[end].value < value)
+   {
+      from = end + 1;
+      end += step;
+      step *= 2;
+   }
+
+   return std::lower_bound(list.begin() + from, list.begin() + qMin(end, size), value, [](const NodeResult<T>& nr, const T& value) {
+      return nr.value < value;
+   }) - list.begin();
+}
+
 template<typename T>
 QString FM::WordIndex<T>::toStringLog() const
 {
-   QMutexLocker locker(&mutex);
+   QReadLocker locker(&this->lock);
    return this->root.toStringDebug();
 }
 
@@ -18,6 +18,7 @@ DEFINES += NETWORKLISTENER_LIBRARY
 SOURCES += priv/UDPListener.cpp \
     priv/TCPListener.cpp \
     priv/Search.cpp \
+    priv/FindPool.cpp \
     priv/NetworkListener.cpp \
     priv/Builder.cpp \
     ../../Protos/common.pb.cc \
@@ -30,6 +31,7 @@ HEADERS += ISearch.h \
     priv/UDPListener.h \
     priv/TCPListener.h \
     priv/Search.h \
+    priv/FindPool.h \
     priv/NetworkListener.h \
     Builder.h \
     ../../Protos/common.pb.h \
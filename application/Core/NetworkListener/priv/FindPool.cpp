@@ -0,0 +1,209 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/FindPool.h>
+using namespace NL;
+
+#include <limits>
+
+#include <QMutexLocker>
+
+#include <Common/Settings.h>
+#include <Common/ProtoHelper.h>
+
+#include <priv/Log.h>
+
+/**
+  * @class NL::FindPool
+  *
+  * The searches of the other peers are processed by a set of threads, a heavy search doesn't block
+  * the thread reading the datagrams (and thus the 'IMAlive' messages).
+  *
+  * The searches waiting to be processed are bounded by 'max_number_of_pending_search'. A peer can't
+  * send more than 'max_search_rate_per_peer' searches per minute, the same search sent again by a
+  * peer during 'search_deduplication_period' is ignored and an identical search from another peer
+  * still waiting is processed once for both.
+  *
+  * The results are given by the signal 'findResult(..)', one 'FindResult' at a time.
+  */
+
+FindPool::FindPool(QSharedPointer<FM::IFileManager> fileManager, int maxResultSize) :
+   fileManager(fileManager),
+   MAX_RESULT_SIZE(maxResultSize),
+   MAX_NB_PENDING_SEARCH(SETTINGS.get<quint32>("max_number_of_pending_search")),
+   SEARCH_RATE_PER_PEER(SETTINGS.get<quint32>("max_search_rate_per_peer") / 60000.0),
+   DEDUPLICATION_PERIOD(SETTINGS.get<quint32>("search_deduplication_period")),
+   toStop(false)
+{
+   qRegisterMetaType<Common::Hash>("Common::Hash");
+   qRegisterMetaType<Protos::Common::FindResult>("Protos::Common::FindResult");
+
+   this->timer.start();
+
+   const int nbThreads = SETTINGS.get<quint32>("number_of_search_thread");
+   for (int i = 0; i < nbThreads; i++)
+      this->workers << new Worker(this);
+}
+
+FindPool::~FindPool()
+{
+   this->mutex.lock();
+   this->toStop = true;
+   this->jobs.clear();
+   this->jobAdded.wakeAll();
+   this->mutex.unlock();
+
+   foreach (Worker* worker, this->workers)
+   {
+      worker->wait();
+      delete worker;
+   }
+}
+
+FindPool::Status FindPool::find(const Common::Hash& peerID, const Protos::Core::Find& findMessage)
+{
+   const std::string pattern = findMessage.pattern().SerializeAsString();
+   const QByteArray key(pattern.data(), static_cast<int>(pattern.size()));
+   const Requester requester = { peerID, findMessage.tag() };
+
+   QMutexLocker locker(&this->mutex);
+
+   const qint64 now = this->timer.elapsed();
+   this->forgetOldSearches(now);
+
+   const QByteArray peerKey = peerID.getByteArray() + key;
+   if (this->recentSearches.contains(peerKey))
+      return DUPLICATED;
+
+   QHash<Common::Hash, PeerRate>::iterator rate = this->peerRates.find(peerID);
+   if (rate == this->peerRates.end())
+   {
+      const PeerRate newRate = { MAX_SEARCH_BURST, now };
+      rate = this->peerRates.insert(peerID, newRate);
+   }
+   else
+   {
+      rate->nbSearchesAllowed = qMin(static_cast<double>(MAX_SEARCH_BURST), rate->nbSearchesAllowed + (now - rate->lastUpdate) * this->SEARCH_RATE_PER_PEER);
+      rate->lastUpdate = now;
+   }
+
+   if (rate->nbSearchesAllowed < 1.0)
+      return RATE_EXCEEDED;
+
+   Job* mergedJob = nullptr;
+   for (QMutableListIterator<Job> i(this->jobs); i.hasNext() && !mergedJob;)
+   {
+      Job& job = i.next();
+      if (job.key == key)
+         mergedJob = &job;
+   }
+
+   if (!mergedJob && this->jobs.size() >= this->MAX_NB_PENDING_SEARCH)
+      return QUEUE_FULL;
+
+   // The search is counted only when it's accepted, thus a rejected search can be sent again.
+   rate->nbSearchesAllowed -= 1.0;
+   this->recentSearches.insert(peerKey, now);
+
+   if (mergedJob)
+   {
+      mergedJob->requesters << requester;
+      return MERGED;
+   }
+
+   const Job job = { key, findMessage.pattern(), QList<Requester>() << requester };
+   this->jobs << job;
+   this->jobAdded.wakeOne();
+
+   return QUEUED;
+}
+
+void FindPool::processJob(const Job& job)
+{
+   QList<QString> extensions;
+   extensions.reserve(job.pattern.extension_filter_size());
+   for (int i = 0; i < job.pattern.extension_filter_size(); i++)
+      extensions << Common::ProtoHelper::getRepeatedStr(job.pattern, &Protos::Common::FindPattern::extension_filter, i);
+
+   QList<Protos::Common::FindResult> results =
+      this->fileManager->find(
+         Common::ProtoHelper::getStr(job.pattern, &Protos::Common::FindPattern::pattern),
+         extensions,
+         job.pattern.min_size() == 0 ? std::numeric_limits<qint64>::min() : (qint64)job.pattern.min_size(), // According the protocol.
+         job.pattern.max_size() == 0 ? std::numeric_limits<qint64>::max() : (qint64)job.pattern.max_size(), // According the protocol.
+         job.pattern.category(),
+         SETTINGS.get<quint32>("max_number_of_search_result_to_send"),
+         this->MAX_RESULT_SIZE
+      );
+
+   for (QListIterator<Requester> i(job.requesters); i.hasNext();)
+   {
+      const Requester& requester = i.next();
+      for (QMutableListIterator<Protos::Common::FindResult> j(results); j.hasNext();)
+      {
+         Protos::Common::FindResult& result = j.next();
+         result.set_tag(requester.tag);
+         emit findResult(requester.peerID, result);
+      }
+   }
+}
+
+/**
+  * Remove the searches received before 'search_deduplication_period' and the peers which can send the maximum number of searches.
+  */
+void FindPool::forgetOldSearches(qint64 now)
+{
+   for (QMutableHashIterator<QByteArray, qint64> i(this->recentSearches); i.hasNext();)
+      if (now - i.next().value() >= this->DEDUPLICATION_PERIOD)
+         i.remove();
+
+   for (QMutableHashIterator<Common::Hash, PeerRate> i(this->peerRates); i.hasNext();)
+   {
+      const PeerRate& rate = i.next().value();
+      if (rate.nbSearchesAllowed + (now - rate.lastUpdate) * this->SEARCH_RATE_PER_PEER >= MAX_SEARCH_BURST)
+         i.remove();
+   }
+}
+
+/////
+
+FindPool::Worker::Worker(FindPool* pool) :
+   pool(pool)
+{
+   this->start();
+}
+
+void FindPool::Worker::run()
+{
+   QMutexLocker locker(&this->pool->mutex);
+
+   forever
+   {
+      while (this->pool->jobs.isEmpty() && !this->pool->toStop)
+         this->pool->jobAdded.wait(&this->pool->mutex);
+
+      if (this->pool->toStop)
+         return;
+
+      const Job job = this->pool->jobs.takeFirst();
+
+      locker.unlock();
+      this->pool->processJob(job);
+      locker.relock();
+   }
+}
@@ -0,0 +1,121 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef NETWORKLISTENER_FINDPOOL_H
+#define NETWORKLISTENER_FINDPOOL_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+
+#include <Protos/common.pb.h>
+#include <Protos/core_protocol.pb.h>
+
+#include <Common/Uncopyable.h>
+#include <Common/Hash.h>
+#include <Core/FileManager/IFileManager.h>
+
+namespace NL
+{
+   class FindPool : public QObject, Common::Uncopyable
+   {
+      Q_OBJECT
+      static const int MAX_SEARCH_BURST = 5; ///< The number of searches a peer can send at once, see 'max_search_rate_per_peer'.
+
+   public:
+      enum Status
+      {
+         QUEUED,
+         MERGED, ///< An identical search from another peer is already waiting, the results will be sent to both.
+         DUPLICATED, ///< The same search has already been received from this peer recently.
+         RATE_EXCEEDED,
+         QUEUE_FULL
+      };
+
+      FindPool(QSharedPointer<FM::IFileManager> fileManager, int maxResultSize);
+      ~FindPool();
+
+      Status find(const Common::Hash& peerID, const Protos::Core::Find& findMessage);
+
+   signals:
+      /**
+        * Emitted by the workers for each 'FindResult' as soon as it is ready, the tag is already set.
+        */
+      void findResult(const Common::Hash& peerID, const Protos::Common::FindResult& result);
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(FindPool* pool);
+
+      protected:
+         void run();
+
+      private:
+         FindPool* pool;
+      };
+
+      struct Requester
+      {
+         Common::Hash peerID;
+         quint64 tag;
+      };
+
+      struct Job
+      {
+         QByteArray key; ///< The serialized pattern.
+         Protos::Common::FindPattern pattern;
+         QList<Requester> requesters;
+      };
+
+      struct PeerRate
+      {
+         double nbSearchesAllowed;
+         qint64 lastUpdate; ///< [ms].
+      };
+
+      void processJob(const Job& job);
+      void forgetOldSearches(qint64 now);
+
+      QSharedPointer<FM::IFileManager> fileManager;
+      const int MAX_RESULT_SIZE; ///< [Byte].
+      const int MAX_NB_PENDING_SEARCH;
+      const double SEARCH_RATE_PER_PEER; ///< [search/ms].
+      const qint64 DEDUPLICATION_PERIOD; ///< [ms].
+
+      QList<Worker*> workers;
+
+      QList<Job> jobs;
+      QHash<QByteArray, qint64> recentSearches; ///< Peer ID + serialized pattern -> time of reception [ms].
+      QHash<Common::Hash, PeerRate> peerRates;
+      QElapsedTimer timer;
+      bool toStop;
+
+      QMutex mutex; ///< Protect 'jobs', 'recentSearches', 'peerRates' and 'toStop'.
+      QWaitCondition jobAdded;
+   };
+}
+
+#endif
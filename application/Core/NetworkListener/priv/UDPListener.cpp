@@ -21,6 +21,9 @@ using namespace NL;
 
 #include <limits>
 
+#include <QHash>
+#include <QSet>
+
 #if defined(Q_OS_LINUX)
    #include <netinet/in.h>
 #elif defined(Q_OS_DARWIN)
@@ -49,6 +52,7 @@ using namespace NL;
   *  - Listen for incoming unicast and multicast datagrams, process them and dispatch the information the correct manager: 'FileManager', 'DownloadManager' or 'PeerManager'.
   *  - Offer methods to send unicast or multicast datagrams.
   *  - Periodically send a 'IMAlive' multicast datagrams.
+  * The searches of the other peers are given to a 'FindPool', their results are sent as soon as they are ready.
   *
   * @author mcuony
   * @author gburri
@@ -70,13 +74,17 @@ UDPListener::UDPListener(
    peerManager(peerManager),
    uploadManager(uploadManager),
    downloadManager(downloadManager),
+   findPool(fileManager, this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - Common::MessageHeader::HEADER_SIZE),
    currentIMAliveTag(0),
+   nextChunksDigestShard(0),
    nextHashRequestType(FIRST_HASHES),
    loggerIMAlive(LM::Builder::newLogger("NetworkListener (IMAlive)"))
 {
    this->initMulticastUDPSocket();
    this->initUnicastUDPSocket();
 
+   connect(&this->findPool, SIGNAL(findResult(const Common::Hash&, const Protos::Common::FindResult&)), this, SLOT(sendFindResult(const Common::Hash&, const Protos::Common::FindResult&)), Qt::QueuedConnection);
+
    connect(&this->timerIMAlive, SIGNAL(timeout()), this, SLOT(sendIMAliveMessage()));
    this->timerIMAlive.start(static_cast<int>(SETTINGS.get<quint32>("peer_imalive_period")));
 
@@ -147,6 +155,7 @@ void UDPListener::sendIMAliveMessage()
 {
    Protos::Core::IMAlive IMAliveMessage;
    IMAliveMessage.set_version(Common::Constants::PROTOCOL_VERSION);
+   IMAliveMessage.set_chunk_hash_algorithm(static_cast<Protos::Common::Hash::Algorithm>(this->peerManager->getSelf()->getChunkHashAlgorithm()));
    Common::ProtoHelper::setStr(IMAliveMessage, &Protos::Core::IMAlive::set_core_version, Common::Global::getVersionFull());
    IMAliveMessage.set_port(this->UNICAST_PORT);
 
@@ -167,43 +176,95 @@ void UDPListener::sendIMAliveMessage()
    static const int AVERAGE_FIXED_SIZE = 100; // [Byte]. Header size + information in the 'IMAlive' message without the hashes.
    static const quint32 IMALIVE_PERIOD = SETTINGS.get<quint32>("peer_imalive_period") / 1000; // [s]
    static const int FIXED_RATE_PER_PEER = AVERAGE_FIXED_SIZE / IMALIVE_PERIOD; // [Byte/s]
-   static const int HASH_SIZE = Common::Hash::HASH_SIZE + 4; // "4" is the overhead added by protobuff for each hash.
+   static const int HASH_SIZE = Common::Hash::PREFIX_SIZE; // Only the prefixes of the hashes are sent, they are packed without overhead.
+   static const int RESERVED_SIZE = 64; // [Byte]. For the header of the packed field and the few hashes sent entirely, see below.
+   static const int CHUNKS_DIGEST_SIZE = SETTINGS.get<quint32>("chunks_digest_size");
 
    const int numberOfPeers = this->peerManager->getNbOfPeers();
-   const int maxNumberOfHashesToSend = numberOfPeers == 0 ? std::numeric_limits<int>::max() : IMALIVE_PERIOD * (MAX_IMALIVE_THROUGHPUT - numberOfPeers * FIXED_RATE_PER_PEER) / (numberOfPeers * HASH_SIZE);
+   const int variableSize = numberOfPeers == 0 ? std::numeric_limits<int>::max() : IMALIVE_PERIOD * (MAX_IMALIVE_THROUGHPUT - numberOfPeers * FIXED_RATE_PER_PEER) / numberOfPeers; // [Byte].
 
-   int numberOfHashesToSend = (this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - IMAliveMessage.ByteSize() - Common::MessageHeader::HEADER_SIZE) / HASH_SIZE;
+   // The digest of our chunks takes at most half of the variable part of the message, one shard is sent per message.
+   const int digestSize = qMin(CHUNKS_DIGEST_SIZE, qMin(variableSize, this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE) / 2);
+   if (digestSize > 0)
+   {
+      const Common::HashesDigest& digest = this->fileManager->getChunksDigest(this->nextChunksDigestShard++, digestSize);
+      if (!digest.isNull())
+      {
+         Protos::Core::IMAlive::ChunksDigest* chunksDigest = IMAliveMessage.mutable_chunks_digest();
+         chunksDigest->set_nb_shards(digest.getNbShards());
+         chunksDigest->set_shard(digest.getShard());
+         chunksDigest->set_bits(digest.getBits().constData(), digest.getBits().size());
+      }
+   }
+
+   const int maxNumberOfHashesToSend = (variableSize - (IMAliveMessage.has_chunks_digest() ? digestSize : 0)) / HASH_SIZE;
+
+   int numberOfHashesToSend = (this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - IMAliveMessage.ByteSize() - Common::MessageHeader::HEADER_SIZE - RESERVED_SIZE) / HASH_SIZE;
    if (numberOfHashesToSend > maxNumberOfHashesToSend)
       numberOfHashesToSend = maxNumberOfHashesToSend;
+   if (numberOfHashesToSend < 0)
+      numberOfHashesToSend = 0;
+
+   // The chunks found in the digests of the other peers are confirmed first (IDownloadManager::getTheChunksFoundInDigests(..)).
+   this->currentChunkDownloaders = this->downloadManager->getTheChunksFoundInDigests(numberOfHashesToSend);
 
-   // The requested hashes method alternates from the first hashes and the oldest hashes.
+   // Then the requested hashes method alternates from the first hashes and the oldest hashes.
    // We are trying to have the knowledge about who has which chunk for the whole download queue (IDownloadManager::getTheOldestUnfinishedChunks(..))
    // and for the chunks we want to download first (IDownloadManager::getTheFirstUnfinishedChunks(..)).
    switch (this->nextHashRequestType)
    {
    case FIRST_HASHES:
-      this->currentChunkDownloaders = this->downloadManager->getTheFirstUnfinishedChunks(numberOfHashesToSend);
+      this->currentChunkDownloaders << this->downloadManager->getTheFirstUnfinishedChunks(numberOfHashesToSend - this->currentChunkDownloaders.size());
       this->nextHashRequestType = OLDEST_HASHES;
       break;
    case OLDEST_HASHES:
-      this->currentChunkDownloaders = this->downloadManager->getTheOldestUnfinishedChunks(numberOfHashesToSend);
+      this->currentChunkDownloaders << this->downloadManager->getTheOldestUnfinishedChunks(numberOfHashesToSend - this->currentChunkDownloaders.size());
       this->nextHashRequestType = FIRST_HASHES;
       break;
    }
 
-   IMAliveMessage.mutable_chunk()->Reserve(this->currentChunkDownloaders.size());
+   // The chunks are identified by the prefix of their hash. When two different hashes have the same prefix they are sent entirely,
+   // before the other ones, see 'Protos::Core::ChunksOwned'.
+   QHash<quint64, Common::Hash> hashesByPrefix;
+   QSet<quint64> sharedPrefixes;
    for (QListIterator<QSharedPointer<DM::IChunkDownloader>> i(this->currentChunkDownloaders); i.hasNext();)
    {
-      QSharedPointer<DM::IChunkDownloader> chunkDownloader = i.next();
-      IMAliveMessage.add_chunk()->set_hash(chunkDownloader->getHash().getData(), Common::Hash::HASH_SIZE);
+      const Common::Hash& hash = i.next()->getHash();
+      auto j = hashesByPrefix.constFind(hash.getPrefix());
+      if (j == hashesByPrefix.constEnd())
+         hashesByPrefix.insert(hash.getPrefix(), hash);
+      else if (j.value() != hash)
+         sharedPrefixes.insert(hash.getPrefix());
+   }
+
+   if (!sharedPrefixes.isEmpty())
+   {
+      QList<QSharedPointer<DM::IChunkDownloader>> chunkDownloadersWithSharedPrefix;
+      for (QMutableListIterator<QSharedPointer<DM::IChunkDownloader>> i(this->currentChunkDownloaders); i.hasNext();)
+         if (sharedPrefixes.contains(i.next()->getHash().getPrefix()))
+         {
+            chunkDownloadersWithSharedPrefix << i.value();
+            i.remove();
+         }
+      this->currentChunkDownloaders = chunkDownloadersWithSharedPrefix + this->currentChunkDownloaders;
+   }
+
+   IMAliveMessage.mutable_chunk_prefix()->Reserve(this->currentChunkDownloaders.size());
+   QBitArray chunksOwnedBySelf(this->currentChunkDownloaders.size());
+   for (int i = 0; i < this->currentChunkDownloaders.size(); i++)
+   {
+      const QSharedPointer<DM::IChunkDownloader>& chunkDownloader = this->currentChunkDownloaders[i];
+      if (sharedPrefixes.contains(chunkDownloader->getHash().getPrefix()))
+         Common::ProtoHelper::setHash(*IMAliveMessage.add_chunk(), chunkDownloader->getHash());
+      else
+         IMAliveMessage.add_chunk_prefix(chunkDownloader->getHash().getPrefix());
 
       // If we already have the chunk . . .
       QSharedPointer<FM::IChunk> chunk = this->fileManager->getChunk(chunkDownloader->getHash());
       if (!chunk.isNull() && chunk->isComplete())
-         chunkDownloader->addPeer(this->peerManager->getSelf());
-      else
-         chunkDownloader->rmPeer(this->peerManager->getSelf());
+         chunksOwnedBySelf.setBit(i);
    }
+   this->downloadManager->updateChunksOwned(this->peerManager->getSelf(), this->currentChunkDownloaders, chunksOwnedBySelf);
 
    emit IMAliveMessageToBeSend(IMAliveMessage);
 
@@ -244,25 +305,53 @@ void UDPListener::processPendingMulticastDatagrams()
                   Common::ProtoHelper::getStr(IMAliveMessage, &Protos::Core::IMAlive::core_version),
                   IMAliveMessage.download_rate(),
                   IMAliveMessage.upload_rate(),
-                  IMAliveMessage.version()
+                  IMAliveMessage.version(),
+                  static_cast<Common::HashAlgorithm>(IMAliveMessage.chunk_hash_algorithm()) // Warning, enums must be compatible.
                );
 
-               if (IMAliveMessage.chunk_size() > 0)
+               if (IMAliveMessage.has_chunks_digest())
                {
-                  QList<Common::Hash> hashes;
-                  hashes.reserve(IMAliveMessage.chunk_size());
-                  for (int i = 0; i < IMAliveMessage.chunk_size(); i++)
-                     hashes << IMAliveMessage.chunk(i).hash();
+                  const Protos::Core::IMAlive::ChunksDigest& chunksDigest = IMAliveMessage.chunks_digest();
+                  const Common::HashesDigest digest(chunksDigest.shard(), chunksDigest.nb_shards(), QByteArray(chunksDigest.bits().data(), chunksDigest.bits().size()));
+                  PM::IPeer* peer = this->peerManager->getPeer(header.getSenderID());
+                  if (peer && peer->isAvailable() && digest.isValid())
+                     this->downloadManager->chunksDigestReceived(peer, digest);
+               }
 
-                  const QBitArray& bitArray = this->fileManager->haveChunks(hashes);
+               if (IMAliveMessage.chunk_size() > 0 || IMAliveMessage.chunk_prefix_size() > 0)
+               {
+                  // The entire hashes first then the prefixes.
+                  QBitArray chunksOwned(IMAliveMessage.chunk_size() + IMAliveMessage.chunk_prefix_size());
 
-                  if (!bitArray.isNull()) // If we own at least one chunk we reply with a CHUNKS_OWNED message.
+                  if (IMAliveMessage.chunk_size() > 0)
+                  {
+                     QVector<Common::Hash> hashes(IMAliveMessage.chunk_size());
+                     for (int i = 0; i < IMAliveMessage.chunk_size(); i++)
+                        hashes[i] = Common::ProtoHelper::getHash(IMAliveMessage.chunk(i));
+
+                     const QBitArray& bitArray = this->fileManager->haveChunks(hashes);
+                     for (int i = 0; i < bitArray.size(); i++)
+                        if (bitArray.testBit(i))
+                           chunksOwned.setBit(i);
+                  }
+
+                  if (IMAliveMessage.chunk_prefix_size() > 0)
+                  {
+                     QVector<quint64> hashPrefixes(IMAliveMessage.chunk_prefix_size());
+                     for (int i = 0; i < IMAliveMessage.chunk_prefix_size(); i++)
+                        hashPrefixes[i] = IMAliveMessage.chunk_prefix(i);
+
+                     const QBitArray& bitArray = this->fileManager->haveChunks(hashPrefixes);
+                     for (int i = 0; i < bitArray.size(); i++)
+                        if (bitArray.testBit(i))
+                           chunksOwned.setBit(IMAliveMessage.chunk_size() + i);
+                  }
+
+                  if (chunksOwned.count(true) > 0) // If we own at least one chunk we reply with a CHUNKS_OWNED message.
                   {
                      Protos::Core::ChunksOwned chunkOwnedMessage;
                      chunkOwnedMessage.set_tag(IMAliveMessage.tag());
-                     chunkOwnedMessage.mutable_chunk_state()->Reserve(bitArray.size());
-                     for (int i = 0; i < bitArray.size(); i++)
-                        chunkOwnedMessage.add_chunk_state(bitArray[i]);
+                     Common::ProtoHelper::setBits(chunkOwnedMessage, &Protos::Core::ChunksOwned::set_chunk_state, chunksOwned);
                      this->send(Common::MessageHeader::CORE_CHUNKS_OWNED, chunkOwnedMessage, header.getSenderID());
                   }
                }
@@ -279,28 +368,15 @@ void UDPListener::processPendingMulticastDatagrams()
 
                if (peer && peer->isAvailable())
                {
-                  const Protos::Core::Find& findMessage = message.getMessage<Protos::Core::Find>();
-                  QList<QString> extensions;
-                  extensions.reserve(findMessage.pattern().extension_filter_size());
-                  for (int i = 0; i < findMessage.pattern().extension_filter_size(); i++)
-                     extensions << Common::ProtoHelper::getRepeatedStr(findMessage.pattern(), &Protos::Common::FindPattern::extension_filter, i);
-
-                  QList<Protos::Common::FindResult> results =
-                     this->fileManager->find(
-                        Common::ProtoHelper::getStr(findMessage.pattern(), &Protos::Common::FindPattern::pattern),
-                        extensions,
-                        findMessage.pattern().min_size() == 0 ? std::numeric_limits<qint64>::min() : (qint64)findMessage.pattern().min_size(), // According the protocol.
-                        findMessage.pattern().max_size() == 0 ? std::numeric_limits<qint64>::max() : (qint64)findMessage.pattern().max_size(), // According the protocol.
-                        findMessage.pattern().category(),
-                        SETTINGS.get<quint32>("max_number_of_search_result_to_send"),
-                        this->MAX_UDP_DATAGRAM_PAYLOAD_SIZE - Common::MessageHeader::HEADER_SIZE
-                     );
-
-                  for (QMutableListIterator<Protos::Common::FindResult> i(results); i.hasNext();)
+                  switch (this->findPool.find(header.getSenderID(), message.getMessage<Protos::Core::Find>()))
                   {
-                     Protos::Common::FindResult& result = i.next();
-                     result.set_tag(findMessage.tag());
-                     this->send(Common::MessageHeader::CORE_FIND_RESULT, result, header.getSenderID());
+                  case FindPool::RATE_EXCEEDED:
+                     L_WARN(QString("Too many searches from %1, search ignored").arg(peer->toStringLog()));
+                     break;
+                  case FindPool::QUEUE_FULL:
+                     L_WARN(QString("Too many pending searches, the search from %1 is ignored").arg(peer->toStringLog()));
+                     break;
+                  default:;
                   }
                }
             }
@@ -318,6 +394,11 @@ void UDPListener::processPendingMulticastDatagrams()
    }
 }
 
+void UDPListener::sendFindResult(const Common::Hash& peerID, const Protos::Common::FindResult& result)
+{
+   this->send(Common::MessageHeader::CORE_FIND_RESULT, result, peerID);
+}
+
 /**
   * Function called when data is recevied by the socket : The corresponding proto is created and the coresponding event is rised.
   */
@@ -349,17 +430,15 @@ void UDPListener::processPendingUnicastDatagrams()
                   continue;
                }
 
-               if (chunksOwnedMessage.chunk_state_size() != this->currentChunkDownloaders.size())
+               const int expectedSize = (this->currentChunkDownloaders.size() + 7) / 8;
+               if (static_cast<int>(chunksOwnedMessage.chunk_state().size()) != expectedSize)
                {
-                  L_WARN(QString("ChunksOwned : The size (%1) doesn't match the expected one (%2)").arg(chunksOwnedMessage.chunk_state_size()).arg(this->currentChunkDownloaders.size()));
+                  L_WARN(QString("ChunksOwned : The size (%1) doesn't match the expected one (%2)").arg(chunksOwnedMessage.chunk_state().size()).arg(expectedSize));
                   continue;
                }
 
-               for (int i = 0; i < chunksOwnedMessage.chunk_state_size(); i++)
-                  if (chunksOwnedMessage.chunk_state(i))
-                     this->currentChunkDownloaders[i]->addPeer(peer);
-                  else
-                     this->currentChunkDownloaders[i]->rmPeer(peer);
+               const QBitArray& chunksOwned = Common::ProtoHelper::getBits(chunksOwnedMessage, &Protos::Core::ChunksOwned::chunk_state, this->currentChunkDownloaders.size());
+               this->downloadManager->updateChunksOwned(peer, this->currentChunkDownloaders, chunksOwned);
             }
             break;
 
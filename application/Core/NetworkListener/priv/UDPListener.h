@@ -42,6 +42,7 @@
 #include <Core/UploadManager/IUploadManager.h>
 #include <Core/DownloadManager/IDownloadManager.h>
 #include <INetworkListener.h>
+#include <priv/FindPool.h>
 
 namespace NL
 {
@@ -80,6 +81,7 @@ namespace NL
       void sendIMAliveMessage();
       void processPendingMulticastDatagrams();
       void processPendingUnicastDatagrams();
+      void sendFindResult(const Common::Hash& peerID, const Protos::Common::FindResult& result);
 
       void initMulticastUDPSocket();
       void initUnicastUDPSocket();
@@ -104,11 +106,14 @@ namespace NL
       QSharedPointer<UM::IUploadManager> uploadManager;
       QSharedPointer<DM::IDownloadManager> downloadManager;
 
+      FindPool findPool; // The searches of the other peers.
+
       QUdpSocket multicastSocket;
       QUdpSocket unicastSocket;
 
       MTRand mtrand;
       quint64 currentIMAliveTag;
+      quint32 nextChunksDigestShard; // Incremented for each 'IMAlive' message, see 'FM::IFileManager::getChunksDigest(..)'.
       QList<QSharedPointer<DM::IChunkDownloader>> currentChunkDownloaders;
       enum HashRequestType
       {
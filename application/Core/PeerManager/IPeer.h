@@ -95,12 +95,17 @@ namespace PM
       virtual bool isAlive() const = 0;
 
       /**
-        * True if the peer is alive, not blocked and has a compatible protocol version.
+        * True if the peer is alive, not blocked, has a compatible protocol version and hashes its chunks with the same algorithm as us.
         */
       virtual bool isAvailable() const = 0;
 
       virtual quint32 getProtocolVersion() const = 0;
 
+      /**
+        * The algorithm used by the peer to hash its chunks, see the setting 'chunk_hash_algorithm'.
+        */
+      virtual Common::HashAlgorithm getChunkHashAlgorithm() const = 0;
+
       /**
         * Ask for the entries in a given directories.
         * Return a null pointer if the peer is not available.
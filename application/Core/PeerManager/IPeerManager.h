@@ -83,7 +83,8 @@ namespace PM
          const QString& coreVersion,
          quint32 downloadRate,
          quint32 uploadRate,
-         quint32 protocolVersion
+         quint32 protocolVersion,
+         Common::HashAlgorithm chunkHashAlgorithm
       ) = 0;
 
       /**
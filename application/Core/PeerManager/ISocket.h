@@ -49,6 +49,12 @@ namespace PM
       virtual void moveToThread(QThread* targetThread) = 0;
       virtual QString errorString() const = 0;
 
+      /**
+        * Returns the native descriptor of the socket, -1 if there is none.
+        * Used to send data directly to the socket, the data given to 'write(..)' must be written before.
+        */
+      virtual int socketDescriptor() const = 0;
+
       /**
         * Returns the ID of the remote peer on which the socket is connected.
         */
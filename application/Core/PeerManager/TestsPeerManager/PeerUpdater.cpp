@@ -21,6 +21,7 @@
 #include <QtDebug>
 
 #include <Common/Hash.h>
+#include <Common/Constants.h>
 #include <Core/PeerManager/priv/PeerManager.h>
 
 /**
@@ -69,7 +70,9 @@ void PeerUpdater::update()
                this->fileManagers[j]->getAmount(),
                QString(),
                0,
-               0
+               0,
+               Common::Constants::PROTOCOL_VERSION,
+               this->peerManagers[j]->getSelf()->getChunkHashAlgorithm()
             );
       }
    }
@@ -43,7 +43,8 @@ Peer::Peer(PeerManager* peerManager, QSharedPointer<FM::IFileManager> fileManage
    speed(MAX_SPEED),
    alive(false),
    blocked(false),
-   protocolVersion(0)
+   protocolVersion(0),
+   chunkHashAlgorithm(Common::HashAlgorithm::SHA1)
 {
    this->speedTimer.invalidate();
 
@@ -155,6 +156,12 @@ quint32 Peer::getProtocolVersion() const
    return this->protocolVersion;
 }
 
+Common::HashAlgorithm Peer::getChunkHashAlgorithm() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->chunkHashAlgorithm;
+}
+
 void Peer::update(
    const QHostAddress& IP,
    quint16 port,
@@ -163,7 +170,8 @@ void Peer::update(
    const QString& coreVersion,
    quint32 downloadRate,
    quint32 uploadRate,
-   quint32 protocolVersion
+   quint32 protocolVersion,
+   Common::HashAlgorithm chunkHashAlgorithm
 )
 {
    this->alive = true;
@@ -177,10 +185,20 @@ void Peer::update(
    this->downloadRate = downloadRate;
    this->uploadRate = uploadRate;
    this->protocolVersion = protocolVersion;
+   this->chunkHashAlgorithm = chunkHashAlgorithm;
 
    this->connectionPool.setIP(this->IP, this->port);
 }
 
+/**
+  * The chunk hashes of a peer using another algorithm can't match ours, it's as incompatible as a peer with another protocol version.
+  */
+bool Peer::isVersionCompatible() const
+{
+   static const Common::HashAlgorithm CHUNK_HASH_ALGORITHM = static_cast<Common::HashAlgorithm>(SETTINGS.get<quint32>("chunk_hash_algorithm"));
+   return this->protocolVersion == Common::Constants::PROTOCOL_VERSION && this->chunkHashAlgorithm == CHUNK_HASH_ALGORITHM;
+}
+
 void Peer::setAsDead()
 {
    this->aliveTimer.stop();
@@ -71,6 +71,7 @@ namespace PM
       virtual bool isAlive() const;
       virtual bool isAvailable() const;
       virtual quint32 getProtocolVersion() const;
+      virtual Common::HashAlgorithm getChunkHashAlgorithm() const;
       virtual void update(
          const QHostAddress& IP,
          quint16 port,
@@ -79,7 +80,8 @@ namespace PM
          const QString& coreVersion,
          quint32 downloadRate,
          quint32 uploadRate,
-         quint32 protocolVersion
+         quint32 protocolVersion,
+         Common::HashAlgorithm chunkHashAlgorithm
       );
       virtual void setAsDead();
 
@@ -97,7 +99,7 @@ namespace PM
       void unblock();
 
    protected:
-      bool isVersionCompatible() const { return this->protocolVersion == Common::Constants::PROTOCOL_VERSION; }
+      bool isVersionCompatible() const;
 
       mutable QMutex mutex;
 
@@ -123,6 +125,7 @@ namespace PM
       QTimer blockedTimer;
 
       quint32 protocolVersion;
+      Common::HashAlgorithm chunkHashAlgorithm;
    };
 }
 #endif
@@ -127,7 +127,8 @@ void PeerManager::updatePeer(
    const QString& coreVersion,
    quint32 downloadRate,
    quint32 uploadRate,
-   quint32 protocolVersion
+   quint32 protocolVersion,
+   Common::HashAlgorithm chunkHashAlgorithm
 )
 {
    if (ID.isNull() || ID == this->self->getID())
@@ -145,7 +146,7 @@ void PeerManager::updatePeer(
 
    const bool wasDead = !peer->isAlive();
 
-   peer->update(IP, port, nick, sharingAmount, coreVersion, downloadRate, uploadRate, protocolVersion);
+   peer->update(IP, port, nick, sharingAmount, coreVersion, downloadRate, uploadRate, protocolVersion, chunkHashAlgorithm);
 
    if (wasDead && peer->isAvailable())
       emit peerBecomesAvailable(peer);
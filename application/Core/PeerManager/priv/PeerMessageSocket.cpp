@@ -113,6 +113,11 @@ QString PeerMessageSocket::errorString() const
    return this->socket->errorString();
 }
 
+int PeerMessageSocket::socketDescriptor() const
+{
+   return static_cast<int>(this->socket->socketDescriptor());
+}
+
 Common::Hash PeerMessageSocket::getRemotePeerID() const
 {
    return this->MessageSocket::getRemoteID();
@@ -73,6 +73,7 @@ namespace PM
 
       void moveToThread(QThread* targetThread);
       QString errorString() const;
+      int socketDescriptor() const;
 
       Common::Hash getRemotePeerID() const;
 
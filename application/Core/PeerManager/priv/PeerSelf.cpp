@@ -32,6 +32,7 @@ PM::PeerSelf::PeerSelf(PM::PeerManager* peerManager, QSharedPointer<FM::IFileMan
    this->port = SETTINGS.get<quint32>("unicast_base_port");
    this->alive = true;
    this->protocolVersion = Common::Constants::PROTOCOL_VERSION;
+   this->chunkHashAlgorithm = static_cast<Common::HashAlgorithm>(SETTINGS.get<quint32>("chunk_hash_algorithm"));
 
    this->connectionPool.setIP(this->IP, this->port);
 
@@ -164,8 +164,9 @@ void RemoteConnection::refresh()
       protoPeer->set_upload_rate(peer->getUploadRate());
       Common::ProtoHelper::setIP(*protoPeer->mutable_ip(), peer->getIP());
       protoPeer->set_status(
-         peer->getProtocolVersion() == Common::Constants::PROTOCOL_VERSION ? Protos::GUI::State::Peer::OK :
-         (peer->getProtocolVersion() < Common::Constants::PROTOCOL_VERSION ? Protos::GUI::State::Peer::VERSION_OUTDATED : Protos::GUI::State::Peer::MORE_RECENT_VERSION)
+         peer->getProtocolVersion() == Common::Constants::PROTOCOL_VERSION ?
+            (peer->getChunkHashAlgorithm() == this->peerManager->getSelf()->getChunkHashAlgorithm() ? Protos::GUI::State::Peer::OK : Protos::GUI::State::Peer::CHUNK_HASH_ALGORITHM_MISMATCH) :
+            (peer->getProtocolVersion() < Common::Constants::PROTOCOL_VERSION ? Protos::GUI::State::Peer::VERSION_OUTDATED : Protos::GUI::State::Peer::MORE_RECENT_VERSION)
       );
    }
 
@@ -228,6 +229,14 @@ void RemoteConnection::refresh()
    stats->set_progress(this->fileManager->getProgress());
    stats->set_download_rate(downloadRate);
    stats->set_upload_rate(uploadRate);
+   stats->set_download_rate_limit(this->downloadManager->getDownloadRateLimit());
+   stats->set_upload_rate_limit(this->uploadManager->getUploadRateLimit());
+   stats->set_number_of_downloads(this->downloadManager->getNumberOfDownloads());
+   stats->set_download_concurrency(this->downloadManager->getDownloadConcurrency());
+   stats->set_remaining_time(this->downloadManager->getRemainingTime());
+   const QPair<quint64, quint64> findCacheStats = this->fileManager->getFindCacheStats();
+   stats->set_find_cache_hits(findCacheStats.first);
+   stats->set_find_cache_misses(findCacheStats.second);
 
    // Network interfaces.
    const QString& adressToListenStr = SETTINGS.get<QString>("listen_address");
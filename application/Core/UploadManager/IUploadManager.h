@@ -35,6 +35,11 @@ namespace UM
         * @return Byte/s.
         */
       virtual int getUploadRate() = 0;
+
+      /**
+        * @return The current limit of the upload rate [byte/s], 0 if unlimited.
+        */
+      virtual int getUploadRateLimit() = 0;
    };
 }
 #endif
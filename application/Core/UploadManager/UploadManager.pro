@@ -21,6 +21,12 @@ SOURCES += priv/UploadManager.cpp \
     priv/Log.cpp \
     priv/ChunkUploader.cpp \
     priv/Builder.cpp
+
+linux|linux-g++* {
+   SOURCES += priv/UploadReactor.cpp
+   HEADERS += priv/UploadReactor.h
+}
+
 HEADERS += IUploadManager.h \
     priv/UploadManager.h \
     Builder.h \
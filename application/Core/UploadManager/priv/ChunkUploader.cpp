@@ -19,6 +19,11 @@
 #include <priv/ChunkUploader.h>
 using namespace UM;
 
+#ifdef Q_OS_LINUX
+   #include <errno.h>
+   #include <sys/socket.h>
+#endif
+
 #include <QCoreApplication>
 
 #include <Common/Settings.h>
@@ -28,11 +33,13 @@ using namespace UM;
 /**
   * Un chunk uploader will write a given chunk to a given socket.
   * This operation is threaded and must be run by a 'Common::ThreadPool'.
+  * On Linux the data are sent without blocking by a thread of 'UploadReactor' shared with the other uploads,
+  * see 'begin()', 'send(..)' and 'end(..)'.
   */
 
 quint64 ChunkUploader::currentID(1);
 
-ChunkUploader::ChunkUploader(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket, Common::TransferRateCalculator& transferRateCalculator) :
+ChunkUploader::ChunkUploader(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter) :
    Common::Timeoutable(SETTINGS.get<quint32>("upload_lifetime")),
    mainThread(QThread::currentThread()),
    ID(currentID++),
@@ -40,8 +47,12 @@ ChunkUploader::ChunkUploader(const QSharedPointer<FM::IChunk>& chunk, int offset
    offset(offset),
    socket(socket),
    transferRateCalculator(transferRateCalculator),
+   bandwidthLimiter(bandwidthLimiter),
+   peerID(socket->getRemotePeerID()),
    closeTheSocket(false),
-   toStop(false)
+   toStop(false),
+   socketDescriptor(-1),
+   zeroCopy(false)
 {
 }
 
@@ -58,7 +69,7 @@ quint64 ChunkUploader::getID() const
 
 Common::Hash ChunkUploader::getPeerID() const
 {
-   return this->socket->getRemotePeerID();
+   return this->peerID;
 }
 
 int ChunkUploader::getProgress() const
@@ -84,6 +95,7 @@ void ChunkUploader::init(QThread* thread)
 
 /**
   * Called by the thread pool ('Common::ThreadPool') in another thread.
+  * Not used on Linux, see 'UploadReactor'.
   */
 void ChunkUploader::run()
 {
@@ -98,11 +110,25 @@ void ChunkUploader::run()
       QSharedPointer<FM::IDataReader> reader = this->chunk->getDataReader();
 
       char buffer[BUFFER_SIZE];
-      int bytesRead = 0;
 
-      while (bytesRead = reader->read(buffer, this->offset))
+      forever
       {
-         const int bytesSent = this->socket->write(buffer, bytesRead);
+         const int bytesAllowed = this->bandwidthLimiter.acquire(this, this->peerID, BUFFER_SIZE);
+         if (bytesAllowed == 0)
+         {
+            if (this->isStopped())
+               goto end;
+            continue;
+         }
+
+         const int bytesRead = reader->read(buffer, this->offset);
+         if (bytesRead == 0)
+         {
+            this->bandwidthLimiter.giveBack(this, bytesAllowed);
+            break;
+         }
+
+         const int bytesSent = this->socket->write(buffer, qMin(bytesRead, bytesAllowed));
 
          if (bytesSent == -1)
          {
@@ -111,14 +137,10 @@ void ChunkUploader::run()
             goto end;
          }
 
-         this->mutex.lock();
-         if (this->toStop)
-         {
-            this->mutex.unlock();
+         this->bandwidthLimiter.giveBack(this, bytesAllowed - bytesSent);
+
+         if (!this->addBytesSent(bytesSent))
             goto end;
-         }
-         this->offset += bytesSent;
-         this->mutex.unlock();
 
          while (socket->bytesToWrite() > SOCKET_BUFFER_SIZE)
          {
@@ -160,6 +182,7 @@ end:
 
 void ChunkUploader::finished()
 {
+   this->bandwidthLimiter.removeStream(this);
    this->socket->finished(this->closeTheSocket);
    this->startTimer();
 }
@@ -175,3 +198,176 @@ void ChunkUploader::stop()
    this->toStop = true;
    this->mutex.unlock();
 }
+
+bool ChunkUploader::isStopped() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->toStop;
+}
+
+#ifdef Q_OS_LINUX
+
+int ChunkUploader::getSocketDescriptor() const
+{
+   return this->socketDescriptor;
+}
+
+/**
+  * Called by 'UploadReactor' in its thread before the first call to 'send(..)'.
+  * @return 'false' if the upload can't be done, 'end()' must be called.
+  */
+bool ChunkUploader::begin()
+{
+   L_DEBU(QString("Starting uploading a chunk from offset %1: %2").arg(this->offset).arg(this->chunk->toStringLog()));
+
+   static const bool ZERO_COPY_UPLOAD = SETTINGS.get<bool>("zero_copy_upload");
+   this->zeroCopy = ZERO_COPY_UPLOAD;
+   this->socketDescriptor = this->socket->socketDescriptor();
+   if (this->socketDescriptor == -1)
+   {
+      this->closeTheSocket = true;
+      return false;
+   }
+
+   try
+   {
+      this->reader = this->chunk->getDataReader();
+   }
+   catch(FM::UnableToOpenFileInReadModeException&)
+   {
+      L_WARN("UnableToOpenFileInReadModeException");
+      this->closeTheSocket = true;
+      return false;
+   }
+
+   return true;
+}
+
+/**
+  * Send at most 'window' bytes without blocking, called by 'UploadReactor' in its thread when the socket can be written.
+  * The first calls may only write the data pending in 'socket'.
+  * The data are sent directly from the file by 'FM::IDataReader::send(..)' if possible, otherwise they are read into
+  * 'buffer' ('buffer_size_reading' bytes). The bytes read but not accepted by the socket will be read again.
+  * @param waitTime Set to the time [ms] the socket mustn't be written because of the bandwidth limit, 0 otherwise.
+  * @return 'false' when the upload is finished: the chunk has been sent, the upload has been stopped or an error occured.
+  */
+bool ChunkUploader::send(char* buffer, int window, int& waitTime)
+{
+   // The data written before by the socket (the 'GetChunkResult' message) must be sent first. The socket can be written
+   // thus 'waitForBytesWritten(0)' doesn't block, the remaining data will be written the next time.
+   if (this->socket->bytesToWrite() > 0)
+   {
+      waitTime = 0;
+      if (!this->socket->waitForBytesWritten(0))
+      {
+         L_WARN(QString("Socket: cannot write data, error: \"%1\", chunk: %2").arg(this->socket->errorString()).arg(this->chunk->toStringLog()));
+         this->closeTheSocket = true;
+         return false;
+      }
+      if (this->socket->bytesToWrite() > 0)
+         return !this->isStopped();
+   }
+
+   window = this->bandwidthLimiter.request(this, this->peerID, window, waitTime);
+   if (window == 0)
+      return !this->isStopped();
+
+   int bytesSentTotal = 0;
+   try
+   {
+      while (bytesSentTotal < window)
+      {
+         int bytesSent;
+
+         if (this->zeroCopy)
+         {
+            bytesSent = this->reader->send(this->socketDescriptor, this->offset, window - bytesSentTotal);
+            if (bytesSent == FM::IDataReader::NOT_SUPPORTED)
+            {
+               this->zeroCopy = false;
+               continue;
+            }
+         }
+         else
+         {
+            const int bytesRead = this->reader->read(buffer, this->offset);
+            if (bytesRead == 0)
+               return false;
+
+            bytesSent = ::send(this->socketDescriptor, buffer, qMin(bytesRead, window - bytesSentTotal), MSG_NOSIGNAL);
+            if (bytesSent == -1)
+            {
+               if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+               {
+                  L_WARN(QString("Socket: cannot send data, error: %1, chunk: %2").arg(errno).arg(this->chunk->toStringLog()));
+                  this->closeTheSocket = true;
+                  return false;
+               }
+               bytesSent = FM::IDataReader::WOULD_BLOCK;
+            }
+         }
+
+         if (bytesSent == 0) // The whole chunk has been sent.
+            return false;
+
+         if (bytesSent == FM::IDataReader::WOULD_BLOCK)
+            break;
+
+         if (!this->addBytesSent(bytesSent))
+            return false;
+
+         this->transferRateCalculator.addData(bytesSent);
+         bytesSentTotal += bytesSent;
+      }
+   }
+   catch(FM::IOErrorException&)
+   {
+      L_WARN("IOErrorException");
+      this->closeTheSocket = true;
+      return false;
+   }
+   catch (FM::ChunkDeletedException)
+   {
+      L_WARN("ChunkDeletedException");
+      this->closeTheSocket = true;
+      return false;
+   }
+   catch (FM::ChunkDataUnknownException)
+   {
+      L_WARN("ChunkDataUnknownException");
+      this->closeTheSocket = true;
+      return false;
+   }
+
+   this->bandwidthLimiter.giveBack(this, window - bytesSentTotal);
+   return true;
+}
+
+/**
+  * Called by 'UploadReactor' in its thread when the upload is over, 'finished()' must be called next in the main thread.
+  * @param closeTheSocket Set when the upload is aborted, for example if the socket can't be written for too long.
+  */
+void ChunkUploader::end(bool closeTheSocket)
+{
+   if (closeTheSocket)
+      this->closeTheSocket = true;
+
+   this->reader.clear();
+   this->socket->moveToThread(this->mainThread);
+}
+
+#endif
+
+/**
+  * @return 'false' if the upload has been stopped.
+  */
+bool ChunkUploader::addBytesSent(int bytesSent)
+{
+   QMutexLocker locker(&this->mutex);
+
+   if (this->toStop)
+      return false;
+
+   this->offset += bytesSent;
+   return true;
+}
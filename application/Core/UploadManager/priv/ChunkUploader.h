@@ -24,6 +24,7 @@
 
 #include <Common/Timeoutable.h>
 #include <Common/TransferRateCalculator.h>
+#include <Common/BandwidthLimiter.h>
 #include <Common/IRunnable.h>
 #include <Core/FileManager/Exceptions.h>
 #include <Core/FileManager/IChunk.h>
@@ -39,7 +40,7 @@ namespace UM
       static quint64 currentID; ///< Used to generate the new upload ID.
 
    public:
-      ChunkUploader(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket, Common::TransferRateCalculator& transferRateCalculator);
+      ChunkUploader(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket, Common::TransferRateCalculator& transferRateCalculator, Common::BandwidthLimiter& bandwidthLimiter);
       ~ChunkUploader();
 
       quint64 getID() const;
@@ -51,8 +52,18 @@ namespace UM
       void run();
       void finished();
       void stop();
+      bool isStopped() const;
+
+#ifdef Q_OS_LINUX
+      int getSocketDescriptor() const;
+      bool begin();
+      bool send(char* buffer, int window, int& waitTime);
+      void end(bool closeTheSocket = false);
+#endif
 
    private:
+      bool addBytesSent(int bytesSent);
+
       mutable QMutex mutex;
 
       QThread* mainThread;
@@ -63,9 +74,16 @@ namespace UM
       QSharedPointer<PM::ISocket> socket;
 
       Common::TransferRateCalculator& transferRateCalculator;
+      Common::BandwidthLimiter& bandwidthLimiter;
+      const Common::Hash peerID;
 
       bool closeTheSocket;
       bool toStop;
+
+      // Used by 'UploadReactor'.
+      QSharedPointer<FM::IDataReader> reader;
+      int socketDescriptor;
+      bool zeroCopy; ///< Set to 'false' if 'FM::IDataReader::send(..)' isn't supported.
    };
 }
 
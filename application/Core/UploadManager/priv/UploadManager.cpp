@@ -20,6 +20,7 @@
 using namespace UM;
 
 #include <QSharedPointer>
+#include <QTime>
 
 #include <Protos/core_protocol.pb.h>
 
@@ -37,14 +38,30 @@ using namespace UM;
   * After the chunk was sent to the peer the Uploader is deleted.
   *
   * We cannot use a QThreadPool object instead of the class 'Uploader' because we have to use the method 'PM::ISocket::moveToThread' when using a socket in a thread. This isn't possible with the 'QRunnable' class.
+  *
+  * On Linux all the uploads are sent by the few threads of 'UploadReactor' instead of one thread per upload.
+  *
+  * The throughput of the uploads is limited by a 'Common::BandwidthLimiter' (settings 'upload_rate_limit*').
   */
 
 LOG_INIT_CPP(UploadManager)
 
 UploadManager::UploadManager(QSharedPointer<PM::IPeerManager> peerManager) :
+#ifdef Q_OS_LINUX
+   peerManager(peerManager)
+{
+#else
    peerManager(peerManager), threadPool(static_cast<int>(SETTINGS.get<quint32>("upload_min_nb_thread")), SETTINGS.get<quint32>("upload_thread_lifetime"))
 {
    this->threadPool.setStackSize(MIN_UPLOAD_THREAD_STACK_SIZE + SETTINGS.get<quint32>("buffer_size_reading"));
+#endif
+   this->bandwidthLimiter.setLimits(SETTINGS.get<quint32>("upload_rate_limit"), SETTINGS.get<quint32>("upload_rate_limit_per_peer"));
+   this->bandwidthLimiter.setLimitedPeriod(
+      QTime(0, 0).addSecs(60 * SETTINGS.get<quint32>("limited_period_begin")),
+      QTime(0, 0).addSecs(60 * SETTINGS.get<quint32>("limited_period_end")),
+      SETTINGS.get<quint32>("upload_rate_limit_during_period")
+   );
+
    connect(this->peerManager.data(), SIGNAL(getChunk(QSharedPointer<FM::IChunk>, int, QSharedPointer<PM::ISocket>)), this, SLOT(getChunk(QSharedPointer<FM::IChunk>, int, QSharedPointer<PM::ISocket>)), Qt::DirectConnection);
 }
 
@@ -52,7 +69,7 @@ UploadManager::~UploadManager()
 {
    L_DEBU("UploadManager deleted");
 
-   // We stop all uploads to avoid the thread pool to wait that all threads have finished their job.
+   // We stop all uploads to avoid the thread pool (or the reactor) to wait that all threads have finished their job.
    for (QListIterator<QSharedPointer<ChunkUploader>> i(this->uploads); i.hasNext();)
       i.next()->stop();
 }
@@ -72,12 +89,21 @@ int UploadManager::getUploadRate()
    return this->transferRateCalculator.getTransferRate();
 }
 
+int UploadManager::getUploadRateLimit()
+{
+   return this->bandwidthLimiter.getRate();
+}
+
 void UploadManager::getChunk(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket)
 {
-   QSharedPointer<ChunkUploader> upload(new ChunkUploader(chunk, offset, socket, this->transferRateCalculator));
+   QSharedPointer<ChunkUploader> upload(new ChunkUploader(chunk, offset, socket, this->transferRateCalculator, this->bandwidthLimiter));
    connect(upload.data(), SIGNAL(timeout()), this, SLOT(uploadTimeout()));
    this->uploads << upload;
+#ifdef Q_OS_LINUX
+   this->uploadReactor.addUpload(upload);
+#else
    this->threadPool.run(upload.toWeakRef());
+#endif
 }
 
 void UploadManager::uploadTimeout()
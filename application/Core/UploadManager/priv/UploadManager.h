@@ -26,11 +26,16 @@
 #include <Common/Hash.h>
 #include <Common/ThreadPool.h>
 #include <Common/TransferRateCalculator.h>
+#include <Common/BandwidthLimiter.h>
 #include <Core/PeerManager/IPeerManager.h>
 
 #include <IUploadManager.h>
 #include <priv/Log.h>
 
+#ifdef Q_OS_LINUX
+   #include <priv/UploadReactor.h>
+#endif
+
 namespace UM
 {
    class ChunkUploader;
@@ -45,6 +50,7 @@ namespace UM
       QList<IChunkUploader*> getChunkUploaders() const;
 
       int getUploadRate();
+      int getUploadRateLimit();
 
    private slots:
       void getChunk(const QSharedPointer<FM::IChunk>& chunk, int offset, const QSharedPointer<PM::ISocket>& socket);
@@ -56,12 +62,17 @@ namespace UM
       static const quint32 MIN_UPLOAD_THREAD_STACK_SIZE;
 
       Common::TransferRateCalculator transferRateCalculator;
+      Common::BandwidthLimiter bandwidthLimiter;
 
       QSharedPointer<PM::IPeerManager> peerManager;
 
       QList<QSharedPointer<ChunkUploader>> uploads;
 
+#ifdef Q_OS_LINUX
+      UploadReactor uploadReactor;
+#else
       Common::ThreadPool threadPool;
+#endif
    };
 }
 #endif
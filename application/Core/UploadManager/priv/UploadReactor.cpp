@@ -0,0 +1,371 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include <priv/UploadReactor.h>
+using namespace UM;
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <Common/Settings.h>
+
+#include <priv/ChunkUploader.h>
+#include <priv/Log.h>
+
+/**
+  * @class UM::UploadReactor
+  *
+  * Send the data of all the uploads with a few threads ('number_of_upload_thread') instead of one thread per upload.
+  * Each thread waits with 'epoll' that one of its sockets can be written and sends at most 'socket_buffer_size' bytes
+  * to it before serving the next one (see 'ChunkUploader::send(..)'), the sockets are non-blocking.
+  * When an upload exceeds its share of the bandwidth its socket isn't watched until it gets some tokens.
+  *
+  * An upload is ended when its chunk has been sent, when it's stopped or when its socket can't be written during 'socket_timeout'.
+  * Then 'ChunkUploader::finished()' is called in the main thread, like with 'Common::ThreadPool'.
+  *
+  * Linux only.
+  */
+
+UploadReactor::UploadReactor()
+{
+   const int nbThreads = SETTINGS.get<quint32>("number_of_upload_thread");
+   for (int i = 0; i < nbThreads; i++)
+      this->workers << new Worker(this);
+}
+
+/**
+  * The current uploads are ended but 'ChunkUploader::finished()' isn't called.
+  */
+UploadReactor::~UploadReactor()
+{
+   foreach (Worker* worker, this->workers)
+      worker->stop();
+
+   foreach (Worker* worker, this->workers)
+   {
+      worker->wait();
+      delete worker;
+   }
+}
+
+/**
+  * The upload is given to the thread having the least uploads.
+  */
+void UploadReactor::addUpload(const QSharedPointer<ChunkUploader>& upload)
+{
+   Worker* worker = this->workers.first();
+   for (QListIterator<Worker*> i(this->workers); i.hasNext();)
+   {
+      Worker* w = i.next();
+      if (w->getNbUploads() < worker->getNbUploads())
+         worker = w;
+   }
+
+   upload->init(worker);
+   worker->addUpload(upload);
+}
+
+void UploadReactor::processFinishedUploads()
+{
+   this->mutex.lock();
+   const QList<QSharedPointer<ChunkUploader>> uploads = this->finishedUploads;
+   this->finishedUploads.clear();
+   this->mutex.unlock();
+
+   for (QListIterator<QSharedPointer<ChunkUploader>> i(uploads); i.hasNext();)
+      i.next()->finished();
+}
+
+/**
+  * Called by the workers, the upload will be finished in the main thread.
+  */
+void UploadReactor::uploadEnded(const QSharedPointer<ChunkUploader>& upload)
+{
+   QMutexLocker locker(&this->mutex);
+
+   this->finishedUploads << upload;
+   if (this->finishedUploads.size() == 1)
+      QMetaObject::invokeMethod(this, "processFinishedUploads", Qt::QueuedConnection);
+}
+
+/////
+
+UploadReactor::Worker::Worker(UploadReactor* reactor) :
+   reactor(reactor), nbUploads(0), toStop(false)
+{
+   this->epollDescriptor = epoll_create1(0);
+   this->eventDescriptor = eventfd(0, EFD_NONBLOCK);
+
+   if (this->epollDescriptor == -1 || this->eventDescriptor == -1)
+   {
+      L_ERRO(QString("Unable to create the descriptors of the upload thread, error: %1").arg(errno));
+   }
+   else
+   {
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.fd = this->eventDescriptor;
+      epoll_ctl(this->epollDescriptor, EPOLL_CTL_ADD, this->eventDescriptor, &event);
+   }
+
+   this->start();
+}
+
+UploadReactor::Worker::~Worker()
+{
+   if (this->epollDescriptor != -1)
+      close(this->epollDescriptor);
+   if (this->eventDescriptor != -1)
+      close(this->eventDescriptor);
+}
+
+void UploadReactor::Worker::addUpload(const QSharedPointer<ChunkUploader>& upload)
+{
+   QMutexLocker locker(&this->mutex);
+   this->newUploads << upload;
+   this->nbUploads++;
+   eventfd_write(this->eventDescriptor, 1);
+}
+
+int UploadReactor::Worker::getNbUploads() const
+{
+   QMutexLocker locker(&this->mutex);
+   return this->nbUploads;
+}
+
+void UploadReactor::Worker::stop()
+{
+   QMutexLocker locker(&this->mutex);
+   this->toStop = true;
+   eventfd_write(this->eventDescriptor, 1);
+}
+
+void UploadReactor::Worker::run()
+{
+   static const int WINDOW_SIZE = SETTINGS.get<quint32>("socket_buffer_size");
+
+   QVector<char> buffer(SETTINGS.get<quint32>("buffer_size_reading"));
+   epoll_event events[MAX_NB_EVENTS];
+
+   QElapsedTimer timer;
+   timer.start();
+   qint64 lastCheck = 0;
+
+   forever
+   {
+      int timeout = CHECK_PERIOD;
+      if (!this->pausedUploads.isEmpty())
+         timeout = qBound(0, static_cast<int>(this->pausedUploads.firstKey() - timer.elapsed()), timeout);
+
+      const int nbEvents = epoll_wait(this->epollDescriptor, events, MAX_NB_EVENTS, timeout);
+      if (nbEvents == -1 && errno != EINTR)
+      {
+         L_ERRO(QString("epoll_wait(..) failed, error: %1").arg(errno));
+         this->msleep(CHECK_PERIOD);
+      }
+
+      const qint64 now = timer.elapsed();
+
+      this->mutex.lock();
+      const bool stopped = this->toStop;
+      this->mutex.unlock();
+      if (stopped)
+         break;
+
+      for (int i = 0; i < nbEvents; i++)
+      {
+         const int descriptor = events[i].data.fd;
+
+         if (descriptor == this->eventDescriptor)
+         {
+            eventfd_t value;
+            eventfd_read(this->eventDescriptor, &value);
+            this->startNewUploads(now);
+            continue;
+         }
+
+         QHash<int, Stream>::iterator stream = this->streams.find(descriptor);
+         if (stream == this->streams.end())
+            continue;
+
+         int waitTime;
+         if (stream->upload->send(buffer.data(), WINDOW_SIZE, waitTime))
+         {
+            stream->lastActivity = now;
+            if (waitTime > 0)
+               this->pauseUpload(descriptor, now + waitTime);
+         }
+         else
+            this->endUpload(descriptor);
+      }
+
+      this->resumeUploads(now);
+
+      if (now - lastCheck >= CHECK_PERIOD)
+      {
+         this->checkUploads(now);
+         lastCheck = now;
+      }
+   }
+
+   this->endAllUploads();
+}
+
+void UploadReactor::Worker::startNewUploads(qint64 now)
+{
+   this->mutex.lock();
+   const QList<QSharedPointer<ChunkUploader>> uploads = this->newUploads;
+   this->newUploads.clear();
+   this->mutex.unlock();
+
+   for (QListIterator<QSharedPointer<ChunkUploader>> i(uploads); i.hasNext();)
+   {
+      const QSharedPointer<ChunkUploader>& upload = i.next();
+
+      bool started = upload->begin();
+      if (started)
+      {
+         epoll_event event = {};
+         event.events = EPOLLOUT;
+         event.data.fd = upload->getSocketDescriptor();
+         if (epoll_ctl(this->epollDescriptor, EPOLL_CTL_ADD, event.data.fd, &event) == -1)
+         {
+            L_ERRO(QString("Unable to watch the socket of an upload, error: %1").arg(errno));
+            started = false;
+         }
+      }
+
+      if (started)
+      {
+         const Stream stream = { upload, now, -1 };
+         this->streams.insert(upload->getSocketDescriptor(), stream);
+      }
+      else
+      {
+         upload->end(true);
+         this->mutex.lock();
+         this->nbUploads--;
+         this->mutex.unlock();
+         this->reactor->uploadEnded(upload);
+      }
+   }
+}
+
+void UploadReactor::Worker::endUpload(int socketDescriptor, bool closeTheSocket)
+{
+   const Stream stream = this->streams.take(socketDescriptor);
+   const QSharedPointer<ChunkUploader>& upload = stream.upload;
+   if (stream.resumeTime != -1)
+      this->pausedUploads.remove(stream.resumeTime, socketDescriptor);
+
+   epoll_ctl(this->epollDescriptor, EPOLL_CTL_DEL, socketDescriptor, 0);
+   upload->end(closeTheSocket);
+
+   this->mutex.lock();
+   this->nbUploads--;
+   this->mutex.unlock();
+
+   this->reactor->uploadEnded(upload);
+}
+
+/**
+  * The socket isn't watched until 'resumeTime' [ms].
+  */
+void UploadReactor::Worker::pauseUpload(int socketDescriptor, qint64 resumeTime)
+{
+   epoll_event event = {};
+   event.data.fd = socketDescriptor;
+   epoll_ctl(this->epollDescriptor, EPOLL_CTL_MOD, socketDescriptor, &event);
+
+   this->streams[socketDescriptor].resumeTime = resumeTime;
+   this->pausedUploads.insert(resumeTime, socketDescriptor);
+}
+
+void UploadReactor::Worker::resumeUploads(qint64 now)
+{
+   while (!this->pausedUploads.isEmpty() && this->pausedUploads.firstKey() <= now)
+   {
+      const int socketDescriptor = this->pausedUploads.take(this->pausedUploads.firstKey());
+
+      epoll_event event = {};
+      event.events = EPOLLOUT;
+      event.data.fd = socketDescriptor;
+      epoll_ctl(this->epollDescriptor, EPOLL_CTL_MOD, socketDescriptor, &event);
+
+      Stream& stream = this->streams[socketDescriptor];
+      stream.resumeTime = -1;
+      stream.lastActivity = now;
+   }
+}
+
+/**
+  * End the stopped uploads and the ones whose socket can't be written since 'socket_timeout'.
+  */
+void UploadReactor::Worker::checkUploads(qint64 now)
+{
+   static const qint64 SOCKET_TIMEOUT = SETTINGS.get<quint32>("socket_timeout");
+
+   QList<int> stoppedUploads;
+   QList<int> timedOutUploads;
+
+   for (QHashIterator<int, Stream> i(this->streams); i.hasNext();)
+   {
+      i.next();
+      if (i.value().upload->isStopped())
+         stoppedUploads << i.key();
+      else if (now - i.value().lastActivity >= SOCKET_TIMEOUT)
+         timedOutUploads << i.key();
+   }
+
+   for (QListIterator<int> i(stoppedUploads); i.hasNext();)
+      this->endUpload(i.next());
+
+   for (QListIterator<int> i(timedOutUploads); i.hasNext();)
+   {
+      const int socketDescriptor = i.next();
+      L_WARN(QString("Socket: cannot write data (timeout), chunk: %1").arg(this->streams[socketDescriptor].upload->getChunk()->toStringLog()));
+      this->endUpload(socketDescriptor, true);
+   }
+}
+
+/**
+  * The sockets are given back to the main thread, the uploads aren't finished.
+  */
+void UploadReactor::Worker::endAllUploads()
+{
+   for (QHashIterator<int, Stream> i(this->streams); i.hasNext();)
+   {
+      i.next();
+      epoll_ctl(this->epollDescriptor, EPOLL_CTL_DEL, i.key(), 0);
+      i.value().upload->end();
+   }
+   this->streams.clear();
+   this->pausedUploads.clear();
+
+   QMutexLocker locker(&this->mutex);
+   for (QListIterator<QSharedPointer<ChunkUploader>> i(this->newUploads); i.hasNext();)
+      i.next()->end();
+   this->newUploads.clear();
+   this->nbUploads = 0;
+}
@@ -0,0 +1,103 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef UPLOADMANAGER_UPLOADREACTOR_H
+#define UPLOADMANAGER_UPLOADREACTOR_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QList>
+#include <QHash>
+#include <QMultiMap>
+
+#include <Common/Uncopyable.h>
+
+namespace UM
+{
+   class ChunkUploader;
+
+   class UploadReactor : public QObject, Common::Uncopyable
+   {
+      Q_OBJECT
+      static const int MAX_NB_EVENTS = 64; ///< The maximum number of events processed by one call to 'epoll_wait(..)'.
+      static const int CHECK_PERIOD = 500; ///< [ms]. The period to check the stopped uploads and the timeouts.
+
+   public:
+      UploadReactor();
+      ~UploadReactor();
+
+      void addUpload(const QSharedPointer<ChunkUploader>& upload);
+
+   private slots:
+      void processFinishedUploads();
+
+   private:
+      class Worker : public QThread
+      {
+      public:
+         Worker(UploadReactor* reactor);
+         ~Worker();
+
+         void addUpload(const QSharedPointer<ChunkUploader>& upload);
+         int getNbUploads() const;
+         void stop();
+
+      protected:
+         void run();
+
+      private:
+         struct Stream
+         {
+            QSharedPointer<ChunkUploader> upload;
+            qint64 lastActivity; ///< [ms].
+            qint64 resumeTime; ///< [ms]. When the upload is paused because of the bandwidth limit, -1 otherwise.
+         };
+
+         void startNewUploads(qint64 now);
+         void endUpload(int socketDescriptor, bool closeTheSocket = false);
+         void pauseUpload(int socketDescriptor, qint64 resumeTime);
+         void resumeUploads(qint64 now);
+         void checkUploads(qint64 now);
+         void endAllUploads();
+
+         UploadReactor* reactor;
+
+         int epollDescriptor;
+         int eventDescriptor; ///< Used to wake up the thread when there is new uploads or when it must stop.
+
+         QHash<int, Stream> streams; ///< Socket descriptor -> upload. Only used by the thread.
+         QMultiMap<qint64, int> pausedUploads; ///< Resume time [ms] -> socket descriptor. Only used by the thread.
+
+         QList<QSharedPointer<ChunkUploader>> newUploads;
+         int nbUploads;
+         bool toStop;
+         mutable QMutex mutex; ///< Protect 'newUploads', 'nbUploads' and 'toStop'.
+      };
+
+      void uploadEnded(const QSharedPointer<ChunkUploader>& upload);
+
+      QList<Worker*> workers;
+
+      QList<QSharedPointer<ChunkUploader>> finishedUploads;
+      QMutex mutex; ///< Protect 'finishedUploads'.
+   };
+}
+
+#endif
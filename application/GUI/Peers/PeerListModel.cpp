@@ -234,6 +234,8 @@ QVariant PeerListModel::data(const QModelIndex& index, int role) const
             toolTip.append(tr("His protocol version is more recent and incompatible with ours. Upgrade you version!")).append('\n');
          else if (peer->status == Protos::GUI::State::Peer::VERSION_OUTDATED)
             toolTip.append(tr("His protocol version is outaded and incompatible with ours. He should upgrade his version!")).append('\n');
+         else if (peer->status == Protos::GUI::State::Peer::CHUNK_HASH_ALGORITHM_MISMATCH)
+            toolTip.append(tr("His files are hashed with another algorithm, no file can be exchanged with him.")).append('\n');
 
          if (!coreVersion.isEmpty())
             toolTip += tr("Version %1\n").arg(coreVersion);
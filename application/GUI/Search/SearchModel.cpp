@@ -472,10 +472,12 @@ void SearchModel::SearchTree::copyFrom(const SearchModel::SearchTree* otherTree)
 
 bool SearchModel::SearchTree::isSameAs(const Protos::Common::Entry& otherEntry) const
 {
-   if (otherEntry.chunk_size() != this->getItem().chunk_size())
+   if (otherEntry.size() != this->getItem().size())
       return false;
 
-   for (int i = 0; i < otherEntry.chunk_size(); i++)
+   // The search results only have the first chunk hash, older peers send all of them.
+   const int nbChunks = qMin(otherEntry.chunk_size(), this->getItem().chunk_size());
+   for (int i = 0; i < nbChunks; i++)
       if (Common::Hash(otherEntry.chunk(i).hash()) != Common::Hash(this->getItem().chunk(i).hash()))
          return false;
 
@@ -84,8 +84,12 @@ void StatusBar::coreDisconnected()
 
 void StatusBar::newState(const Protos::GUI::State& state)
 {
-   this->setDownloadRate(state.stats().download_rate());
-   this->setUploadRate(state.stats().upload_rate());
+   this->setDownloadRate(state.stats().download_rate(), state.stats().download_rate_limit());
+   QString downloadRateToolTip = QString(tr("Download rate, %1 simultaneous downloads (%2 allowed)")).arg(state.stats().number_of_downloads()).arg(state.stats().download_concurrency());
+   if (state.stats().remaining_time() >= 0)
+      downloadRateToolTip.append('\n').append(QString(tr("Remaining time for the queue: %1")).arg(Common::Global::formatTime(state.stats().remaining_time())));
+   this->ui->lblDownloadRate->setToolTip(downloadRateToolTip);
+   this->setUploadRate(state.stats().upload_rate(), state.stats().upload_rate_limit());
 
    qint64 totalSharing = 0;
    for (int i = 0; i < state.peer_size(); i++)
@@ -101,14 +105,28 @@ void StatusBar::showAbout()
    about.exec();
 }
 
-void StatusBar::setDownloadRate(qint64 rate)
+/**
+  * @param limit The limit of the rate, 0 if unlimited.
+  */
+void StatusBar::setDownloadRate(qint64 rate, qint64 limit)
+{
+   this->ui->lblDownloadRate->setText(formatRate(rate, limit));
+}
+
+/**
+  * @param limit The limit of the rate, 0 if unlimited.
+  */
+void StatusBar::setUploadRate(qint64 rate, qint64 limit)
 {
-   this->ui->lblDownloadRate->setText(Common::Global::formatByteSize(rate).append("/s"));
+   this->ui->lblUploadRate->setText(formatRate(rate, limit));
 }
 
-void StatusBar::setUploadRate(qint64 rate)
+QString StatusBar::formatRate(qint64 rate, qint64 limit)
 {
-   this->ui->lblUploadRate->setText(Common::Global::formatByteSize(rate).append("/s"));
+   QString text = Common::Global::formatByteSize(rate).append("/s");
+   if (limit != 0)
+      text.append(" / ").append(Common::Global::formatByteSize(limit)).append("/s");
+   return text;
 }
 
 void StatusBar::setTotalSharing(int nbPeer, qint64 amount)
@@ -136,6 +154,8 @@ void StatusBar::updateCoreStatus(Protos::GUI::State_Stats_CacheStatus status, in
          break;
       case Protos::GUI::State_Stats_CacheStatus_SCANNING_IN_PROGRESS:
          statusMess.append(" - ").append(tr("scanning in progress . . ."));
+         if (progress > 0)
+            statusMess.append(" ").append(tr("(%1 entries/s)").arg(progress));
          this->ui->prgCurrentAction->setVisible(false);
          break;
       case Protos::GUI::State_Stats_CacheStatus_HASHING_IN_PROGRESS:
@@ -58,8 +58,9 @@ namespace GUI
       void showAbout();
 
    private:
-      void setDownloadRate(qint64 rate);
-      void setUploadRate(qint64 rate);
+      void setDownloadRate(qint64 rate, qint64 limit = 0);
+      void setUploadRate(qint64 rate, qint64 limit = 0);
+      static QString formatRate(qint64 rate, qint64 limit);
       void setTotalSharing(int nbPeer, qint64 amount);
       void updateCoreStatus(Protos::GUI::State_Stats_CacheStatus status = Protos::GUI::State_Stats_CacheStatus_UNKNOWN, int progress = 0);
 
@@ -18,13 +18,24 @@
   
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QByteArray>
 #include <QtCore/QLinkedList>
 #include <QtCore/QElapsedTimer>
 #include <QtCore/QTextStream>
 #include <QtCore/QPair>
 #include <QtCore/QDebug>
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QVector>
 
-#include <Common/Global.h>
+#if defined(Q_OS_LINUX)
+#  include <unistd.h>
+#endif
+
+#include <Common/StringUtils.h>
 
 #define IMPLEMENTATION NEW // OLD or NEW
 
@@ -42,6 +53,23 @@
 QTextStream in(stdin);
 QTextStream out(stdout);
 
+/**
+  * The resident memory of the process, in bytes. Always 0 on the other platforms than Linux.
+  */
+qint64 residentMemory()
+{
+#if defined(Q_OS_LINUX)
+   QFile statm("/proc/self/statm");
+   if (statm.open(QIODevice::ReadOnly))
+   {
+      const QList<QByteArray> values = statm.readAll().split(' ');
+      if (values.size() >= 2)
+         return values[1].toLongLong() * sysconf(_SC_PAGESIZE);
+   }
+#endif
+   return 0;
+}
+
 template <typename T>
 void add(WordIndex<T>& index, const QString& word, const T& item)
 {
@@ -86,7 +114,7 @@ void rm(WordIndex<T>& index, const QString& word, const T& item)
 template <typename T>
 void indexFile(WordIndex<T>& index, const QString& fileName, const T& item)
 {
-   const QStringList& words = Common::Global::splitInWords(fileName);
+   const QStringList& words = Common::StringUtils::splitInWords(fileName);
 
    index.addItem(words, item);
 }
@@ -107,12 +135,8 @@ QString buildItem<QString>(const QFileInfo& entry)
 }
 
 template <typename T>
-void buildIndex(WordIndex<T>& index, const QString& path)
+void scanDir(QLinkedList<QPair<QString, T>>& items, const QString& path)
 {
-   QLinkedList< QPair< QString, T > > items;
-
-   out << "Scanning..." << endl;
-
    QLinkedList<QDir> dirsToVisit;
    dirsToVisit.append(path);
    while (!dirsToVisit.isEmpty())
@@ -122,14 +146,24 @@ void buildIndex(WordIndex<T>& index, const QString& path)
          if (entry.fileName() == "." || entry.fileName() == "..")
             continue;
 
-         items << qMakePair(entry.fileName(), buildItem<T>(entry)); // entry.absoluteFilePath(), entry.fileName()
+         items << qMakePair(entry.fileName(), buildItem<T>(entry));
 
          if (entry.isDir())
             dirsToVisit.append(entry.absoluteFilePath());
       }
    }
+}
+
+template <typename T>
+void buildIndex(WordIndex<T>& index, const QString& path)
+{
+   QLinkedList< QPair< QString, T > > items;
+
+   out << "Scanning..." << endl;
+   scanDir(items, path);
 
    out << "Indexing..." << endl;
+   const qint64 memoryBefore = residentMemory();
    QElapsedTimer t;
    t.start();
 
@@ -141,18 +175,151 @@ void buildIndex(WordIndex<T>& index, const QString& path)
    }
 
    out << n << " items indexed in " << double(t.elapsed()) / 1000 << " s" << endl;
+   out << "Memory used by the index: " << (residentMemory() - memoryBefore) / 1024 << " KiB" << endl;
+}
+
+/**
+  * Index the items in its own thread, like 'FileManager' when it adds the new scanned entries.
+  */
+template <typename T>
+class Indexer : public QThread
+{
+public:
+   Indexer(WordIndex<T>& index, const QLinkedList<QPair<QString, T>>& items) : index(index), items(items) {}
+
+protected:
+   void run()
+   {
+      for (auto i = this->items.begin(); i != this->items.end(); ++i)
+         indexFile(this->index, i->first, i->second);
+   }
+
+private:
+   WordIndex<T>& index;
+   const QLinkedList<QPair<QString, T>>& items;
+};
+
+/**
+  * Search random words until 'toStop' is set, like the searches coming from the other peers.
+  */
+template <typename T>
+class Searcher : public QThread
+{
+public:
+   Searcher(const WordIndex<T>& index, const QVector<QString>& words, QAtomicInt& toStop, uint seed) :
+      index(index), words(words), toStop(toStop), seed(seed), nbSearches(0) {}
+
+   qint64 getNbSearches() const { return this->nbSearches; }
+
+protected:
+   void run()
+   {
+      while (!this->toStop.load())
+      {
+         this->seed = this->seed * 1103515245 + 12345;
+         this->index.search(this->words[(this->seed >> 8) % this->words.size()], 300);
+         this->nbSearches++;
+      }
+   }
+
+private:
+   const WordIndex<T>& index;
+   const QVector<QString>& words;
+   QAtomicInt& toStop;
+   uint seed;
+   qint64 nbSearches;
+};
+
+/**
+  * Measure the number of searches per second made by 'nbThreads' threads while the index is built
+  * and once it is complete.
+  */
+template <typename T>
+void benchmark(int nbThreads, const QStringList& paths)
+{
+   QLinkedList<QPair<QString, T>> items;
+   out << "Scanning..." << endl;
+   foreach (QString path, paths)
+      scanDir(items, path);
+
+   QVector<QString> words;
+   for (auto i = items.begin(); i != items.end(); ++i)
+      foreach (QString word, Common::StringUtils::splitInWords(i->first))
+         words << word;
+
+   if (words.isEmpty())
+   {
+      out << "No word to search" << endl;
+      return;
+   }
+
+   out << items.size() << " items, " << words.size() << " words, " << nbThreads << " search threads" << endl;
+
+   const qint64 memoryBefore = residentMemory();
+   WordIndex<T> index;
+
+   for (int phase = 0; phase < 2; phase++)
+   {
+      QAtomicInt toStop(0);
+      QList<Searcher<T>*> searchers;
+      for (int i = 0; i < nbThreads; i++)
+         searchers << new Searcher<T>(index, words, toStop, i + 1);
+
+      QElapsedTimer t;
+      t.start();
+
+      foreach (Searcher<T>* searcher, searchers)
+         searcher->start();
+
+      if (phase == 0)
+      {
+         Indexer<T> indexer(index, items);
+         indexer.start();
+         indexer.wait();
+      }
+      else
+      {
+         QMutex mutex;
+         QWaitCondition waitCondition;
+         mutex.lock();
+         waitCondition.wait(&mutex, 5000);
+         mutex.unlock();
+      }
+
+      toStop.store(1);
+      qint64 nbSearches = 0;
+      foreach (Searcher<T>* searcher, searchers)
+      {
+         searcher->wait();
+         nbSearches += searcher->getNbSearches();
+         delete searcher;
+      }
+
+      const double time = double(t.elapsed()) / 1000;
+      if (phase == 0)
+         out << "Memory used by the index: " << (residentMemory() - memoryBefore) / 1024 << " KiB" << endl;
+      out << (phase == 0 ? "During indexing" : "After indexing") << ": " << nbSearches << " searches in " << time << " s, " << (time > 0 ? qint64(nbSearches / time) : 0) << " searches/s" << endl;
+   }
 }
 
 void printUsage(int argc, char *argv[])
 {
    QTextStream out(stdout);
-   out << "Usage : " << argv[0] << " <directory>*" << endl
-      << " <directory> : will scan recursively the directory and index each file and folder." << endl;
+   out << "Usage : " << argv[0] << " [-b <nb thread>] <directory>*" << endl
+      << " <directory> : will scan recursively the directory and index each file and folder." << endl
+      << " -b <nb thread> : measure the number of searches per second made concurrently by <nb thread> threads during and after the indexing." << endl;
 }
 
 int main(int argc, char *argv[])
 {
-   if (argc >= 2)
+   if (argc >= 4 && QString(argv[1]) == "-b")
+   {
+      QStringList paths;
+      for (int i = 3; i < argc; i++)
+         paths << argv[i];
+      benchmark<int>(qMax(1, QString(argv[2]).toInt()), paths);
+   }
+   else if (argc >= 2)
    {
       // WordIndex<QString> index; // If a word index of string is used the item corrsponds to fullpath + filename.
       WordIndex<int> index;
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Compare the two ways of uploading a chunk used by 'UM::ChunkUploader':
+# reading the file into a buffer then writing it to the socket and 'sendfile(..)'.
+# Linux only.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = UploadBenchmark
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+include(../../Common/common.pri)
+
+SOURCES += main.cpp
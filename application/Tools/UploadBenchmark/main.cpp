@@ -0,0 +1,237 @@
+/**
+  * D-LAN - A decentralized LAN file sharing software.
+  * Copyright (C) 2010-2012 Greg Burri <greg.burri@gmail.com>
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+  
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+  * Measure the throughput and the CPU time of the two ways of sending a file used by 'UM::ChunkUploader'
+  * over a loopback TCP connection:
+  *  - Copy: the file is read by blocks of 'buffer_size_reading' bytes and each block is written to the socket.
+  *  - Zero-copy: 'sendfile(..)' sends the file directly from the page cache to the socket.
+  * The CPU time is the one of the sending thread, the receiving thread is the same for both.
+  *
+  * Usage: UploadBenchmark [<file size [MiB]> [<directory>]]
+  */
+
+QTextStream out(stdout);
+
+static const int BUFFER_SIZE = 131072; // The default value of 'buffer_size_reading'.
+
+/**
+  * The CPU time used by the current thread [s].
+  */
+double threadCPUTime()
+{
+   timespec t;
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+  * Wait until the non-blocking socket can be written.
+  */
+bool waitSocketWritable(int socket)
+{
+   pollfd socketToPoll = { socket, POLLOUT, 0 };
+   const int nbReady = poll(&socketToPoll, 1, 7000);
+   return nbReady > 0 || nbReady == -1 && errno == EINTR;
+}
+
+/**
+  * Accept one connection and read everything until it's closed.
+  */
+class Receiver : public QThread
+{
+public:
+   Receiver(int server) : server(server), nbBytesReceived(0) {}
+
+   qint64 getNbBytesReceived() const { return this->nbBytesReceived; }
+
+protected:
+   void run()
+   {
+      const int socket = accept(this->server, 0, 0);
+      if (socket == -1)
+         return;
+
+      QVector<char> buffer(1 << 20);
+      ssize_t n;
+      while ((n = recv(socket, buffer.data(), buffer.size(), 0)) > 0)
+         this->nbBytesReceived += n;
+
+      close(socket);
+   }
+
+private:
+   const int server;
+   qint64 nbBytesReceived;
+};
+
+bool sendWithCopy(int file, int socket, qint64 size)
+{
+   QVector<char> buffer(BUFFER_SIZE);
+
+   for (qint64 offset = 0; offset < size;)
+   {
+      const ssize_t bytesRead = pread(file, buffer.data(), buffer.size(), offset);
+      if (bytesRead <= 0)
+         return false;
+
+      for (ssize_t bytesWritten = 0; bytesWritten < bytesRead;)
+      {
+         const ssize_t n = send(socket, buffer.data() + bytesWritten, bytesRead - bytesWritten, 0);
+         if (n == -1)
+         {
+            if (errno != EAGAIN && errno != EWOULDBLOCK || !waitSocketWritable(socket))
+               return false;
+            continue;
+         }
+         bytesWritten += n;
+      }
+
+      offset += bytesRead;
+   }
+
+   return true;
+}
+
+bool sendWithoutCopy(int file, int socket, qint64 size)
+{
+   for (qint64 offset = 0; offset < size;)
+   {
+      off_t fileOffset = offset;
+      const ssize_t n = sendfile(socket, file, &fileOffset, size - offset);
+      if (n == -1)
+      {
+         if (errno != EAGAIN && errno != EWOULDBLOCK || !waitSocketWritable(socket))
+            return false;
+         continue;
+      }
+      if (n == 0)
+         return false;
+
+      offset += n;
+   }
+
+   return true;
+}
+
+/**
+  * Send the file to a receiver through a loopback connection and print the results.
+  */
+bool benchmark(const QString& name, bool (*sendFunction)(int, int, qint64), int file, qint64 size)
+{
+   const int server = socket(AF_INET, SOCK_STREAM, 0);
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   socklen_t addressLength = sizeof address;
+
+   if (server == -1 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof address) || listen(server, 1) || getsockname(server, reinterpret_cast<sockaddr*>(&address), &addressLength))
+   {
+      out << "Unable to create the server socket" << endl;
+      return false;
+   }
+
+   Receiver receiver(server);
+   receiver.start();
+
+   const int sender = socket(AF_INET, SOCK_STREAM, 0);
+   if (sender == -1 || ::connect(sender, reinterpret_cast<sockaddr*>(&address), sizeof address))
+   {
+      out << "Unable to connect to the server socket" << endl;
+      return false;
+   }
+   fcntl(sender, F_SETFL, fcntl(sender, F_GETFL) | O_NONBLOCK); // Like the sockets of Qt.
+
+   QElapsedTimer timer;
+   timer.start();
+   const double cpuTimeBefore = threadCPUTime();
+
+   const bool ok = sendFunction(file, sender, size);
+
+   const double cpuTime = threadCPUTime() - cpuTimeBefore;
+   close(sender);
+   receiver.wait();
+   const double duration = timer.elapsed() / 1000.0;
+   close(server);
+
+   if (!ok || receiver.getNbBytesReceived() != size)
+   {
+      out << name << ": failed, " << receiver.getNbBytesReceived() << " bytes received" << endl;
+      return false;
+   }
+
+   out << name << ": " << QString::number(size / 1048576.0 / duration, 'f', 0) << " MiB/s, " << QString::number(cpuTime / (size / 1073741824.0), 'f', 3) << " s CPU/GiB" << endl;
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   QCoreApplication a(argc, argv);
+
+   const QStringList arguments = a.arguments();
+   const qint64 size = (arguments.size() > 1 ? arguments[1].toLongLong() : 1024) * 1048576;
+   const QString directory = arguments.size() > 2 ? arguments[2] : QDir::tempPath();
+
+   // The file is written once, then it's in the page cache: only the sending is measured.
+   const QByteArray path = QDir(directory).absoluteFilePath("UploadBenchmark.bin").toLocal8Bit();
+   const int file = open(path.constData(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (file == -1)
+   {
+      out << "Unable to create the file: " << path << endl;
+      return 1;
+   }
+
+   out << "Writing " << size / 1048576 << " MiB in " << path << " . . ." << endl;
+   const QVector<char> block(1 << 20, 'D');
+   for (qint64 written = 0; written < size; written += block.size())
+      if (write(file, block.data(), qMin(static_cast<qint64>(block.size()), size - written)) == -1)
+      {
+         out << "Unable to write the file" << endl;
+         return 1;
+      }
+
+   bool ok = true;
+   for (int i = 0; i < 3 && ok; i++)
+   {
+      ok = benchmark("Copy", sendWithCopy, file, size) &&
+           benchmark("Zero-copy", sendWithoutCopy, file, size);
+   }
+
+   close(file);
+   unlink(path.constData());
+
+   return ok ? 0 : 1;
+}